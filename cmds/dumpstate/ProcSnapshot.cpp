@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "ProcSnapshot.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <android-base/unique_fd.h>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+namespace {
+
+// Same limits as the per-section readers used before the snapshot.
+constexpr size_t kMaxNameSize = 253;
+constexpr size_t kMaxWchanSize = 254;
+constexpr size_t kMaxStatSize = 1022;
+
+// Reads up to max_size bytes of the file at name relative to dir_fd with a single read(), which
+// returns the whole file for the small /proc files read here. Returns 0 or the errno value.
+int ReadAt(int dir_fd, const char* name, size_t max_size, std::string* content) {
+    content->clear();
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(openat(dir_fd, name, O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        return errno;
+    }
+    content->resize(max_size);
+    ssize_t ret = TEMP_FAILURE_RETRY(read(fd, &(*content)[0], max_size));
+    if (ret < 0) {
+        int save_errno = errno;
+        content->clear();
+        return save_errno;
+    }
+    content->resize(ret);
+    return 0;
+}
+
+void ReadName(int pid_fd, ProcSnapshot::Process* process) {
+    std::string content;
+    if (ReadAt(pid_fd, "cmdline", kMaxNameSize, &content) == 0) {
+        // Only the first argument, as the arguments are NUL separated.
+        process->name = content.c_str();
+        if (!process->name.empty()) {
+            return;
+        }
+    }
+
+    // If no cmdline, a kernel thread has comm.
+    if (ReadAt(pid_fd, "comm", kMaxNameSize, &content) == 0 && !content.empty()) {
+        const char* comm = content.c_str();
+        process->name = "[" + std::string(comm, strcspn(comm, "\f\b\r\n")) + "]";
+        return;
+    }
+    process->name = "N/A";
+}
+
+void ReadThreads(int pid_fd, ProcSnapshot::Process* process) {
+    int task_fd = TEMP_FAILURE_RETRY(openat(pid_fd, "task", O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (task_fd < 0) {
+        return;
+    }
+    // Takes ownership of task_fd.
+    std::unique_ptr<DIR, decltype(&closedir)> task_dir(fdopendir(task_fd), closedir);
+    if (!task_dir) {
+        close(task_fd);
+        return;
+    }
+
+    // The main thread goes first.
+    process->threads.emplace_back();
+    process->threads.back().tid = process->pid;
+
+    struct dirent* de;
+    while ((de = readdir(task_dir.get()))) {
+        int tid = atoi(de->d_name);
+        if (!tid || tid == process->pid) {
+            continue;
+        }
+        ProcSnapshot::Thread thread;
+        thread.tid = tid;
+        std::string path = std::string(de->d_name) + "/comm";
+        if (ReadAt(task_fd, path.c_str(), kMaxNameSize, &thread.comm) == 0) {
+            // Same trimming as before: everything from the last newline on.
+            size_t newline = thread.comm.rfind('\n');
+            if (newline != std::string::npos) {
+                thread.comm.resize(newline);
+            }
+            thread.comm = thread.comm.c_str();
+        } else {
+            thread.comm = "N/A";
+        }
+        process->threads.push_back(std::move(thread));
+    }
+
+    for (auto& thread : process->threads) {
+        std::string path = std::to_string(thread.tid) + "/wchan";
+        thread.wchan_error = ReadAt(task_fd, path.c_str(), kMaxWchanSize, &thread.wchan);
+    }
+}
+
+// Returns false if the process is gone.
+bool ReadProcess(int proc_fd, ProcSnapshot::Process* process) {
+    std::string pid = std::to_string(process->pid);
+    android::base::unique_fd pid_fd(
+        TEMP_FAILURE_RETRY(openat(proc_fd, pid.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+    if (pid_fd < 0) {
+        return false;
+    }
+    ReadName(pid_fd, process);
+    process->stat_error = ReadAt(pid_fd, "stat", kMaxStatSize, &process->stat);
+    ReadThreads(pid_fd, process);
+    return true;
+}
+
+}  // namespace
+
+bool ProcSnapshot::Collect(const std::string& proc_root, int num_threads) {
+    processes_.clear();
+
+    android::base::unique_fd proc_fd(
+        TEMP_FAILURE_RETRY(open(proc_root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+    if (proc_fd < 0) {
+        return false;
+    }
+    // The listing gets its own descriptor, as closedir() closes it.
+    int list_fd = dup(proc_fd);
+    std::unique_ptr<DIR, decltype(&closedir)> proc_dir(fdopendir(list_fd), closedir);
+    if (!proc_dir) {
+        if (list_fd >= 0) close(list_fd);
+        return false;
+    }
+
+    struct dirent* de;
+    while ((de = readdir(proc_dir.get()))) {
+        int pid = atoi(de->d_name);
+        if (pid) {
+            processes_.emplace_back();
+            processes_.back().pid = pid;
+        }
+    }
+
+    // Every worker claims the next unread process, so slow processes with many threads do not
+    // hold up the others.
+    std::vector<char> alive(processes_.size());
+    std::atomic<size_t> next(0);
+    auto read_processes = [&]() {
+        for (size_t i = next++; i < processes_.size(); i = next++) {
+            alive[i] = ReadProcess(proc_fd, &processes_[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    const size_t num_workers = std::min(static_cast<size_t>(std::max(num_threads, 1)),
+                                        std::max(processes_.size(), static_cast<size_t>(1)));
+    for (size_t i = 1; i < num_workers; i++) {
+        workers.emplace_back(read_processes);
+    }
+    read_processes();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Drops the processes that exited while the snapshot was being collected.
+    size_t count = 0;
+    for (size_t i = 0; i < processes_.size(); i++) {
+        if (alive[i]) {
+            if (count != i) {
+                processes_[count] = std::move(processes_[i]);
+            }
+            count++;
+        }
+    }
+    processes_.resize(count);
+    return true;
+}
+
+size_t ProcSnapshot::thread_count() const {
+    size_t count = 0;
+    for (const auto& process : processes_) {
+        count += process.threads.size();
+    }
+    return count;
+}
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
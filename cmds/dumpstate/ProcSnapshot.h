@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OS_DUMPSTATE_PROCSNAPSHOT_H_
+#define ANDROID_OS_DUMPSTATE_PROCSNAPSHOT_H_
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+/*
+ * In-memory copy of the per-process and per-thread /proc files that dumpstate sections format
+ * from, so that /proc is walked and each file is read only once per bugreport instead of once
+ * per section.
+ *
+ * Typical usage:
+ *
+ *    ProcSnapshot snapshot;
+ *    snapshot.Collect("/proc", 4);
+ *    for (const auto& process : snapshot.processes()) { ... }
+ *
+ */
+class ProcSnapshot {
+  public:
+    struct Thread {
+        int tid = 0;
+        // Contents of task/TID/comm without the trailing newline, or "N/A". Not read for the
+        // main thread, which goes by the name of its process.
+        std::string comm;
+        // Contents of task/TID/wchan, or empty with wchan_error set if it could not be read.
+        std::string wchan;
+        int wchan_error = 0;
+    };
+
+    struct Process {
+        int pid = 0;
+        // The cmdline, or the comm in brackets for kernel threads, or "N/A".
+        std::string name;
+        // Contents of PID/stat, or empty with stat_error set if it could not be read.
+        std::string stat;
+        int stat_error = 0;
+        // The main thread first, followed by the other threads in directory order.
+        std::vector<Thread> threads;
+    };
+
+    /*
+     * Reads the files of every process found under proc_root, spreading the processes over
+     * num_threads threads when it is greater than 1. Returns false if proc_root could not be
+     * opened, in which case the snapshot is empty.
+     */
+    bool Collect(const std::string& proc_root = "/proc", int num_threads = 1);
+
+    // Processes in the order they were listed in proc_root.
+    const std::vector<Process>& processes() const {
+        return processes_;
+    }
+
+    size_t thread_count() const;
+
+  private:
+    std::vector<Process> processes_;
+};
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
+
+#endif  // ANDROID_OS_DUMPSTATE_PROCSNAPSHOT_H_
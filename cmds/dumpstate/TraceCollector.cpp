@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "TraceCollector.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <android-base/unique_fd.h>
+#include <log/log.h>
+
+#include "DumpstateInternal.h"
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+namespace {
+
+// Creates an unnamed file in dir that goes away when closed.
+android::base::unique_fd CreateTempFile(const std::string& dir) {
+    std::string pattern = dir + "/dumptrace_XXXXXX";
+    android::base::unique_fd fd(mkostemp(&pattern[0], O_CLOEXEC));
+    if (fd < 0) {
+        MYLOGE("mkostemp on pattern %s: %s\n", pattern.c_str(), strerror(errno));
+        return fd;
+    }
+    unlink(pattern.c_str());
+    return fd;
+}
+
+void CopyFile(int from_fd, int to_fd) {
+    if (lseek(from_fd, 0, SEEK_SET) < 0) {
+        return;
+    }
+    char buffer[65536];
+    ssize_t bytes_read;
+    while ((bytes_read = TEMP_FAILURE_RETRY(read(from_fd, buffer, sizeof(buffer)))) > 0) {
+        for (ssize_t written = 0; written < bytes_read;) {
+            ssize_t ret = TEMP_FAILURE_RETRY(write(to_fd, buffer + written, bytes_read - written));
+            if (ret <= 0) {
+                return;
+            }
+            written += ret;
+        }
+    }
+}
+
+const char* SkipReason(TraceCollector::Result::Status status) {
+    switch (status) {
+        case TraceCollector::Result::SKIPPED_AFTER_FAILURES:
+            return "too many stack dump failures";
+        case TraceCollector::Result::SKIPPED_AFTER_DEADLINE:
+            return "deadline reached";
+        case TraceCollector::Result::SKIPPED_STOPPED:
+            return "dumpstate stopped";
+        default:
+            return "unknown";
+    }
+}
+
+}  // namespace
+
+TraceCollector::TraceCollector(DumpFunction dump, const std::string& temp_dir,
+                               size_t max_concurrent_dumps, int deadline_sec)
+    : dump_(std::move(dump)),
+      temp_dir_(temp_dir),
+      max_concurrent_dumps_(std::max(max_concurrent_dumps, static_cast<size_t>(1))),
+      deadline_sec_(deadline_sec) {
+}
+
+std::vector<TraceCollector::Result> TraceCollector::Collect(
+    std::vector<Request> requests, int out_fd, const std::function<bool()>& should_stop) {
+    std::sort(requests.begin(), requests.end(),
+              [](const Request& a, const Request& b) { return a.pid < b.pid; });
+
+    const uint64_t start = Nanotime();
+    const uint64_t deadline = start + deadline_sec_ * NANOS_PER_SEC;
+
+    std::vector<Result> results(requests.size());
+    std::vector<android::base::unique_fd> files(requests.size());
+    std::atomic<size_t> next(0);
+    std::atomic<int> failures_in_a_row(0);
+
+    auto dump_requests = [&]() {
+        for (size_t i = next++; i < requests.size(); i = next++) {
+            const Request& request = requests[i];
+            Result& result = results[i];
+            result.pid = request.pid;
+            result.is_java = request.is_java;
+            result.elapsed_ns = 0;
+
+            const uint64_t now = Nanotime();
+            if (should_stop()) {
+                result.status = Result::SKIPPED_STOPPED;
+                continue;
+            }
+            if (failures_in_a_row >= kMaxFailuresInARow) {
+                result.status = Result::SKIPPED_AFTER_FAILURES;
+                continue;
+            }
+            if (now >= deadline) {
+                result.status = Result::SKIPPED_AFTER_DEADLINE;
+                continue;
+            }
+
+            // Rounds up so that a dump starting just before the deadline gets a chance.
+            const int remaining_sec =
+                static_cast<int>((deadline - now + NANOS_PER_SEC - 1) / NANOS_PER_SEC);
+            files[i] = CreateTempFile(temp_dir_);
+            const int ret = files[i] < 0 ? -1
+                                         : dump_(request.pid, request.is_java,
+                                                 std::min(request.timeout_sec, remaining_sec),
+                                                 files[i].get());
+            result.elapsed_ns = Nanotime() - now;
+            if (ret == -1) {
+                result.status = Result::FAILED;
+                failures_in_a_row++;
+            } else {
+                result.status = Result::OK;
+                failures_in_a_row = 0;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    const size_t num_workers = std::min(max_concurrent_dumps_, requests.size());
+    for (size_t i = 1; i < num_workers; i++) {
+        workers.emplace_back(dump_requests);
+    }
+    dump_requests();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    size_t failed = 0, skipped = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        const char* type = result.is_java ? "dalvik" : "native";
+        if (files[i] >= 0) {
+            CopyFile(files[i].get(), out_fd);
+        }
+        switch (result.status) {
+            case Result::OK:
+                break;
+            case Result::FAILED:
+                // For consistency, the header and footer to this message match those
+                // dumped by debuggerd in the success case.
+                dprintf(out_fd, "\n---- pid %d at [unknown] ----\n", result.pid);
+                dprintf(out_fd, "Dump failed, likely due to a timeout.\n");
+                dprintf(out_fd, "---- end %d ----\n", result.pid);
+                failed++;
+                break;
+            default:
+                dprintf(out_fd, "\n---- pid %d at [unknown] ----\n", result.pid);
+                dprintf(out_fd, "Dump skipped: %s.\n", SkipReason(result.status));
+                dprintf(out_fd, "---- end %d ----\n", result.pid);
+                skipped++;
+                continue;
+        }
+        dprintf(out_fd, "[dump %s stack %d: %.3fs elapsed%s]\n", type, result.pid,
+                (float)result.elapsed_ns / NANOS_PER_SEC,
+                result.status == Result::FAILED ? ", failed" : "");
+    }
+
+    dprintf(out_fd, "[dump stacks: %zu processes, %zu failed, %zu skipped, %.3fs elapsed with %zu "
+            "at a time]\n", results.size(), failed, skipped,
+            (float)(Nanotime() - start) / NANOS_PER_SEC, num_workers);
+    return results;
+}
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
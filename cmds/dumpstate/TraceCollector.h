@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OS_DUMPSTATE_TRACECOLLECTOR_H_
+#define ANDROID_OS_DUMPSTATE_TRACECOLLECTOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+/*
+ * Collects stack traces of several processes at once, each into its own temporary file, and then
+ * writes them out in pid order, so that a few hung processes only delay the report by their own
+ * timeout instead of by the sum of them.
+ *
+ * Typical usage:
+ *
+ *    TraceCollector collector(dump_function, "/data/anr", 4, 60);
+ *    collector.Collect(requests, out_fd, should_stop);
+ *
+ */
+class TraceCollector {
+  public:
+    struct Request {
+        int pid;
+        bool is_java;
+        // Longest time the dump of this process may take.
+        int timeout_sec;
+    };
+
+    struct Result {
+        enum Status { OK, FAILED, SKIPPED_AFTER_FAILURES, SKIPPED_AFTER_DEADLINE, SKIPPED_STOPPED };
+
+        int pid;
+        bool is_java;
+        Status status;
+        // Time spent dumping the process, 0 if it was skipped.
+        uint64_t elapsed_ns;
+    };
+
+    // Dumps the traces of a process into fd, giving up after timeout_sec. Returns -1 on failure.
+    // Called from several threads at once.
+    using DumpFunction = std::function<int(int pid, bool is_java, int timeout_sec, int fd)>;
+
+    // Dumps are stopped after this many failures in a row, as debuggerd is then likely dead.
+    static const int kMaxFailuresInARow = 3;
+
+    TraceCollector(DumpFunction dump, const std::string& temp_dir, size_t max_concurrent_dumps,
+                   int deadline_sec);
+
+    /*
+     * Dumps the traces of the requested processes, with at most max_concurrent_dumps at a time,
+     * and appends them to out_fd in pid order, each followed by the time it took. Processes are
+     * skipped once deadline_sec have passed since the start, after kMaxFailuresInARow failures, or
+     * once should_stop returns true. Returns the results in pid order.
+     */
+    std::vector<Result> Collect(std::vector<Request> requests, int out_fd,
+                                const std::function<bool()>& should_stop);
+
+  private:
+    DumpFunction dump_;
+    std::string temp_dir_;
+    size_t max_concurrent_dumps_;
+    int deadline_sec_;
+};
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
+
+#endif  // ANDROID_OS_DUMPSTATE_TRACECOLLECTOR_H_
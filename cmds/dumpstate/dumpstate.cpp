@@ -70,6 +70,7 @@
 #include "DumpstateInternal.h"
 #include "DumpstateSectionReporter.h"
 #include "DumpstateService.h"
+#include "TraceCollector.h"
 #include "dumpstate.h"
 
 using ::android::hardware::dumpstate::V1_0::IDumpstateDevice;
@@ -95,7 +96,9 @@ using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
 using android::os::dumpstate::DumpstateSectionReporter;
 using android::os::dumpstate::GetPidByName;
+using android::os::dumpstate::ProcSnapshot;
 using android::os::dumpstate::PropertiesHelper;
+using android::os::dumpstate::TraceCollector;
 
 typedef Dumpstate::ConsentCallback::ConsentResult UserConsentResult;
 
@@ -132,6 +135,14 @@ static const std::string TOMBSTONE_FILE_PREFIX = "tombstone_";
 static const std::string ANR_DIR = "/data/anr/";
 static const std::string ANR_FILE_PREFIX = "anr_";
 
+// Threads reading /proc for the per-process sections.
+static const int kProcSnapshotThreads = 4;
+
+// Processes whose stacks are dumped at the same time, and the time after which the processes not
+// dumped yet are skipped.
+static const size_t kMaxConcurrentTraceDumps = 4;
+static const int kDumpTracesDeadlineSec = 60;
+
 // TODO: temporary variables and functions used during C++ refactoring
 static Dumpstate& ds = Dumpstate::GetInstance();
 
@@ -1374,8 +1385,16 @@ static Dumpstate::RunStatus dumpstate() {
 
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(for_each_pid, do_showmap, "SMAPS OF ALL PROCESSES");
 
-    for_each_tid(show_wchan, "BLOCKED PROCESS WAIT-CHANNELS");
-    for_each_pid(show_showtime, "PROCESS TIMES (pid cmd user system iowait+percentage)");
+    // Both sections format from one read of /proc, which also makes them agree with each other.
+    ProcSnapshot proc_snapshot;
+    if (!PropertiesHelper::IsDryRun()) {
+        DurationReporter duration_reporter("PROC SNAPSHOT");
+        if (!proc_snapshot.Collect("/proc", kProcSnapshotThreads)) {
+            printf("Failed to open /proc (%s)\n", strerror(errno));
+        }
+    }
+    show_wchans(proc_snapshot, "BLOCKED PROCESS WAIT-CHANNELS");
+    show_showtimes(proc_snapshot, "PROCESS TIMES (pid cmd user system iowait+percentage)");
 
     /* Dump Bluetooth HCI logs */
     ds.AddDir("/data/misc/bluetooth/logs", true);
@@ -1716,13 +1735,11 @@ Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
         return RunStatus::OK;
     }
 
-    // Number of times process dumping has timed out. If we encounter too many
-    // failures, we'll give up.
-    int timeout_failures = 0;
     bool dalvik_found = false;
 
     const std::set<int> hal_pids = get_interesting_hal_pids();
 
+    std::vector<TraceCollector::Request> requests;
     struct dirent* d;
     while ((d = readdir(proc.get()))) {
         RETURN_IF_USER_DENIED_CONSENT();
@@ -1753,36 +1770,21 @@ Dumpstate::RunStatus Dumpstate::DumpTraces(const char** path) {
             continue;
         }
 
-        // If 3 backtrace dumps fail in a row, consider debuggerd dead.
-        if (timeout_failures == 3) {
-            dprintf(fd, "ERROR: Too many stack dump failures, exiting.\n");
-            break;
-        }
-
-        const uint64_t start = Nanotime();
-        const int ret = dump_backtrace_to_file_timeout(
-            pid, is_java_process ? kDebuggerdJavaBacktrace : kDebuggerdNativeBacktrace,
-            is_java_process ? 5 : 20, fd);
-
-        if (ret == -1) {
-            // For consistency, the header and footer to this message match those
-            // dumped by debuggerd in the success case.
-            dprintf(fd, "\n---- pid %d at [unknown] ----\n", pid);
-            dprintf(fd, "Dump failed, likely due to a timeout.\n");
-            dprintf(fd, "---- end %d ----", pid);
-            timeout_failures++;
-            continue;
-        }
-
-        // We've successfully dumped stack traces, reset the failure count
-        // and write a summary of the elapsed time to the file and continue with the
-        // next process.
-        timeout_failures = 0;
-
-        dprintf(fd, "[dump %s stack %d: %.3fs elapsed]\n", is_java_process ? "dalvik" : "native",
-                pid, (float)(Nanotime() - start) / NANOS_PER_SEC);
+        requests.push_back({pid, is_java_process, is_java_process ? 5 : 20});
     }
 
+    // Several processes are dumped at once into their own files, so that hung processes only
+    // delay the others by their own timeout. The traces are then written in pid order.
+    TraceCollector collector(
+        [](int pid, bool is_java, int timeout_sec, int out_fd) {
+            return dump_backtrace_to_file_timeout(
+                pid, is_java ? kDebuggerdJavaBacktrace : kDebuggerdNativeBacktrace, timeout_sec,
+                out_fd);
+        },
+        "/data/anr", kMaxConcurrentTraceDumps, kDumpTracesDeadlineSec);
+    collector.Collect(std::move(requests), fd, [this]() { return IsUserConsentDenied(); });
+    RETURN_IF_USER_DENIED_CONSENT();
+
     if (!dalvik_found) {
         MYLOGE("Warning: no Dalvik processes found to dump stacks\n");
     }
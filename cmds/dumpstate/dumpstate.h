@@ -34,6 +34,7 @@
 #include <ziparchive/zip_writer.h>
 
 #include "DumpstateUtil.h"
+#include "ProcSnapshot.h"
 
 // Workaround for const char *args[MAX_ARGS_ARRAY_SIZE] variables until they're converted to
 // std::vector<std::string>
@@ -568,6 +569,12 @@ void show_wchan(int pid, int tid, const char *name);
 /* Displays a processes times */
 void show_showtime(int pid, const char *name);
 
+/* Displays the in-kernel wait channel of each thread in the snapshot */
+void show_wchans(const android::os::dumpstate::ProcSnapshot& snapshot, const char *header);
+
+/* Displays the times of each process in the snapshot */
+void show_showtimes(const android::os::dumpstate::ProcSnapshot& snapshot, const char *header);
+
 /* Runs "showmap" for a process */
 void do_showmap(int pid, const char *name);
 
@@ -19,23 +19,32 @@
 
 #include "DumpstateInternal.h"
 #include "DumpstateService.h"
+#include "TraceCollector.h"
 #include "android/os/BnDumpstate.h"
 #include "dumpstate.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <dirent.h>
 #include <fcntl.h>
+#include <ftw.h>
 #include <libgen.h>
 #include <signal.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
 #include <thread>
 
 #include <android-base/file.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/test_utils.h>
 #include <cutils/properties.h>
 
 namespace android {
@@ -1773,6 +1782,342 @@ TEST_F(DumpstateUtilTest, FindingPidWithNotExistingProcess) {
     EXPECT_THAT(err, StrEq("can't find the pid\n"));
 }
 
+class ProcSnapshotTest : public Test {
+  public:
+    void TearDown() override {
+        // TemporaryDir only removes the directory itself.
+        nftw(
+            root_.path,
+            [](const char* path, const struct stat*, int, struct FTW*) { return remove(path); },
+            16, FTW_DEPTH | FTW_PHYS);
+    }
+
+  protected:
+    std::string Path(const std::string& relative_path) const {
+        return std::string(root_.path) + "/" + relative_path;
+    }
+
+    void MakeDir(const std::string& relative_path) const {
+        ASSERT_EQ(0, mkdir(Path(relative_path).c_str(), 0700)) << relative_path;
+    }
+
+    void WriteFile(const std::string& relative_path, const std::string& content) const {
+        ASSERT_TRUE(android::base::WriteStringToFile(content, Path(relative_path)))
+            << relative_path;
+    }
+
+    // Lays out a process the way /proc does, with its threads under task/.
+    void AddProcess(int pid, const std::string& cmdline, const std::string& comm,
+                    const std::vector<int>& tids) const {
+        const std::string dir = std::to_string(pid);
+        MakeDir(dir);
+        WriteFile(dir + "/cmdline", cmdline);
+        WriteFile(dir + "/comm", comm + "\n");
+        WriteFile(dir + "/stat", android::base::StringPrintf(
+                                     "%d (%s) S 1 1 0 0 -1 0 0 0 0 0 %d %d 0 0 20 0 1 0 0 0 0 0 0 "
+                                     "0 0 0 0 0 0 0 0 0 17 0 0 0 %d 0 0",
+                                     pid, comm.c_str(), pid * 10, pid, pid));
+        WriteFile(dir + "/wchan", "do_wait");
+        MakeDir(dir + "/task");
+        for (int tid : tids) {
+            const std::string task = dir + "/task/" + std::to_string(tid);
+            MakeDir(task);
+            WriteFile(task + "/comm", comm + ":" + std::to_string(tid) + "\n");
+            WriteFile(task + "/wchan", tid == pid ? "do_wait" : "futex_wait_queue_me");
+        }
+    }
+
+    TemporaryDir root_;
+};
+
+TEST_F(ProcSnapshotTest, MissingRoot) {
+    ProcSnapshot snapshot;
+    EXPECT_FALSE(snapshot.Collect(Path("missing")));
+    EXPECT_THAT(snapshot.processes(), IsEmpty());
+}
+
+TEST_F(ProcSnapshotTest, ReadsEveryProcess) {
+    AddProcess(1, std::string("/system/bin/init\0second_stage", 29), "init", {1});
+    AddProcess(2, "", "kthreadd", {2});
+    AddProcess(42, "system_server", "system_server", {42, 43, 44});
+    // Not a process.
+    WriteFile("meminfo", "MemTotal: 1 kB\n");
+    // A process without a name, stat or wchan.
+    MakeDir("7");
+    MakeDir("7/task");
+    MakeDir("7/task/7");
+
+    ProcSnapshot snapshot;
+    ASSERT_TRUE(snapshot.Collect(root_.path));
+    ASSERT_EQ(4U, snapshot.processes().size());
+    EXPECT_EQ(6U, snapshot.thread_count());
+
+    std::map<int, ProcSnapshot::Process> processes;
+    for (const auto& process : snapshot.processes()) {
+        processes[process.pid] = process;
+    }
+
+    EXPECT_EQ("/system/bin/init", processes[1].name);
+    EXPECT_EQ("[kthreadd]", processes[2].name);
+    EXPECT_EQ("N/A", processes[7].name);
+    EXPECT_EQ("system_server", processes[42].name);
+
+    EXPECT_THAT(processes[42].stat, StartsWith("42 (system_server) S "));
+    EXPECT_EQ(0, processes[42].stat_error);
+    EXPECT_THAT(processes[7].stat, IsEmpty());
+    EXPECT_EQ(ENOENT, processes[7].stat_error);
+
+    const auto& threads = processes[42].threads;
+    ASSERT_EQ(3U, threads.size());
+    EXPECT_EQ(42, threads[0].tid);
+    EXPECT_EQ("do_wait", threads[0].wchan);
+    std::set<int> tids = {threads[1].tid, threads[2].tid};
+    EXPECT_EQ(std::set<int>({43, 44}), tids);
+    for (size_t i = 1; i < threads.size(); i++) {
+        EXPECT_EQ("system_server:" + std::to_string(threads[i].tid), threads[i].comm);
+        EXPECT_EQ("futex_wait_queue_me", threads[i].wchan);
+        EXPECT_EQ(0, threads[i].wchan_error);
+    }
+
+    ASSERT_EQ(1U, processes[7].threads.size());
+    EXPECT_THAT(processes[7].threads[0].wchan, IsEmpty());
+    EXPECT_EQ(ENOENT, processes[7].threads[0].wchan_error);
+}
+
+TEST_F(ProcSnapshotTest, ParallelMatchesSerial) {
+    for (int pid = 100; pid < 164; pid++) {
+        AddProcess(pid, "app_" + std::to_string(pid), "app", {pid, pid + 1000, pid + 2000});
+    }
+
+    ProcSnapshot serial, parallel;
+    ASSERT_TRUE(serial.Collect(root_.path, 1));
+    ASSERT_TRUE(parallel.Collect(root_.path, 4));
+
+    ASSERT_EQ(64U, serial.processes().size());
+    ASSERT_EQ(serial.processes().size(), parallel.processes().size());
+    EXPECT_EQ(serial.thread_count(), parallel.thread_count());
+    for (size_t i = 0; i < serial.processes().size(); i++) {
+        const auto& expected = serial.processes()[i];
+        const auto& actual = parallel.processes()[i];
+        EXPECT_EQ(expected.pid, actual.pid);
+        EXPECT_EQ(expected.name, actual.name);
+        EXPECT_EQ(expected.stat, actual.stat);
+        ASSERT_EQ(expected.threads.size(), actual.threads.size());
+        for (size_t j = 0; j < expected.threads.size(); j++) {
+            EXPECT_EQ(expected.threads[j].tid, actual.threads[j].tid);
+            EXPECT_EQ(expected.threads[j].comm, actual.threads[j].comm);
+            EXPECT_EQ(expected.threads[j].wchan, actual.threads[j].wchan);
+        }
+    }
+}
+
+// Reads a file the way the per-section walks do: open by path, read, close.
+static bool ReadByPath(const std::string& path, char* buffer, size_t size) {
+    int fd = TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = TEMP_FAILURE_RETRY(read(fd, buffer, size)) >= 0;
+    close(fd);
+    return ok;
+}
+
+// Walks the tree once per section like the wait-channel and process-time sections used to,
+// returning the number of threads seen.
+static size_t WalkPerSection(const std::string& root) {
+    size_t threads = 0;
+    char buffer[1024];
+    for (int section = 0; section < 2; section++) {
+        std::unique_ptr<DIR, decltype(&closedir)> d(opendir(root.c_str()), closedir);
+        struct dirent* de;
+        while ((de = readdir(d.get()))) {
+            int pid = atoi(de->d_name);
+            if (!pid) continue;
+            const std::string dir = root + "/" + de->d_name;
+            if (!ReadByPath(dir + "/cmdline", buffer, 253) || !buffer[0]) {
+                ReadByPath(dir + "/comm", buffer, 253);
+            }
+            if (section == 1) {
+                ReadByPath(dir + "/stat", buffer, sizeof(buffer));
+                continue;
+            }
+            std::unique_ptr<DIR, decltype(&closedir)> task(opendir((dir + "/task").c_str()),
+                                                           closedir);
+            ReadByPath(dir + "/wchan", buffer, 255);
+            threads++;
+            struct dirent* te;
+            while ((te = readdir(task.get()))) {
+                int tid = atoi(te->d_name);
+                if (!tid || tid == pid) continue;
+                const std::string task_dir = dir + "/task/" + te->d_name;
+                ReadByPath(task_dir + "/comm", buffer, 253);
+                ReadByPath(task_dir + "/wchan", buffer, 255);
+                threads++;
+            }
+        }
+    }
+    return threads;
+}
+
+TEST_F(ProcSnapshotTest, TimingComparedToPerSectionWalk) {
+    constexpr int kProcesses = 400;
+    constexpr int kThreadsPerProcess = 8;
+    for (int pid = 1000; pid < 1000 + kProcesses; pid++) {
+        std::vector<int> tids;
+        for (int i = 0; i < kThreadsPerProcess; i++) {
+            tids.push_back(pid + i * 100000);
+        }
+        AddProcess(pid, "com.example.app" + std::to_string(pid), "example", tids);
+    }
+
+    using std::chrono::steady_clock;
+    auto elapsed_ms = [](steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+    };
+
+    auto start = steady_clock::now();
+    size_t walked_threads = WalkPerSection(root_.path);
+    double walk_ms = elapsed_ms(start);
+
+    ProcSnapshot serial;
+    start = steady_clock::now();
+    ASSERT_TRUE(serial.Collect(root_.path, 1));
+    double serial_ms = elapsed_ms(start);
+
+    ProcSnapshot parallel;
+    start = steady_clock::now();
+    ASSERT_TRUE(parallel.Collect(root_.path, 4));
+    double parallel_ms = elapsed_ms(start);
+
+    EXPECT_EQ(static_cast<size_t>(kProcesses * kThreadsPerProcess), walked_threads);
+    EXPECT_EQ(walked_threads, serial.thread_count());
+    EXPECT_EQ(walked_threads, parallel.thread_count());
+
+    // Timings vary too much between devices to be asserted on, so they are only reported.
+    printf("%d processes x %d threads: per-section walk %.2fms, snapshot %.2fms, "
+           "snapshot with 4 threads %.2fms\n",
+           kProcesses, kThreadsPerProcess, walk_ms, serial_ms, parallel_ms);
+}
+
+class TraceCollectorTest : public Test {
+  protected:
+    // Dumps a fake trace after delay_ms, failing for the pids in failing_pids_.
+    TraceCollector::DumpFunction FakeDump(int delay_ms) {
+        return [this, delay_ms](int pid, bool is_java, int timeout_sec, int fd) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                max_running_ = std::max(max_running_, ++running_);
+                timeouts_[pid] = timeout_sec;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+            dprintf(fd, "trace of %s %d\n", is_java ? "java" : "native", pid);
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_--;
+            return failing_pids_.count(pid) ? -1 : 0;
+        };
+    }
+
+    std::string Collect(TraceCollector& collector,
+                        const std::vector<TraceCollector::Request>& requests,
+                        std::vector<TraceCollector::Result>* results,
+                        std::function<bool()> should_stop = [] { return false; }) {
+        TemporaryFile out;
+        *results = collector.Collect(requests, out.fd, should_stop);
+        std::string content;
+        android::base::ReadFileToString(out.path, &content);
+        return content;
+    }
+
+    TemporaryDir temp_dir_;
+    std::mutex mutex_;
+    int running_ = 0;
+    int max_running_ = 0;
+    std::map<int, int> timeouts_;
+    std::set<int> failing_pids_;
+};
+
+TEST_F(TraceCollectorTest, WritesTracesInPidOrder) {
+    TraceCollector collector(FakeDump(20), temp_dir_.path, 4, 60);
+    std::vector<TraceCollector::Result> results;
+    std::string out = Collect(collector, {{30, false, 20}, {10, true, 5}, {20, false, 20}}, &results);
+
+    ASSERT_EQ(3U, results.size());
+    EXPECT_EQ(10, results[0].pid);
+    EXPECT_EQ(20, results[1].pid);
+    EXPECT_EQ(30, results[2].pid);
+    for (const auto& result : results) {
+        EXPECT_EQ(TraceCollector::Result::OK, result.status);
+        EXPECT_GT(result.elapsed_ns, 0U);
+    }
+    EXPECT_EQ(5, timeouts_[10]);
+    EXPECT_EQ(20, timeouts_[30]);
+
+    size_t trace10 = out.find("trace of java 10\n[dump dalvik stack 10: ");
+    size_t trace20 = out.find("trace of native 20\n[dump native stack 20: ");
+    size_t trace30 = out.find("trace of native 30\n[dump native stack 30: ");
+    ASSERT_NE(std::string::npos, trace10) << out;
+    ASSERT_NE(std::string::npos, trace20) << out;
+    ASSERT_NE(std::string::npos, trace30) << out;
+    EXPECT_LT(trace10, trace20);
+    EXPECT_LT(trace20, trace30);
+    EXPECT_THAT(out, HasSubstr("[dump stacks: 3 processes, 0 failed, 0 skipped, "));
+}
+
+TEST_F(TraceCollectorTest, BoundsConcurrentDumps) {
+    TraceCollector collector(FakeDump(20), temp_dir_.path, 3, 60);
+    std::vector<TraceCollector::Request> requests;
+    for (int pid = 1; pid <= 12; pid++) {
+        requests.push_back({pid, false, 20});
+    }
+    std::vector<TraceCollector::Result> results;
+    Collect(collector, requests, &results);
+
+    EXPECT_EQ(12U, results.size());
+    EXPECT_LE(max_running_, 3);
+    EXPECT_GT(max_running_, 1);
+}
+
+TEST_F(TraceCollectorTest, StopsAfterFailuresInARow) {
+    failing_pids_ = {1, 2, 3};
+    TraceCollector collector(FakeDump(0), temp_dir_.path, 1, 60);
+    std::vector<TraceCollector::Result> results;
+    std::string out = Collect(collector, {{1, false, 20}, {2, false, 20}, {3, false, 20},
+                                          {4, false, 20}}, &results);
+
+    ASSERT_EQ(4U, results.size());
+    EXPECT_EQ(TraceCollector::Result::FAILED, results[2].status);
+    EXPECT_EQ(TraceCollector::Result::SKIPPED_AFTER_FAILURES, results[3].status);
+    EXPECT_THAT(out, HasSubstr("---- pid 1 at [unknown] ----\n"
+                               "Dump failed, likely due to a timeout.\n"));
+    EXPECT_THAT(out, HasSubstr("Dump skipped: too many stack dump failures.\n---- end 4 ----"));
+    EXPECT_THAT(out, HasSubstr("[dump stacks: 4 processes, 3 failed, 1 skipped, "));
+}
+
+TEST_F(TraceCollectorTest, SkipsProcessesAfterDeadline) {
+    TraceCollector collector(FakeDump(1100), temp_dir_.path, 1, 1);
+    std::vector<TraceCollector::Result> results;
+    std::string out = Collect(collector, {{1, false, 20}, {2, false, 20}}, &results);
+
+    ASSERT_EQ(2U, results.size());
+    EXPECT_EQ(TraceCollector::Result::OK, results[0].status);
+    // The dump is not allowed to run past the deadline.
+    EXPECT_EQ(1, timeouts_[1]);
+    EXPECT_EQ(TraceCollector::Result::SKIPPED_AFTER_DEADLINE, results[1].status);
+    EXPECT_EQ(0U, results[1].elapsed_ns);
+    EXPECT_THAT(out, HasSubstr("Dump skipped: deadline reached.\n---- end 2 ----"));
+}
+
+TEST_F(TraceCollectorTest, SkipsProcessesWhenStopped) {
+    TraceCollector collector(FakeDump(0), temp_dir_.path, 2, 60);
+    std::vector<TraceCollector::Result> results;
+    Collect(collector, {{1, false, 20}, {2, false, 20}}, &results, [] { return true; });
+
+    ASSERT_EQ(2U, results.size());
+    EXPECT_EQ(TraceCollector::Result::SKIPPED_STOPPED, results[0].status);
+    EXPECT_EQ(TraceCollector::Result::SKIPPED_STOPPED, results[1].status);
+    EXPECT_TRUE(timeouts_.empty());
+}
+
 }  // namespace dumpstate
 }  // namespace os
 }  // namespace android
@@ -58,6 +58,7 @@
 // TODO: remove once moved to namespace
 using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
+using android::os::dumpstate::ProcSnapshot;
 using android::os::dumpstate::PropertiesHelper;
 
 // Keep in sync with
@@ -406,13 +407,21 @@ void for_each_tid(for_each_tid_func func, const char *header) {
     __for_each_pid(for_each_tid_helper, header, (void *) func);
 }
 
+static void print_wchan(int pid, int tid, const char *name, const char *wchan) {
+    char name_buffer[255];
+
+    snprintf(name_buffer, sizeof(name_buffer), "%*s%s",
+             pid == tid ? 0 : 3, "", name);
+
+    printf("%-7d %-32s %s\n", tid, name_buffer, wchan);
+}
+
 void show_wchan(int pid, int tid, const char *name) {
     if (PropertiesHelper::IsDryRun()) return;
 
     char path[255];
     char buffer[255];
     int fd, ret, save_errno;
-    char name_buffer[255];
 
     memset(buffer, 0, sizeof(buffer));
 
@@ -431,10 +440,7 @@ void show_wchan(int pid, int tid, const char *name) {
         return;
     }
 
-    snprintf(name_buffer, sizeof(name_buffer), "%*s%s",
-             pid == tid ? 0 : 3, "", name);
-
-    printf("%-7d %-32s %s\n", tid, name_buffer, buffer);
+    print_wchan(pid, tid, name, buffer);
 
     return;
 }
@@ -473,35 +479,12 @@ static void snprdec(char *buffer, size_t len, size_t spc, unsigned permille) {
              "%*s", (spc > offset) ? (int)(spc - offset) : 0, str);
 }
 
-void show_showtime(int pid, const char *name) {
-    if (PropertiesHelper::IsDryRun()) return;
-
-    char path[255];
-    char buffer[1023];
-    int fd, ret, save_errno;
-
-    memset(buffer, 0, sizeof(buffer));
-
-    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
-    if ((fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC))) < 0) {
-        printf("Failed to open '%s' (%s)\n", path, strerror(errno));
-        return;
-    }
-
-    ret = TEMP_FAILURE_RETRY(read(fd, buffer, sizeof(buffer)));
-    save_errno = errno;
-    close(fd);
-
-    if (ret < 0) {
-        printf("Failed to read '%s' (%s)\n", path, strerror(save_errno));
-        return;
-    }
-
+static void print_showtime(int pid, const char *name, const char *stat) {
     // field 14 is utime
     // field 15 is stime
     // field 42 is iotime
     unsigned long long utime = 0, stime = 0, iotime = 0;
-    if (sscanf(buffer,
+    if (sscanf(stat,
                "%*u %*s %*s %*d %*d %*d %*d %*d %*d %*d %*d "
                "%*d %*d %llu %llu %*d %*d %*d %*d %*d %*d "
                "%*d %*d %*d %*d %*d %*d %*d %*d %*d %*d "
@@ -521,6 +504,7 @@ void show_showtime(int pid, const char *name) {
     }
 
     // try to beautify and stabilize columns at <80 characters
+    char buffer[1023];
     snprintf(buffer, sizeof(buffer), "%-6d%s", pid, name);
     if ((name[0] != '[') || utime) {
         snprcent(buffer, sizeof(buffer), 57, utime);
@@ -533,10 +517,81 @@ void show_showtime(int pid, const char *name) {
         snprdec(buffer, sizeof(buffer), 79, permille);
     }
     puts(buffer);  // adds a trailing newline
+}
+
+void show_showtime(int pid, const char *name) {
+    if (PropertiesHelper::IsDryRun()) return;
+
+    char path[255];
+    char buffer[1023];
+    int fd, ret, save_errno;
+
+    memset(buffer, 0, sizeof(buffer));
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    if ((fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC))) < 0) {
+        printf("Failed to open '%s' (%s)\n", path, strerror(errno));
+        return;
+    }
+
+    ret = TEMP_FAILURE_RETRY(read(fd, buffer, sizeof(buffer)));
+    save_errno = errno;
+    close(fd);
+
+    if (ret < 0) {
+        printf("Failed to read '%s' (%s)\n", path, strerror(save_errno));
+        return;
+    }
+
+    print_showtime(pid, name, buffer);
 
     return;
 }
 
+void show_wchans(const ProcSnapshot& snapshot, const char *header) {
+    DurationReporter duration_reporter(header);
+    if (PropertiesHelper::IsDryRun()) return;
+
+    printf("\n------ %s ------\n", header);
+    for (const auto& process : snapshot.processes()) {
+        if (ds.IsUserConsentDenied()) {
+            MYLOGE(
+                "Returning early because user denied consent to share bugreport with calling app.");
+            return;
+        }
+        for (const auto& thread : process.threads) {
+            const char *name = thread.tid == process.pid ? process.name.c_str()
+                                                         : thread.comm.c_str();
+            if (thread.wchan_error) {
+                printf("Failed to read '/proc/%d/wchan' (%s)\n", thread.tid,
+                       strerror(thread.wchan_error));
+                continue;
+            }
+            print_wchan(process.pid, thread.tid, name, thread.wchan.c_str());
+        }
+    }
+}
+
+void show_showtimes(const ProcSnapshot& snapshot, const char *header) {
+    DurationReporter duration_reporter(header);
+    if (PropertiesHelper::IsDryRun()) return;
+
+    printf("\n------ %s ------\n", header);
+    for (const auto& process : snapshot.processes()) {
+        if (ds.IsUserConsentDenied()) {
+            MYLOGE(
+                "Returning early because user denied consent to share bugreport with calling app.");
+            return;
+        }
+        if (process.stat_error) {
+            printf("Failed to read '/proc/%d/stat' (%s)\n", process.pid,
+                   strerror(process.stat_error));
+            continue;
+        }
+        print_showtime(process.pid, process.name.c_str(), process.stat.c_str());
+    }
+}
+
 void do_dmesg() {
     const char *title = "KERNEL LOG (dmesg)";
     DurationReporter duration_reporter(title);
@@ -19,6 +19,7 @@ LOCAL_MULTILIB := both
 LOCAL_MODULE_STEM_32 := flatland
 LOCAL_MODULE_STEM_64 := flatland64
 LOCAL_SHARED_LIBRARIES := \
+    libbase     \
     libEGL      \
     libGLESv2   \
     libcutils   \
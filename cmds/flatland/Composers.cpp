@@ -25,10 +25,10 @@ namespace android {
 class Blitter {
 public:
 
-    bool setUp(GLHelper* helper) {
+    bool setUp(GLHelper* helper, const char* shaderName = "Blit") {
         bool result;
 
-        result = helper->getShaderProgram("Blit", &mBlitPgm);
+        result = helper->getShaderProgram(shaderName, &mBlitPgm);
         if (!result) {
             return false;
         }
@@ -99,6 +99,12 @@ public:
         return true;
     }
 
+    // The program used for blits, for setting the uniforms specific to its
+    // shader before blitting.
+    GLuint getProgram() const {
+        return mBlitPgm;
+    }
+
 private:
     GLuint mBlitPgm;
     GLint mPosAttribLoc;
@@ -282,4 +288,153 @@ Composer* blendShrink() {
     return new BlendShrinkComp();
 }
 
+Composer* roundedCorners() {
+    class RoundedCornersComp : public ComposerBase {
+        virtual bool setUp(GLHelper* helper) {
+            bool result = mBlitter.setUp(helper, "RoundedBlit");
+            if (!result) {
+                return false;
+            }
+
+            GLuint pgm = mBlitter.getProgram();
+            mLayerSizeUniformLoc = glGetUniformLocation(pgm, "layerSize");
+            mCornerRadiusUniformLoc = glGetUniformLocation(pgm, "cornerRadius");
+            return true;
+        }
+
+        virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+            bool result;
+
+            float texMatrix[16];
+            glc->getTransformMatrix(texMatrix);
+
+            float modColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+            int32_t x = mLayerDesc.x;
+            int32_t y = mLayerDesc.y;
+            int32_t w = mLayerDesc.width;
+            int32_t h = mLayerDesc.height;
+
+            // A radius proportional to the layer size, so that the cost
+            // scales with the resolution like the rest of the layer.
+            float radius = float(h < w ? h : w) / 16.0f;
+
+            glUseProgram(mBlitter.getProgram());
+            glUniform2f(mLayerSizeUniformLoc, float(w), float(h));
+            glUniform1f(mCornerRadiusUniformLoc, radius);
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+            result = mBlitter.modBlit(texName, texMatrix, modColor,
+                    x, y, w, h);
+            if (!result) {
+                return false;
+            }
+
+            glDisable(GL_BLEND);
+
+            return true;
+        }
+
+        Blitter mBlitter;
+        GLint mLayerSizeUniformLoc;
+        GLint mCornerRadiusUniformLoc;
+    };
+    return new RoundedCornersComp();
+}
+
+Composer* colorTransform() {
+    class ColorTransformComp : public ComposerBase {
+        virtual bool setUp(GLHelper* helper) {
+            bool result = mBlitter.setUp(helper, "ColorMatrixBlit");
+            if (!result) {
+                return false;
+            }
+
+            mColorMatrixUniformLoc = glGetUniformLocation(
+                    mBlitter.getProgram(), "colorMatrix");
+            return true;
+        }
+
+        virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+            float texMatrix[16];
+            glc->getTransformMatrix(texMatrix);
+
+            // A saturation boost, like the ones applied for display color
+            // modes.
+            const float colorMatrix[16] = {
+                1.18f,  -0.09f, -0.09f, 0.0f,
+                -0.09f, 1.18f,  -0.09f, 0.0f,
+                -0.09f, -0.09f, 1.18f,  0.0f,
+                0.0f,   0.0f,   0.0f,   1.0f,
+            };
+
+            int32_t x = mLayerDesc.x;
+            int32_t y = mLayerDesc.y;
+            int32_t w = mLayerDesc.width;
+            int32_t h = mLayerDesc.height;
+
+            glUseProgram(mBlitter.getProgram());
+            glUniformMatrix4fv(mColorMatrixUniformLoc, 1, GL_FALSE,
+                    colorMatrix);
+
+            return mBlitter.blit(texName, texMatrix, x, y, w, h);
+        }
+
+        Blitter mBlitter;
+        GLint mColorMatrixUniformLoc;
+    };
+    return new ColorTransformComp();
+}
+
+Composer* blurBlend() {
+    class BlurBlendComp : public ComposerBase {
+        virtual bool setUp(GLHelper* helper) {
+            return mBlitter.setUp(helper);
+        }
+
+        // Approximates the cost of a background blur by compositing the
+        // layer once per tap, offset in each direction and additively
+        // blended.
+        virtual bool compose(GLuint texName, const sp<GLConsumer>& glc) {
+            bool result;
+
+            float texMatrix[16];
+            glc->getTransformMatrix(texMatrix);
+
+            const int32_t offsets[][2] = {
+                { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 },
+            };
+            float modColor[4] = { .25f, .25f, .25f, .25f };
+
+            int32_t x = mLayerDesc.x;
+            int32_t y = mLayerDesc.y;
+            int32_t w = mLayerDesc.width;
+            int32_t h = mLayerDesc.height;
+            int32_t radius = h / 128 + 1;
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+
+            for (size_t i = 0; i < NELEMS(offsets); i++) {
+                result = mBlitter.modBlit(texName, texMatrix, modColor,
+                        x + offsets[i][0] * radius, y + offsets[i][1] * radius,
+                        w, h);
+                if (!result) {
+                    glDisable(GL_BLEND);
+                    return false;
+                }
+            }
+
+            glDisable(GL_BLEND);
+
+            return true;
+        }
+
+        Blitter mBlitter;
+    };
+    return new BlurBlendComp();
+}
+
 } // namespace android
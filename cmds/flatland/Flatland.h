@@ -57,6 +57,9 @@ Composer* opaque();
 Composer* opaqueShrink();
 Composer* blend();
 Composer* blendShrink();
+Composer* roundedCorners();
+Composer* colorTransform();
+Composer* blurBlend();
 
 class Renderer {
 public:
@@ -26,9 +26,20 @@
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include <errno.h>
 #include <math.h>
 #include <getopt.h>
 
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
 #include "Flatland.h"
 #include "GLHelper.h"
 
@@ -53,6 +64,10 @@ struct BenchmarkDesc {
     LayerDesc layers[MAX_NUM_LAYERS];
 };
 
+// The scenarios to run, either the UI scenarios below or the generated
+// composition strategy matrix.
+static std::vector<BenchmarkDesc> g_Benchmarks;
+
 static const BenchmarkDesc benchmarks[] = {
     { "16:10 Single Static Window",
         2560, 1600, { 800, 1200, 1600, 2400 },
@@ -238,6 +253,87 @@ static const ShaderDesc shaders[] = {
         },
     },
 
+    {
+        .name="RoundedBlit",
+        .vertexShader={
+            "precision mediump float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "uniform vec2 layerSize;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "    layerCoords = uv.xy * layerSize;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "precision mediump float;",
+            "",
+            "varying vec4 texCoords;",
+            "varying vec2 layerCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "uniform vec2 layerSize;",
+            "uniform float cornerRadius;",
+            "",
+            "void main() {",
+            "    vec2 halfSize = layerSize * 0.5;",
+            "    vec2 dist = max(abs(layerCoords - halfSize) -",
+            "            (halfSize - cornerRadius), 0.0);",
+            "    float coverage = clamp(cornerRadius - length(dist) + 0.5,",
+            "            0.0, 1.0);",
+            "    gl_FragColor = texture2D(blitSrc, texCoords.xy);",
+            "    gl_FragColor *= modColor * coverage;",
+            "}",
+        },
+    },
+
+    {
+        .name="ColorMatrixBlit",
+        .vertexShader={
+            "precision mediump float;",
+            "",
+            "attribute vec4 position;",
+            "attribute vec4 uv;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform mat4 objToNdc;",
+            "uniform mat4 uvToTex;",
+            "",
+            "void main() {",
+            "    gl_Position = objToNdc * position;",
+            "    texCoords = uvToTex * uv;",
+            "}",
+        },
+        .fragmentShader={
+            "#extension GL_OES_EGL_image_external : require",
+            "precision mediump float;",
+            "",
+            "varying vec4 texCoords;",
+            "",
+            "uniform samplerExternalOES blitSrc;",
+            "uniform vec4 modColor;",
+            "uniform mat4 colorMatrix;",
+            "",
+            "void main() {",
+            "    vec4 color = texture2D(blitSrc, texCoords.xy);",
+            "    gl_FragColor = colorMatrix * color;",
+            "    gl_FragColor *= modColor;",
+            "}",
+        },
+    },
+
     {
         .name="Gradient",
         .vertexShader={
@@ -586,8 +682,62 @@ static int cmpDouble(const double* lhs, const double* rhs) {
     return 0;
 }
 
+struct BenchmarkResult {
+    std::string name;
+    uint32_t width;
+    uint32_t height;
+
+    // One of "ok", "fast", "slow", "varies" or "error".
+    const char* status;
+
+    // The time a single frame takes, and the spread between the first and
+    // third quartile of the samples it was computed from.
+    double timeMs;
+    double spreadMs;
+    size_t numSamples;
+};
+
+static std::vector<BenchmarkResult> g_Results;
+static std::vector<BenchmarkResult> g_Baseline;
+
+// Results that differ from the baseline by less than this fraction, or by
+// less than the spread of the samples, are considered unchanged.
+static const double kMinBaselineChange = 0.02;
+
+static const BenchmarkResult* findBaseline(const BenchmarkResult& r) {
+    for (const BenchmarkResult& b : g_Baseline) {
+        if (b.name == r.name && b.width == r.width && b.height == r.height) {
+            return &b;
+        }
+    }
+    return nullptr;
+}
+
+// Print the comparison of a result against the baseline, and return whether
+// it regressed.
+static bool printBaselineComparison(const BenchmarkResult& r) {
+    const BenchmarkResult* b = findBaseline(r);
+    if (b == nullptr || strcmp(b->status, "ok") || strcmp(r.status, "ok")) {
+        printf(" |");
+        return false;
+    }
+
+    double delta = r.timeMs - b->timeMs;
+    double noise = b->spreadMs > r.spreadMs ? b->spreadMs : r.spreadMs;
+    if (noise < kMinBaselineChange * b->timeMs) {
+        noise = kMinBaselineChange * b->timeMs;
+    }
+
+    printf(" | %+6.1f%%", delta / b->timeMs * 100.0);
+    if (fabs(delta) <= noise) {
+        return false;
+    }
+    printf("%s", delta > 0 ? " slower" : " faster");
+    return delta > 0;
+}
+
 // Run a single benchmark and print the result.
-static bool runTest(const BenchmarkDesc b, size_t run) {
+static bool runTest(const BenchmarkDesc& b, size_t run, bool* outRegressed) {
     bool success = true;
     double prevResult = 0.0, result = 0.0;
     Vector<double> samples;
@@ -598,8 +748,10 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
             runWidth, runHeight);
     fflush(stdout);
 
-    BenchmarkRunner r(b, run);
-    if (!r.setUp()) {
+    BenchmarkResult r = { b.name, runWidth, runHeight, "error", 0.0, 0.0, 0 };
+
+    BenchmarkRunner runner(b, run);
+    if (!runner.setUp()) {
         fprintf(stderr, "error initializing runner.\n");
         return false;
     }
@@ -615,7 +767,7 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
     // Find the number of frames needed to run for over 100ms.
     double runTime = 0.0;
     while (true) {
-        runTime = double(r.run(warmUpFrames, totalFrames));
+        runTime = double(runner.run(warmUpFrames, totalFrames));
         if (runTime < 50e6) {
             warmUpFrames *= 2;
             totalFrames *= 2;
@@ -628,10 +780,12 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
     if (totalFrames - warmUpFrames > 16) {
         // The test runs too fast to get a stable result.  Skip it.
         printf("  fast");
+        r.status = "fast";
         goto done;
     } else if (totalFrames == 5 && runTime > 200e6) {
         // The test runs too slow to be very useful.  Skip it.
         printf("  slow");
+        r.status = "slow";
         goto done;
     }
 
@@ -643,11 +797,12 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
 
         if (newSamples > 512) {
             printf("varies");
+            r.status = "varies";
             goto done;
         }
 
         for (size_t i = 0; i < newSamples; i++) {
-            double sample = double(r.run(warmUpFrames, totalFrames));
+            double sample = double(runner.run(warmUpFrames, totalFrames));
 
             if (g_SleepBetweenSamplesMs > 0) {
                 usleep(g_SleepBetweenSamplesMs  * 1000);
@@ -668,13 +823,27 @@ static bool runTest(const BenchmarkDesc b, size_t run) {
         result = (samples[elem-1] + samples[elem]) * 0.5;
     } while (fabs(result - prevResult) > threshold * result);
 
-    printf("%6.3f", result / double(totalFrames - warmUpFrames) / 1e6);
+    {
+        double frameNs = double(totalFrames - warmUpFrames) * 1e6;
+        size_t n = samples.size();
+        r.status = "ok";
+        r.timeMs = result / frameNs;
+        r.spreadMs = (samples[n * 3 / 4] - samples[n / 4]) / frameNs;
+        r.numSamples = n;
+    }
+
+    printf("%6.3f", r.timeMs);
 
 done:
 
+    if (!g_Baseline.empty()) {
+        *outRegressed = printBaselineComparison(r);
+    }
     printf("\n");
     fflush(stdout);
-    r.tearDown();
+    runner.tearDown();
+
+    g_Results.push_back(r);
 
     return success;
 }
@@ -684,22 +853,198 @@ static void printResultsTableHeader() {
     size_t len = strlen(scenario);
     size_t leftPad = (g_BenchmarkNameLen - len) / 2;
     size_t rightPad = g_BenchmarkNameLen - len - leftPad;
-    printf(" %*s%s%*s | Resolution  | Time (ms)\n",
+    printf(" %*s%s%*s | Resolution  | Time (ms)%s\n",
             static_cast<int>(leftPad), "",
-            "Scenario", static_cast<int>(rightPad), "");
+            "Scenario", static_cast<int>(rightPad), "",
+            g_Baseline.empty() ? "" : " | vs baseline");
 }
 
 // Run ALL the benchmarks!
-static bool runTests() {
+static bool runTests(bool* outRegressed) {
     printResultsTableHeader();
 
-    for (size_t i = 0; i < NELEMS(benchmarks); i++) {
-        const BenchmarkDesc& b = benchmarks[i];
+    for (const BenchmarkDesc& b : g_Benchmarks) {
         for (size_t j = 0; j < MAX_TEST_RUNS && b.runHeights[j]; j++) {
-            if (!runTest(b, j)) {
+            bool regressed = false;
+            if (!runTest(b, j, &regressed)) {
                 return false;
             }
+            *outRegressed = *outRegressed || regressed;
+        }
+    }
+    return true;
+}
+
+// The composition strategies and layer counts combined by the --matrix
+// scenarios.
+static const struct {
+    const char* name;
+    Composer* (*composerFactory)();
+} matrixComposers[] = {
+    { "Opaque",          opaque },
+    { "Blend",           blend },
+    { "Rounded Corners", roundedCorners },
+    { "Color Transform", colorTransform },
+    { "Blur",            blurBlend },
+};
+
+static const uint32_t kDefaultMatrixLayerCounts[] = { 1, 4, 8 };
+
+// Storage for the names of the generated scenarios.
+static std::deque<std::string> g_MatrixNames;
+
+// Generate a scenario for each composition strategy and layer count, in which
+// all the layers cover most of a 16:10 screen.
+static void addMatrixBenchmarks(const std::vector<uint32_t>& layerCounts) {
+    const uint32_t width = 2560;
+    const uint32_t height = 1600;
+
+    for (size_t i = 0; i < NELEMS(matrixComposers); i++) {
+        for (uint32_t numLayers : layerCounts) {
+            g_MatrixNames.push_back(android::base::StringPrintf("%s x %u",
+                    matrixComposers[i].name, numLayers));
+
+            BenchmarkDesc b = {};
+            b.name = g_MatrixNames.back().c_str();
+            b.width = width;
+            b.height = height;
+            b.runHeights[0] = 800;
+            b.runHeights[1] = 1600;
+
+            for (uint32_t l = 0; l < numLayers; l++) {
+                // Offset the layers from each other so that none of them is
+                // entirely covered by the next one.
+                uint32_t inset = 16 * l;
+                b.layers[l] = {
+                    0, staticGradient, matrixComposers[i].composerFactory,
+                    int32_t(inset), int32_t(inset),
+                    width - 2 * inset, height - 2 * inset,
+                };
+            }
+            g_Benchmarks.push_back(b);
+        }
+    }
+}
+
+static bool parseLayerCounts(const char* arg, std::vector<uint32_t>* outCounts) {
+    outCounts->clear();
+    for (const std::string& count : android::base::Split(arg, ",")) {
+        uint32_t n;
+        if (!android::base::ParseUint(count, &n, uint32_t(MAX_NUM_LAYERS)) ||
+                n == 0) {
+            fprintf(stderr, "invalid layer count: \"%s\" (max %d)\n",
+                    count.c_str(), MAX_NUM_LAYERS);
+            return false;
         }
+        outCounts->push_back(n);
+    }
+    return true;
+}
+
+static std::string escapeJson(const std::string& s) {
+    std::string result;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+// Write the results, one per line so that they can be read back by
+// readBaseline().
+static bool writeJsonResults(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == nullptr) {
+        fprintf(stderr, "unable to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(f, "{\n  \"results\": [\n");
+    for (size_t i = 0; i < g_Results.size(); i++) {
+        const BenchmarkResult& r = g_Results[i];
+        fprintf(f, "    {\"scenario\": \"%s\", \"width\": %u, \"height\": %u, "
+                "\"status\": \"%s\", \"time_ms\": %.4f, \"spread_ms\": %.4f, "
+                "\"samples\": %zu}%s\n",
+                escapeJson(r.name).c_str(), r.width, r.height, r.status,
+                r.timeMs, r.spreadMs, r.numSamples,
+                i + 1 < g_Results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    return fclose(f) == 0;
+}
+
+// Find the string value of the given key in a line of the JSON results.
+static bool findJsonString(const std::string& line, const char* key,
+        std::string* outValue) {
+    std::string prefix = android::base::StringPrintf("\"%s\": \"", key);
+    size_t pos = line.find(prefix);
+    if (pos == std::string::npos) {
+        return false;
+    }
+
+    outValue->clear();
+    for (pos += prefix.size(); pos < line.size() && line[pos] != '"'; pos++) {
+        if (line[pos] == '\\' && pos + 1 < line.size()) {
+            pos++;
+        }
+        *outValue += line[pos];
+    }
+    return pos < line.size();
+}
+
+// Find the numeric value of the given key in a line of the JSON results.
+static bool findJsonNumber(const std::string& line, const char* key,
+        double* outValue) {
+    std::string prefix = android::base::StringPrintf("\"%s\": ", key);
+    size_t pos = line.find(prefix);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    return sscanf(line.c_str() + pos + prefix.size(), "%lf", outValue) == 1;
+}
+
+// Read the results of a previous run, as written by writeJsonResults().
+static bool readBaseline(const char* path) {
+    std::string contents;
+    if (!android::base::ReadFileToString(path, &contents)) {
+        fprintf(stderr, "unable to read %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    static const char* const statuses[] = { "ok", "fast", "slow", "varies", "error" };
+
+    for (const std::string& line : android::base::Split(contents, "\n")) {
+        BenchmarkResult r = {};
+        std::string status;
+        double width, height, samples;
+        if (!findJsonString(line, "scenario", &r.name) ||
+                !findJsonString(line, "status", &status) ||
+                !findJsonNumber(line, "width", &width) ||
+                !findJsonNumber(line, "height", &height) ||
+                !findJsonNumber(line, "time_ms", &r.timeMs) ||
+                !findJsonNumber(line, "spread_ms", &r.spreadMs) ||
+                !findJsonNumber(line, "samples", &samples)) {
+            continue;
+        }
+
+        r.width = uint32_t(width);
+        r.height = uint32_t(height);
+        r.numSamples = size_t(samples);
+        r.status = "error";
+        for (size_t i = 0; i < NELEMS(statuses); i++) {
+            if (status == statuses[i]) {
+                r.status = statuses[i];
+            }
+        }
+        g_Baseline.push_back(r);
+    }
+
+    if (g_Baseline.empty()) {
+        fprintf(stderr, "no results found in %s\n", path);
+        return false;
     }
     return true;
 }
@@ -707,8 +1052,7 @@ static bool runTests() {
 // Return the length longest benchmark name.
 static size_t maxBenchmarkNameLen() {
     size_t maxLen = 0;
-    for (size_t i = 0; i < NELEMS(benchmarks); i++) {
-        const BenchmarkDesc& b = benchmarks[i];
+    for (const BenchmarkDesc& b : g_Benchmarks) {
         size_t len = strlen(b.name);
         if (len > maxLen) {
             maxLen = len;
@@ -723,6 +1067,13 @@ static void showHelp(const char *cmd) {
     fprintf(stderr, "options include:\n"
                     "  -s N            sleep for N ms between samples\n"
                     "  -d              display the test frame to a window\n"
+                    "  -f PATTERN      only run the scenarios whose name contains PATTERN\n"
+                    "  -m              run the composition strategy matrix instead of the\n"
+                    "                  UI scenarios\n"
+                    "  -l N[,N...]     layer counts of the matrix scenarios (default 1,4,8)\n"
+                    "  -j FILE         write the results to FILE as JSON\n"
+                    "  -b FILE         compare the results with the JSON results in FILE,\n"
+                    "                  and exit with status 3 if any of them regressed\n"
                     "  --help          print this helpful message and exit\n"
             );
 }
@@ -733,6 +1084,12 @@ int main(int argc, char** argv) {
         exit(0);
     }
 
+    bool runMatrix = false;
+    std::vector<uint32_t> matrixLayerCounts(kDefaultMatrixLayerCounts,
+            kDefaultMatrixLayerCounts + NELEMS(kDefaultMatrixLayerCounts));
+    const char* filter = nullptr;
+    const char* jsonPath = nullptr;
+
     for (;;) {
         int ret;
         int option_index = 0;
@@ -741,7 +1098,7 @@ int main(int argc, char** argv) {
             {     0,               0, 0,  0 }
         };
 
-        ret = getopt_long(argc, argv, "ds:",
+        ret = getopt_long(argc, argv, "ds:f:ml:j:b:",
                           long_options, &option_index);
 
         if (ret < 0) {
@@ -757,6 +1114,30 @@ int main(int argc, char** argv) {
                 g_SleepBetweenSamplesMs = atoi(optarg);
             break;
 
+            case 'f':
+                filter = optarg;
+            break;
+
+            case 'm':
+                runMatrix = true;
+            break;
+
+            case 'l':
+                if (!parseLayerCounts(optarg, &matrixLayerCounts)) {
+                    exit(2);
+                }
+            break;
+
+            case 'j':
+                jsonPath = optarg;
+            break;
+
+            case 'b':
+                if (!readBaseline(optarg)) {
+                    exit(2);
+                }
+            break;
+
             case 0:
                 if (strcmp(long_options[option_index].name, "help")) {
                     showHelp(argv[0]);
@@ -770,6 +1151,20 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (runMatrix) {
+        addMatrixBenchmarks(matrixLayerCounts);
+    } else {
+        g_Benchmarks.assign(benchmarks, benchmarks + NELEMS(benchmarks));
+    }
+
+    if (filter != nullptr) {
+        auto end = std::remove_if(g_Benchmarks.begin(), g_Benchmarks.end(),
+                [filter](const BenchmarkDesc& b) {
+                    return strstr(b.name, filter) == nullptr;
+                });
+        g_Benchmarks.erase(end, g_Benchmarks.end());
+    }
+
     g_BenchmarkNameLen = maxBenchmarkNameLen();
 
     printf(" cmdline:");
@@ -778,8 +1173,21 @@ int main(int argc, char** argv) {
     }
     printf("\n");
 
-    if (!runTests()) {
+    bool regressed = false;
+    bool success = runTests(&regressed);
+
+    if (jsonPath != nullptr && !writeJsonResults(jsonPath)) {
+        fprintf(stderr, "unable to write the results to %s.\n", jsonPath);
+        return 1;
+    }
+
+    if (!success) {
         fprintf(stderr, "exiting due to error.\n");
         return 1;
     }
+
+    if (regressed) {
+        fprintf(stderr, "some scenarios regressed from the baseline.\n");
+        return 3;
+    }
 }
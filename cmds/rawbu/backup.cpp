@@ -14,11 +14,21 @@
 #include <utime.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
 #include <stdint.h>
 
-#include <cutils/properties.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
-#include <private/android_filesystem_config.h>
+#include <zlib.h>
+
+#include "backup.h"
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
@@ -30,19 +40,33 @@
 // Introduces backup all option to header.
 #define FILE_VERSION_2 0xffff0002
 
-#define FILE_VERSION FILE_VERSION_2
+// File data is stored in chunks of at most CHUNK_SIZE bytes, each compressed on its own.
+// Symbolic links are saved.
+#define FILE_VERSION_3 0xffff0003
+
+#define FILE_VERSION FILE_VERSION_3
+
+// Chunks are compressed and decompressed independently, so that several threads can work on
+// them, including on the chunks of a single large file.
+#define CHUNK_SIZE (256 * 1024)
+
+// Each chunk starts with its uncompressed size and its stored size. A chunk that does not get
+// smaller when compressed is stored as is, with both sizes equal.
+#define CHUNK_HEADER_SIZE 8
 
 namespace android {
 
 static char nameBuffer[PATH_MAX];
 static struct stat statBuffer;
 
-static char copyBuffer[8192];
 static char *backupFilePath = nullptr;
 
 static uint32_t inputFileVersion;
 
-static int opt_backupAll;
+int opt_backupAll = 0;
+int opt_threads = 1;
+bool opt_copyFileRange = true;
+const char* opt_dataRoot = DATA_ROOT;
 
 #define SPECIAL_NO_TOUCH 0
 #define SPECIAL_NO_BACKUP 1
@@ -61,6 +85,24 @@ static const struct special_dir SKIP_PATHS[] = {
     { nullptr, 0 },
 };
 
+// Backup files store paths as if opt_dataRoot were DATA_ROOT, so that a backup can be restored
+// under another root.
+static std::string stored_path(const char* path)
+{
+    return std::string(DATA_ROOT) + (path + strlen(opt_dataRoot));
+}
+
+// Returns where a path stored in a backup file is restored, or an empty string if the path is
+// not under DATA_ROOT.
+static std::string restored_path(const char* path)
+{
+    const size_t rootLen = strlen(DATA_ROOT);
+    if (strncmp(path, DATA_ROOT, rootLen) != 0 || path[rootLen] != '/') {
+        return "";
+    }
+    return std::string(opt_dataRoot) + (path + rootLen);
+}
+
 /* This is just copied from the shell's built-in wipe command. */
 static int wipe (const char *path) 
 {
@@ -102,8 +144,9 @@ static int wipe (const char *path)
         bool noBackup = false;
         
         /* See if this is a path we should skip. */
+        const std::string storedName = stored_path(nameBuffer);
         for (i = 0; SKIP_PATHS[i].path; i++) {
-            if (strcmp(SKIP_PATHS[i].path, nameBuffer) == 0) {
+            if (strcmp(SKIP_PATHS[i].path, storedName.c_str()) == 0) {
                 if (opt_backupAll || SKIP_PATHS[i].type == SPECIAL_NO_BACKUP) {
                     // In this case we didn't back up the directory --
                     // we do want to wipe its contents, but not the
@@ -192,45 +235,11 @@ static int write_int64(FILE* fh, int64_t val)
     return 1;
 }
 
-static int copy_file(FILE* dest, FILE* src, off_t size, const char* destName,
-        const char* srcName)
-{
-    errno = 0;
-    
-    off_t origSize = size;
-    
-    while (size > 0) {
-        int amt = size > (off_t)sizeof(copyBuffer) ? sizeof(copyBuffer) : (int)size;
-        int readLen = fread(copyBuffer, 1, amt, src);
-        if (readLen <= 0) {
-            if (srcName != nullptr) {
-                fprintf(stderr, "unable to read source (%d of %ld bytes) file '%s': %s\n",
-                    amt, origSize, srcName, errno != 0 ? strerror(errno) : "unexpected EOF");
-            } else {
-                fprintf(stderr, "unable to read buffer (%d of %ld bytes): %s\n",
-                    amt, origSize, errno != 0 ? strerror(errno) : "unexpected EOF");
-            }
-            return 0;
-        }
-        int writeLen = fwrite(copyBuffer, 1, readLen, dest); 
-        if (writeLen != readLen) {
-            if (destName != nullptr) {
-                fprintf(stderr, "unable to write file (%d of %d bytes) '%s': '%s'\n",
-                    writeLen, readLen, destName, strerror(errno));
-            } else {
-                fprintf(stderr, "unable to write buffer (%d of %d bytes): '%s'\n",
-                    writeLen, readLen, strerror(errno));
-            }
-            return 0;
-        }
-        size -= readLen;
-    }
-    return 1;
-}
-
 #define TYPE_END 0
 #define TYPE_DIR 1
 #define TYPE_FILE 2
+// Only in FILE_VERSION_3 and later.
+#define TYPE_SYMLINK 3
 
 static int write_header(FILE* fh, int type, const char* path, const struct stat* st)
 {
@@ -252,7 +261,238 @@ static int write_header(FILE* fh, int type, const char* path, const struct stat*
     return 1;
 }
 
-static int backup_dir(FILE* fh, const char* srcPath)
+static int write_fully(int fd, const char* data, size_t len, off_t offset, const char* destName)
+{
+    size_t written = 0;
+    while (written < len) {
+        ssize_t ret = TEMP_FAILURE_RETRY(pwrite(fd, data + written, len - written,
+                offset + written));
+        if (ret <= 0) {
+            fprintf(stderr, "unable to write file (%zu of %zu bytes) '%s': '%s'\n",
+                written, len, destName, strerror(errno));
+            return 0;
+        }
+        written += ret;
+    }
+    return 1;
+}
+
+struct SourceFile {
+    SourceFile(int fd, const char* path) : fd(fd), path(path) {}
+    ~SourceFile() { close(fd); }
+
+    const int fd;
+    const std::string path;
+};
+
+/*
+ * Writes the backup file while the directory tree is still being walked. The walking thread
+ * queues headers and the chunks of each file in order. Worker threads read and compress the
+ * chunks, and a writer thread writes them out in the order they were queued.
+ */
+class BackupPipeline {
+public:
+    BackupPipeline(FILE* fh, int numThreads) : mFh(fh), mMaxPending(numThreads * 4) {
+        for (int i = 0; i < numThreads; i++) {
+            mWorkers.emplace_back(&BackupPipeline::compressLoop, this);
+        }
+        mWriter = std::thread(&BackupPipeline::writeLoop, this);
+    }
+
+    ~BackupPipeline() { finish(); }
+
+    // Queues bytes to write as is. Returns 0 if the backup failed.
+    int write(std::vector<char> bytes) {
+        auto block = std::make_shared<Block>();
+        block->data = std::move(bytes);
+        block->ready = true;
+        return queue(block, nullptr, 0, 0);
+    }
+
+    // Queues the size and data of a file. Returns 0 if the backup failed.
+    int writeFile(const std::shared_ptr<SourceFile>& source, off_t size) {
+        std::vector<char> bytes(sizeof(int64_t));
+        int64_t size64 = size;
+        memcpy(bytes.data(), &size64, sizeof(size64));
+        if (!write(std::move(bytes))) return 0;
+
+        for (off_t offset = 0; offset < size; offset += CHUNK_SIZE) {
+            size_t len = size - offset > CHUNK_SIZE ? CHUNK_SIZE : (size_t)(size - offset);
+            if (!queue(std::make_shared<Block>(), source, offset, len)) return 0;
+        }
+        mBytesRead += size;
+        return 1;
+    }
+
+    // Waits until everything queued is written. Returns 0 if the backup failed.
+    int finish() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mClosing = true;
+        }
+        mCond.notify_all();
+        if (mWriter.joinable()) mWriter.join();
+        for (auto& worker : mWorkers) {
+            if (worker.joinable()) worker.join();
+        }
+        return !mFailed;
+    }
+
+    int64_t bytesRead() const { return mBytesRead; }
+    int64_t bytesWritten() const { return mBytesWritten; }
+
+private:
+    struct Block {
+        std::vector<char> data;
+        bool ready = false;
+    };
+
+    struct Job {
+        std::shared_ptr<Block> block;
+        std::shared_ptr<SourceFile> source;
+        off_t offset;
+        size_t len;
+    };
+
+    int queue(const std::shared_ptr<Block>& block, const std::shared_ptr<SourceFile>& source,
+            off_t offset, size_t len) {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mCond.wait(lock, [this] { return mBlocks.size() < mMaxPending || mFailed; });
+            if (mFailed) return 0;
+            mBlocks.push_back(block);
+            if (source) {
+                mJobs.push_back({block, source, offset, len});
+            }
+        }
+        mCond.notify_all();
+        return 1;
+    }
+
+    // Reads a chunk and stores it with its header, compressed if that makes it smaller.
+    static int compressChunk(const Job& job) {
+        std::vector<char> raw(job.len);
+        size_t readLen = 0;
+        while (readLen < job.len) {
+            ssize_t ret = TEMP_FAILURE_RETRY(pread(job.source->fd, raw.data() + readLen,
+                    job.len - readLen, job.offset + readLen));
+            if (ret <= 0) {
+                fprintf(stderr, "unable to read source (%zu of %zu bytes at %lld) file '%s': %s\n",
+                    readLen, job.len, (long long)job.offset, job.source->path.c_str(),
+                    ret < 0 ? strerror(errno) : "unexpected EOF");
+                return 0;
+            }
+            readLen += ret;
+        }
+
+        std::vector<char>& data = job.block->data;
+        uLongf storedLen = compressBound(job.len);
+        data.resize(CHUNK_HEADER_SIZE + storedLen);
+        if (compress2((Bytef*)data.data() + CHUNK_HEADER_SIZE, &storedLen, (const Bytef*)raw.data(),
+                job.len, Z_BEST_SPEED) != Z_OK || storedLen >= job.len) {
+            storedLen = job.len;
+            memcpy(data.data() + CHUNK_HEADER_SIZE, raw.data(), job.len);
+        }
+        data.resize(CHUNK_HEADER_SIZE + storedLen);
+        int32_t sizes[2] = { (int32_t)job.len, (int32_t)storedLen };
+        memcpy(data.data(), sizes, sizeof(sizes));
+        return 1;
+    }
+
+    void compressLoop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mCond.wait(lock, [this] { return !mJobs.empty() || mClosing; });
+                if (mJobs.empty()) return;
+                job = std::move(mJobs.front());
+                mJobs.pop_front();
+            }
+            int ok = mFailed || compressChunk(job);
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                job.block->ready = true;
+                if (!ok) mFailed = true;
+            }
+            mCond.notify_all();
+        }
+    }
+
+    void writeLoop() {
+        for (;;) {
+            std::shared_ptr<Block> block;
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mCond.wait(lock, [this] {
+                    return mFailed || (mBlocks.empty() ? mClosing : mBlocks.front()->ready);
+                });
+                if (mFailed || mBlocks.empty()) return;
+                block = std::move(mBlocks.front());
+                mBlocks.pop_front();
+            }
+            mCond.notify_all();
+
+            size_t len = block->data.size();
+            if (fwrite(block->data.data(), 1, len, mFh) != len) {
+                fprintf(stderr, "unable to write %zu bytes: %s\n", len, strerror(errno));
+                {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    mFailed = true;
+                }
+                mCond.notify_all();
+                return;
+            }
+            mBytesWritten += len;
+        }
+    }
+
+    FILE* const mFh;
+    // Blocks queued but not written yet, which bounds the memory used.
+    const size_t mMaxPending;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::deque<std::shared_ptr<Block>> mBlocks;
+    std::deque<Job> mJobs;
+    bool mClosing = false;
+    std::atomic<bool> mFailed{false};
+
+    std::vector<std::thread> mWorkers;
+    std::thread mWriter;
+
+    // Only used by the walking and writer threads, respectively.
+    int64_t mBytesRead = 0;
+    int64_t mBytesWritten = 0;
+};
+
+static int queue_header(BackupPipeline* pipeline, int type, const char* path,
+        const struct stat* st)
+{
+    char* buffer = nullptr;
+    size_t size = 0;
+    FILE* mem = open_memstream(&buffer, &size);
+    if (mem == nullptr) {
+        fprintf(stderr, "unable to open memory stream: %s\n", strerror(errno));
+        return 0;
+    }
+    int res = write_header(mem, type, path, st);
+    fclose(mem);
+    if (res) {
+        res = pipeline->write(std::vector<char>(buffer, buffer + size));
+    }
+    free(buffer);
+    return res;
+}
+
+static double elapsed_seconds(const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int backup_dir(BackupPipeline* pipeline, const char* srcPath)
 {
     DIR *dir;
     struct dirent *de;
@@ -290,11 +530,12 @@ static int backup_dir(FILE* fh, const char* srcPath)
         strcpy(fullPath, srcPath);
         fullPath[srcLen] = '/';
         strcpy(fullPath+srcLen+1, de->d_name);
+        const std::string storedPath = stored_path(fullPath);
 
         /* See if this is a path we should skip. */
         if (!opt_backupAll) {
             for (i = 0; SKIP_PATHS[i].path; i++) {
-                if (strcmp(SKIP_PATHS[i].path, fullPath) == 0) {
+                if (strcmp(SKIP_PATHS[i].path, storedPath.c_str()) == 0) {
                     break;
                 }
             }
@@ -315,11 +556,11 @@ static int backup_dir(FILE* fh, const char* srcPath)
         if(S_ISDIR(statBuffer.st_mode)) {
             printf("Saving dir %s...\n", fullPath);
             
-            if (write_header(fh, TYPE_DIR, fullPath, &statBuffer) == 0) {
+            if (queue_header(pipeline, TYPE_DIR, storedPath.c_str(), &statBuffer) == 0) {
                 result = 0;
                 goto done;
             }
-            if (backup_dir(fh, fullPath) == 0) {
+            if (backup_dir(pipeline, fullPath) == 0) {
                 result = 0;
                 goto done;
             }
@@ -331,28 +572,44 @@ static int backup_dir(FILE* fh, const char* srcPath)
             } else {
                 printf("Saving file %s...\n", fullPath);
             }
-            if (write_header(fh, TYPE_FILE, fullPath, &statBuffer) == 0) {
+            if (queue_header(pipeline, TYPE_FILE, storedPath.c_str(), &statBuffer) == 0) {
                 result = 0;
                 goto done;
             }
-            
-            off_t size = statBuffer.st_size;
-            if (!write_int64(fh, size)) {
+
+            int fd = TEMP_FAILURE_RETRY(open(fullPath, O_RDONLY | O_CLOEXEC));
+            if (fd < 0) {
+                fprintf(stderr, "unable to open source file '%s': %s\n",
+                    fullPath, strerror(errno));
                 result = 0;
                 goto done;
             }
-            
-            FILE* src = fopen(fullPath, "r");
-            if (src == nullptr) {
-                fprintf(stderr, "unable to open source file '%s': %s\n",
-                    fullPath, strerror(errno));
+
+            auto source = std::make_shared<SourceFile>(fd, fullPath);
+            if (!pipeline->writeFile(source, statBuffer.st_size)) {
                 result = 0;
                 goto done;
             }
-            
-            int copyres = copy_file(fh, src, size, nullptr, fullPath);
-            fclose(src);
-            if (!copyres) {
+        } else if (S_ISLNK(statBuffer.st_mode)) {
+            printf("Saving link %s...\n", fullPath);
+
+            char target[PATH_MAX];
+            ssize_t targetLen = readlink(fullPath, target, sizeof(target));
+            if (targetLen < 0 || targetLen == (ssize_t)sizeof(target)) {
+                fprintf(stderr, "unable to read link '%s': %s\n", fullPath,
+                    targetLen < 0 ? strerror(errno) : "target too long");
+                result = 0;
+                goto done;
+            }
+            if (queue_header(pipeline, TYPE_SYMLINK, storedPath.c_str(), &statBuffer) == 0) {
+                result = 0;
+                goto done;
+            }
+            std::vector<char> bytes(sizeof(int32_t) + targetLen);
+            int32_t targetLen32 = targetLen;
+            memcpy(bytes.data(), &targetLen32, sizeof(targetLen32));
+            memcpy(bytes.data() + sizeof(targetLen32), target, targetLen);
+            if (!pipeline->write(std::move(bytes))) {
                 result = 0;
                 goto done;
             }
@@ -369,7 +626,23 @@ done:
     return result;
 }
 
-static int backup_data(const char* destPath)
+static int backup_all(FILE* fh, const char* srcPath, const struct timespec* start)
+{
+    BackupPipeline pipeline(fh, opt_threads);
+    int res = backup_dir(&pipeline, srcPath);
+    if (!pipeline.finish()) {
+        res = 0;
+    }
+    if (res) {
+        double seconds = elapsed_seconds(start);
+        printf("Backed up %lld bytes into %lld bytes in %.1fs (%.1f MB/s) with %d threads\n",
+            (long long)pipeline.bytesRead(), (long long)pipeline.bytesWritten(), seconds,
+            seconds > 0 ? pipeline.bytesRead() / seconds / (1024 * 1024) : 0.0, opt_threads);
+    }
+    return res;
+}
+
+int backup_data(const char* destPath)
 {
     int res = -1;
     
@@ -380,14 +653,18 @@ static int backup_data(const char* destPath)
         return -1;
     }
     
-    printf("Backing up /data to %s...\n", destPath);
+    printf("Backing up %s to %s...\n", opt_dataRoot, destPath);
 
     // The path that shouldn't be backed up
+    free(backupFilePath);
     backupFilePath = strdup(destPath);
 
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     if (!write_int32(fh, FILE_VERSION)) goto done;
     if (!write_int32(fh, opt_backupAll)) goto done;
-    if (!backup_dir(fh, "/data")) goto done;
+    if (!backup_all(fh, opt_dataRoot, &start)) goto done;
     if (!write_int32(fh, 0)) goto done;
     
     res = 0;
@@ -405,10 +682,10 @@ done:
         res = -1;
         goto donedone;
     }
-    fclose(fh);
     sync();
 
 donedone:    
+    fclose(fh);
     return res;
 }
 
@@ -499,48 +776,289 @@ static int read_header(FILE* fh, int* type, char** path, struct stat* st)
     return 1;
 }
 
-static int restore_data(const char* srcPath)
+struct DestFile {
+    DestFile(int fd, const char* path) : fd(fd), path(path) {}
+    ~DestFile() { close(fd); }
+
+    const int fd;
+    const std::string path;
+};
+
+/*
+ * Decompresses and writes the compressed chunks of the restored files on worker threads, while
+ * the restoring thread goes on reading the backup file.
+ */
+class RestorePipeline {
+public:
+    explicit RestorePipeline(int numThreads) : mMaxPending(numThreads * 4) {
+        for (int i = 0; i < numThreads; i++) {
+            mWorkers.emplace_back(&RestorePipeline::inflateLoop, this);
+        }
+    }
+
+    ~RestorePipeline() { finish(); }
+
+    // Queues a compressed chunk to write at offset in dest. Returns 0 if the restore failed.
+    int inflate(const std::shared_ptr<DestFile>& dest, off_t offset, size_t rawLen,
+            std::vector<char> data) {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mCond.wait(lock, [this] { return mJobs.size() < mMaxPending || mFailed; });
+            if (mFailed) return 0;
+            mJobs.push_back({dest, offset, rawLen, std::move(data)});
+        }
+        mCond.notify_all();
+        return 1;
+    }
+
+    // Waits until every queued chunk is written. Returns 0 if the restore failed.
+    int finish() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mClosing = true;
+        }
+        mCond.notify_all();
+        for (auto& worker : mWorkers) {
+            if (worker.joinable()) worker.join();
+        }
+        return !mFailed;
+    }
+
+private:
+    struct Job {
+        std::shared_ptr<DestFile> dest;
+        off_t offset;
+        size_t rawLen;
+        std::vector<char> data;
+    };
+
+    static int inflateChunk(const Job& job) {
+        std::vector<char> raw(job.rawLen);
+        uLongf rawLen = job.rawLen;
+        if (uncompress((Bytef*)raw.data(), &rawLen, (const Bytef*)job.data.data(),
+                job.data.size()) != Z_OK || rawLen != job.rawLen) {
+            fprintf(stderr, "corrupt chunk at %lld of '%s' in restore file\n",
+                (long long)job.offset, job.dest->path.c_str());
+            return 0;
+        }
+        return write_fully(job.dest->fd, raw.data(), rawLen, job.offset, job.dest->path.c_str());
+    }
+
+    void inflateLoop() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mCond.wait(lock, [this] { return !mJobs.empty() || mClosing; });
+                if (mJobs.empty()) return;
+                job = std::move(mJobs.front());
+                mJobs.pop_front();
+            }
+            mCond.notify_all();
+            if (!mFailed && !inflateChunk(job)) {
+                {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    mFailed = true;
+                }
+                mCond.notify_all();
+            }
+        }
+    }
+
+    // Chunks queued but not taken by a worker yet, which bounds the memory used.
+    const size_t mMaxPending;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::deque<Job> mJobs;
+    bool mClosing = false;
+    std::atomic<bool> mFailed{false};
+
+    std::vector<std::thread> mWorkers;
+};
+
+static ssize_t copy_file_range_compat(int inFd, off_t* inOffset, int outFd, off_t* outOffset,
+        size_t len)
 {
-    int res = -1;
-    
-    FILE* fh = fopen(srcPath, "r");
-    if (fh == nullptr) {
-        fprintf(stderr, "Unable to open source '%s': %s\n",
-                srcPath, strerror(errno));
-        return -1;
+#ifdef __NR_copy_file_range
+    loff_t in = *inOffset;
+    loff_t out = *outOffset;
+    ssize_t ret = syscall(__NR_copy_file_range, inFd, &in, outFd, &out, len, 0);
+    if (ret > 0) {
+        *inOffset = in;
+        *outOffset = out;
     }
-    
-    inputFileVersion = read_int32(fh, 0);
-    if (inputFileVersion < FILE_VERSION_1 || inputFileVersion > FILE_VERSION) {
-        fprintf(stderr, "Restore file has bad version: 0x%x\n", inputFileVersion);
-        goto done;
+    return ret;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Copies len bytes at the current position of fh to offset in dest, in the kernel when the two
+// files allow it, and leaves fh positioned after them.
+static int copy_range(FILE* fh, const DestFile& dest, off_t destOffset, off_t len)
+{
+    static char buffer[CHUNK_SIZE];
+
+    int srcFd = fileno(fh);
+    off_t srcOffset = ftello(fh);
+    while (len > 0) {
+        ssize_t ret = -1;
+        if (opt_copyFileRange) {
+            ret = copy_file_range_compat(srcFd, &srcOffset, dest.fd, &destOffset, len);
+            if (ret < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL
+                    || errno == EOPNOTSUPP)) {
+                opt_copyFileRange = false;
+            }
+        }
+        if (!opt_copyFileRange) {
+            size_t amt = len > (off_t)sizeof(buffer) ? sizeof(buffer) : (size_t)len;
+            ret = TEMP_FAILURE_RETRY(pread(srcFd, buffer, amt, srcOffset));
+            if (ret > 0) {
+                if (!write_fully(dest.fd, buffer, ret, destOffset, dest.path.c_str())) {
+                    return 0;
+                }
+                srcOffset += ret;
+                destOffset += ret;
+            }
+        }
+        if (ret <= 0) {
+            fprintf(stderr, "unable to copy file (%lld bytes left) '%s': %s\n",
+                (long long)len, dest.path.c_str(), ret < 0 ? strerror(errno) : "unexpected EOF");
+            return 0;
+        }
+        len -= ret;
     }
-    
-    if (inputFileVersion >= FILE_VERSION_2) {
-        opt_backupAll = read_int32(fh, 0);
-    } else {
-        opt_backupAll = 0;
+
+    if (fseeko(fh, srcOffset, SEEK_SET) != 0) {
+        fprintf(stderr, "unable to seek restore file: %s\n", strerror(errno));
+        return 0;
     }
+    return 1;
+}
 
-    // The path that shouldn't be deleted
-    backupFilePath = strdup(srcPath);
-    
-    printf("Wiping contents of /data...\n");
-    if (!wipe("/data")) {
-        goto done;
+static int restore_file(FILE* fh, RestorePipeline* pipeline, const char* path, off_t size)
+{
+    int fd = TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (fd < 0) {
+        fprintf(stderr, "unable to open destination file '%s': %s\n",
+            path, strerror(errno));
+        return 0;
+    }
+    auto dest = std::make_shared<DestFile>(fd, path);
+
+    // Lets the file system lay the file out in one go. This is only a hint, the writes report
+    // any actual lack of space.
+    if (size > 0) {
+        fallocate(fd, 0, 0, size);
+    }
+
+    if (inputFileVersion < FILE_VERSION_3) {
+        return copy_range(fh, *dest, 0, size);
+    }
+
+    for (off_t offset = 0; offset < size;) {
+        int32_t rawLen = read_int32(fh, -1);
+        int32_t storedLen = read_int32(fh, -1);
+        if (rawLen <= 0 || rawLen > CHUNK_SIZE || rawLen > size - offset || storedLen <= 0
+                || (uLong)storedLen > compressBound(rawLen)) {
+            fprintf(stderr, "bad chunk sizes %d / %d in restore file at '%s'\n",
+                rawLen, storedLen, path);
+            return 0;
+        }
+
+        if (storedLen == rawLen) {
+            if (!copy_range(fh, *dest, offset, rawLen)) return 0;
+        } else {
+            std::vector<char> data(storedLen);
+            if (fread(data.data(), 1, storedLen, fh) != (size_t)storedLen) {
+                fprintf(stderr, "truncated chunk in restore file at '%s'\n", path);
+                return 0;
+            }
+            if (!pipeline->inflate(dest, offset, rawLen, std::move(data))) return 0;
+        }
+        offset += rawLen;
+    }
+    return 1;
+}
+
+struct RestoredEntry {
+    int type;
+    const char* typeName;
+    std::string path;
+    struct stat st;
+};
+
+static int restore_metadata(const RestoredEntry& entry)
+{
+    const char* typeName = entry.typeName;
+    const char* path = entry.path.c_str();
+    const struct stat& st = entry.st;
+
+    if (entry.type == TYPE_SYMLINK) {
+        // The mode of a link is not used, and its times are those of the link itself.
+        if (lchown(path, st.st_uid, st.st_gid) != 0) {
+            fprintf(stderr, "unable to chown destination %s '%s' to uid %d / gid %d: %s\n",
+                typeName, path, (int)st.st_uid, (int)st.st_gid, strerror(errno));
+            return 0;
+        }
+        struct timespec times[2] = {{st.st_atime, 0}, {st.st_mtime, 0}};
+        if (utimensat(AT_FDCWD, path, times, AT_SYMLINK_NOFOLLOW) != 0) {
+            fprintf(stderr, "unable to utime destination %s '%s': %s\n",
+                typeName, path, strerror(errno));
+            return 0;
+        }
+        return 1;
     }
 
-    printf("Restoring from %s to /data...\n", srcPath);
+    // Do this even for directories, since the dir may have already existed
+    // so we need to make sure it gets the correct mode.    
+    if (chmod(path, st.st_mode&(S_IRWXU|S_IRWXG|S_IRWXO)) != 0) {
+        fprintf(stderr, "unable to chmod destination %s '%s' to 0x%x: %s\n",
+            typeName, path, st.st_mode, strerror(errno));
+        return 0;
+    }
+    
+    if (chown(path, st.st_uid, st.st_gid) != 0) {
+        fprintf(stderr, "unable to chown destination %s '%s' to uid %d / gid %d: %s\n",
+            typeName, path, (int)st.st_uid, (int)st.st_gid, strerror(errno));
+        return 0;
+    }
+    
+    struct utimbuf timbuf;
+    timbuf.actime = st.st_atime;
+    timbuf.modtime = st.st_mtime;
+    if (utime(path, &timbuf) != 0) {
+        fprintf(stderr, "unable to utime destination %s '%s': %s\n",
+            typeName, path, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
 
+static int restore_entries(FILE* fh, RestorePipeline* pipeline,
+        std::vector<RestoredEntry>* entries, int64_t* bytesRestored)
+{
     while (1) {
         int type;
         char* path = nullptr;
         if (read_header(fh, &type, &path, &statBuffer) == 0) {
-            goto done;
+            free(path);
+            return 0;
         }
         if (type == 0) {
             break;
         }
+
+        const std::string storedPath = path;
+        free(path);
+        const std::string restoredPath = restored_path(storedPath.c_str());
+        if (restoredPath.empty()) {
+            fprintf(stderr, "bad path '%s' in restore file\n", storedPath.c_str());
+            return 0;
+        }
+        path = strdup(restoredPath.c_str());
         
         const char* typeName = "?";
         
@@ -554,7 +1072,7 @@ static int restore_data(const char* srcPath)
                     fprintf(stderr, "unable to create directory '%s': %s\n",
                         path, strerror(errno));
                     free(path);
-                    goto done;
+                    return 0;
                 }
             }
             
@@ -562,190 +1080,126 @@ static int restore_data(const char* srcPath)
             typeName = "file";
             off_t size = read_int64(fh, -1);
             if (size < 0) {
-                fprintf(stderr, "bad file size %ld in restore file\n", size);
+                fprintf(stderr, "bad file size %lld in restore file\n", (long long)size);
                 free(path);
-                goto done;
+                return 0;
             }
             
             printf("Restoring file %s...\n", path);
             
-            FILE* dest = fopen(path, "w");
-            if (dest == nullptr) {
-                fprintf(stderr, "unable to open destination file '%s': %s\n",
-                    path, strerror(errno));
+            if (!restore_file(fh, pipeline, path, size)) {
                 free(path);
-                goto done;
+                return 0;
             }
-            
-            int copyres = copy_file(dest, fh, size, path, nullptr);
-            fclose(dest);
-            if (!copyres) {
+            *bytesRestored += size;
+
+        } else if (type == TYPE_SYMLINK && inputFileVersion >= FILE_VERSION_3) {
+            typeName = "link";
+            int32_t targetLen = read_int32(fh, -1);
+            if (targetLen <= 0 || targetLen >= PATH_MAX) {
+                fprintf(stderr, "bad link target length %d in restore file\n", targetLen);
                 free(path);
-                goto done;
+                return 0;
             }
-        
+            std::string target(targetLen, '\0');
+            if (fread(&target[0], 1, targetLen, fh) != (size_t)targetLen) {
+                fprintf(stderr, "truncated link target in restore file at '%s'\n", path);
+                free(path);
+                return 0;
+            }
+
+            printf("Restoring link %s...\n", path);
+
+            if (symlink(target.c_str(), path) != 0) {
+                fprintf(stderr, "unable to create link '%s': %s\n", path, strerror(errno));
+                free(path);
+                return 0;
+            }
+
         } else {
             fprintf(stderr, "unknown node type %d\n", type);
-            goto done;
-        }
-        
-        // Do this even for directories, since the dir may have already existed
-        // so we need to make sure it gets the correct mode.    
-        if (chmod(path, statBuffer.st_mode&(S_IRWXU|S_IRWXG|S_IRWXO)) != 0) {
-            fprintf(stderr, "unable to chmod destination %s '%s' to 0x%x: %s\n",
-                typeName, path, statBuffer.st_mode, strerror(errno));
             free(path);
-            goto done;
-        }
-        
-        if (chown(path, statBuffer.st_uid, statBuffer.st_gid) != 0) {
-            fprintf(stderr, "unable to chown destination %s '%s' to uid %d / gid %d: %s\n",
-                typeName, path, (int)statBuffer.st_uid, (int)statBuffer.st_gid, strerror(errno));
-            free(path);
-            goto done;
-        }
-        
-        struct utimbuf timbuf;
-        timbuf.actime = statBuffer.st_atime;
-        timbuf.modtime = statBuffer.st_mtime;
-        if (utime(path, &timbuf) != 0) {
-            fprintf(stderr, "unable to utime destination %s '%s': %s\n",
-                typeName, path, strerror(errno));
-            free(path);
-            goto done;
+            return 0;
         }
         
-        
+        entries->push_back({type, typeName, path, statBuffer});
         free(path);
     }
-    
-    res = 0;
-        
-done:    
-    fclose(fh);
-    
-    return res;
-}
-
-static void show_help(const char *cmd)
-{
-    fprintf(stderr,"Usage: %s COMMAND [options] [backup-file-path]\n", cmd);
-
-    fprintf(stderr, "commands are:\n"
-                    "  help            Show this help text.\n"
-                    "  backup          Perform a backup of /data.\n"
-                    "  restore         Perform a restore of /data.\n");
-    fprintf(stderr, "options include:\n"
-                    "  -h              Show this help text.\n"
-                    "  -a              Backup all files.\n");
-    fprintf(stderr, "\n backup-file-path Defaults to /sdcard/backup.dat .\n"
-                    "                  On devices that emulate the sdcard, you will need to\n"
-                    "                  explicitly specify the directory it is mapped to,\n"
-                    "                  to avoid recursive backup or deletion of the backup file\n"
-                    "                  during restore.\n\n"
-                    "                  Eg. /data/media/0/backup.dat\n");
-    fprintf(stderr, "\nThe %s command allows you to perform low-level\n"
-                    "backup and restore of the /data partition.  This is\n"
-                    "where all user data is kept, allowing for a fairly\n"
-                    "complete restore of a device's state.  Note that\n"
-                    "because this is low-level, it will only work across\n"
-                    "builds of the same (or very similar) device software.\n",
-                    cmd);
+    return 1;
 }
 
-} /* namespace android */
-
-int main (int argc, char **argv)
+static int restore_all(FILE* fh)
 {
-    int restore = 0;
-
-    if (getuid() != AID_ROOT) {
-        fprintf(stderr, "error -- %s must run as root\n", argv[0]);
-        exit(-1);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    RestorePipeline pipeline(opt_threads);
+    std::vector<RestoredEntry> entries;
+    int64_t bytesRestored = 0;
+    int res = restore_entries(fh, &pipeline, &entries, &bytesRestored);
+    if (!pipeline.finish()) {
+        res = 0;
     }
-    
-    if (argc < 2) {
-        fprintf(stderr, "No command specified.\n");
-        android::show_help(argv[0]);
-        exit(-1);
-    }
-
-    if (0 == strcmp(argv[1], "restore")) {
-        restore = 1;
-    } else if (0 == strcmp(argv[1], "help")) {
-        android::show_help(argv[0]);
-        exit(0);
-    } else if (0 != strcmp(argv[1], "backup")) {
-        fprintf(stderr, "Unknown command: %s\n", argv[1]);
-        android::show_help(argv[0]);
-        exit(-1);
-    }
-
-    android::opt_backupAll = 0;
-                
-    optind = 2;
-    
-    for (;;) {
-        int ret;
-
-        ret = getopt(argc, argv, "ah");
 
-        if (ret < 0) {
-            break;
-        }
-
-        switch(ret) {
-            case 'a':
-                android::opt_backupAll = 1;
-                if (restore) fprintf(stderr, "Warning: -a option ignored on restore\n");
-                break;
-            case 'h':
-                android::show_help(argv[0]);
-                exit(0);
-            break;
+    // The ownership, modes and times are restored once all the data is written, which also
+    // keeps the files restored in a directory from changing its modification time.
+    for (size_t i = 0; res && i < entries.size(); i++) {
+        res = restore_metadata(entries[i]);
+    }
 
-            default:
-                fprintf(stderr,"Unrecognized Option\n");
-                android::show_help(argv[0]);
-                exit(-1);
-            break;
-        }
+    if (res) {
+        double seconds = elapsed_seconds(&start);
+        printf("Restored %lld bytes from %lld bytes in %.1fs (%.1f MB/s) with %d threads\n",
+            (long long)bytesRestored, (long long)ftello(fh), seconds,
+            seconds > 0 ? bytesRestored / seconds / (1024 * 1024) : 0.0, opt_threads);
     }
+    return res;
+}
 
-    const char* backupFile = "/sdcard/backup.dat";
+int restore_data(const char* srcPath)
+{
+    int res = -1;
     
-    if (argc > optind) {
-        backupFile = argv[optind];
-        optind++;
-        if (argc != optind) {
-            fprintf(stderr, "Too many arguments\n");
-            android::show_help(argv[0]);
-            exit(-1);
-        }
+    FILE* fh = fopen(srcPath, "r");
+    if (fh == nullptr) {
+        fprintf(stderr, "Unable to open source '%s': %s\n",
+                srcPath, strerror(errno));
+        return -1;
     }
     
-    printf("Stopping system...\n");
-    property_set("ctl.stop", "runtime");
-    property_set("ctl.stop", "zygote");
-    sleep(1);
+    inputFileVersion = read_int32(fh, 0);
+    if (inputFileVersion < FILE_VERSION_1 || inputFileVersion > FILE_VERSION) {
+        fprintf(stderr, "Restore file has bad version: 0x%x\n", inputFileVersion);
+        goto done;
+    }
     
-    int res;
-    if (restore) {
-        res = android::restore_data(backupFile);
-        if (res != 0) {
-            // Don't restart system, since the data partition is hosed.
-            return res;
-        }
-        printf("Restore complete!  Restarting system, cross your fingers...\n");
+    if (inputFileVersion >= FILE_VERSION_2) {
+        opt_backupAll = read_int32(fh, 0);
     } else {
-        res = android::backup_data(backupFile);
-        if (res == 0) {
-            printf("Backup complete!  Restarting system...\n");
-        } else {
-            printf("Restarting system...\n");
-        }
+        opt_backupAll = 0;
+    }
+
+    // The path that shouldn't be deleted
+    free(backupFilePath);
+    backupFilePath = strdup(srcPath);
+    
+    printf("Wiping contents of %s...\n", opt_dataRoot);
+    if (!wipe(opt_dataRoot)) {
+        goto done;
+    }
+
+    printf("Restoring from %s to %s...\n", srcPath, opt_dataRoot);
+
+    if (!restore_all(fh)) {
+        goto done;
     }
+
+    res = 0;
+        
+done:    
+    fclose(fh);
     
-    property_set("ctl.start", "zygote");
-    property_set("ctl.start", "runtime");
+    return res;
 }
+
+} /* namespace android */
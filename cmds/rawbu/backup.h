@@ -0,0 +1,30 @@
+// Copyright 2019 The Android Open Source Project
+
+#ifndef RAWBU_BACKUP_H_
+#define RAWBU_BACKUP_H_
+
+// The directory that is backed up and restored by default.
+#define DATA_ROOT "/data"
+
+namespace android {
+
+// Back up the files that are skipped by default.
+extern int opt_backupAll;
+// Number of threads compressing or decompressing file data.
+extern int opt_threads;
+// Copy the file data stored as is with copy_file_range() when the kernel and the files allow
+// it. Cleared once copy_file_range() turns out not to work.
+extern bool opt_copyFileRange;
+// The directory to back up or restore. Paths in backup files are always stored under
+// DATA_ROOT, so that a backup can be restored under another directory.
+extern const char* opt_dataRoot;
+
+// Backs up opt_dataRoot to destPath. Returns 0 on success.
+int backup_data(const char* destPath);
+
+// Wipes opt_dataRoot and restores it from srcPath. Returns 0 on success.
+int restore_data(const char* srcPath);
+
+} /* namespace android */
+
+#endif  // RAWBU_BACKUP_H_
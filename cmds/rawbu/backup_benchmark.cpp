@@ -0,0 +1,123 @@
+// Copyright 2019 The Android Open Source Project
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <benchmark/benchmark.h>
+
+#include "backup.h"
+
+namespace android {
+namespace {
+
+constexpr int kNumDirs = 8;
+constexpr int kFilesPerDir = 8;
+
+// A tree of 64 files of 1MiB, half of them text-like and half incompressible.
+class DataTree {
+public:
+    DataTree() {
+        opt_dataRoot = mRoot.path;
+        std::mt19937 random(0);
+        for (int i = 0; i < kNumDirs; i++) {
+            const std::string dir = std::string(mRoot.path) + "/d" + std::to_string(i);
+            mkdir(dir.c_str(), 0700);
+            for (int j = 0; j < kFilesPerDir; j++) {
+                std::string data(1024 * 1024, '\0');
+                for (size_t k = 0; k < data.size(); k++) {
+                    data[k] = j % 2 ? static_cast<char>(random()) : "0123456789 \n"[random() % 12];
+                }
+                base::WriteStringToFile(data, dir + "/f" + std::to_string(j));
+                mSize += data.size();
+            }
+        }
+        mBackupPath = std::string(mBackupDir.path) + "/backup.dat";
+    }
+
+    ~DataTree() {
+        for (int i = 0; i < kNumDirs; i++) {
+            const std::string dir = std::string(mRoot.path) + "/d" + std::to_string(i);
+            for (int j = 0; j < kFilesPerDir; j++) {
+                unlink((dir + "/f" + std::to_string(j)).c_str());
+            }
+            rmdir(dir.c_str());
+        }
+        unlink(mBackupPath.c_str());
+        opt_dataRoot = DATA_ROOT;
+    }
+
+    const char* backupPath() const { return mBackupPath.c_str(); }
+    int64_t size() const { return mSize; }
+
+private:
+    TemporaryDir mRoot;
+    TemporaryDir mBackupDir;
+    std::string mBackupPath;
+    int64_t mSize = 0;
+};
+
+// Sends the progress that rawbu prints for every file to /dev/null, so that it is not timed with
+// the rest.
+class QuietStdout {
+public:
+    QuietStdout() {
+        fflush(stdout);
+        mSavedFd = dup(STDOUT_FILENO);
+        const int nullFd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        dup2(nullFd, STDOUT_FILENO);
+        close(nullFd);
+    }
+
+    ~QuietStdout() {
+        fflush(stdout);
+        dup2(mSavedFd, STDOUT_FILENO);
+        close(mSavedFd);
+    }
+
+private:
+    int mSavedFd;
+};
+
+void BM_Backup(benchmark::State& state) {
+    DataTree tree;
+    QuietStdout quiet;
+    opt_threads = state.range(0);
+    for (auto _ : state) {
+        if (backup_data(tree.backupPath()) != 0) {
+            state.SkipWithError("backup failed");
+            return;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * tree.size());
+}
+BENCHMARK(BM_Backup)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond);
+
+void BM_Restore(benchmark::State& state) {
+    DataTree tree;
+    QuietStdout quiet;
+    opt_threads = state.range(0);
+    if (backup_data(tree.backupPath()) != 0) {
+        state.SkipWithError("backup failed");
+        return;
+    }
+    for (auto _ : state) {
+        if (restore_data(tree.backupPath()) != 0) {
+            state.SkipWithError("restore failed");
+            return;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * tree.size());
+}
+BENCHMARK(BM_Restore)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,356 @@
+// Copyright 2019 The Android Open Source Project
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "backup.h"
+
+namespace android {
+namespace {
+
+constexpr uint32_t kFileVersion2 = 0xffff0002;
+constexpr size_t kChunkSize = 256 * 1024;
+
+std::string compressibleData(size_t size) {
+    std::string data;
+    while (data.size() < size) {
+        data += "All work and no play makes Jack a dull boy. " + std::to_string(data.size());
+    }
+    data.resize(size);
+    return data;
+}
+
+std::string randomData(size_t size) {
+    std::mt19937 random(size);
+    std::string data(size, '\0');
+    for (char& c : data) {
+        c = static_cast<char>(random());
+    }
+    return data;
+}
+
+void appendInt32(std::string* out, int32_t val) {
+    out->append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void appendInt64(std::string* out, int64_t val) {
+    out->append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+// The header of an entry, as rawbu writes it.
+void appendHeader(std::string* out, int32_t type, const std::string& path, mode_t mode) {
+    appendInt32(out, type);
+    appendInt32(out, path.size());
+    out->append(path);
+    appendInt32(out, getuid());
+    appendInt32(out, getgid());
+    appendInt32(out, mode);
+    for (int i = 0; i < 3; i++) {
+        appendInt64(out, int64_t(1500000000) * 1000 * 1000 * 1000);
+    }
+}
+
+class BackupTest : public testing::Test {
+protected:
+    void SetUp() override {
+        opt_dataRoot = mRoot.path;
+        opt_backupAll = 0;
+        opt_threads = 4;
+        opt_copyFileRange = true;
+        mBackupPath = std::string(mBackupDir.path) + "/backup.dat";
+    }
+
+    void TearDown() override {
+        wipe(mRoot.path);
+        unlink(mBackupPath.c_str());
+        opt_dataRoot = DATA_ROOT;
+    }
+
+    static void wipe(const std::string& dir) {
+        DIR* d = opendir(dir.c_str());
+        if (d == nullptr) return;
+        while (struct dirent* de = readdir(d)) {
+            const std::string name = de->d_name;
+            if (name == "." || name == "..") continue;
+            const std::string path = dir + "/" + name;
+            struct stat st;
+            if (lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                chmod(path.c_str(), 0700);
+                wipe(path);
+                rmdir(path.c_str());
+            } else {
+                unlink(path.c_str());
+            }
+        }
+        closedir(d);
+    }
+
+    std::string path(const std::string& relativePath) const {
+        return std::string(mRoot.path) + "/" + relativePath;
+    }
+
+    void writeFile(const std::string& relativePath, const std::string& data, mode_t mode) {
+        ASSERT_TRUE(base::WriteStringToFile(data, path(relativePath))) << relativePath;
+        ASSERT_EQ(0, chmod(path(relativePath).c_str(), mode)) << relativePath;
+    }
+
+    void makeDir(const std::string& relativePath) {
+        ASSERT_EQ(0, mkdir(path(relativePath).c_str(), 0750)) << relativePath;
+    }
+
+    void makeLink(const std::string& target, const std::string& relativePath) {
+        ASSERT_EQ(0, symlink(target.c_str(), path(relativePath).c_str())) << relativePath;
+    }
+
+    // Small and empty files, files of several compressed chunks, incompressible files whose
+    // chunks are stored as is, directories and links.
+    void makeTree() {
+        writeFile("empty", "", 0600);
+        writeFile("small", "hello", 0644);
+        makeDir("dir");
+        writeFile("dir/compressible", compressibleData(3 * kChunkSize + 123), 0640);
+        writeFile("dir/random", randomData(2 * kChunkSize + 7), 0600);
+        makeDir("dir/sub");
+        writeFile("dir/sub/chunk", compressibleData(kChunkSize), 0444);
+        makeDir("emptydir");
+        makeLink("dir/compressible", "link");
+        makeLink("dir", "dirlink");
+        makeLink("nowhere", "dangling");
+    }
+
+    // Describes everything under dir that a restore brings back, keyed by relative path.
+    std::map<std::string, std::string> snapshot(const std::string& relativeDir = "") const {
+        std::map<std::string, std::string> entries;
+        const std::string dir = relativeDir.empty() ? mRoot.path : path(relativeDir);
+        DIR* d = opendir(dir.c_str());
+        if (d == nullptr) return entries;
+        while (struct dirent* de = readdir(d)) {
+            const std::string name = de->d_name;
+            if (name == "." || name == "..") continue;
+            const std::string relativePath = relativeDir.empty() ? name : relativeDir + "/" + name;
+            struct stat st;
+            if (lstat(path(relativePath).c_str(), &st) != 0) continue;
+
+            std::string description;
+            if (S_ISLNK(st.st_mode)) {
+                char target[PATH_MAX];
+                const ssize_t len = readlink(path(relativePath).c_str(), target, sizeof(target));
+                description = "link -> " + std::string(target, len > 0 ? len : 0);
+            } else {
+                description = (S_ISDIR(st.st_mode) ? "dir " : "file ") +
+                        std::to_string(st.st_mode & 0777) + " " + std::to_string(st.st_mtime);
+                if (S_ISREG(st.st_mode)) {
+                    std::string data;
+                    base::ReadFileToString(path(relativePath), &data);
+                    description += " " + std::to_string(std::hash<std::string>()(data)) + " " +
+                            std::to_string(data.size());
+                }
+            }
+            entries[relativePath] = description;
+            if (S_ISDIR(st.st_mode)) {
+                const auto children = snapshot(relativePath);
+                entries.insert(children.begin(), children.end());
+            }
+        }
+        closedir(d);
+        return entries;
+    }
+
+    std::string readBackup() const {
+        std::string data;
+        EXPECT_TRUE(base::ReadFileToString(mBackupPath, &data));
+        return data;
+    }
+
+    void writeBackup(const std::string& data) const {
+        ASSERT_TRUE(base::WriteStringToFile(data, mBackupPath));
+    }
+
+    TemporaryDir mRoot;
+    TemporaryDir mBackupDir;
+    std::string mBackupPath;
+};
+
+TEST_F(BackupTest, roundTripsFilesDirsAndLinks) {
+    makeTree();
+    const auto expected = snapshot();
+
+    // Without copy_file_range(), the data stored as is is copied through a buffer.
+    for (bool copyFileRange : {true, false}) {
+        for (int threads : {1, 4}) {
+            SCOPED_TRACE(std::to_string(threads) + " threads, copy_file_range " +
+                         std::to_string(copyFileRange));
+            opt_threads = threads;
+            opt_copyFileRange = copyFileRange;
+            ASSERT_EQ(0, backup_data(mBackupPath.c_str()));
+
+            // Restoring wipes what was added since the backup, and brings back what was
+            // removed.
+            writeFile("dir/added", "stray", 0600);
+            ASSERT_EQ(0, unlink(path("dir/random").c_str()));
+            ASSERT_EQ(0, unlink(path("link").c_str()));
+
+            ASSERT_EQ(0, restore_data(mBackupPath.c_str()));
+            EXPECT_EQ(expected, snapshot());
+        }
+    }
+}
+
+TEST_F(BackupTest, storesPathsUnderDataRoot) {
+    writeFile("small", "hello", 0644);
+    ASSERT_EQ(0, backup_data(mBackupPath.c_str()));
+
+    const std::string backup = readBackup();
+    EXPECT_NE(std::string::npos, backup.find(DATA_ROOT "/small"));
+    EXPECT_EQ(std::string::npos, backup.find(mRoot.path));
+}
+
+TEST_F(BackupTest, rejectsTruncatedBackup) {
+    makeTree();
+    ASSERT_EQ(0, backup_data(mBackupPath.c_str()));
+    const std::string backup = readBackup();
+
+    // Cuts in headers, in chunk headers, in compressed and stored chunks, and before the end.
+    for (size_t len : {size_t(6), size_t(40), backup.size() / 3, backup.size() / 2,
+                       backup.size() - kChunkSize / 2, backup.size() - 2}) {
+        SCOPED_TRACE(len);
+        writeBackup(backup.substr(0, len));
+        EXPECT_NE(0, restore_data(mBackupPath.c_str()));
+    }
+}
+
+TEST_F(BackupTest, rejectsCorruptChunks) {
+    writeFile("f", compressibleData(1000), 0600);
+    ASSERT_EQ(0, backup_data(mBackupPath.c_str()));
+    const std::string backup = readBackup();
+
+    // The version, the backup all flag, the header of "/data/f" and its size come first.
+    const size_t chunkOffset = 8 + 4 + 4 + strlen(DATA_ROOT "/f") + 3 * 4 + 3 * 8 + 8;
+    int32_t sizes[2];
+    memcpy(sizes, backup.data() + chunkOffset, sizeof(sizes));
+    ASSERT_EQ(1000, sizes[0]);
+    ASSERT_LT(sizes[1], 1000);
+    ASSERT_EQ(chunkOffset + 8 + sizes[1] + 4, backup.size());
+
+    ASSERT_EQ(0, restore_data(mBackupPath.c_str()));
+
+    {
+        SCOPED_TRACE("truncated chunk");
+        writeBackup(backup.substr(0, chunkOffset + 8 + sizes[1] / 2));
+        EXPECT_NE(0, restore_data(mBackupPath.c_str()));
+    }
+    {
+        SCOPED_TRACE("bad checksum");
+        std::string corrupt = backup;
+        // The last bytes of the compressed chunk are its checksum.
+        corrupt[backup.size() - 5] ^= 0x55;
+        writeBackup(corrupt);
+        EXPECT_NE(0, restore_data(mBackupPath.c_str()));
+    }
+    {
+        SCOPED_TRACE("raw size larger than a chunk");
+        std::string corrupt = backup;
+        const int32_t rawLen = kChunkSize + 1;
+        memcpy(&corrupt[chunkOffset], &rawLen, sizeof(rawLen));
+        writeBackup(corrupt);
+        EXPECT_NE(0, restore_data(mBackupPath.c_str()));
+    }
+    {
+        SCOPED_TRACE("stored size larger than the compression bound");
+        std::string corrupt = backup;
+        const int32_t storedLen = 2000;
+        memcpy(&corrupt[chunkOffset + 4], &storedLen, sizeof(storedLen));
+        writeBackup(corrupt);
+        EXPECT_NE(0, restore_data(mBackupPath.c_str()));
+    }
+}
+
+TEST_F(BackupTest, restoresVersion2Backup) {
+    const std::string data = randomData(kChunkSize + 10);
+    std::string backup;
+    appendInt32(&backup, kFileVersion2);
+    appendInt32(&backup, 0);
+    appendHeader(&backup, 1, DATA_ROOT "/dir", 0750);
+    appendHeader(&backup, 2, DATA_ROOT "/dir/file", 0640);
+    appendInt64(&backup, data.size());
+    backup += data;
+    appendHeader(&backup, 2, DATA_ROOT "/empty", 0600);
+    appendInt64(&backup, 0);
+    appendInt32(&backup, 0);
+    writeBackup(backup);
+
+    writeFile("stray", "stray", 0600);
+    ASSERT_EQ(0, restore_data(mBackupPath.c_str()));
+
+    std::string restored;
+    ASSERT_TRUE(base::ReadFileToString(path("dir/file"), &restored));
+    EXPECT_EQ(data, restored);
+    struct stat st;
+    ASSERT_EQ(0, stat(path("dir/file").c_str(), &st));
+    EXPECT_EQ(0640u, st.st_mode & 0777);
+    EXPECT_EQ(1500000000, st.st_mtime);
+    ASSERT_EQ(0, stat(path("empty").c_str(), &st));
+    EXPECT_EQ(0, st.st_size);
+    EXPECT_NE(0, access(path("stray").c_str(), F_OK));
+}
+
+TEST_F(BackupTest, restoresVersion2BackupWithoutCopyFileRange) {
+    opt_copyFileRange = false;
+    const std::string data = randomData(3 * kChunkSize);
+    std::string backup;
+    appendInt32(&backup, kFileVersion2);
+    appendInt32(&backup, 0);
+    appendHeader(&backup, 2, DATA_ROOT "/file", 0600);
+    appendInt64(&backup, data.size());
+    backup += data;
+    appendInt32(&backup, 0);
+    writeBackup(backup);
+
+    ASSERT_EQ(0, restore_data(mBackupPath.c_str()));
+    std::string restored;
+    ASSERT_TRUE(base::ReadFileToString(path("file"), &restored));
+    EXPECT_EQ(data, restored);
+}
+
+TEST_F(BackupTest, rejectsLinksInVersion2Backup) {
+    std::string backup;
+    appendInt32(&backup, kFileVersion2);
+    appendInt32(&backup, 0);
+    appendHeader(&backup, 3, DATA_ROOT "/link", 0777);
+    appendInt32(&backup, 6);
+    backup += "target";
+    appendInt32(&backup, 0);
+    writeBackup(backup);
+
+    EXPECT_NE(0, restore_data(mBackupPath.c_str()));
+}
+
+TEST_F(BackupTest, rejectsPathsOutsideDataRoot) {
+    for (const char* badPath : {"/etc/passwd", DATA_ROOT "x/file", "relative"}) {
+        SCOPED_TRACE(badPath);
+        std::string backup;
+        appendInt32(&backup, kFileVersion2);
+        appendInt32(&backup, 0);
+        appendHeader(&backup, 2, badPath, 0600);
+        appendInt64(&backup, 0);
+        appendInt32(&backup, 0);
+        writeBackup(backup);
+
+        EXPECT_NE(0, restore_data(mBackupPath.c_str()));
+    }
+}
+
+} // namespace
+} // namespace android
@@ -20,11 +20,18 @@
 #include <android/native_window.h>
 #include <gui/Surface.h>
 
+#include <algorithm>
+#include <cstring>
+
 using namespace android;
 
 BufferQueueScheduler::BufferQueueScheduler(
-        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id)
-      : mSurfaceControl(surfaceControl), mColor(color), mSurfaceId(id), mContinueScheduling(true) {}
+        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id, ReplayStats* stats)
+      : mSurfaceControl(surfaceControl),
+        mColor(color),
+        mSurfaceId(id),
+        mStats(stats),
+        mContinueScheduling(true) {}
 
 void BufferQueueScheduler::startScheduling() {
     ALOGV("Starting Scheduler for %d Layer", mSurfaceId);
@@ -40,11 +47,19 @@ void BufferQueueScheduler::startScheduling() {
             }
 
             BufferEvent event = mBufferEvents.front();
+            // setSurfaceControl() replaces the surface, its color and its dimensions, so they are
+            // only touched under the lock, and the event is handled on a snapshot of them.
+            const bool resize = event.dimensions != mDimensions;
+            mDimensions = event.dimensions;
+            const sp<SurfaceControl> surfaceControl = mSurfaceControl;
+            const RGB color = mColor.getRGB();
+            mColor.modulate();
             lock.unlock();
 
-            bufferUpdate(event.dimensions);
-            fillSurface(event.event);
-            mColor.modulate();
+            if (resize) {
+                bufferUpdate(surfaceControl, event.dimensions);
+            }
+            fillSurface(surfaceControl, color, event.event);
             lock.lock();
             mBufferEvents.pop();
         }
@@ -69,18 +84,23 @@ void BufferQueueScheduler::setSurfaceControl(
     std::lock_guard<std::mutex> lock(mMutex);
     mSurfaceControl = surfaceControl;
     mColor = color;
+    mDimensions = Dimensions();
     mCondition.notify_one();
 }
 
-void BufferQueueScheduler::bufferUpdate(const Dimensions& dimensions) {
-    sp<Surface> s = mSurfaceControl->getSurface();
+void BufferQueueScheduler::bufferUpdate(const sp<SurfaceControl>& surfaceControl,
+                                        const Dimensions& dimensions) {
+    sp<Surface> s = surfaceControl->getSurface();
     s->setBuffersDimensions(dimensions.width, dimensions.height);
+    s->allocateBuffers();
 }
 
-void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
+void BufferQueueScheduler::fillSurface(const sp<SurfaceControl>& surfaceControl, const RGB& color,
+                                       const std::shared_ptr<Event>& event) {
     ANativeWindow_Buffer outBuffer;
-    sp<Surface> s = mSurfaceControl->getSurface();
+    sp<Surface> s = surfaceControl->getSurface();
 
+    const nsecs_t fillStart = systemTime();
     status_t status = s->lock(&outBuffer, nullptr);
 
     if (status != NO_ERROR) {
@@ -88,22 +108,21 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
         return;
     }
 
-    auto color = mColor.getRGB();
+    const uint8_t pixel[4] = {color.r, color.g, color.b, LAYER_ALPHA};
+    uint32_t value;
+    memcpy(&value, pixel, sizeof(value));
 
-    auto img = reinterpret_cast<uint8_t*>(outBuffer.bits);
+    auto img = reinterpret_cast<uint32_t*>(outBuffer.bits);
     for (int y = 0; y < outBuffer.height; y++) {
-        for (int x = 0; x < outBuffer.width; x++) {
-            uint8_t* pixel = img + (4 * (y * outBuffer.stride + x));
-            pixel[0] = color.r;
-            pixel[1] = color.g;
-            pixel[2] = color.b;
-            pixel[3] = LAYER_ALPHA;
-        }
+        std::fill_n(img + y * outBuffer.stride, outBuffer.width, value);
     }
+    const nsecs_t fillDuration = systemTime() - fillStart;
 
     event->readyToExecute();
 
+    const nsecs_t postStart = systemTime();
     status = s->unlockAndPost();
+    mStats->recordBuffer(fillDuration, systemTime() - postStart);
 
     ALOGE_IF(status != NO_ERROR, "fillSurface: failed to unlock and post buffer, (%d)", status);
 }
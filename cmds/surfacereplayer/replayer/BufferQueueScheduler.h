@@ -19,6 +19,7 @@
 
 #include "Color.h"
 #include "Event.h"
+#include "ReplayStats.h"
 
 #include <gui/SurfaceControl.h>
 
@@ -38,6 +39,11 @@ struct Dimensions {
     Dimensions() = default;
     Dimensions(int w, int h) : width(w), height(h) {}
 
+    bool operator==(const Dimensions& other) const {
+        return width == other.width && height == other.height;
+    }
+    bool operator!=(const Dimensions& other) const { return !(*this == other); }
+
     int width = 0;
     int height = 0;
 };
@@ -52,7 +58,8 @@ struct BufferEvent {
 
 class BufferQueueScheduler {
   public:
-    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id);
+    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id,
+            ReplayStats* stats);
 
     void startScheduling();
     void addEvent(const BufferEvent&);
@@ -61,15 +68,22 @@ class BufferQueueScheduler {
     void setSurfaceControl(const sp<SurfaceControl>& surfaceControl, const HSV& color);
 
   private:
-    void bufferUpdate(const Dimensions& dimensions);
+    // Resizes the buffers of the surface, and allocates them ahead of the first buffer update
+    // at the new size so that filling them does not wait for an allocation.
+    void bufferUpdate(const sp<SurfaceControl>& surfaceControl, const Dimensions& dimensions);
 
     // Lock and fill the surface, block until the event is signaled by the main loop,
     // then unlock and post the buffer.
-    void fillSurface(const std::shared_ptr<Event>& event);
+    void fillSurface(const sp<SurfaceControl>& surfaceControl, const RGB& color,
+                     const std::shared_ptr<Event>& event);
 
     sp<SurfaceControl> mSurfaceControl;
     HSV mColor;
     const int mSurfaceId;
+    ReplayStats* const mStats;
+
+    // Dimensions the buffers of mSurfaceControl were last allocated at. Guarded by mMutex.
+    Dimensions mDimensions;
 
     bool mContinueScheduling;
 
@@ -51,6 +51,8 @@ void printHelpMenu() {
 
     std::cout << "  -l  Indefinitely loop the replayer\n";
 
+    std::cout << "  -p  Report the achieved timing of the replay compared to the trace\n";
+
     std::cout << "  -h  Display help menu\n";
 
     std::cout << std::endl;
@@ -61,11 +63,12 @@ int main(int argc, char** argv) {
     bool loop = false;
     bool wait = true;
     bool pauseBeginning = false;
+    bool report = false;
     int numThreads = DEFAULT_THREADS;
     long stopHere = -1;
 
     int opt = 0;
-    while ((opt = getopt(argc, argv, "mt:s:nlh?")) != -1) {
+    while ((opt = getopt(argc, argv, "mt:s:nlph?")) != -1) {
         switch (opt) {
             case 'm':
                 pauseBeginning = true;
@@ -82,6 +85,9 @@ int main(int argc, char** argv) {
             case 'l':
                 loop = true;
                 break;
+            case 'p':
+                report = true;
+                break;
             case 'h':
             case '?':
                 printHelpMenu();
@@ -104,6 +110,9 @@ int main(int argc, char** argv) {
     do {
         android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere);
         status = r.replay();
+        if (report) {
+            r.getStats().dump(std::cout);
+        }
     } while(loop);
 
     if (status == NO_ERROR) {
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ReplayStats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+using namespace android;
+
+void ReplayStats::reserve(size_t numIncrements) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLateness.reserve(numIncrements);
+    mTransactionApply.reserve(numIncrements);
+    mBufferFill.reserve(numIncrements);
+    mBufferPost.reserve(numIncrements);
+}
+
+void ReplayStats::recordIncrement(nsecs_t recordedOffset, nsecs_t achievedOffset) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecordedDuration = std::max(mRecordedDuration, recordedOffset);
+    mAchievedDuration = std::max(mAchievedDuration, achievedOffset);
+    mLateness.push_back(achievedOffset - recordedOffset);
+}
+
+void ReplayStats::recordTransaction(nsecs_t applyDuration) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTransactionApply.push_back(applyDuration);
+}
+
+void ReplayStats::recordBuffer(nsecs_t fillDuration, nsecs_t postDuration) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBufferFill.push_back(fillDuration);
+    mBufferPost.push_back(postDuration);
+}
+
+static void dumpPercentiles(std::ostream& out, const char* name, std::vector<nsecs_t> samples) {
+    out << "  " << std::left << std::setw(20) << name << std::right << "count=" << samples.size();
+    if (samples.empty()) {
+        out << "\n";
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto percentileMs = [&](size_t percentile) {
+        return samples[std::min(samples.size() * percentile / 100, samples.size() - 1)] / 1e6;
+    };
+    out << std::fixed << std::setprecision(3) << " p50=" << percentileMs(50)
+        << "ms p90=" << percentileMs(90) << "ms p99=" << percentileMs(99)
+        << "ms max=" << samples.back() / 1e6 << "ms\n";
+}
+
+void ReplayStats::dump(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    out << "Replayed " << mLateness.size() << " increments in " << std::fixed
+        << std::setprecision(3) << mAchievedDuration / 1e9 << "s (recorded "
+        << mRecordedDuration / 1e9 << "s";
+    if (mAchievedDuration > 0) {
+        out << ", " << std::setprecision(1) << mLateness.size() * 1e9 / mAchievedDuration
+            << " increments/s";
+    }
+    out << ")\n";
+
+    dumpPercentiles(out, "Increment lateness", mLateness);
+    dumpPercentiles(out, "Transaction apply", mTransactionApply);
+    dumpPercentiles(out, "Buffer fill", mBufferFill);
+    dumpPercentiles(out, "Buffer post", mBufferPost);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SURFACEREPLAYER_REPLAYSTATS_H
+#define ANDROID_SURFACEREPLAYER_REPLAYSTATS_H
+
+#include <utils/Timers.h>
+
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace android {
+
+// Collects how closely a replay followed the timing of its trace, and how long the calls into
+// SurfaceFlinger took. Samples may be recorded from any thread.
+class ReplayStats {
+  public:
+    // Preallocates room for the samples of a trace with the given number of increments, so
+    // that recording them does not allocate while replaying.
+    void reserve(size_t numIncrements);
+
+    // Records that an increment recorded at the given offset from the start of the trace was
+    // executed at the given offset from the start of the replay.
+    void recordIncrement(nsecs_t recordedOffset, nsecs_t achievedOffset);
+    void recordTransaction(nsecs_t applyDuration);
+    void recordBuffer(nsecs_t fillDuration, nsecs_t postDuration);
+
+    void dump(std::ostream& out) const;
+
+  private:
+    mutable std::mutex mMutex;
+    nsecs_t mRecordedDuration = 0;
+    nsecs_t mAchievedDuration = 0;
+    // Difference between the achieved and recorded offsets of each increment.
+    std::vector<nsecs_t> mLateness;
+    std::vector<nsecs_t> mTransactionApply;
+    std::vector<nsecs_t> mBufferFill;
+    std::vector<nsecs_t> mBufferPost;
+};
+
+}  // namespace android
+#endif
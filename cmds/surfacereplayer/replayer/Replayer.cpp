@@ -29,14 +29,17 @@
 #include <private/gui/ComposerService.h>
 
 #include <ui/DisplayInfo.h>
+#include <utils/Timers.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <cerrno>
 #include <chrono>
 #include <cmath>
 #include <condition_variable>
 #include <cstdlib>
+#include <ctime>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -50,6 +53,10 @@ using namespace android;
 
 std::atomic_bool Replayer::sReplayingManually(false);
 
+// Sleeping is only accurate to within the timer slack and the scheduling latency of the wakeup,
+// so the last part of a wait is spent spinning.
+static constexpr nsecs_t SPIN_THRESHOLD = us2ns(200);
+
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
         nsecs_t stopHere)
       : mTrace(),
@@ -74,6 +81,7 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 
     mCurrentTime = mTrace.increment(0).time_stamp();
+    mTraceStartTime = mCurrentTime;
 
     sReplayingManually.store(replayManually);
 
@@ -92,6 +100,7 @@ Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wai
         mStopTimeStamp(stopHere) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
+    mTraceStartTime = mCurrentTime;
 
     sReplayingManually.store(replayManually);
 
@@ -114,18 +123,25 @@ status_t Replayer::replay() {
 
     SurfaceComposerClient::enableVSyncInjections(true);
 
+    mStats.reserve(mTrace.increment_size());
     initReplay();
 
     ALOGV("Starting actual Replay!");
+    mReplayStartTime = systemTime();
     while (!mPendingIncrements.empty()) {
         mCurrentIncrement = mTrace.increment(mIncrementIndex);
+        const int64_t recordedOffset = mCurrentIncrement.time_stamp() - mTraceStartTime;
 
         if (mHasStopped == false && mCurrentIncrement.time_stamp() >= mStopTimeStamp) {
             mHasStopped = true;
             sReplayingManually.store(true);
         }
 
-        waitForConsoleCommmand();
+        if (sReplayingManually && !mWaitingForNextVSync) {
+            waitForConsoleCommmand();
+            // Resume the timeline from the increment the user stopped at.
+            mReplayStartTime = systemTime() - recordedOffset;
+        }
 
         if (mWaitForTimeStamps) {
             waitUntilTimestamp(mCurrentIncrement.time_stamp());
@@ -135,6 +151,7 @@ status_t Replayer::replay() {
         mPendingIncrements.pop();
 
         event->complete();
+        mStats.recordIncrement(recordedOffset, systemTime() - mReplayStartTime);
 
         if (event->getIncrementType() == Increment::kVsyncEvent) {
             mWaitingForNextVSync = false;
@@ -296,7 +313,7 @@ status_t Replayer::dispatchEvent(int index) {
             auto layerId = increment.buffer_update().id();
             if (mBufferQueueSchedulers.count(layerId) == 0) {
                 mBufferQueueSchedulers[layerId] = std::make_shared<BufferQueueScheduler>(
-                        mLayers[layerId], mColors[layerId], layerId);
+                        mLayers[layerId], mColors[layerId], layerId, &mStats);
                 mBufferQueueSchedulers[layerId]->addEvent(bufferEvent);
 
                 std::thread(&BufferQueueScheduler::startScheduling,
@@ -347,7 +364,9 @@ status_t Replayer::doTransaction(const Transaction& t, const std::shared_ptr<Eve
 
     event->readyToExecute();
 
+    const nsecs_t applyStart = systemTime();
     liveTransaction.apply(t.synchronous());
+    mStats.recordTransaction(systemTime() - applyStart);
 
     ALOGV("Ended Transaction");
 
@@ -665,8 +684,18 @@ void Replayer::updatePowerMode(const PowerModeUpdate& pmu, const std::shared_ptr
 }
 
 void Replayer::waitUntilTimestamp(int64_t timestamp) {
-    ALOGV("Waiting for %lld nanoseconds...", static_cast<int64_t>(timestamp - mCurrentTime));
-    std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
+    const nsecs_t deadline = mReplayStartTime + (timestamp - mTraceStartTime);
+    ALOGV("Waiting for %lld nanoseconds...", static_cast<int64_t>(deadline - systemTime()));
+
+    const nsecs_t wakeup = deadline - SPIN_THRESHOLD;
+    if (wakeup > systemTime()) {
+        const timespec ts = {static_cast<time_t>(wakeup / 1000000000),
+                             static_cast<long>(wakeup % 1000000000)};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+        }
+    }
+    while (systemTime() < deadline) {
+    }
 }
 
 void Replayer::waitUntilDeferredTransactionLayerExists(
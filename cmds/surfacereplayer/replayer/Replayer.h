@@ -20,6 +20,7 @@
 #include "BufferQueueScheduler.h"
 #include "Color.h"
 #include "Event.h"
+#include "ReplayStats.h"
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
@@ -59,6 +60,9 @@ class Replayer {
 
     status_t replay();
 
+    // Timing of the replay compared to the trace, complete once replay() returns.
+    const ReplayStats& getStats() const { return mStats; }
+
   private:
     status_t initReplay();
 
@@ -118,6 +122,8 @@ class Replayer {
     void setDisplayProjection(SurfaceComposerClient::Transaction& t,
             display_id id, const ProjectionChange& pc);
 
+    // Sleeps until the increment recorded at the given time stamp is due, relative to the start
+    // of the replay rather than to the previous increment so that delays do not accumulate.
     void waitUntilTimestamp(int64_t timestamp);
     void waitUntilDeferredTransactionLayerExists(
             const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock);
@@ -129,6 +135,13 @@ class Replayer {
     int64_t mCurrentTime = 0;
     int32_t mNumThreads = DEFAULT_THREADS;
 
+    // Time stamp of the first increment, and the time at which it was (or would have been, when
+    // resuming from manual replay) replayed.
+    int64_t mTraceStartTime = 0;
+    nsecs_t mReplayStartTime = 0;
+
+    ReplayStats mStats;
+
     Increment mCurrentIncrement;
 
     std::string mLastInput;
@@ -18,6 +18,7 @@
 #ifndef __LIBDISKUSAGE_DIRSIZE_H
 #define __LIBDISKUSAGE_DIRSIZE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 __BEGIN_DECLS
@@ -25,6 +26,33 @@ __BEGIN_DECLS
 int64_t stat_size(struct stat *s);
 int64_t calculate_dir_size(int dfd);
 
+/*
+ * Remembers, for each directory measured, the total size of its files and the names of its
+ * subdirectories, so that measuring a mostly unchanged tree again only stats its directories.
+ *
+ * A directory is re-read when its mtime, ctime or inode generation changed, that is when entries
+ * were added to it, removed from it or renamed. The size of a file that is rewritten in place,
+ * without going through a rename, is only picked up once its directory changes; callers that
+ * need the exact size of such files should use calculate_dir_size().
+ */
+struct dir_size_cache;
+
+struct dir_size_cache *dir_size_cache_create(void);
+void dir_size_cache_destroy(struct dir_size_cache *cache);
+
+/*
+ * Same as calculate_dir_size(), including taking ownership of dfd, but reuses and updates the
+ * sizes remembered in cache. Directories with many subdirectories have them measured by up to
+ * max_threads threads in total. The cache can be used from several threads at once.
+ *
+ * Directories that a walk no longer reaches from the directory of dfd, such as deleted ones,
+ * are dropped from the cache. Those of other trees measured with the cache are kept.
+ */
+int64_t calculate_dir_size_cached(struct dir_size_cache *cache, int dfd, int max_threads);
+
+/* Returns the number of directories remembered in cache. */
+size_t dir_size_cache_entries(struct dir_size_cache *cache);
+
 __END_DECLS
 
 #endif /* __LIBDISKUSAGE_DIRSIZE_H */
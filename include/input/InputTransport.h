@@ -29,6 +29,8 @@
  * The InputConsumer is used by the application to receive events from the input dispatcher.
  */
 
+#include <atomic>
+#include <memory>
 #include <string>
 
 #include <binder/IBinder.h>
@@ -148,12 +150,80 @@ struct InputMessage {
     void getSanitizedCopy(InputMessage* msg) const;
 };
 
+/*
+ * Single producer, single consumer ring of input messages in memory shared by the two ends of
+ * an input channel. Messages are copied in and out of the ring as variable sized records, so
+ * high-rate publishers go without a system call per message and without the per-packet overhead
+ * of the socket buffer.
+ *
+ * The ring only holds messages; waking up the consumer is left to the owner of the ring.
+ */
+class InputMessageRing {
+public:
+    // Twice the socket buffer, and none of it is spent on packet overhead.
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    /* Creates a ring in new shared memory, of a capacity in bytes that is a power of two.
+     *
+     * Returns null if the capacity is invalid or the memory could not be allocated.
+     */
+    static std::unique_ptr<InputMessageRing> create(const std::string& name, size_t capacity);
+
+    /* Maps the ring of another process, taking ownership of fd.
+     *
+     * Returns null if fd does not hold a ring.
+     */
+    static std::unique_ptr<InputMessageRing> map(int fd);
+
+    ~InputMessageRing();
+
+    inline int getFd() const { return mFd; }
+    inline size_t getCapacity() const { return mCapacity; }
+
+    /* Appends the first size bytes of msg to the ring.
+     *
+     * Sets outWasEmpty when the consumer had taken every message before this one, in which case
+     * it may be waiting for a wakeup.
+     *
+     * Returns OK on success.
+     * Returns WOULD_BLOCK if the ring is full.
+     * Returns BAD_VALUE if the consumer broke the ring.
+     */
+    status_t push(const InputMessage& msg, size_t size, bool* outWasEmpty);
+
+    /* Takes the oldest message from the ring.
+     *
+     * Returns OK on success.
+     * Returns WOULD_BLOCK if the ring is empty.
+     * Returns BAD_VALUE if the message is invalid, or the producer broke the ring.
+     */
+    status_t pop(InputMessage* msg);
+
+private:
+    // Positions only ever grow, and are taken modulo the capacity.
+    struct Control {
+        std::atomic<uint32_t> head __attribute__((aligned(64)));
+        std::atomic<uint32_t> tail __attribute__((aligned(64)));
+    };
+
+    InputMessageRing(int fd, void* memory, size_t capacity);
+
+    int mFd;
+    Control* mControl;
+    uint8_t* mData;
+    size_t mCapacity;
+};
+
 /*
  * An input channel consists of a local unix domain socket used to send and receive
  * input messages across processes.  Each channel has a descriptive name for debugging purposes.
  *
  * Each endpoint has its own InputChannel object that specifies its file descriptor.
  *
+ * A channel pair may also carry the messages of the server through an InputMessageRing, in which
+ * case the socket only carries the finished signals of the client, and wakes the client up when
+ * the ring stops being empty.
+ *
  * The input channel is closed when all references to it are released.
  */
 class InputChannel : public RefBase {
@@ -171,6 +241,15 @@ public:
     static status_t openInputChannelPair(const std::string& name,
             sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel);
 
+    /* Creates a pair of input channels where the server sends its messages through a shared
+     * memory ring of the given capacity, such as InputMessageRing::DEFAULT_CAPACITY.
+     *
+     * Returns OK on success.
+     */
+    static status_t openInputChannelPair(const std::string& name,
+            sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel,
+            size_t ringCapacity);
+
     inline std::string getName() const { return mName; }
     inline int getFd() const { return mFd; }
 
@@ -180,6 +259,9 @@ public:
      * Try again after the consumer has sent a finished signal indicating that it has
      * consumed some of the pending messages from the channel.
      *
+     * Messages sent through a ring only find out that the peer was closed if it has to be woken
+     * up, so that is left to polling the fd for a hangup.
+     *
      * Returns OK on success.
      * Returns WOULD_BLOCK if the channel is full.
      * Returns DEAD_OBJECT if the channel's peer has been closed.
@@ -199,7 +281,9 @@ public:
      */
     status_t receiveMessage(InputMessage* msg);
 
-    /* Returns a new object that has a duplicate of this channel's fd. */
+    inline bool hasMessageRing() const { return mSendRing || mReceiveRing; }
+
+    /* Returns a new object that has a duplicate of this channel's fd, and of its ring. */
     sp<InputChannel> dup() const;
 
     status_t write(Parcel& out) const;
@@ -210,10 +294,17 @@ public:
 
 private:
     void setFd(int fd);
+    status_t sendWakeup();
+    // Consumes the wakeups sent by the peer.
+    status_t receiveWakeups();
 
     std::string mName;
     int mFd = -1;
 
+    // The server sends its messages through mSendRing, which the client receives as mReceiveRing.
+    std::unique_ptr<InputMessageRing> mSendRing;
+    std::unique_ptr<InputMessageRing> mReceiveRing;
+
     sp<IBinder> mToken = nullptr;
 };
 
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <diskusage/dirsize.h>
+
+namespace {
+
+// Directories with at least this many subdirectories have them measured in parallel.
+constexpr size_t kParallelSubdirs = 8;
+
+// A directory changed this shortly before it was read may change again without its timestamps
+// moving, as they only advance with the kernel's coarse clock, so it is not cached.
+constexpr int64_t kRacyWindowNs = 1000000000;
+
+int64_t ToNs(const struct timespec& ts) {
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Device and inode number of a directory.
+using DirKey = std::pair<dev_t, ino_t>;
+
+struct DirStamp {
+    int64_t mtime;
+    int64_t ctime;
+    uint32_t generation;
+
+    bool operator==(const DirStamp& other) const {
+        return mtime == other.mtime && ctime == other.ctime && generation == other.generation;
+    }
+};
+
+struct DirEntry {
+    DirStamp stamp;
+    // Total size of the entries that are not directories.
+    int64_t files_size;
+    std::vector<std::string> subdirs;
+};
+
+} // namespace
+
+struct dir_size_cache {
+    std::mutex lock;
+    std::map<DirKey, DirEntry> dirs;
+    // The directories that the last walk from each root reached, sorted. Directories that the
+    // next walk from the same root no longer reaches, such as deleted ones, are dropped, while
+    // those of the other trees measured with the cache are left alone.
+    std::map<DirKey, std::vector<DirKey>> roots;
+};
+
+namespace {
+
+class Walker {
+public:
+    Walker(dir_size_cache* cache, int max_threads)
+          : mCache(cache), mSpareThreads(std::max(max_threads, 1) - 1) {}
+
+    // The cached directories reached so far, in no particular order.
+    std::vector<DirKey>& reached() { return mReached; }
+
+    // Returns the size of the contents of dfd, and closes it.
+    int64_t walk(int dfd) {
+        struct stat st;
+        if (fstat(dfd, &st) != 0) {
+            close(dfd);
+            return 0;
+        }
+        const DirKey key(st.st_dev, st.st_ino);
+        DirStamp stamp = {ToNs(st.st_mtim), ToNs(st.st_ctim), 0};
+        // Tells a new directory from a deleted one whose inode number was reused.
+        unsigned int generation;
+        if (ioctl(dfd, FS_IOC_GETVERSION, &generation) == 0) {
+            stamp.generation = generation;
+        }
+
+        int64_t files_size = 0;
+        std::vector<std::string> subdirs;
+        bool cached = false;
+        {
+            std::lock_guard<std::mutex> lock(mCache->lock);
+            auto it = mCache->dirs.find(key);
+            if (it != mCache->dirs.end() && it->second.stamp == stamp) {
+                files_size = it->second.files_size;
+                subdirs = it->second.subdirs;
+                mReached.push_back(key);
+                cached = true;
+            }
+        }
+
+        DIR* d = nullptr;
+        if (!cached) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+
+            d = fdopendir(dfd);
+            if (d == nullptr) {
+                close(dfd);
+                return 0;
+            }
+            struct dirent* de;
+            while ((de = readdir(d))) {
+                const char* name = de->d_name;
+                if (de->d_type == DT_DIR) {
+                    // always skip "." and ".."
+                    if (strcmp(name, ".") != 0 && strcmp(name, "..") != 0) {
+                        subdirs.push_back(name);
+                    }
+                } else if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                    files_size += stat_size(&st);
+                }
+            }
+
+            if (ToNs(now) - std::max(stamp.mtime, stamp.ctime) > kRacyWindowNs) {
+                std::lock_guard<std::mutex> lock(mCache->lock);
+                mCache->dirs[key] = {stamp, files_size, subdirs};
+                mReached.push_back(key);
+            } else {
+                std::lock_guard<std::mutex> lock(mCache->lock);
+                mCache->dirs.erase(key);
+            }
+        }
+
+        const int64_t size = files_size + walkSubdirs(dfd, subdirs);
+        if (d != nullptr) {
+            closedir(d);
+        } else {
+            close(dfd);
+        }
+        return size;
+    }
+
+private:
+    int64_t walkSubdir(int dfd, const std::string& name) {
+        int64_t size = 0;
+        struct stat st;
+        if (fstatat(dfd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            size += stat_size(&st);
+        }
+        int subfd = openat(dfd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (subfd >= 0) {
+            size += walk(subfd);
+        }
+        return size;
+    }
+
+    int64_t walkSubdirs(int dfd, const std::vector<std::string>& subdirs) {
+        std::atomic<size_t> next(0);
+        std::atomic<int64_t> size(0);
+        auto walkNext = [&]() {
+            for (size_t i = next++; i < subdirs.size(); i = next++) {
+                size += walkSubdir(dfd, subdirs[i]);
+            }
+        };
+
+        // Helpers are taken from the threads left, and handed back once done.
+        int helpers = 0;
+        if (subdirs.size() >= kParallelSubdirs) {
+            int spare = mSpareThreads.load();
+            do {
+                helpers = std::min(spare, int(subdirs.size() - 1));
+            } while (helpers > 0 && !mSpareThreads.compare_exchange_weak(spare, spare - helpers));
+            helpers = std::max(helpers, 0);
+        }
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < helpers; i++) {
+            threads.emplace_back(walkNext);
+        }
+        walkNext();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        mSpareThreads += helpers;
+        return size;
+    }
+
+    dir_size_cache* const mCache;
+    std::atomic<int> mSpareThreads;
+    // Guarded by mCache->lock.
+    std::vector<DirKey> mReached;
+};
+
+} // namespace
+
+struct dir_size_cache* dir_size_cache_create(void) {
+    return new dir_size_cache;
+}
+
+void dir_size_cache_destroy(struct dir_size_cache* cache) {
+    delete cache;
+}
+
+int64_t calculate_dir_size_cached(struct dir_size_cache* cache, int dfd, int max_threads) {
+    struct stat st;
+    if (dfd < 0 || fstat(dfd, &st) != 0) {
+        if (dfd >= 0) {
+            close(dfd);
+        }
+        return 0;
+    }
+    const DirKey root(st.st_dev, st.st_ino);
+
+    Walker walker(cache, max_threads);
+    const int64_t size = walker.walk(dfd);
+
+    // Only the directories of this tree are swept, so the cost is that of the walk, whatever
+    // the number of trees measured with the cache.
+    std::vector<DirKey>& reached = walker.reached();
+    std::sort(reached.begin(), reached.end());
+    std::lock_guard<std::mutex> lock(cache->lock);
+    std::vector<DirKey>& previous = cache->roots[root];
+    for (const DirKey& key : previous) {
+        if (!std::binary_search(reached.begin(), reached.end(), key)) {
+            cache->dirs.erase(key);
+        }
+    }
+    previous = std::move(reached);
+    return size;
+}
+
+size_t dir_size_cache_entries(struct dir_size_cache* cache) {
+    std::lock_guard<std::mutex> lock(cache->lock);
+    return cache->dirs.size();
+}
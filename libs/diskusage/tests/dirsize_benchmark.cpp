@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <benchmark/benchmark.h>
+
+#include <diskusage/dirsize.h>
+
+namespace {
+
+// An app data directory sized tree: 32 directories of 32 subdirectories of 16 files.
+constexpr int kDirs = 32;
+constexpr int kSubdirs = 32;
+constexpr int kFiles = 16;
+
+class SyntheticTree {
+public:
+    SyntheticTree() {
+        for (int i = 0; i < kDirs; i++) {
+            const std::string dir = std::string(mRoot.path) + "/d" + std::to_string(i);
+            mkdir(dir.c_str(), 0700);
+            for (int j = 0; j < kSubdirs; j++) {
+                const std::string subdir = dir + "/s" + std::to_string(j);
+                mkdir(subdir.c_str(), 0700);
+                for (int k = 0; k < kFiles; k++) {
+                    android::base::WriteStringToFile(std::string(k * 100, 'x'),
+                                                     subdir + "/f" + std::to_string(k));
+                }
+            }
+        }
+        // Lets the timestamps get old enough for the directories to be cached.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    }
+
+    ~SyntheticTree() {
+        nftw(mRoot.path,
+             [](const char* path, const struct stat*, int, struct FTW*) { return remove(path); },
+             16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    int open() const { return ::open(mRoot.path, O_RDONLY | O_DIRECTORY | O_CLOEXEC); }
+
+private:
+    TemporaryDir mRoot;
+};
+
+const SyntheticTree& tree() {
+    static const SyntheticTree* tree = new SyntheticTree;
+    return *tree;
+}
+
+void BM_Uncached(benchmark::State& state) {
+    const SyntheticTree& root = tree();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(calculate_dir_size(root.open()));
+    }
+}
+BENCHMARK(BM_Uncached)->Unit(benchmark::kMillisecond);
+
+// Every call measures the whole tree with an empty cache.
+void BM_CachedCold(benchmark::State& state) {
+    const SyntheticTree& root = tree();
+    for (auto _ : state) {
+        dir_size_cache* cache = dir_size_cache_create();
+        benchmark::DoNotOptimize(calculate_dir_size_cached(cache, root.open(), state.range(0)));
+        dir_size_cache_destroy(cache);
+    }
+}
+BENCHMARK(BM_CachedCold)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The tree is unchanged since the previous call, so only its directories are looked at.
+void BM_CachedWarm(benchmark::State& state) {
+    const SyntheticTree& root = tree();
+    dir_size_cache* cache = dir_size_cache_create();
+    calculate_dir_size_cached(cache, root.open(), 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(calculate_dir_size_cached(cache, root.open(), state.range(0)));
+    }
+    dir_size_cache_destroy(cache);
+}
+BENCHMARK(BM_CachedWarm)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include <diskusage/dirsize.h>
+
+namespace android {
+namespace {
+
+class DirSizeCacheTest : public testing::Test {
+protected:
+    void SetUp() override { mCache = dir_size_cache_create(); }
+
+    void TearDown() override {
+        dir_size_cache_destroy(mCache);
+        // TemporaryDir only removes the directory itself.
+        nftw(mRoot.path,
+             [](const char* path, const struct stat*, int, struct FTW*) { return remove(path); },
+             16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    std::string path(const std::string& relativePath) const {
+        return std::string(mRoot.path) + "/" + relativePath;
+    }
+
+    void makeDir(const std::string& relativePath) const {
+        ASSERT_EQ(0, mkdir(path(relativePath).c_str(), 0700)) << relativePath;
+    }
+
+    void writeFile(const std::string& relativePath, size_t size) const {
+        ASSERT_TRUE(base::WriteStringToFile(std::string(size, 'x'), path(relativePath)))
+                << relativePath;
+    }
+
+    // Three levels of directories, some wide enough to be measured in parallel.
+    void makeTree() const {
+        for (int i = 0; i < 10; i++) {
+            const std::string dir = "d" + std::to_string(i);
+            makeDir(dir);
+            for (int j = 0; j < i; j++) {
+                const std::string subdir = dir + "/s" + std::to_string(j);
+                makeDir(subdir);
+                for (int k = 0; k < 3; k++) {
+                    writeFile(subdir + "/f" + std::to_string(k), 1000 * (i + j + k) + 1);
+                }
+            }
+            writeFile(dir + "/file", 5000 * i);
+        }
+        makeDir("empty");
+        ASSERT_EQ(0, symlink("d1/file", path("link").c_str()));
+    }
+
+    // Lets the timestamps of the tree get old enough for its directories to be cached.
+    static void waitForTimestamps() { std::this_thread::sleep_for(std::chrono::milliseconds(1100)); }
+
+    int64_t uncachedSize(const std::string& relativePath = "") const {
+        return calculate_dir_size(open(path(relativePath).c_str(), O_RDONLY | O_DIRECTORY));
+    }
+
+    int64_t cachedSize(int maxThreads, const std::string& relativePath = "") const {
+        return calculate_dir_size_cached(mCache,
+                                         open(path(relativePath).c_str(), O_RDONLY | O_DIRECTORY),
+                                         maxThreads);
+    }
+
+    TemporaryDir mRoot;
+    dir_size_cache* mCache = nullptr;
+};
+
+TEST_F(DirSizeCacheTest, matchesUncachedSize) {
+    makeTree();
+    const int64_t expected = uncachedSize();
+    ASSERT_GT(expected, 0);
+
+    EXPECT_EQ(expected, cachedSize(1));
+    EXPECT_EQ(expected, cachedSize(1));
+    EXPECT_EQ(uncachedSize("d9"), cachedSize(1, "d9"));
+}
+
+TEST_F(DirSizeCacheTest, parallelMatchesSerial) {
+    makeTree();
+    const int64_t expected = uncachedSize();
+
+    EXPECT_EQ(expected, cachedSize(4));
+    waitForTimestamps();
+    EXPECT_EQ(expected, cachedSize(4));
+    EXPECT_EQ(expected, cachedSize(4));
+}
+
+TEST_F(DirSizeCacheTest, invalidFdIsEmpty) {
+    EXPECT_EQ(0, calculate_dir_size_cached(mCache, -1, 1));
+}
+
+TEST_F(DirSizeCacheTest, picksUpChangedDirectories) {
+    makeTree();
+    waitForTimestamps();
+    ASSERT_EQ(uncachedSize(), cachedSize(2));
+
+    writeFile("d5/s2/added", 123456);
+    EXPECT_EQ(uncachedSize(), cachedSize(2));
+
+    ASSERT_EQ(0, unlink(path("d5/s2/added").c_str()));
+    ASSERT_EQ(0, unlink(path("d9/s8/f0").c_str()));
+    EXPECT_EQ(uncachedSize(), cachedSize(2));
+
+    makeDir("d3/new");
+    writeFile("d3/new/file", 70000);
+    EXPECT_EQ(uncachedSize(), cachedSize(2));
+
+    ASSERT_EQ(0, rename(path("d4/s0/f1").c_str(), path("d2/moved").c_str()));
+    EXPECT_EQ(uncachedSize(), cachedSize(2));
+}
+
+TEST_F(DirSizeCacheTest, reusesSizesOfUnchangedDirectories) {
+    makeTree();
+    waitForTimestamps();
+    const int64_t before = cachedSize(1);
+
+    // Growing a file in place leaves its directory unchanged, so the cached size is used.
+    ASSERT_TRUE(base::WriteStringToFile(std::string(100000, 'y'), path("d7/s3/f1")));
+    EXPECT_EQ(before, cachedSize(1));
+    EXPECT_GT(uncachedSize(), before);
+
+    // Until something changes in the directory.
+    writeFile("d7/s3/touch", 0);
+    EXPECT_EQ(uncachedSize(), cachedSize(1));
+}
+
+TEST_F(DirSizeCacheTest, doesNotCacheRecentlyChangedDirectories) {
+    makeTree();
+    ASSERT_EQ(uncachedSize(), cachedSize(1));
+
+    // The tree was just written, so this is seen even though it may not move the timestamps.
+    ASSERT_TRUE(base::WriteStringToFile(std::string(100000, 'y'), path("d7/s3/f1")));
+    EXPECT_EQ(uncachedSize(), cachedSize(1));
+}
+
+TEST_F(DirSizeCacheTest, dropsDirectoriesNoLongerReached) {
+    makeTree();
+    waitForTimestamps();
+    ASSERT_EQ(uncachedSize(), cachedSize(2));
+    const size_t before = dir_size_cache_entries(mCache);
+    // The root, d0 to d9, their 45 subdirectories and "empty".
+    EXPECT_EQ(57u, before);
+
+    for (int k = 0; k < 3; k++) {
+        ASSERT_EQ(0, unlink(path("d9/s8/f" + std::to_string(k)).c_str()));
+    }
+    ASSERT_EQ(0, rmdir(path("d9/s8").c_str()));
+    waitForTimestamps();
+    EXPECT_EQ(uncachedSize(), cachedSize(2));
+    EXPECT_EQ(before - 1, dir_size_cache_entries(mCache));
+}
+
+TEST_F(DirSizeCacheTest, keepsOtherTrees) {
+    makeTree();
+    waitForTimestamps();
+    const int64_t before = cachedSize(1, "d9");
+    const size_t entries = dir_size_cache_entries(mCache);
+
+    // Measure many other trees with the same cache.
+    for (int i = 0; i < 9; i++) {
+        const std::string dir = "d" + std::to_string(i);
+        EXPECT_EQ(uncachedSize(dir), cachedSize(1, dir));
+    }
+    for (int j = 0; j < 9; j++) {
+        const std::string dir = "d9/s" + std::to_string(j);
+        EXPECT_EQ(uncachedSize(dir), cachedSize(1, dir));
+    }
+    EXPECT_EQ(entries + 9 + 36, dir_size_cache_entries(mCache));
+
+    // The size of d9 itself is still reused: growing its file in place is not seen.
+    ASSERT_TRUE(base::WriteStringToFile(std::string(100000, 'y'), path("d9/file")));
+    EXPECT_EQ(before, cachedSize(1, "d9"));
+}
+
+} // namespace
+} // namespace android
@@ -123,4 +123,55 @@ std::string GpuStatsAppInfo::toString() const {
     return result;
 }
 
+status_t GpuStatsBatch::writeToParcel(Parcel* parcel) const {
+    status_t status;
+    if ((status = parcel->writeUtf8AsUtf16(driverPackageName)) != OK) return status;
+    if ((status = parcel->writeUtf8AsUtf16(driverVersionName)) != OK) return status;
+    if ((status = parcel->writeUint64(driverVersionCode)) != OK) return status;
+    if ((status = parcel->writeInt64(driverBuildTime)) != OK) return status;
+    if ((status = parcel->writeUtf8AsUtf16(appPackageName)) != OK) return status;
+    if ((status = parcel->writeInt32(vulkanVersion)) != OK) return status;
+    if ((status = parcel->writeUint32(driverStats.size())) != OK) return status;
+    for (const auto& ele : driverStats) {
+        if ((status = parcel->writeInt32(ele.driver)) != OK) return status;
+        if ((status = parcel->writeBool(ele.isDriverLoaded)) != OK) return status;
+        if ((status = parcel->writeInt64(ele.driverLoadingTime)) != OK) return status;
+    }
+    if ((status = parcel->writeUint32(targetStats.size())) != OK) return status;
+    for (const auto& ele : targetStats) {
+        if ((status = parcel->writeInt32(ele.stats)) != OK) return status;
+        if ((status = parcel->writeUint64(ele.value)) != OK) return status;
+    }
+    return OK;
+}
+
+status_t GpuStatsBatch::readFromParcel(const Parcel* parcel) {
+    status_t status;
+    if ((status = parcel->readUtf8FromUtf16(&driverPackageName)) != OK) return status;
+    if ((status = parcel->readUtf8FromUtf16(&driverVersionName)) != OK) return status;
+    if ((status = parcel->readUint64(&driverVersionCode)) != OK) return status;
+    if ((status = parcel->readInt64(&driverBuildTime)) != OK) return status;
+    if ((status = parcel->readUtf8FromUtf16(&appPackageName)) != OK) return status;
+    if ((status = parcel->readInt32(&vulkanVersion)) != OK) return status;
+
+    uint32_t size = 0;
+    if ((status = parcel->readUint32(&size)) != OK) return status;
+    if (size > MAX_NUM_ENTRIES) return BAD_VALUE;
+    driverStats.resize(size);
+    for (auto& ele : driverStats) {
+        if ((status = parcel->readInt32(&ele.driver)) != OK) return status;
+        if ((status = parcel->readBool(&ele.isDriverLoaded)) != OK) return status;
+        if ((status = parcel->readInt64(&ele.driverLoadingTime)) != OK) return status;
+    }
+
+    if ((status = parcel->readUint32(&size)) != OK) return status;
+    if (size > MAX_NUM_ENTRIES) return BAD_VALUE;
+    targetStats.resize(size);
+    for (auto& ele : targetStats) {
+        if ((status = parcel->readInt32(&ele.stats)) != OK) return status;
+        if ((status = parcel->readUint64(&ele.value)) != OK) return status;
+    }
+    return OK;
+}
+
 } // namespace android
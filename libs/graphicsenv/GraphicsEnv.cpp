@@ -35,6 +35,7 @@
 #include <sys/prctl.h>
 #include <utils/Trace.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <thread>
@@ -76,6 +77,9 @@ enum NativeLibrary {
     VNDKSP = 1,
 };
 
+// Delay before the stats recorded during app startup are sent to GpuService.
+static constexpr int64_t kGpuStatsFlushDelayMs = 1000;
+
 static constexpr const char* kNativeLibrariesSystemConfigPath[] = {"/etc/llndk.libraries.txt",
                                                                    "/etc/vndksp.libraries.txt"};
 
@@ -164,20 +168,17 @@ void GraphicsEnv::setDriverPathAndSphalLibraries(const std::string path,
 void GraphicsEnv::hintActivityLaunch() {
     ATRACE_CALL();
 
-    std::thread trySendGpuStatsThread([this]() {
-        // If there's already graphics driver preloaded in the process, just send
-        // the stats info to GpuStats directly through async binder.
-        std::lock_guard<std::mutex> lock(mStatsLock);
-        if (mGpuStats.glDriverToSend) {
-            mGpuStats.glDriverToSend = false;
-            sendGpuStatsLocked(GraphicsEnv::Api::API_GL, true, mGpuStats.glDriverLoadingTime);
-        }
-        if (mGpuStats.vkDriverToSend) {
-            mGpuStats.vkDriverToSend = false;
-            sendGpuStatsLocked(GraphicsEnv::Api::API_VK, true, mGpuStats.vkDriverLoadingTime);
-        }
-    });
-    trySendGpuStatsThread.detach();
+    // If there's already graphics driver preloaded in the process, queue its stats now that the
+    // app package name is known. They are sent to GpuStats with the next batch.
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    if (mGpuStats.glDriverToSend) {
+        mGpuStats.glDriverToSend = false;
+        sendGpuStatsLocked(GraphicsEnv::Api::API_GL, true, mGpuStats.glDriverLoadingTime);
+    }
+    if (mGpuStats.vkDriverToSend) {
+        mGpuStats.vkDriverToSend = false;
+        sendGpuStatsLocked(GraphicsEnv::Api::API_VK, true, mGpuStats.vkDriverLoadingTime);
+    }
 }
 
 void GraphicsEnv::setGpuStats(const std::string& driverPackageName,
@@ -259,6 +260,9 @@ void GraphicsEnv::setDriverLoaded(GraphicsEnv::Api api, bool isDriverLoaded,
     sendGpuStatsLocked(api, isDriverLoaded, driverLoadingTime);
 }
 
+// Only set by tests. Guarded by GraphicsEnv::mStatsLock.
+static sp<IGpuService> gGpuServiceForTesting;
+
 static sp<IGpuService> getGpuService() {
     const sp<IBinder> binder = defaultServiceManager()->checkService(String16("gpu"));
     if (!binder) {
@@ -273,11 +277,13 @@ void GraphicsEnv::setTargetStats(const Stats stats, const uint64_t value) {
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mStatsLock);
-    const sp<IGpuService> gpuService = getGpuService();
-    if (gpuService) {
-        gpuService->setTargetStats(mGpuStats.appPackageName, mGpuStats.driverVersionCode, stats,
-                                   value);
+    if (mGpuStats.pendingTargetStats.size() >= GpuStatsBatch::MAX_NUM_ENTRIES) {
+        ALOGW("Too many pending target stats, dropping stats[%d]", static_cast<int32_t>(stats));
+        return;
     }
+
+    mGpuStats.pendingTargetStats.push_back({stats, value});
+    scheduleGpuStatsFlushLocked();
 }
 
 void GraphicsEnv::sendGpuStatsLocked(GraphicsEnv::Api api, bool isDriverLoaded,
@@ -313,13 +319,96 @@ void GraphicsEnv::sendGpuStatsLocked(GraphicsEnv::Api api, bool isDriverLoaded,
                 isDriverLoaded && (mGpuStats.vkDriverFallback == GraphicsEnv::Driver::NONE);
     }
 
-    const sp<IGpuService> gpuService = getGpuService();
-    if (gpuService) {
-        gpuService->setGpuStats(mGpuStats.driverPackageName, mGpuStats.driverVersionName,
-                                mGpuStats.driverVersionCode, mGpuStats.driverBuildTime,
-                                mGpuStats.appPackageName, mGpuStats.vulkanVersion, driver,
-                                isIntendedDriverLoaded, driverLoadingTime);
+    // Only record the stats here. The binder call happens on a background thread so that it
+    // never adds latency to the GL/Vulkan driver loading path.
+    if (mGpuStats.pendingDriverStats.size() >= GpuStatsBatch::MAX_NUM_ENTRIES) {
+        ALOGW("Too many pending driver stats, dropping api[%d]", static_cast<int32_t>(api));
+        return;
+    }
+
+    mGpuStats.pendingDriverStats.push_back({driver, isIntendedDriverLoaded, driverLoadingTime});
+    scheduleGpuStatsFlushLocked();
+}
+
+void GraphicsEnv::scheduleGpuStatsFlushLocked() {
+    if (mGpuStats.flushScheduled) return;
+    mGpuStats.flushScheduled = true;
+
+    if (mGpuStatsFlushSchedulerForTesting) {
+        mGpuStatsFlushSchedulerForTesting();
+        return;
+    }
+
+    // Delay the flush so that stats recorded during app startup, e.g. GL followed by Vulkan
+    // loading and target stats from the first frames, are coalesced into a single transaction
+    // that is sent once the app is past its startup path.
+    std::thread flushGpuStatsThread([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kGpuStatsFlushDelayMs));
+        flushGpuStats();
+    });
+    flushGpuStatsThread.detach();
+}
+
+void GraphicsEnv::flushGpuStats() {
+    ATRACE_CALL();
+
+    GpuStatsBatch batch;
+    sp<IGpuService> gpuService;
+    {
+        std::lock_guard<std::mutex> lock(mStatsLock);
+        mGpuStats.flushScheduled = false;
+
+        // Target stats can be set before the GraphicsEnvironment setup, but are meaningless
+        // without an app package name.
+        if (mGpuStats.appPackageName.empty()) {
+            mGpuStats.pendingTargetStats.clear();
+            return;
+        }
+
+        if (mGpuStats.pendingDriverStats.empty() && mGpuStats.pendingTargetStats.empty()) {
+            return;
+        }
+
+        batch.driverPackageName = mGpuStats.driverPackageName;
+        batch.driverVersionName = mGpuStats.driverVersionName;
+        batch.driverVersionCode = mGpuStats.driverVersionCode;
+        batch.driverBuildTime = mGpuStats.driverBuildTime;
+        batch.appPackageName = mGpuStats.appPackageName;
+        batch.vulkanVersion = mGpuStats.vulkanVersion;
+        for (const auto& ele : mGpuStats.pendingDriverStats) {
+            batch.driverStats.push_back(
+                    {static_cast<int32_t>(ele.driver), ele.isDriverLoaded, ele.driverLoadingTime});
+        }
+        for (const auto& ele : mGpuStats.pendingTargetStats) {
+            batch.targetStats.push_back({static_cast<int32_t>(ele.stats), ele.value});
+        }
+        mGpuStats.pendingDriverStats.clear();
+        mGpuStats.pendingTargetStats.clear();
+
+        gpuService = gGpuServiceForTesting;
+    }
+
+    // Stats are best effort. If the gpu service is unavailable or the transaction fails, the
+    // batch is dropped rather than retried, so a missing service never keeps a thread around.
+    if (!gpuService) {
+        gpuService = getGpuService();
+        if (!gpuService) return;
     }
+
+    const status_t status = gpuService->setGpuStatsBatch(batch);
+    if (status != OK) {
+        ALOGW("Failed to send gpu stats: %s (%d)", strerror(-status), status);
+    }
+}
+
+void GraphicsEnv::setGpuServiceForTesting(const sp<IGpuService>& gpuService) {
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    gGpuServiceForTesting = gpuService;
+}
+
+void GraphicsEnv::setGpuStatsFlushSchedulerForTesting(std::function<void()> scheduler) {
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    mGpuStatsFlushSchedulerForTesting = std::move(scheduler);
 }
 
 void* GraphicsEnv::loadLibrary(std::string name) {
@@ -104,6 +104,20 @@ public:
 
         remote()->transact(BnGpuService::SET_TARGET_STATS, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+    virtual status_t setGpuStatsBatch(const GpuStatsBatch& batch) {
+        Parcel data, reply;
+        status_t status;
+
+        if ((status = data.writeInterfaceToken(IGpuService::getInterfaceDescriptor())) != OK) {
+            return status;
+        }
+
+        if ((status = data.writeParcelable(batch)) != OK) return status;
+
+        return remote()->transact(BnGpuService::SET_GPU_STATS_BATCH, data, &reply,
+                                  IBinder::FLAG_ONEWAY);
+    }
 };
 
 IMPLEMENT_META_INTERFACE(GpuService, "android.graphicsenv.IGpuService");
@@ -196,6 +210,14 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data, Parcel* rep
 
             return OK;
         }
+        case SET_GPU_STATS_BATCH: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            GpuStatsBatch batch;
+            if ((status = data.readParcelable(&batch)) != OK) return status;
+
+            return setGpuStatsBatch(batch);
+        }
         case SHELL_COMMAND_TRANSACTION: {
             int in = data.readFileDescriptor();
             int out = data.readFileDescriptor();
@@ -72,4 +72,43 @@ public:
     bool cpuVulkanInUse = false;
 };
 
+/*
+ * class for transporting the gpu stats collected by GraphicsEnv in a process to
+ * GpuService in a single transaction. This class is intended to be a data
+ * container.
+ */
+class GpuStatsBatch : public Parcelable {
+public:
+    struct DriverStats {
+        int32_t driver = 0;
+        bool isDriverLoaded = false;
+        int64_t driverLoadingTime = 0;
+    };
+
+    struct TargetStats {
+        int32_t stats = 0;
+        uint64_t value = 0;
+    };
+
+    GpuStatsBatch() = default;
+    GpuStatsBatch(const GpuStatsBatch&) = default;
+    virtual ~GpuStatsBatch() = default;
+    virtual status_t writeToParcel(Parcel* parcel) const;
+    virtual status_t readFromParcel(const Parcel* parcel);
+
+    bool empty() const { return driverStats.empty() && targetStats.empty(); }
+
+    // This limits the number of entries accepted from a single batch.
+    static constexpr size_t MAX_NUM_ENTRIES = 64;
+
+    std::string driverPackageName = "";
+    std::string driverVersionName = "";
+    uint64_t driverVersionCode = 0;
+    int64_t driverBuildTime = 0;
+    std::string appPackageName = "";
+    int32_t vulkanVersion = 0;
+    std::vector<DriverStats> driverStats = {};
+    std::vector<TargetStats> targetStats = {};
+};
+
 } // namespace android
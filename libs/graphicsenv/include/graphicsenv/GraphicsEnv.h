@@ -17,6 +17,7 @@
 #ifndef ANDROID_UI_GRAPHICS_ENV_H
 #define ANDROID_UI_GRAPHICS_ENV_H 1
 
+#include <functional>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -25,7 +26,10 @@ struct android_namespace_t;
 
 namespace android {
 
+class IGpuService;
 struct NativeLoaderNamespace;
+template <typename T>
+class sp;
 
 class GraphicsEnv {
 public:
@@ -48,6 +52,17 @@ public:
     };
 
 private:
+    struct PendingDriverStats {
+        Driver driver;
+        bool isDriverLoaded;
+        int64_t driverLoadingTime;
+    };
+
+    struct PendingTargetStats {
+        Stats stats;
+        uint64_t value;
+    };
+
     struct GpuStats {
         std::string driverPackageName;
         std::string driverVersionName;
@@ -63,6 +78,10 @@ private:
         bool vkDriverToSend;
         int64_t glDriverLoadingTime;
         int64_t vkDriverLoadingTime;
+        // Stats waiting to be flushed to GpuService in one batch.
+        std::vector<PendingDriverStats> pendingDriverStats;
+        std::vector<PendingTargetStats> pendingTargetStats;
+        bool flushScheduled;
 
         GpuStats()
               : driverPackageName(""),
@@ -78,7 +97,8 @@ private:
                 glDriverToSend(false),
                 vkDriverToSend(false),
                 glDriverLoadingTime(0),
-                vkDriverLoadingTime(0) {}
+                vkDriverLoadingTime(0),
+                flushScheduled(false) {}
     };
 
 public:
@@ -104,6 +124,14 @@ public:
     void setDriverToLoad(Driver driver);
     void setDriverLoaded(Api api, bool isDriverLoaded, int64_t driverLoadingTime);
     void sendGpuStatsLocked(Api api, bool isDriverLoaded, int64_t driverLoadingTime);
+    // Send all pending stats to GpuService in one oneway transaction. Stats are normally flushed
+    // from a background thread shortly after they are recorded, off the driver loading path.
+    void flushGpuStats();
+    // Test only: route the stats to the given service instead of looking up the gpu service.
+    void setGpuServiceForTesting(const sp<IGpuService>& gpuService);
+    // Test only: called instead of starting the background flush, so that tests can flush the
+    // stats themselves with flushGpuStats().
+    void setGpuStatsFlushSchedulerForTesting(std::function<void()> scheduler);
 
     bool shouldUseAngle(std::string appName);
     bool shouldUseAngle();
@@ -134,12 +162,14 @@ private:
     bool checkAngleRules(void* so);
     void updateUseAngle();
     bool linkDriverNamespaceLocked(android_namespace_t* vndkNamespace);
+    void scheduleGpuStatsFlushLocked();
 
     GraphicsEnv() = default;
     std::string mDriverPath;
     std::string mSphalLibraries;
     std::mutex mStatsLock;
     GpuStats mGpuStats;
+    std::function<void()> mGpuStatsFlushSchedulerForTesting;
     std::string mAnglePath;
     std::string mAngleAppName;
     std::string mAngleDeveloperOptIn;
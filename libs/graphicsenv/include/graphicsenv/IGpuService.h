@@ -44,6 +44,9 @@ public:
     virtual void setTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
                                 const GraphicsEnv::Stats stats, const uint64_t value = 0) = 0;
 
+    // set all GPU stats and target stats collected by GraphicsEnvironment in one transaction.
+    virtual status_t setGpuStatsBatch(const GpuStatsBatch& batch) = 0;
+
     // get GPU global stats from GpuStats module.
     virtual status_t getGpuStatsGlobalInfo(std::vector<GpuStatsGlobalInfo>* outStats) const = 0;
 
@@ -58,6 +61,7 @@ public:
         GET_GPU_STATS_GLOBAL_INFO,
         GET_GPU_STATS_APP_INFO,
         SET_TARGET_STATS,
+        SET_GPU_STATS_BATCH,
         // Always append new enum to the end.
     };
 
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GraphicsEnv_test"
+
+#include <gtest/gtest.h>
+
+#include <graphicsenv/GraphicsEnv.h>
+#include <graphicsenv/IGpuService.h>
+
+#include <mutex>
+#include <thread>
+
+namespace android {
+namespace {
+
+class FakeGpuService : public BnGpuService {
+public:
+    void setGpuStats(const std::string&, const std::string&, uint64_t, int64_t,
+                     const std::string&, const int32_t, GraphicsEnv::Driver, bool,
+                     int64_t) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNumTransactions++;
+        mLastThread = std::this_thread::get_id();
+    }
+
+    status_t setGpuStatsBatch(const GpuStatsBatch& batch) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNumTransactions++;
+        mLastThread = std::this_thread::get_id();
+        mLastBatch = batch;
+        return mStatus;
+    }
+
+    void setTargetStats(const std::string&, const uint64_t, const GraphicsEnv::Stats,
+                        const uint64_t) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNumTransactions++;
+        mLastThread = std::this_thread::get_id();
+    }
+
+    status_t getGpuStatsGlobalInfo(std::vector<GpuStatsGlobalInfo>*) const override { return OK; }
+    status_t getGpuStatsAppInfo(std::vector<GpuStatsAppInfo>*) const override { return OK; }
+
+    std::mutex mMutex;
+    size_t mNumTransactions = 0;
+    std::thread::id mLastThread;
+    GpuStatsBatch mLastBatch;
+    status_t mStatus = OK;
+
+protected:
+    status_t shellCommand(int, int, int, std::vector<String16>&) override { return OK; }
+};
+
+class GraphicsEnvStatsTest : public testing::Test {
+protected:
+    void SetUp() override {
+        mGpuService = new FakeGpuService();
+        GraphicsEnv::getInstance().setGpuServiceForTesting(mGpuService);
+        // The stats are only flushed by the tests, so that none is left for later tests.
+        GraphicsEnv::getInstance().setGpuStatsFlushSchedulerForTesting(
+                [this] { mNumScheduledFlushes++; });
+        GraphicsEnv::getInstance().setGpuStats("com.example.driver", "1.0", 10, 20,
+                                               "com.example.app", 0x401000);
+        // Drain anything left behind by a previous test.
+        GraphicsEnv::getInstance().flushGpuStats();
+        mGpuService->mNumTransactions = 0;
+        mNumScheduledFlushes = 0;
+    }
+
+    void TearDown() override {
+        GraphicsEnv::getInstance().flushGpuStats();
+        GraphicsEnv::getInstance().setGpuStatsFlushSchedulerForTesting(nullptr);
+        GraphicsEnv::getInstance().setGpuServiceForTesting(nullptr);
+    }
+
+    sp<FakeGpuService> mGpuService;
+    size_t mNumScheduledFlushes = 0;
+};
+
+TEST_F(GraphicsEnvStatsTest, driverLoadingDoesNotCallGpuService) {
+    // The synchronous path paid a round trip to the gpu service on every driver load. Now the
+    // caller only schedules a flush, which runs on another thread.
+    for (int i = 0; i < 20; i++) {
+        GraphicsEnv::getInstance().setDriverLoaded(GraphicsEnv::Api::API_GL, true, 1000);
+        GraphicsEnv::getInstance().setTargetStats(GraphicsEnv::Stats::CPU_VULKAN_IN_USE);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mGpuService->mMutex);
+        EXPECT_EQ(0u, mGpuService->mNumTransactions);
+    }
+    EXPECT_EQ(1u, mNumScheduledFlushes);
+
+    std::thread flushThread([] { GraphicsEnv::getInstance().flushGpuStats(); });
+    const std::thread::id flushThreadId = flushThread.get_id();
+    flushThread.join();
+
+    std::lock_guard<std::mutex> lock(mGpuService->mMutex);
+    EXPECT_EQ(1u, mGpuService->mNumTransactions);
+    EXPECT_EQ(flushThreadId, mGpuService->mLastThread);
+}
+
+TEST_F(GraphicsEnvStatsTest, statsAreSentInOneBatch) {
+    GraphicsEnv::getInstance().setDriverLoaded(GraphicsEnv::Api::API_GL, true, 1000);
+    GraphicsEnv::getInstance().setDriverLoaded(GraphicsEnv::Api::API_VK, false, 2000);
+    GraphicsEnv::getInstance().setTargetStats(GraphicsEnv::Stats::CPU_VULKAN_IN_USE);
+    GraphicsEnv::getInstance().flushGpuStats();
+
+    std::lock_guard<std::mutex> lock(mGpuService->mMutex);
+    EXPECT_EQ(1u, mGpuService->mNumTransactions);
+
+    const GpuStatsBatch& batch = mGpuService->mLastBatch;
+    EXPECT_EQ("com.example.app", batch.appPackageName);
+    EXPECT_EQ(10u, batch.driverVersionCode);
+    ASSERT_EQ(2u, batch.driverStats.size());
+    EXPECT_TRUE(batch.driverStats[0].isDriverLoaded);
+    EXPECT_EQ(1000, batch.driverStats[0].driverLoadingTime);
+    EXPECT_FALSE(batch.driverStats[1].isDriverLoaded);
+    EXPECT_EQ(2000, batch.driverStats[1].driverLoadingTime);
+    ASSERT_EQ(1u, batch.targetStats.size());
+    EXPECT_EQ(GraphicsEnv::Stats::CPU_VULKAN_IN_USE, batch.targetStats[0].stats);
+}
+
+TEST_F(GraphicsEnvStatsTest, emptyFlushDoesNotTransact) {
+    GraphicsEnv::getInstance().flushGpuStats();
+
+    std::lock_guard<std::mutex> lock(mGpuService->mMutex);
+    EXPECT_EQ(0u, mGpuService->mNumTransactions);
+}
+
+TEST_F(GraphicsEnvStatsTest, failedTransactionDropsBatch) {
+    mGpuService->mStatus = DEAD_OBJECT;
+    GraphicsEnv::getInstance().setDriverLoaded(GraphicsEnv::Api::API_GL, true, 1000);
+    GraphicsEnv::getInstance().flushGpuStats();
+
+    mGpuService->mStatus = OK;
+    GraphicsEnv::getInstance().flushGpuStats();
+
+    std::lock_guard<std::mutex> lock(mGpuService->mMutex);
+    EXPECT_EQ(1u, mGpuService->mNumTransactions);
+}
+
+TEST_F(GraphicsEnvStatsTest, pendingStatsScheduleOneFlush) {
+    GraphicsEnv::getInstance().setDriverLoaded(GraphicsEnv::Api::API_GL, true, 1000);
+    GraphicsEnv::getInstance().setDriverLoaded(GraphicsEnv::Api::API_VK, true, 2000);
+    GraphicsEnv::getInstance().setTargetStats(GraphicsEnv::Stats::CPU_VULKAN_IN_USE);
+    EXPECT_EQ(1u, mNumScheduledFlushes);
+
+    GraphicsEnv::getInstance().flushGpuStats();
+    GraphicsEnv::getInstance().setTargetStats(GraphicsEnv::Stats::CPU_VULKAN_IN_USE);
+    EXPECT_EQ(2u, mNumScheduledFlushes);
+
+    std::lock_guard<std::mutex> lock(mGpuService->mMutex);
+    EXPECT_EQ(1u, mGpuService->mNumTransactions);
+}
+
+} // namespace
+} // namespace android
@@ -69,7 +69,7 @@ public:
                                      const sp<IBinder>& applyToken,
                                      const InputWindowCommands& commands,
                                      int64_t desiredPresentTime,
-                                     const client_cache_t& uncacheBuffer,
+                                     const std::vector<client_cache_t>& uncacheBuffers,
                                      const std::vector<ListenerCallbacks>& listenerCallbacks) {
         Parcel data, reply;
         data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
@@ -88,8 +88,11 @@ public:
         data.writeStrongBinder(applyToken);
         commands.write(data);
         data.writeInt64(desiredPresentTime);
-        data.writeWeakBinder(uncacheBuffer.token);
-        data.writeUint64(uncacheBuffer.id);
+        data.writeUint32(static_cast<uint32_t>(uncacheBuffers.size()));
+        for (const auto& uncacheBuffer : uncacheBuffers) {
+            data.writeWeakBinder(uncacheBuffer.token);
+            data.writeUint64(uncacheBuffer.id);
+        }
 
         if (data.writeVectorSize(listenerCallbacks) == NO_ERROR) {
             for (const auto& [listener, callbackIds] : listenerCallbacks) {
@@ -1035,9 +1038,15 @@ status_t BnSurfaceComposer::onTransact(
 
             int64_t desiredPresentTime = data.readInt64();
 
-            client_cache_t uncachedBuffer;
-            uncachedBuffer.token = data.readWeakBinder();
-            uncachedBuffer.id = data.readUint64();
+            count = data.readUint32();
+            if (count > data.dataSize()) {
+                return BAD_VALUE;
+            }
+            std::vector<client_cache_t> uncacheBuffers(count);
+            for (auto& uncacheBuffer : uncacheBuffers) {
+                uncacheBuffer.token = data.readWeakBinder();
+                uncacheBuffer.id = data.readUint64();
+            }
 
             std::vector<ListenerCallbacks> listenerCallbacks;
             int32_t listenersSize = data.readInt32();
@@ -1050,7 +1059,7 @@ status_t BnSurfaceComposer::onTransact(
             }
 
             setTransactionState(state, displays, stateFlags, applyToken, inputWindowCommands,
-                                desiredPresentTime, uncachedBuffer, listenerCallbacks);
+                                desiredPresentTime, uncacheBuffers, listenerCallbacks);
             return NO_ERROR;
         }
         case BOOT_FINISHED: {
@@ -20,6 +20,7 @@
 #include <gui/ISurfaceComposerClient.h>
 
 #include <gui/IGraphicBufferProducer.h>
+#include <gui/LayerState.h>
 
 #include <binder/SafeInterface.h>
 
@@ -34,7 +35,8 @@ enum class Tag : uint32_t {
     CREATE_WITH_SURFACE_PARENT,
     CLEAR_LAYER_FRAME_STATS,
     GET_LAYER_FRAME_STATS,
-    LAST = GET_LAYER_FRAME_STATS,
+    CREATE_SURFACES,
+    LAST = CREATE_SURFACES,
 };
 
 } // Anonymous namespace
@@ -80,6 +82,12 @@ public:
                 &ISurfaceComposerClient::getLayerFrameStats)>(Tag::GET_LAYER_FRAME_STATS, handle,
                                                               outStats);
     }
+
+    status_t createSurfaces(const std::vector<SurfaceCreationArgs>& args,
+                            std::vector<SurfaceCreationResult>* outResults) override {
+        return callRemote<decltype(&ISurfaceComposerClient::createSurfaces)>(Tag::CREATE_SURFACES,
+                                                                             args, outResults);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this
@@ -105,6 +113,8 @@ status_t BnSurfaceComposerClient::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &ISurfaceComposerClient::clearLayerFrameStats);
         case Tag::GET_LAYER_FRAME_STATS:
             return callLocal(data, reply, &ISurfaceComposerClient::getLayerFrameStats);
+        case Tag::CREATE_SURFACES:
+            return callLocal(data, reply, &ISurfaceComposerClient::createSurfaces);
     }
 }
 
@@ -178,6 +178,47 @@ status_t ComposerState::read(const Parcel& input) {
     return state.read(input);
 }
 
+status_t SurfaceCreationArgs::writeToParcel(Parcel* output) const {
+    output->writeString8(name);
+    output->writeUint32(w);
+    output->writeUint32(h);
+    output->writeInt32(format);
+    output->writeUint32(flags);
+    output->writeInt32(parentIndex);
+    output->writeStrongBinder(parentHandle);
+    status_t err = metadata.writeToParcel(output);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    return state.write(*output);
+}
+
+status_t SurfaceCreationArgs::readFromParcel(const Parcel* input) {
+    name = input->readString8();
+    w = input->readUint32();
+    h = input->readUint32();
+    format = input->readInt32();
+    flags = input->readUint32();
+    parentIndex = input->readInt32();
+    parentHandle = input->readStrongBinder();
+    status_t err = metadata.readFromParcel(input);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    return state.read(*input);
+}
+
+status_t SurfaceCreationResult::writeToParcel(Parcel* output) const {
+    output->writeStrongBinder(handle);
+    return output->writeStrongBinder(IInterface::asBinder(gbp));
+}
+
+status_t SurfaceCreationResult::readFromParcel(const Parcel* input) {
+    handle = input->readStrongBinder();
+    gbp = interface_cast<IGraphicBufferProducer>(input->readStrongBinder());
+    return NO_ERROR;
+}
+
 
 DisplayState::DisplayState() :
     what(0),
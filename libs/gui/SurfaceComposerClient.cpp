@@ -19,6 +19,17 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <pthread.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <utils/SortedVector.h>
@@ -235,6 +246,10 @@ void TransactionCompletedListener::onTransactionCompleted(ListenerStats listener
 
 void bufferCacheCallback(void* /*context*/, uint64_t graphicBufferId);
 
+// Buffers are uncached along with the next transaction of the process, and keep their slot until
+// that transaction is sent: SurfaceFlinger applies transactions in order, and erases the uncached
+// buffers of a transaction before it caches the new ones, so that its cache never holds more than
+// BUFFER_CACHE_MAX_SIZE buffers.
 class BufferCache : public Singleton<BufferCache> {
 public:
     BufferCache() : token(new BBinder()) {}
@@ -246,63 +261,149 @@ public:
     status_t getCacheId(const sp<GraphicBuffer>& buffer, uint64_t* cacheId) {
         std::lock_guard<std::mutex> lock(mMutex);
 
-        auto itr = mBuffers.find(buffer->getId());
+        const uint64_t id = buffer->getId();
+        auto itr = mBuffers.find(id);
         if (itr == mBuffers.end()) {
+            mStats.misses++;
             return BAD_VALUE;
         }
-        itr->second = getCounter();
-        *cacheId = buffer->getId();
+        mLru.splice(mLru.begin(), mLru, itr->second);
+        mStats.hits++;
+        *cacheId = id;
         return NO_ERROR;
     }
 
-    uint64_t cache(const sp<GraphicBuffer>& buffer) {
+    // Caches a buffer of the transaction that uncaches the buffers in uncacheIds, evicting the
+    // least recently used buffer into them if the cache is full. The buffers in usedIds, which
+    // the transaction already refers to by id, are never evicted.
+    status_t cache(const sp<GraphicBuffer>& buffer, const std::unordered_set<uint64_t>& usedIds,
+                   std::vector<uint64_t>* uncacheIds, uint64_t* cacheId) {
         std::lock_guard<std::mutex> lock(mMutex);
 
-        if (mBuffers.size() >= BUFFER_CACHE_MAX_SIZE) {
-            evictLeastRecentlyUsedBuffer();
+        // SurfaceFlinger could erase it after it is cached again.
+        const uint64_t id = buffer->getId();
+        if (mUncachesInFlight.count(id)) {
+            return BAD_VALUE;
+        }
+
+        // The buffers that the transaction uncaches are erased before it caches its own.
+        while (mBuffers.size() + mPendingUncaches.size() + mUncachesInFlight.size() -
+                       uncacheIds->size() >=
+               BUFFER_CACHE_MAX_SIZE) {
+            // The buffers used by the transaction were just moved to the front.
+            auto evicted = std::find_if(mLru.rbegin(), mLru.rend(),
+                                        [&](uint64_t id) { return usedIds.count(id) == 0; });
+            if (evicted == mLru.rend()) {
+                return NO_MEMORY;
+            }
+            const uint64_t evictedId = *evicted;
+            mLru.erase(std::next(evicted).base());
+            mBuffers.erase(evictedId);
+            mUncachesInFlight.insert(evictedId);
+            uncacheIds->push_back(evictedId);
+            mStats.evictions++;
         }
 
         buffer->addDeathCallback(bufferCacheCallback, nullptr);
 
-        mBuffers[buffer->getId()] = getCounter();
-        return buffer->getId();
+        mLru.push_front(id);
+        mBuffers.emplace(id, mLru.begin());
+        *cacheId = id;
+        return NO_ERROR;
     }
 
+    // Called when the buffer is destroyed, so that it is uncached by the next transaction, or
+    // by a transaction of its own if the process sends none soon.
     void uncache(uint64_t cacheId) {
         std::lock_guard<std::mutex> lock(mMutex);
-        uncacheLocked(cacheId);
+
+        auto itr = mBuffers.find(cacheId);
+        if (itr == mBuffers.end()) {
+            return;
+        }
+        mLru.erase(itr->second);
+        mBuffers.erase(itr);
+        mPendingUncaches.insert(cacheId);
+
+        if (!mFlushThreadStarted) {
+            std::thread thread([this] { flushThreadMain(); });
+            pthread_setname_np(thread.native_handle(), "BufferUncache");
+            thread.detach();
+            mFlushThreadStarted = true;
+        }
+        if (mPendingUncaches.size() == 1 || isFlushDueLocked()) {
+            mFlushCondition.notify_one();
+        }
     }
 
-    void uncacheLocked(uint64_t cacheId) REQUIRES(mMutex) {
-        mBuffers.erase(cacheId);
-        SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
+    // Moves the buffers waiting to be uncached to the transaction about to be sent.
+    void takeUncaches(std::vector<uint64_t>* uncacheIds) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for (uint64_t id : mPendingUncaches) {
+            mUncachesInFlight.insert(id);
+            uncacheIds->push_back(id);
+        }
+        mPendingUncaches.clear();
     }
 
-private:
-    void evictLeastRecentlyUsedBuffer() REQUIRES(mMutex) {
-        auto itr = mBuffers.begin();
-        uint64_t minCounter = itr->second;
-        auto minBuffer = itr;
-        itr++;
-
-        while (itr != mBuffers.end()) {
-            uint64_t counter = itr->second;
-            if (counter < minCounter) {
-                minCounter = counter;
-                minBuffer = itr;
-            }
-            itr++;
+    // Called once the transaction that uncaches the buffers is sent.
+    void finishUncaches(const std::vector<uint64_t>& uncacheIds) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for (uint64_t id : uncacheIds) {
+            mUncachesInFlight.erase(id);
         }
-        uncacheLocked(minBuffer->first);
+        mStats.uncaches += uncacheIds.size();
     }
 
-    uint64_t getCounter() REQUIRES(mMutex) {
-        static uint64_t counter = 0;
-        return counter++;
+    SurfaceComposerClient::BufferCacheStats getStats() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+private:
+    // How long destroyed buffers wait for a transaction of the process to take their uncaches
+    // along, before they are sent on their own.
+    static constexpr std::chrono::milliseconds kUncacheDelay{100};
+
+    bool isFlushDueLocked() REQUIRES(mMutex) {
+        return mPendingUncaches.size() >= BUFFER_CACHE_MAX_SIZE / 4;
+    }
+
+    // Sends the uncaches that no transaction took along in time, so that destroyed buffers are
+    // not kept alive by SurfaceFlinger while the process is idle.
+    void flushThreadMain() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mFlushCondition.wait(lock, [this] { return !mPendingUncaches.empty(); });
+            mFlushCondition.wait_for(lock, kUncacheDelay, [this] {
+                return mPendingUncaches.empty() || isFlushDueLocked();
+            });
+            if (mPendingUncaches.empty()) {
+                continue;
+            }
+            lock.unlock();
+            SurfaceComposerClient::doUncacheBufferTransaction();
+            lock.lock();
+        }
     }
 
     std::mutex mMutex;
-    std::map<uint64_t /*Cache id*/, uint64_t /*counter*/> mBuffers GUARDED_BY(mMutex);
+    // Wakes the flush thread when buffers are destroyed.
+    std::condition_variable mFlushCondition;
+    // The flush thread is started with the first destroyed buffer, and lives as long as the
+    // process, like the cache.
+    bool mFlushThreadStarted GUARDED_BY(mMutex) = false;
+    // Ids of the cached buffers, from the most to the least recently used.
+    std::list<uint64_t> mLru GUARDED_BY(mMutex);
+    std::unordered_map<uint64_t /*Cache id*/, std::list<uint64_t>::iterator> mBuffers
+            GUARDED_BY(mMutex);
+    // Buffers to uncache with the next transaction.
+    std::unordered_set<uint64_t> mPendingUncaches GUARDED_BY(mMutex);
+    // Buffers uncached by transactions that are being sent.
+    std::unordered_set<uint64_t> mUncachesInFlight GUARDED_BY(mMutex);
+    SurfaceComposerClient::BufferCacheStats mStats GUARDED_BY(mMutex);
 
     // Used by ISurfaceComposer to identify which process is sending the cached buffer.
     sp<IBinder> token;
@@ -371,6 +472,19 @@ SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Tr
     return *this;
 }
 
+static std::vector<client_cache_t> toClientCacheIds(const std::vector<uint64_t>& cacheIds) {
+    std::vector<client_cache_t> clientCacheIds(cacheIds.size());
+    if (cacheIds.empty()) {
+        return clientCacheIds;
+    }
+    const sp<IBinder> token = BufferCache::getInstance().getToken();
+    for (size_t i = 0; i < cacheIds.size(); i++) {
+        clientCacheIds[i].token = token;
+        clientCacheIds[i].id = cacheIds[i];
+    }
+    return clientCacheIds;
+}
+
 void SurfaceComposerClient::doDropReferenceTransaction(const sp<IBinder>& handle,
         const sp<ISurfaceComposerClient>& client) {
     sp<ISurfaceComposer> sf(ComposerService::getComposerService());
@@ -384,26 +498,45 @@ void SurfaceComposerClient::doDropReferenceTransaction(const sp<IBinder>& handle
     s.state.parentHandleForChild = nullptr;
 
     composerStates.add(s);
+
+    // The buffers of the surface are often destroyed along with it.
+    std::vector<uint64_t> uncacheIds;
+    BufferCache::getInstance().takeUncaches(&uncacheIds);
+
     sp<IBinder> applyToken = IInterface::asBinder(TransactionCompletedListener::getIInstance());
-    sf->setTransactionState(composerStates, displayStates, 0, applyToken, {}, -1, {}, {});
+    sf->setTransactionState(composerStates, displayStates, 0, applyToken, {}, -1,
+                            toClientCacheIds(uncacheIds), {});
+    BufferCache::getInstance().finishUncaches(uncacheIds);
 }
 
-void SurfaceComposerClient::doUncacheBufferTransaction(uint64_t cacheId) {
-    sp<ISurfaceComposer> sf(ComposerService::getComposerService());
-
-    client_cache_t uncacheBuffer;
-    uncacheBuffer.token = BufferCache::getInstance().getToken();
-    uncacheBuffer.id = cacheId;
+void SurfaceComposerClient::doUncacheBufferTransaction() {
+    std::vector<uint64_t> uncacheIds;
+    BufferCache::getInstance().takeUncaches(&uncacheIds);
+    if (uncacheIds.empty()) {
+        return;
+    }
 
+    sp<ISurfaceComposer> sf(ComposerService::getComposerService());
     sp<IBinder> applyToken = IInterface::asBinder(TransactionCompletedListener::getIInstance());
-    sf->setTransactionState({}, {}, 0, applyToken, {}, -1, uncacheBuffer, {});
+    sf->setTransactionState({}, {}, 0, applyToken, {}, -1, toClientCacheIds(uncacheIds), {});
+    BufferCache::getInstance().finishUncaches(uncacheIds);
 }
 
-void SurfaceComposerClient::Transaction::cacheBuffers() {
+SurfaceComposerClient::BufferCacheStats SurfaceComposerClient::getBufferCacheStats() {
+    return BufferCache::getInstance().getStats();
+}
+
+void SurfaceComposerClient::Transaction::cacheBuffers(std::vector<uint64_t>* uncacheIds) {
+    // Any transaction takes the buffers to uncache along, which saves a transaction for them.
+    BufferCache::getInstance().takeUncaches(uncacheIds);
+
     if (!mContainsBuffer) {
         return;
     }
 
+    // SurfaceFlinger erases the uncached buffers before it applies the states, so a buffer that
+    // a state refers to by id must not be evicted by a later state.
+    std::unordered_set<uint64_t> usedIds;
     size_t count = 0;
     for (auto& [sc, cs] : mComposerStates) {
         layer_state_t* s = getLayerState(sc);
@@ -422,9 +555,12 @@ void SurfaceComposerClient::Transaction::cacheBuffers() {
         if (ret == NO_ERROR) {
             s->what &= ~static_cast<uint64_t>(layer_state_t::eBufferChanged);
             s->buffer = nullptr;
-        } else {
-            cacheId = BufferCache::getInstance().cache(s->buffer);
+        } else if (BufferCache::getInstance().cache(s->buffer, usedIds, uncacheIds, &cacheId) !=
+                   NO_ERROR) {
+            // Sent without caching it, until the cache has room for it.
+            continue;
         }
+        usedIds.insert(cacheId);
         s->what |= layer_state_t::eCachedBufferChanged;
         s->cachedBuffer.token = BufferCache::getInstance().getToken();
         s->cachedBuffer.id = cacheId;
@@ -469,7 +605,8 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
     }
     mListenerCallbacks.clear();
 
-    cacheBuffers();
+    std::vector<uint64_t> uncacheIds;
+    cacheBuffers(&uncacheIds);
 
     Vector<ComposerState> composerStates;
     Vector<DisplayState> displayStates;
@@ -502,9 +639,8 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
 
     sp<IBinder> applyToken = IInterface::asBinder(TransactionCompletedListener::getIInstance());
     sf->setTransactionState(composerStates, displayStates, flags, applyToken, mInputWindowCommands,
-                            mDesiredPresentTime,
-                            {} /*uncacheBuffer - only set in doUncacheBufferTransaction*/,
-                            listenerCallbacks);
+                            mDesiredPresentTime, toClientCacheIds(uncacheIds), listenerCallbacks);
+    BufferCache::getInstance().finishUncaches(uncacheIds);
     mInputWindowCommands.clear();
     mStatus = NO_ERROR;
     return NO_ERROR;
@@ -1371,6 +1507,31 @@ status_t SurfaceComposerClient::createSurfaceChecked(const String8& name, uint32
     return err;
 }
 
+status_t SurfaceComposerClient::createSurfaces(const std::vector<SurfaceCreationArgs>& args,
+                                               std::vector<sp<SurfaceControl>>* outSurfaces) {
+    if (mStatus != NO_ERROR) {
+        return mStatus;
+    }
+
+    std::vector<SurfaceCreationResult> results;
+    status_t err = mClient->createSurfaces(args, &results);
+    ALOGE_IF(err, "SurfaceComposerClient::createSurfaces error %s", strerror(-err));
+    if (err != NO_ERROR) {
+        return err;
+    }
+    if (results.size() != args.size()) {
+        return BAD_VALUE;
+    }
+
+    outSurfaces->clear();
+    outSurfaces->reserve(results.size());
+    for (const SurfaceCreationResult& result : results) {
+        outSurfaces->push_back(
+                new SurfaceControl(this, result.handle, result.gbp, true /* owned */));
+    }
+    return NO_ERROR;
+}
+
 status_t SurfaceComposerClient::clearLayerFrameStats(const sp<IBinder>& token) const {
     if (mStatus != NO_ERROR) {
         return mStatus;
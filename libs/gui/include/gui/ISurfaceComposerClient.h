@@ -22,11 +22,14 @@
 #include <ui/PixelFormat.h>
 
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 
 class FrameStats;
 class IGraphicBufferProducer;
+struct SurfaceCreationArgs;
+struct SurfaceCreationResult;
 
 class ISurfaceComposerClient : public IInterface {
 public:
@@ -76,6 +79,15 @@ public:
      * Requires ACCESS_SURFACE_FLINGER permission
      */
     virtual status_t getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outStats) const = 0;
+
+    /*
+     * Creates the surfaces of a tree at once, with their initial state, so that none of them
+     * appears before the others. Fails without creating any surface if one of them fails.
+     *
+     * Requires ACCESS_SURFACE_FLINGER permission
+     */
+    virtual status_t createSurfaces(const std::vector<SurfaceCreationArgs>& args,
+                                    std::vector<SurfaceCreationResult>* outResults) = 0;
 };
 
 class BnSurfaceComposerClient : public SafeBnInterface<ISurfaceComposerClient> {
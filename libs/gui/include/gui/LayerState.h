@@ -21,6 +21,7 @@
 #include <sys/types.h>
 
 #include <utils/Errors.h>
+#include <utils/String8.h>
 
 #include <gui/IGraphicBufferProducer.h>
 #include <math/mat4.h>
@@ -32,6 +33,7 @@
 #include <gui/LayerMetadata.h>
 #include <math/vec3.h>
 #include <ui/GraphicTypes.h>
+#include <ui/PixelFormat.h>
 #include <ui/Rect.h>
 #include <ui/Region.h>
 
@@ -212,6 +214,33 @@ struct ComposerState {
     status_t read(const Parcel& input);
 };
 
+// A surface created by ISurfaceComposerClient::createSurfaces, along with the rest of its tree.
+struct SurfaceCreationArgs : public Parcelable {
+    String8 name;
+    uint32_t w = 0;
+    uint32_t h = 0;
+    PixelFormat format = PIXEL_FORMAT_NONE;
+    uint32_t flags = 0;
+    // Index of the parent when it is created by the same call, before this surface, or -1.
+    int32_t parentIndex = -1;
+    // Existing parent, if any, when parentIndex is -1.
+    sp<IBinder> parentHandle;
+    LayerMetadata metadata;
+    // Applied as the surface is created, whatever its surface field.
+    layer_state_t state;
+
+    status_t writeToParcel(Parcel* output) const override;
+    status_t readFromParcel(const Parcel* input) override;
+};
+
+struct SurfaceCreationResult : public Parcelable {
+    sp<IBinder> handle;
+    sp<IGraphicBufferProducer> gbp;
+
+    status_t writeToParcel(Parcel* output) const override;
+    status_t readFromParcel(const Parcel* input) override;
+};
+
 struct DisplayState {
     enum {
         eOrientationDefault = 0,
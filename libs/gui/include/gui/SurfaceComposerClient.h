@@ -167,10 +167,23 @@ public:
             const sp<ISurfaceComposerClient>& client);
 
     /**
-     * Uncaches a buffer in ISurfaceComposer. It must be uncached via a transaction so that it is
-     * in order with other transactions that use buffers.
+     * Uncaches the destroyed buffers in ISurfaceComposer. They must be uncached via a transaction
+     * so that it is in order with other transactions that use buffers.
      */
-    static void doUncacheBufferTransaction(uint64_t cacheId);
+    static void doUncacheBufferTransaction();
+
+    struct BufferCacheStats {
+        // Buffers of transactions that were, or were not, cached already.
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        // Buffers uncached to make room for others.
+        uint64_t evictions = 0;
+        // Buffers uncached in ISurfaceComposer, once evicted or destroyed.
+        uint64_t uncaches = 0;
+    };
+
+    // Statistics of the buffer cache that the process shares with ISurfaceComposer.
+    static BufferCacheStats getBufferCacheStats();
 
     // Queries whether a given display is wide color display.
     static status_t isWideColorDisplay(const sp<IBinder>& display, bool* outIsWideColorDisplay);
@@ -236,6 +249,10 @@ public:
                                   LayerMetadata metadata = LayerMetadata() // metadata
     );
 
+    //! Create the surfaces of a tree with their initial state, in a single call
+    status_t createSurfaces(const std::vector<SurfaceCreationArgs>& args,
+                            std::vector<sp<SurfaceControl>>* outSurfaces);
+
     //! Create a surface
     sp<SurfaceControl> createWithSurfaceParent(const String8& name,       // name of the surface
                                                uint32_t w,                // width in pixel
@@ -317,7 +334,7 @@ public:
         layer_state_t* getLayerState(const sp<SurfaceControl>& sc);
         DisplayState& getDisplayState(const sp<IBinder>& token);
 
-        void cacheBuffers();
+        void cacheBuffers(std::vector<uint64_t>* uncacheIds);
         void registerSurfaceControlForCallback(const sp<SurfaceControl>& sc);
 
     public:
@@ -687,7 +687,8 @@ public:
                              const Vector<DisplayState>& /*displays*/, uint32_t /*flags*/,
                              const sp<IBinder>& /*applyToken*/,
                              const InputWindowCommands& /*inputWindowCommands*/,
-                             int64_t /*desiredPresentTime*/, const client_cache_t& /*cachedBuffer*/,
+                             int64_t /*desiredPresentTime*/,
+                             const std::vector<client_cache_t>& /*uncacheBuffers*/,
                              const std::vector<ListenerCallbacks>& /*listenerCallbacks*/) override {
     }
 
@@ -23,12 +23,14 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
+#include <cutils/ashmem.h>
 #include <cutils/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
@@ -220,6 +222,149 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
     }
 }
 
+// --- InputMessageRing ---
+
+namespace {
+
+// Records start with their header, and are 8-byte aligned like the messages.
+struct RingRecord {
+    uint32_t size;
+    uint32_t padding;
+};
+
+// Size of the record skipping the end of the ring, when a message does not fit there.
+constexpr uint32_t RING_RECORD_WRAP = UINT32_MAX;
+
+// The control block is followed by the messages.
+constexpr size_t RING_DATA_OFFSET = 128;
+
+inline size_t ringRecordSize(size_t messageSize) {
+    return sizeof(RingRecord) + ((messageSize + 7) & ~size_t(7));
+}
+
+} // namespace
+
+InputMessageRing::InputMessageRing(int fd, void* memory, size_t capacity) :
+        mFd(fd), mControl(static_cast<Control*>(memory)),
+        mData(static_cast<uint8_t*>(memory) + RING_DATA_OFFSET), mCapacity(capacity) {
+    static_assert(sizeof(Control) <= RING_DATA_OFFSET);
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+}
+
+InputMessageRing::~InputMessageRing() {
+    munmap(mControl, RING_DATA_OFFSET + mCapacity);
+    ::close(mFd);
+}
+
+std::unique_ptr<InputMessageRing> InputMessageRing::create(const std::string& name,
+        size_t capacity) {
+    if (capacity < 2 * ringRecordSize(sizeof(InputMessage)) || capacity > UINT32_MAX / 2
+            || (capacity & (capacity - 1))) {
+        ALOGE("channel '%s' ~ Invalid message ring capacity %zu.", name.c_str(), capacity);
+        return nullptr;
+    }
+
+    int fd = ashmem_create_region(name.c_str(), RING_DATA_OFFSET + capacity);
+    if (fd < 0) {
+        ALOGE("channel '%s' ~ Could not create message ring.  errno=%d", name.c_str(), errno);
+        return nullptr;
+    }
+    // Zero-filled, so the ring starts empty.
+    return map(fd);
+}
+
+std::unique_ptr<InputMessageRing> InputMessageRing::map(int fd) {
+    const int size = ashmem_get_size_region(fd);
+    const size_t capacity = size > int(RING_DATA_OFFSET) ? size - RING_DATA_OFFSET : 0;
+    if (capacity < 2 * ringRecordSize(sizeof(InputMessage)) || (capacity & (capacity - 1))) {
+        ALOGE("Invalid message ring of size %d.", size);
+        ::close(fd);
+        return nullptr;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        ALOGE("Could not map message ring.  errno=%d", errno);
+        ::close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<InputMessageRing>(new InputMessageRing(fd, memory, capacity));
+}
+
+status_t InputMessageRing::push(const InputMessage& msg, size_t size, bool* outWasEmpty) {
+    const uint32_t start = mControl->head.load(std::memory_order_relaxed);
+    // Not trusted, since the consumer is usually an app.
+    const uint32_t tail = mControl->tail.load(std::memory_order_acquire);
+    const uint32_t used = start - tail;
+    if (used > mCapacity || (start & 7)) {
+        return BAD_VALUE;
+    }
+
+    const size_t recordSize = ringRecordSize(size);
+    uint32_t head = start;
+    size_t offset = head & (mCapacity - 1);
+    const size_t skipped = mCapacity - offset < recordSize ? mCapacity - offset : 0;
+    if (skipped + recordSize > mCapacity - used) {
+        return WOULD_BLOCK;
+    }
+
+    RingRecord record = {};
+    if (skipped) {
+        record.size = RING_RECORD_WRAP;
+        memcpy(mData + offset, &record, sizeof(record));
+        head += skipped;
+        offset = 0;
+    }
+    record.size = size;
+    memcpy(mData + offset, &record, sizeof(record));
+    memcpy(mData + offset + sizeof(record), &msg, size);
+
+    // Sequentially consistent, so that either the consumer sees the new head before deciding to
+    // wait for a wakeup, or the tail loaded here shows that it took every message before.
+    mControl->head.store(head + recordSize);
+    *outWasEmpty = int32_t(mControl->tail.load() - start) >= 0;
+    return OK;
+}
+
+status_t InputMessageRing::pop(InputMessage* msg) {
+    uint32_t tail = mControl->tail.load(std::memory_order_relaxed);
+    const uint32_t head = mControl->head.load();
+    if (head == tail) {
+        return WOULD_BLOCK;
+    }
+    size_t available = head - tail;
+    if (available > mCapacity || (tail & 7)) {
+        return BAD_VALUE;
+    }
+
+    size_t offset = tail & (mCapacity - 1);
+    RingRecord record;
+    memcpy(&record, mData + offset, sizeof(record));
+    if (record.size == RING_RECORD_WRAP) {
+        const size_t skipped = mCapacity - offset;
+        if (skipped >= available) {
+            return BAD_VALUE;
+        }
+        tail += skipped;
+        available -= skipped;
+        offset = 0;
+        memcpy(&record, mData, sizeof(record));
+    }
+    // The record is copied out before it is validated, since the producer could still change it.
+    const size_t recordSize = ringRecordSize(record.size);
+    if (record.size > sizeof(InputMessage) || recordSize > available
+            || offset + recordSize > mCapacity) {
+        return BAD_VALUE;
+    }
+    memcpy(msg, mData + offset + sizeof(record), record.size);
+    mControl->tail.store(tail + recordSize);
+
+    if (!msg->isValid(record.size)) {
+        return BAD_VALUE;
+    }
+    return OK;
+}
+
 // --- InputChannel ---
 
 InputChannel::InputChannel(const std::string& name, int fd) :
@@ -281,10 +426,48 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
     return OK;
 }
 
+status_t InputChannel::openInputChannelPair(const std::string& name,
+        sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel,
+        size_t ringCapacity) {
+    status_t result = openInputChannelPair(name, outServerChannel, outClientChannel);
+    if (result != OK) {
+        return result;
+    }
+
+    outServerChannel->mSendRing = InputMessageRing::create(name, ringCapacity);
+    if (outServerChannel->mSendRing) {
+        outClientChannel->mReceiveRing =
+                InputMessageRing::map(::dup(outServerChannel->mSendRing->getFd()));
+    }
+    if (!outClientChannel->mReceiveRing) {
+        outServerChannel.clear();
+        outClientChannel.clear();
+        return NO_MEMORY;
+    }
+    return OK;
+}
+
 status_t InputChannel::sendMessage(const InputMessage* msg) {
     const size_t msgLength = msg->size();
     InputMessage cleanMsg;
     msg->getSanitizedCopy(&cleanMsg);
+    if (mSendRing) {
+        bool wasEmpty;
+        status_t result = mSendRing->push(cleanMsg, msgLength, &wasEmpty);
+        if (result != OK) {
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ error adding message of type %d to ring, status=%d",
+                    mName.c_str(), msg->header.type, result);
+#endif
+            return result;
+        }
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ added message of type %d to ring", mName.c_str(),
+                msg->header.type);
+#endif
+        return wasEmpty ? sendWakeup() : OK;
+    }
+
     ssize_t nWrite;
     do {
         nWrite = ::send(mFd, &cleanMsg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
@@ -320,6 +503,21 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
 }
 
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (mReceiveRing) {
+        status_t result = mReceiveRing->pop(msg);
+        if (result != WOULD_BLOCK) {
+            return result;
+        }
+        // The wakeups are consumed before looking at the ring again, so that the one sent for a
+        // message added in between cannot be lost.
+        status_t wakeupResult = receiveWakeups();
+        result = mReceiveRing->pop(msg);
+        if (result != WOULD_BLOCK || wakeupResult == OK) {
+            return result;
+        }
+        return wakeupResult;
+    }
+
     ssize_t nRead;
     do {
         nRead = ::recv(mFd, msg, sizeof(InputMessage), MSG_DONTWAIT);
@@ -359,11 +557,95 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendWakeup() {
+    const uint8_t wakeup = 0;
+    ssize_t nWrite;
+    do {
+        nWrite = ::send(mFd, &wakeup, sizeof(wakeup), MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (nWrite == -1 && errno == EINTR);
+
+    if (nWrite < 0) {
+        int error = errno;
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            // The peer has yet to receive the wakeups sent before.
+            return OK;
+        }
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED || error == ECONNRESET) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+    return OK;
+}
+
+status_t InputChannel::receiveWakeups() {
+    uint8_t wakeup;
+    while (true) {
+        ssize_t nRead = ::recv(mFd, &wakeup, sizeof(wakeup), MSG_DONTWAIT);
+        if (nRead > 0) {
+            continue;
+        }
+        if (nRead == 0) { // check for EOF
+            return DEAD_OBJECT;
+        }
+
+        int error = errno;
+        if (error == EINTR) {
+            continue;
+        }
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            return OK;
+        }
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ receive wakeup failed, errno=%d", mName.c_str(), error);
+#endif
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+}
+
+static std::unique_ptr<InputMessageRing> dupRing(const std::unique_ptr<InputMessageRing>& ring) {
+    int fd = ::dup(ring->getFd());
+    return fd >= 0 ? InputMessageRing::map(fd) : nullptr;
+}
+
 sp<InputChannel> InputChannel::dup() const {
     int fd = ::dup(getFd());
-    return fd >= 0 ? new InputChannel(getName(), fd) : nullptr;
+    if (fd < 0) {
+        return nullptr;
+    }
+    sp<InputChannel> channel = new InputChannel(getName(), fd);
+    if (mSendRing && !(channel->mSendRing = dupRing(mSendRing))) {
+        return nullptr;
+    }
+    if (mReceiveRing && !(channel->mReceiveRing = dupRing(mReceiveRing))) {
+        return nullptr;
+    }
+    return channel;
+}
+
+static status_t writeRing(Parcel& out, const std::unique_ptr<InputMessageRing>& ring) {
+    status_t s = out.writeBool(ring != nullptr);
+    if (s != OK || !ring) {
+        return s;
+    }
+    return out.writeDupFileDescriptor(ring->getFd());
 }
 
+static status_t readRing(const Parcel& from, std::unique_ptr<InputMessageRing>* outRing) {
+    outRing->reset();
+    if (!from.readBool()) {
+        return OK;
+    }
+    int fd = ::dup(from.readFileDescriptor());
+    if (fd < 0) {
+        return BAD_VALUE;
+    }
+    *outRing = InputMessageRing::map(fd);
+    return *outRing ? OK : BAD_VALUE;
+}
 
 status_t InputChannel::write(Parcel& out) const {
     status_t s = out.writeString8(String8(getName().c_str()));
@@ -377,6 +659,14 @@ status_t InputChannel::write(Parcel& out) const {
     }
 
     s = out.writeDupFileDescriptor(getFd());
+    if (s != OK) {
+        return s;
+    }
+    s = writeRing(out, mSendRing);
+    if (s != OK) {
+        return s;
+    }
+    s = writeRing(out, mReceiveRing);
 
     return s;
 }
@@ -392,7 +682,11 @@ status_t InputChannel::read(const Parcel& from) {
         return BAD_VALUE;
     }
 
-    return OK;
+    status_t s = readRing(from, &mSendRing);
+    if (s != OK) {
+        return s;
+    }
+    return readRing(from, &mReceiveRing);
 }
 
 sp<IBinder> InputChannel::getToken() const {
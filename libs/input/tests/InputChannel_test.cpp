@@ -21,6 +21,9 @@
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 
 #include <gtest/gtest.h>
 #include <input/InputTransport.h>
@@ -189,5 +192,187 @@ TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
     }
 }
 
+static InputMessage makeMotionMessage(uint32_t seq, uint32_t pointerCount) {
+    InputMessage msg = {};
+    msg.header.type = InputMessage::TYPE_MOTION;
+    msg.body.motion.seq = seq;
+    msg.body.motion.pointerCount = pointerCount;
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        msg.body.motion.pointers[i].properties.id = i;
+        msg.body.motion.pointers[i].coords.setAxisValue(AMOTION_EVENT_AXIS_X, seq);
+        msg.body.motion.pointers[i].coords.setAxisValue(AMOTION_EVENT_AXIS_Y, i);
+    }
+    return msg;
+}
+
+// Counts and consumes the packets waiting on the fd.
+static size_t drainPackets(int fd) {
+    size_t count = 0;
+    uint8_t buffer[sizeof(InputMessage)];
+    while (::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+        count++;
+    }
+    return count;
+}
+
+TEST_F(InputChannelTest, OpenInputChannelPairWithRing_ReturnsAPairOfConnectedChannels) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, InputMessageRing::DEFAULT_CAPACITY));
+    EXPECT_TRUE(serverChannel->hasMessageRing());
+    EXPECT_TRUE(clientChannel->hasMessageRing());
+
+    InputMessage serverMsg = makeMotionMessage(1, 3), clientMsg;
+    EXPECT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(InputMessage::TYPE_MOTION, clientMsg.header.type);
+    EXPECT_EQ(0, memcmp(&serverMsg, &clientMsg, serverMsg.size()));
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+
+    // Finished signals still go through the socket.
+    InputMessage clientReply = {}, serverReply;
+    clientReply.header.type = InputMessage::TYPE_FINISHED;
+    clientReply.body.finished.seq = 1;
+    clientReply.body.finished.handled = true;
+    EXPECT_EQ(OK, clientChannel->sendMessage(&clientReply));
+    EXPECT_EQ(OK, serverChannel->receiveMessage(&serverReply));
+    EXPECT_EQ(InputMessage::TYPE_FINISHED, serverReply.header.type);
+    EXPECT_EQ(1U, serverReply.body.finished.seq);
+    EXPECT_TRUE(serverReply.body.finished.handled);
+}
+
+TEST_F(InputChannelTest, OpenInputChannelPairWithRing_WhenCapacityIsInvalid_ReturnsAnError) {
+    sp<InputChannel> serverChannel, clientChannel;
+    EXPECT_NE(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, InputMessageRing::DEFAULT_CAPACITY - 1));
+    EXPECT_EQ(nullptr, serverChannel.get());
+    EXPECT_EQ(nullptr, clientChannel.get());
+}
+
+TEST_F(InputChannelTest, SendMessage_WithRing_OnlyWakesUpTheClientWhenTheRingWasEmpty) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, InputMessageRing::DEFAULT_CAPACITY));
+
+    InputMessage msg = makeMotionMessage(1, 1);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    struct pollfd pfd = {clientChannel->getFd(), POLLIN, 0};
+    EXPECT_EQ(1, poll(&pfd, 1, 0));
+
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    EXPECT_EQ(1U, drainPackets(clientChannel->getFd()));
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    }
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    EXPECT_EQ(1, poll(&pfd, 1, 0));
+}
+
+TEST_F(InputChannelTest, SendMessage_WithRing_WhenFull_ReturnsWouldBlock) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, 8 * 1024));
+
+    InputMessage msg = makeMotionMessage(1, MAX_POINTERS);
+    size_t sent = 0;
+    while (serverChannel->sendMessage(&msg) == OK) {
+        sent++;
+    }
+    ASSERT_GT(sent, 0U);
+    EXPECT_EQ(WOULD_BLOCK, serverChannel->sendMessage(&msg));
+
+    InputMessage received;
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&received));
+    EXPECT_EQ(OK, serverChannel->sendMessage(&msg));
+}
+
+TEST_F(InputChannelTest, SendAndReceive_WithRing_KeepsMessagesInOrderAcrossWraparounds) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, 8 * 1024));
+
+    uint32_t sentSeq = 1, receivedSeq = 1;
+    while (receivedSeq < 1000) {
+        InputMessage msg = makeMotionMessage(sentSeq, 1 + sentSeq % MAX_POINTERS);
+        while (serverChannel->sendMessage(&msg) == OK) {
+            sentSeq++;
+            msg = makeMotionMessage(sentSeq, 1 + sentSeq % MAX_POINTERS);
+        }
+
+        InputMessage received;
+        status_t result;
+        while ((result = clientChannel->receiveMessage(&received)) == OK) {
+            const InputMessage expected =
+                    makeMotionMessage(receivedSeq, 1 + receivedSeq % MAX_POINTERS);
+            ASSERT_EQ(expected.size(), received.size());
+            ASSERT_EQ(0, memcmp(&expected, &received, expected.size())) << receivedSeq;
+            receivedSeq++;
+        }
+        ASSERT_EQ(WOULD_BLOCK, result);
+        ASSERT_EQ(sentSeq, receivedSeq);
+    }
+}
+
+TEST_F(InputChannelTest, ReceiveMessage_WithRing_WhenPeerClosed_ReturnsPendingMessagesFirst) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, InputMessageRing::DEFAULT_CAPACITY));
+
+    InputMessage msg = makeMotionMessage(1, 1);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    serverChannel.clear();
+
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&msg));
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessage(&msg));
+}
+
+TEST_F(InputChannelTest, Dup_WithRing_SharesTheRing) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel, InputMessageRing::DEFAULT_CAPACITY));
+
+    sp<InputChannel> dupChannel = clientChannel->dup();
+    ASSERT_NE(nullptr, dupChannel.get());
+    EXPECT_TRUE(dupChannel->hasMessageRing());
+    clientChannel.clear();
+
+    InputMessage msg = makeMotionMessage(7, 2), received;
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    EXPECT_EQ(OK, dupChannel->receiveMessage(&received));
+    EXPECT_EQ(7U, received.body.motion.seq);
+}
+
+// The ring is shared with another process, so each end checks what the other one wrote.
+TEST_F(InputChannelTest, InputMessageRing_WhenPositionsAreCorrupted_ReturnsAnError) {
+    std::unique_ptr<InputMessageRing> ring =
+            InputMessageRing::create("ring", InputMessageRing::DEFAULT_CAPACITY);
+    ASSERT_NE(nullptr, ring);
+    void* memory = mmap(nullptr, 128, PROT_READ | PROT_WRITE, MAP_SHARED, ring->getFd(), 0);
+    ASSERT_NE(MAP_FAILED, memory);
+    // The head and the tail, each on its own cache line.
+    uint32_t* head = static_cast<uint32_t*>(memory);
+    uint32_t* tail = head + 16;
+
+    InputMessage msg = makeMotionMessage(1, 1);
+    bool wasEmpty;
+    *tail = InputMessageRing::DEFAULT_CAPACITY * 2;
+    EXPECT_EQ(BAD_VALUE, ring->push(msg, msg.size(), &wasEmpty));
+
+    *tail = 0;
+    ASSERT_EQ(OK, ring->push(msg, msg.size(), &wasEmpty));
+    EXPECT_TRUE(wasEmpty);
+    *head += InputMessageRing::DEFAULT_CAPACITY;
+    EXPECT_EQ(BAD_VALUE, ring->pop(&msg));
+
+    *head = 4;
+    EXPECT_EQ(BAD_VALUE, ring->pop(&msg));
+    munmap(memory, 128);
+}
 
 } // namespace android
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <binder/Parcel.h>
+#include <input/Input.h>
+
+namespace android {
+namespace {
+
+// A batch of touchscreen samples, as a consumer would resample from several input messages.
+constexpr size_t kPointerCount = 2;
+constexpr size_t kSampleCount = 64;
+
+std::vector<PointerCoords> makeSampleCoords() {
+    std::vector<PointerCoords> coords(kPointerCount * kSampleCount);
+    for (size_t i = 0; i < coords.size(); i++) {
+        const float t = float(i);
+        coords[i].clear();
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 + t);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 200 + t * 2);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5f);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_SIZE, 0.25f);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, 10 + t);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, 8 + t);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, 0.1f);
+    }
+    return coords;
+}
+
+void makeMotionEvent(const std::vector<PointerCoords>& coords, MotionEvent* event) {
+    PointerProperties properties[kPointerCount];
+    for (size_t i = 0; i < kPointerCount; i++) {
+        properties[i].clear();
+        properties[i].id = i;
+        properties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    }
+    event->initialize(0 /*deviceId*/, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+            AMOTION_EVENT_ACTION_MOVE, 0 /*actionButton*/, 0 /*flags*/,
+            AMOTION_EVENT_EDGE_FLAG_NONE, AMETA_NONE, 0 /*buttonState*/,
+            MotionClassification::NONE, 0 /*xOffset*/, 0 /*yOffset*/, 1 /*xPrecision*/,
+            1 /*yPrecision*/, 0 /*downTime*/, 0 /*eventTime*/, kPointerCount, properties,
+            coords.data());
+    for (size_t i = 1; i < kSampleCount; i++) {
+        event->addSample(i, &coords[i * kPointerCount]);
+    }
+}
+
+void makeRotationMatrix(float matrix[9]) {
+    const float angle = 0.01f;
+    matrix[0] = cosf(angle);
+    matrix[1] = -sinf(angle);
+    matrix[2] = 0;
+    matrix[3] = sinf(angle);
+    matrix[4] = cosf(angle);
+    matrix[5] = 0;
+    matrix[6] = 0;
+    matrix[7] = 0;
+    matrix[8] = 1;
+}
+
+// --- Batching ---
+
+void BM_MotionEventAddSample(benchmark::State& state) {
+    const std::vector<PointerCoords> coords = makeSampleCoords();
+    for (auto _ : state) {
+        MotionEvent event;
+        makeMotionEvent(coords, &event);
+        benchmark::DoNotOptimize(event.getHistoricalX(0, kSampleCount - 2));
+    }
+}
+BENCHMARK(BM_MotionEventAddSample);
+
+// --- Transform and scale ---
+
+void BM_MotionEventTransform(benchmark::State& state) {
+    MotionEvent event;
+    makeMotionEvent(makeSampleCoords(), &event);
+    float matrix[9];
+    makeRotationMatrix(matrix);
+    for (auto _ : state) {
+        event.transform(matrix);
+    }
+    benchmark::DoNotOptimize(event.getX(0));
+}
+BENCHMARK(BM_MotionEventTransform);
+
+// Scales back and forth, so that the values stay in range however long the benchmark runs.
+void BM_MotionEventScale(benchmark::State& state) {
+    MotionEvent event;
+    makeMotionEvent(makeSampleCoords(), &event);
+    for (auto _ : state) {
+        event.scale(2.0f);
+        event.scale(0.5f);
+    }
+    benchmark::DoNotOptimize(event.getX(0));
+}
+BENCHMARK(BM_MotionEventScale);
+
+// --- Parceling ---
+
+void BM_MotionEventParcel(benchmark::State& state) {
+    MotionEvent event;
+    makeMotionEvent(makeSampleCoords(), &event);
+    for (auto _ : state) {
+        Parcel parcel;
+        event.writeToParcel(&parcel);
+        parcel.setDataPosition(0);
+        MotionEvent outEvent;
+        benchmark::DoNotOptimize(outEvent.readFromParcel(&parcel));
+    }
+}
+BENCHMARK(BM_MotionEventParcel);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -320,4 +320,26 @@ TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
 }
 
+class InputPublisherAndConsumerWithRingTest : public InputPublisherAndConsumerTest {
+protected:
+    virtual void SetUp() {
+        mPublisher = nullptr;
+        mConsumer = nullptr;
+        status_t result = InputChannel::openInputChannelPair("channel name",
+                serverChannel, clientChannel, InputMessageRing::DEFAULT_CAPACITY);
+        ASSERT_EQ(OK, result);
+
+        mPublisher = new InputPublisher(serverChannel);
+        mConsumer = new InputConsumer(clientChannel);
+    }
+};
+
+TEST_F(InputPublisherAndConsumerWithRingTest, PublishMultipleEvents_EndToEnd) {
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+}
+
 } // namespace android
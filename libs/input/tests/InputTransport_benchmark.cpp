@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <poll.h>
+
+#include <thread>
+
+#include <benchmark/benchmark.h>
+#include <input/InputTransport.h>
+
+namespace android {
+namespace {
+
+// Messages sent before the consumer gets to run, as when a 1 kHz mouse outpaces the frame rate.
+constexpr size_t kBurstSize = 16;
+
+// Arguments of the benchmarks: 0 for the socket alone, or the capacity of the message ring.
+constexpr int64_t kSocket = 0;
+constexpr int64_t kRing = InputMessageRing::DEFAULT_CAPACITY;
+
+void openChannels(int64_t ringCapacity, sp<InputChannel>* outServerChannel,
+        sp<InputChannel>* outClientChannel) {
+    if (ringCapacity) {
+        InputChannel::openInputChannelPair("benchmark", *outServerChannel, *outClientChannel,
+                ringCapacity);
+    } else {
+        InputChannel::openInputChannelPair("benchmark", *outServerChannel, *outClientChannel);
+    }
+}
+
+InputMessage makeMouseMessage(uint32_t seq) {
+    InputMessage msg = {};
+    msg.header.type = InputMessage::TYPE_MOTION;
+    msg.body.motion.seq = seq;
+    msg.body.motion.source = AINPUT_SOURCE_MOUSE;
+    msg.body.motion.action = AMOTION_EVENT_ACTION_HOVER_MOVE;
+    msg.body.motion.pointerCount = 1;
+    msg.body.motion.pointers[0].properties.toolType = AMOTION_EVENT_TOOL_TYPE_MOUSE;
+    msg.body.motion.pointers[0].coords.setAxisValue(AMOTION_EVENT_AXIS_X, 100);
+    msg.body.motion.pointers[0].coords.setAxisValue(AMOTION_EVENT_AXIS_Y, 200);
+    msg.body.motion.pointers[0].coords.setAxisValue(AMOTION_EVENT_AXIS_RELATIVE_X, 1);
+    msg.body.motion.pointers[0].coords.setAxisValue(AMOTION_EVENT_AXIS_RELATIVE_Y, 2);
+    return msg;
+}
+
+bool waitForInput(int fd) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, -1) == 1 && !(pfd.revents & (POLLERR | POLLHUP));
+}
+
+// Sends bursts of messages, and receives them on the same thread.
+void BM_SendAndReceiveBurst(benchmark::State& state) {
+    sp<InputChannel> serverChannel, clientChannel;
+    openChannels(state.range(0), &serverChannel, &clientChannel);
+    const InputMessage msg = makeMouseMessage(1);
+    InputMessage received;
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < kBurstSize; i++) {
+            if (serverChannel->sendMessage(&msg) != OK) {
+                state.SkipWithError("Channel is full");
+                return;
+            }
+        }
+        while (clientChannel->receiveMessage(&received) == OK) {
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kBurstSize);
+}
+BENCHMARK(BM_SendAndReceiveBurst)->Arg(kSocket)->Arg(kRing);
+
+// Time from publishing a message to receiving the finished signal of the consumer thread.
+void BM_FinishedSignalRoundTrip(benchmark::State& state) {
+    sp<InputChannel> serverChannel, clientChannel;
+    openChannels(state.range(0), &serverChannel, &clientChannel);
+
+    std::thread consumer([clientChannel] {
+        InputMessage msg;
+        while (waitForInput(clientChannel->getFd())) {
+            status_t result;
+            while ((result = clientChannel->receiveMessage(&msg)) == OK) {
+                InputMessage reply = {};
+                reply.header.type = InputMessage::TYPE_FINISHED;
+                reply.body.finished.seq = msg.body.motion.seq;
+                reply.body.finished.handled = true;
+                clientChannel->sendMessage(&reply);
+            }
+            if (result != WOULD_BLOCK) {
+                return;
+            }
+        }
+    });
+
+    uint32_t seq = 1;
+    for (auto _ : state) {
+        const InputMessage msg = makeMouseMessage(seq++);
+        serverChannel->sendMessage(&msg);
+        InputMessage reply;
+        while (serverChannel->receiveMessage(&reply) == WOULD_BLOCK) {
+            waitForInput(serverChannel->getFd());
+        }
+    }
+
+    // Lets the consumer find out the channel was closed.
+    serverChannel.clear();
+    consumer.join();
+}
+BENCHMARK(BM_FinishedSignalRoundTrip)->Arg(kSocket)->Arg(kRing)->UseRealTime();
+
+} // namespace
+} // namespace android
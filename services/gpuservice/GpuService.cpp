@@ -57,6 +57,23 @@ void GpuService::setGpuStats(const std::string& driverPackageName,
                       appPackageName, vulkanVersion, driver, isDriverLoaded, driverLoadingTime);
 }
 
+status_t GpuService::setGpuStatsBatch(const GpuStatsBatch& batch) {
+    // Driver stats go first since target stats are only recorded for known app records.
+    for (const auto& ele : batch.driverStats) {
+        mGpuStats->insert(batch.driverPackageName, batch.driverVersionName,
+                          batch.driverVersionCode, batch.driverBuildTime, batch.appPackageName,
+                          batch.vulkanVersion, static_cast<GraphicsEnv::Driver>(ele.driver),
+                          ele.isDriverLoaded, ele.driverLoadingTime);
+    }
+
+    for (const auto& ele : batch.targetStats) {
+        mGpuStats->insertTargetStats(batch.appPackageName, batch.driverVersionCode,
+                                     static_cast<GraphicsEnv::Stats>(ele.stats), ele.value);
+    }
+
+    return OK;
+}
+
 status_t GpuService::getGpuStatsGlobalInfo(std::vector<GpuStatsGlobalInfo>* outStats) const {
     mGpuStats->pullGlobalStats(outStats);
     return OK;
@@ -48,6 +48,7 @@ private:
                      const std::string& appPackageName, const int32_t vulkanVersion,
                      GraphicsEnv::Driver driver, bool isDriverLoaded,
                      int64_t driverLoadingTime) override;
+    status_t setGpuStatsBatch(const GpuStatsBatch& batch) override;
     status_t getGpuStatsGlobalInfo(std::vector<GpuStatsGlobalInfo>* outStats) const override;
     status_t getGpuStatsAppInfo(std::vector<GpuStatsAppInfo>* outStats) const override;
     void setTargetStats(const std::string& appPackageName, const uint64_t driverVersionCode,
@@ -19,14 +19,81 @@
 
 #include "GpuStats.h"
 
+#include <android-base/stringprintf.h>
 #include <cutils/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <unordered_set>
 
 namespace android {
 
+using base::StringAppendF;
+
+size_t LoadingTimeHistogram::bucketIndex(int64_t loadingTimeNs) {
+    if (loadingTimeNs < (int64_t(1) << MIN_EXPONENT)) {
+        return 0;
+    }
+    const uint64_t value = static_cast<uint64_t>(loadingTimeNs);
+    const size_t exponent = 63 - __builtin_clzll(value);
+    if (exponent >= MAX_EXPONENT) {
+        return NUM_BUCKETS - 1;
+    }
+    const size_t subBucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return 1 + (exponent - MIN_EXPONENT) * SUB_BUCKETS + subBucket;
+}
+
+int64_t LoadingTimeHistogram::bucketUpperBound(size_t index) {
+    if (index == 0) {
+        return (int64_t(1) << MIN_EXPONENT) - 1;
+    }
+    const size_t exponent = (index - 1) / SUB_BUCKETS + MIN_EXPONENT;
+    const size_t subBucket = (index - 1) % SUB_BUCKETS;
+    return static_cast<int64_t>(((SUB_BUCKETS + subBucket + 1) << (exponent - SUB_BUCKET_BITS)) -
+                                1);
+}
+
+void LoadingTimeHistogram::insert(int64_t loadingTimeNs) {
+    uint16_t& bucket = mBuckets[bucketIndex(loadingTimeNs)];
+    if (bucket < UINT16_MAX) {
+        bucket++;
+    }
+    mMin = mCount ? std::min(mMin, loadingTimeNs) : loadingTimeNs;
+    mMax = mCount ? std::max(mMax, loadingTimeNs) : loadingTimeNs;
+    mCount++;
+}
+
+int64_t LoadingTimeHistogram::percentile(double percentile) const {
+    if (!mCount) return 0;
+    if (percentile <= 0) return mMin;
+
+    // Ranked against the bucket counts, which only differ from mCount once a bucket saturated.
+    const size_t total = std::accumulate(mBuckets.begin(), mBuckets.end(), size_t(0));
+    const size_t rank =
+            std::max<size_t>(1, static_cast<size_t>(std::ceil(percentile / 100.0 * total)));
+    size_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += mBuckets[i];
+        if (seen >= rank) {
+            // The last bucket has no upper bound of its own, as it holds the clamped samples.
+            return i == NUM_BUCKETS - 1 ? mMax : std::clamp(bucketUpperBound(i), mMin, mMax);
+        }
+    }
+    return mMax;
+}
+
+std::string LoadingTimeHistogram::toString() const {
+    std::string result;
+    StringAppendF(&result,
+                  "count = %zu, min = %" PRId64 ", p50 = %" PRId64 ", p90 = %" PRId64
+                  ", p99 = %" PRId64 ", max = %" PRId64,
+                  mCount, mMin, percentile(50), percentile(90), percentile(99), mMax);
+    return result;
+}
+
 static void addLoadingCount(GraphicsEnv::Driver driver, bool isDriverLoaded,
                             GpuStatsGlobalInfo* const outGlobalInfo) {
     switch (driver) {
@@ -49,29 +116,73 @@ static void addLoadingCount(GraphicsEnv::Driver driver, bool isDriverLoaded,
     }
 }
 
-static void addLoadingTime(GraphicsEnv::Driver driver, int64_t driverLoadingTime,
-                           GpuStatsAppInfo* const outAppInfo) {
-    switch (driver) {
-        case GraphicsEnv::Driver::GL:
-        case GraphicsEnv::Driver::GL_UPDATED:
-            if (outAppInfo->glDriverLoadingTime.size() < GpuStats::MAX_NUM_LOADING_TIMES) {
-                outAppInfo->glDriverLoadingTime.emplace_back(driverLoadingTime);
-            }
-            break;
-        case GraphicsEnv::Driver::VULKAN:
-        case GraphicsEnv::Driver::VULKAN_UPDATED:
-            if (outAppInfo->vkDriverLoadingTime.size() < GpuStats::MAX_NUM_LOADING_TIMES) {
-                outAppInfo->vkDriverLoadingTime.emplace_back(driverLoadingTime);
-            }
-            break;
-        case GraphicsEnv::Driver::ANGLE:
-            if (outAppInfo->angleDriverLoadingTime.size() < GpuStats::MAX_NUM_LOADING_TIMES) {
-                outAppInfo->angleDriverLoadingTime.emplace_back(driverLoadingTime);
-            }
-            break;
-        default:
-            break;
+static void addLoadingTime(int64_t driverLoadingTime, std::vector<int64_t>* outLoadingTimes,
+                           LoadingTimeHistogram* outHistogram) {
+    // The raw samples are capped for statsd, while the histogram keeps the full distribution.
+    if (outLoadingTimes->size() < GpuStats::MAX_NUM_LOADING_TIMES) {
+        outLoadingTimes->emplace_back(driverLoadingTime);
+    }
+    outHistogram->insert(driverLoadingTime);
+}
+
+GpuStats::AppStats* GpuStats::findAppStatsLocked(const std::string& appPackageName,
+                                                 uint64_t driverVersionCode) {
+    const auto packageName = mPackageNames.find(appPackageName);
+    if (packageName == mPackageNames.end()) {
+        return nullptr;
+    }
+
+    const auto appStats = mAppStats.find({packageName->second.id, driverVersionCode});
+    if (appStats == mAppStats.end()) {
+        return nullptr;
+    }
+
+    mAppStatsLru.splice(mAppStatsLru.begin(), mAppStatsLru, appStats->second.lruPosition);
+    return &appStats->second;
+}
+
+GpuStats::AppStats* GpuStats::createAppStatsLocked(const std::string& appPackageName,
+                                                   uint64_t driverVersionCode) {
+    if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
+        ALOGV("GpuStatsAppInfo has reached maximum size. Evict the least recently used record.");
+        evictAppStatsLocked(mAppStatsLru.back());
+    }
+
+    auto packageName = mPackageNames.find(appPackageName);
+    if (packageName == mPackageNames.end()) {
+        packageName = mPackageNames.insert({appPackageName, {mNextPackageId++, 0}}).first;
+    }
+    packageName->second.refCount++;
+
+    const AppStatsKey key = {packageName->second.id, driverVersionCode};
+    mAppStatsLru.push_front(key);
+
+    AppStats& appStats = mAppStats[key];
+    appStats.info.appPackageName = appPackageName;
+    appStats.info.driverVersionCode = driverVersionCode;
+    appStats.lruPosition = mAppStatsLru.begin();
+    return &appStats;
+}
+
+void GpuStats::evictAppStatsLocked(const AppStatsKey& key) {
+    const auto appStats = mAppStats.find(key);
+    if (appStats == mAppStats.end()) {
+        return;
+    }
+
+    const auto packageName = mPackageNames.find(appStats->second.info.appPackageName);
+    if (packageName != mPackageNames.end() && --packageName->second.refCount == 0) {
+        mPackageNames.erase(packageName);
     }
+
+    mAppStatsLru.erase(appStats->second.lruPosition);
+    mAppStats.erase(appStats);
+}
+
+void GpuStats::clearAppStatsLocked() {
+    mAppStats.clear();
+    mAppStatsLru.clear();
+    mPackageNames.clear();
 }
 
 void GpuStats::insert(const std::string& driverPackageName, const std::string& driverVersionName,
@@ -95,7 +206,8 @@ void GpuStats::insert(const std::string& driverPackageName, const std::string& d
           appPackageName.c_str(), vulkanVersion, static_cast<int32_t>(driver), isDriverLoaded,
           driverLoadingTime);
 
-    if (!mGlobalStats.count(driverVersionCode)) {
+    const auto globalStats = mGlobalStats.find(driverVersionCode);
+    if (globalStats == mGlobalStats.end()) {
         GpuStatsGlobalInfo globalInfo;
         addLoadingCount(driver, isDriverLoaded, &globalInfo);
         globalInfo.driverPackageName = driverPackageName;
@@ -105,25 +217,32 @@ void GpuStats::insert(const std::string& driverPackageName, const std::string& d
         globalInfo.vulkanVersion = vulkanVersion;
         mGlobalStats.insert({driverVersionCode, globalInfo});
     } else {
-        addLoadingCount(driver, isDriverLoaded, &mGlobalStats[driverVersionCode]);
+        addLoadingCount(driver, isDriverLoaded, &globalStats->second);
     }
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-    if (!mAppStats.count(appStatsKey)) {
-        if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
-            ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
-            return;
-        }
-
-        GpuStatsAppInfo appInfo;
-        addLoadingTime(driver, driverLoadingTime, &appInfo);
-        appInfo.appPackageName = appPackageName;
-        appInfo.driverVersionCode = driverVersionCode;
-        mAppStats.insert({appStatsKey, appInfo});
-        return;
+    AppStats* appStats = findAppStatsLocked(appPackageName, driverVersionCode);
+    if (!appStats) {
+        appStats = createAppStatsLocked(appPackageName, driverVersionCode);
     }
 
-    addLoadingTime(driver, driverLoadingTime, &mAppStats[appStatsKey]);
+    switch (driver) {
+        case GraphicsEnv::Driver::GL:
+        case GraphicsEnv::Driver::GL_UPDATED:
+            addLoadingTime(driverLoadingTime, &appStats->info.glDriverLoadingTime,
+                           &appStats->glLoadingTime);
+            break;
+        case GraphicsEnv::Driver::VULKAN:
+        case GraphicsEnv::Driver::VULKAN_UPDATED:
+            addLoadingTime(driverLoadingTime, &appStats->info.vkDriverLoadingTime,
+                           &appStats->vkLoadingTime);
+            break;
+        case GraphicsEnv::Driver::ANGLE:
+            addLoadingTime(driverLoadingTime, &appStats->info.angleDriverLoadingTime,
+                           &appStats->angleLoadingTime);
+            break;
+        default:
+            break;
+    }
 }
 
 void GpuStats::insertTargetStats(const std::string& appPackageName,
@@ -131,16 +250,15 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
                                  const uint64_t /*value*/) {
     ATRACE_CALL();
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-
     std::lock_guard<std::mutex> lock(mLock);
-    if (!mAppStats.count(appStatsKey)) {
+    AppStats* appStats = findAppStatsLocked(appPackageName, driverVersionCode);
+    if (!appStats) {
         return;
     }
 
     switch (stats) {
         case GraphicsEnv::Stats::CPU_VULKAN_IN_USE:
-            mAppStats[appStatsKey].cpuVulkanInUse = true;
+            appStats->info.cpuVulkanInUse = true;
             break;
         default:
             break;
@@ -165,7 +283,6 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(mLock);
     bool dumpAll = true;
 
     std::unordered_set<std::string> argsSet;
@@ -174,56 +291,66 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
     }
 
     const bool dumpGlobal = argsSet.count("--global") != 0;
-    if (dumpGlobal) {
-        dumpGlobalLocked(result);
-        dumpAll = false;
-    }
-
     const bool dumpApp = argsSet.count("--app") != 0;
-    if (dumpApp) {
-        dumpAppLocked(result);
+    const bool clear = argsSet.count("--clear") != 0;
+    if (dumpGlobal || dumpApp || clear) {
         dumpAll = false;
     }
 
-    if (argsSet.count("--clear")) {
-        bool clearAll = true;
-
-        if (dumpGlobal) {
-            mGlobalStats.clear();
-            clearAll = false;
+    // Only take a snapshot of the stats under the lock, and format it afterwards so that
+    // concurrent inserts are not blocked behind string formatting.
+    std::vector<GpuStatsGlobalInfo> globalStats;
+    std::vector<AppStats> appStats;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (dumpAll || dumpGlobal) {
+            interceptSystemDriverStatsLocked();
+            globalStats.reserve(mGlobalStats.size());
+            for (const auto& ele : mGlobalStats) {
+                globalStats.emplace_back(ele.second);
+            }
         }
 
-        if (dumpApp) {
-            mAppStats.clear();
-            clearAll = false;
+        if (dumpAll || dumpApp) {
+            // Report the most recently used records first.
+            appStats.reserve(mAppStats.size());
+            for (const auto& key : mAppStatsLru) {
+                appStats.emplace_back(mAppStats[key]);
+            }
         }
 
-        if (clearAll) {
-            mGlobalStats.clear();
-            mAppStats.clear();
+        if (clear) {
+            const bool clearAll = !dumpGlobal && !dumpApp;
+            if (clearAll || dumpGlobal) {
+                mGlobalStats.clear();
+            }
+            if (clearAll || dumpApp) {
+                clearAppStatsLocked();
+            }
         }
-
-        dumpAll = false;
     }
 
-    if (dumpAll) {
-        dumpGlobalLocked(result);
-        dumpAppLocked(result);
-    }
+    dumpGlobalStats(globalStats, result);
+    dumpAppStats(appStats, result);
 }
 
-void GpuStats::dumpGlobalLocked(std::string* result) {
-    interceptSystemDriverStatsLocked();
-
-    for (const auto& ele : mGlobalStats) {
-        result->append(ele.second.toString());
+void GpuStats::dumpGlobalStats(const std::vector<GpuStatsGlobalInfo>& globalStats,
+                               std::string* result) {
+    for (const auto& ele : globalStats) {
+        result->append(ele.toString());
         result->append("\n");
     }
 }
 
-void GpuStats::dumpAppLocked(std::string* result) {
-    for (const auto& ele : mAppStats) {
-        result->append(ele.second.toString());
+void GpuStats::dumpAppStats(const std::vector<AppStats>& appStats, std::string* result) {
+    for (const auto& ele : appStats) {
+        result->append(ele.info.toString());
+        StringAppendF(result, "glDriverLoadingTimeDistribution: %s\n",
+                      ele.glLoadingTime.toString().c_str());
+        StringAppendF(result, "angleDriverLoadingTimeDistribution: %s\n",
+                      ele.angleLoadingTime.toString().c_str());
+        StringAppendF(result, "vkDriverLoadingTimeDistribution: %s\n",
+                      ele.vkLoadingTime.toString().c_str());
         result->append("\n");
     }
 }
@@ -252,10 +379,10 @@ void GpuStats::pullAppStats(std::vector<GpuStatsAppInfo>* outStats) {
     outStats->reserve(mAppStats.size());
 
     for (const auto& ele : mAppStats) {
-        outStats->emplace_back(ele.second);
+        outStats->emplace_back(ele.second.info);
     }
 
-    mAppStats.clear();
+    clearAppStatsLocked();
 }
 
 } // namespace android
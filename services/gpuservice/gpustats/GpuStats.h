@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <array>
+#include <list>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -27,6 +30,36 @@
 
 namespace android {
 
+// Fixed-size, log-linear histogram of driver loading times in nanoseconds. Each power of two
+// is split into SUB_BUCKETS linear sub-buckets, which bounds the relative error of a reported
+// percentile to 1 / SUB_BUCKETS regardless of the number of samples. Counts saturate at
+// UINT16_MAX; app stats are cleared on every pull, long before a bucket gets there.
+class LoadingTimeHistogram {
+public:
+    void insert(int64_t loadingTimeNs);
+    // Returns the upper bound of the bucket containing the given percentile in [0, 100].
+    int64_t percentile(double percentile) const;
+    size_t count() const { return mCount; }
+    std::string toString() const;
+
+    static constexpr size_t SUB_BUCKET_BITS = 2;
+    static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // Samples below 2^12ns (~4us) share the first bucket, and samples above 2^36ns (~69s) are
+    // clamped into the last one.
+    static constexpr size_t MIN_EXPONENT = 12;
+    static constexpr size_t MAX_EXPONENT = 36;
+    static constexpr size_t NUM_BUCKETS = 1 + (MAX_EXPONENT - MIN_EXPONENT) * SUB_BUCKETS;
+
+private:
+    static size_t bucketIndex(int64_t loadingTimeNs);
+    static int64_t bucketUpperBound(size_t index);
+
+    std::array<uint16_t, NUM_BUCKETS> mBuckets = {};
+    size_t mCount = 0;
+    int64_t mMin = 0;
+    int64_t mMax = 0;
+};
+
 class GpuStats {
 public:
     GpuStats() = default;
@@ -48,25 +81,73 @@ public:
     void pullAppStats(std::vector<GpuStatsAppInfo>* outStats);
 
     // This limits the worst case number of loading times tracked.
-    static const size_t MAX_NUM_LOADING_TIMES = 50;
+    static constexpr size_t MAX_NUM_LOADING_TIMES = 50;
+    // Below limits the number of app records, which is the preferred number for
+    // statsd while maintaining nice data quality. A record takes at most about
+    // 1.9KB: 1.2KB for MAX_NUM_LOADING_TIMES raw loading times of each of the
+    // three drivers, and 3 * ~220 bytes of histograms. All records together
+    // stay under 200KB, and under 70KB for apps that rarely load a driver.
+    // Once reached, the least recently updated app record is evicted.
+    static constexpr size_t MAX_NUM_APP_RECORDS = 100;
 
 private:
-    // Dump global stats
-    void dumpGlobalLocked(std::string* result);
-    // Dump app stats
-    void dumpAppLocked(std::string* result);
+    // App stats are keyed by an interned package name id and the driver version code, so that
+    // the hot insert path never has to build a temporary key string.
+    struct AppStatsKey {
+        uint32_t packageId;
+        uint64_t driverVersionCode;
+
+        bool operator==(const AppStatsKey& other) const {
+            return packageId == other.packageId && driverVersionCode == other.driverVersionCode;
+        }
+    };
+
+    struct AppStatsKeyHash {
+        size_t operator()(const AppStatsKey& key) const {
+            return std::hash<uint64_t>()(key.driverVersionCode) * 31 + key.packageId;
+        }
+    };
+
+    struct PackageName {
+        uint32_t id;
+        // Number of app records referencing this package name.
+        uint32_t refCount;
+    };
+
+    struct AppStats {
+        GpuStatsAppInfo info;
+        LoadingTimeHistogram glLoadingTime;
+        LoadingTimeHistogram vkLoadingTime;
+        LoadingTimeHistogram angleLoadingTime;
+        // Position of this record in mAppStatsLru.
+        std::list<AppStatsKey>::iterator lruPosition;
+    };
+
+    // Returns the app record for the key, or nullptr if not present. Marks it most recently used.
+    AppStats* findAppStatsLocked(const std::string& appPackageName, uint64_t driverVersionCode);
+    // Creates a new app record, evicting the least recently used one if needed.
+    AppStats* createAppStatsLocked(const std::string& appPackageName, uint64_t driverVersionCode);
+    void evictAppStatsLocked(const AppStatsKey& key);
+    void clearAppStatsLocked();
     // Append cpuVulkanVersion and glesVersion to system driver stats
     void interceptSystemDriverStatsLocked();
 
-    // Below limits the memory usage of GpuStats to be less than 10KB. This is
-    // the preferred number for statsd while maintaining nice data quality.
-    static const size_t MAX_NUM_APP_RECORDS = 100;
+    // Dump global stats
+    static void dumpGlobalStats(const std::vector<GpuStatsGlobalInfo>& globalStats,
+                                std::string* result);
+    // Dump app stats
+    static void dumpAppStats(const std::vector<AppStats>& appStats, std::string* result);
+
     // GpuStats access should be guarded by mLock.
     std::mutex mLock;
     // Key is driver version code.
     std::unordered_map<uint64_t, GpuStatsGlobalInfo> mGlobalStats;
-    // Key is <app package name>+<driver version code>.
-    std::unordered_map<std::string, GpuStatsAppInfo> mAppStats;
+    // Interned app package names, shared by all records of the same app.
+    std::unordered_map<std::string, PackageName> mPackageNames;
+    uint32_t mNextPackageId = 0;
+    std::unordered_map<AppStatsKey, AppStats, AppStatsKeyHash> mAppStats;
+    // Most recently used app record first.
+    std::list<AppStatsKey> mAppStatsLru;
 };
 
 } // namespace android
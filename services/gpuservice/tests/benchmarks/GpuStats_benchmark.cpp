@@ -0,0 +1,85 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gpustats/GpuStats.h"
+
+namespace android {
+namespace {
+
+// Simulates app launch reports from a population of apps, more than GpuStats keeps records for,
+// so the steady state exercises lookup, LRU promotion and eviction.
+void BM_GpuStatsInsert(benchmark::State& state) {
+    const size_t numApps = static_cast<size_t>(state.range(0));
+    std::vector<std::string> appPackageNames;
+    appPackageNames.reserve(numApps);
+    for (size_t i = 0; i < numApps; i++) {
+        appPackageNames.emplace_back("com.example.benchmark.app" + std::to_string(i));
+    }
+
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<size_t> appDistribution(0, numApps - 1);
+    std::uniform_int_distribution<int64_t> loadingTimeDistribution(1000000, 100000000);
+
+    GpuStats gpuStats;
+    for (auto _ : state) {
+        gpuStats.insert("com.example.driver", "1.0", 10, 20,
+                        appPackageNames[appDistribution(rng)], 0x401000,
+                        GraphicsEnv::Driver::GL, true, loadingTimeDistribution(rng));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GpuStatsInsert)->Arg(10)->Arg(GpuStats::MAX_NUM_APP_RECORDS)->Arg(1000);
+
+// Measures insert throughput while another thread keeps dumping, as dumpsys and statsd do.
+void BM_GpuStatsInsertWhileDumping(benchmark::State& state) {
+    static GpuStats* gpuStats = nullptr;
+    if (state.thread_index == 0) {
+        gpuStats = new GpuStats();
+    }
+
+    std::mt19937 rng(state.thread_index);
+    std::uniform_int_distribution<int64_t> loadingTimeDistribution(1000000, 100000000);
+    const std::string appPackageName =
+            "com.example.benchmark.app" + std::to_string(state.thread_index);
+
+    for (auto _ : state) {
+        if (state.thread_index == 0) {
+            std::string result;
+            gpuStats->dump(Vector<String16>(), &result);
+            benchmark::DoNotOptimize(result);
+        } else {
+            gpuStats->insert("com.example.driver", "1.0", 10, 20, appPackageName, 0x401000,
+                             GraphicsEnv::Driver::VULKAN, true, loadingTimeDistribution(rng));
+        }
+    }
+
+    if (state.thread_index == 0) {
+        delete gpuStats;
+        gpuStats = nullptr;
+    }
+}
+BENCHMARK(BM_GpuStatsInsertWhileDumping)->ThreadRange(2, 8);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
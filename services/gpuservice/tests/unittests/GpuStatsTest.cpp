@@ -0,0 +1,154 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "GpuStatsTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <unordered_set>
+
+#include "gpustats/GpuStats.h"
+
+namespace android {
+namespace {
+
+using testing::HasSubstr;
+
+constexpr char kDriverPackageName[] = "com.example.driver";
+constexpr char kDriverVersionName[] = "1.0";
+constexpr uint64_t kDriverVersionCode = 10;
+constexpr int64_t kDriverBuildTime = 20;
+constexpr int32_t kVulkanVersion = 0x401000;
+
+class GpuStatsTest : public testing::Test {
+protected:
+    void insert(const std::string& appPackageName, int64_t loadingTime,
+                GraphicsEnv::Driver driver = GraphicsEnv::Driver::GL) {
+        mGpuStats.insert(kDriverPackageName, kDriverVersionName, kDriverVersionCode,
+                         kDriverBuildTime, appPackageName, kVulkanVersion, driver, true,
+                         loadingTime);
+    }
+
+    std::string dump(const std::vector<std::string>& args) {
+        Vector<String16> dumpArgs;
+        for (const auto& arg : args) {
+            dumpArgs.add(String16(arg.c_str()));
+        }
+        std::string result;
+        mGpuStats.dump(dumpArgs, &result);
+        return result;
+    }
+
+    GpuStats mGpuStats;
+};
+
+TEST_F(GpuStatsTest, histogramPercentiles) {
+    LoadingTimeHistogram histogram;
+    EXPECT_EQ(0, histogram.percentile(50));
+
+    for (int64_t i = 1; i <= 1000; i++) {
+        histogram.insert(i * 1000);
+    }
+
+    EXPECT_EQ(1000u, histogram.count());
+    EXPECT_EQ(1000, histogram.percentile(0));
+    EXPECT_EQ(1000000, histogram.percentile(100));
+    // Each bucket spans at most a quarter of its power of two.
+    EXPECT_NEAR(500000, histogram.percentile(50), 500000 / LoadingTimeHistogram::SUB_BUCKETS);
+    EXPECT_NEAR(990000, histogram.percentile(99), 990000 / LoadingTimeHistogram::SUB_BUCKETS);
+}
+
+TEST_F(GpuStatsTest, histogramClampsOutOfRangeSamples) {
+    LoadingTimeHistogram histogram;
+    histogram.insert(10);
+    histogram.insert(int64_t(1) << 40);
+
+    EXPECT_EQ(2u, histogram.count());
+    EXPECT_GE(histogram.percentile(50), 10);
+    EXPECT_LT(histogram.percentile(50), 1 << LoadingTimeHistogram::MIN_EXPONENT);
+    EXPECT_EQ(int64_t(1) << 40, histogram.percentile(100));
+    EXPECT_LE(sizeof(LoadingTimeHistogram), 256u);
+}
+
+TEST_F(GpuStatsTest, insertAggregatesPerApp) {
+    insert("com.example.app", 100);
+    insert("com.example.app", 200);
+    insert("com.example.app", 300, GraphicsEnv::Driver::VULKAN);
+
+    std::vector<GpuStatsAppInfo> appStats;
+    mGpuStats.pullAppStats(&appStats);
+    ASSERT_EQ(1u, appStats.size());
+    EXPECT_EQ("com.example.app", appStats[0].appPackageName);
+    EXPECT_EQ(kDriverVersionCode, appStats[0].driverVersionCode);
+    EXPECT_THAT(appStats[0].glDriverLoadingTime, testing::ElementsAre(100, 200));
+    EXPECT_THAT(appStats[0].vkDriverLoadingTime, testing::ElementsAre(300));
+
+    std::vector<GpuStatsGlobalInfo> globalStats;
+    mGpuStats.pullGlobalStats(&globalStats);
+    ASSERT_EQ(1u, globalStats.size());
+    EXPECT_EQ(2, globalStats[0].glLoadingCount);
+    EXPECT_EQ(1, globalStats[0].vkLoadingCount);
+}
+
+TEST_F(GpuStatsTest, rawLoadingTimesAreCapped) {
+    for (size_t i = 0; i < GpuStats::MAX_NUM_LOADING_TIMES * 2; i++) {
+        insert("com.example.app", 100);
+    }
+
+    EXPECT_THAT(dump({"--app"}),
+                HasSubstr("glDriverLoadingTimeDistribution: count = " +
+                          std::to_string(GpuStats::MAX_NUM_LOADING_TIMES * 2)));
+
+    std::vector<GpuStatsAppInfo> appStats;
+    mGpuStats.pullAppStats(&appStats);
+    ASSERT_EQ(1u, appStats.size());
+    EXPECT_EQ(GpuStats::MAX_NUM_LOADING_TIMES, appStats[0].glDriverLoadingTime.size());
+}
+
+TEST_F(GpuStatsTest, evictsLeastRecentlyUsedApp) {
+    for (size_t i = 0; i < GpuStats::MAX_NUM_APP_RECORDS; i++) {
+        insert("com.example.app" + std::to_string(i), 100);
+    }
+    // Touch the oldest record so that the second oldest one gets evicted instead.
+    mGpuStats.insertTargetStats("com.example.app0", kDriverVersionCode,
+                                GraphicsEnv::Stats::CPU_VULKAN_IN_USE, 0);
+    insert("com.example.new", 100);
+
+    std::vector<GpuStatsAppInfo> appStats;
+    mGpuStats.pullAppStats(&appStats);
+    ASSERT_EQ(GpuStats::MAX_NUM_APP_RECORDS, appStats.size());
+
+    std::unordered_set<std::string> appPackageNames;
+    for (const auto& appInfo : appStats) {
+        appPackageNames.insert(appInfo.appPackageName);
+    }
+    EXPECT_EQ(1u, appPackageNames.count("com.example.app0"));
+    EXPECT_EQ(0u, appPackageNames.count("com.example.app1"));
+    EXPECT_EQ(1u, appPackageNames.count("com.example.new"));
+}
+
+TEST_F(GpuStatsTest, dumpClearResetsStats) {
+    insert("com.example.app", 100);
+    EXPECT_THAT(dump({}), HasSubstr("appPackageName = com.example.app"));
+
+    dump({"--clear"});
+    EXPECT_EQ("", dump({}));
+}
+
+} // namespace
+} // namespace android
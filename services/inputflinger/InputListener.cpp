@@ -221,40 +221,34 @@ QueuedInputListener::QueuedInputListener(const sp<InputListenerInterface>& inner
 }
 
 QueuedInputListener::~QueuedInputListener() {
-    size_t count = mArgsQueue.size();
-    for (size_t i = 0; i < count; i++) {
-        delete mArgsQueue[i];
-    }
 }
 
 void QueuedInputListener::notifyConfigurationChanged(
         const NotifyConfigurationChangedArgs* args) {
-    mArgsQueue.push_back(new NotifyConfigurationChangedArgs(*args));
+    mArgsQueue.emplace_back(std::in_place_type<NotifyConfigurationChangedArgs>, *args);
 }
 
 void QueuedInputListener::notifyKey(const NotifyKeyArgs* args) {
-    mArgsQueue.push_back(new NotifyKeyArgs(*args));
+    mArgsQueue.emplace_back(std::in_place_type<NotifyKeyArgs>, *args);
 }
 
 void QueuedInputListener::notifyMotion(const NotifyMotionArgs* args) {
-    mArgsQueue.push_back(new NotifyMotionArgs(*args));
+    mArgsQueue.emplace_back(std::in_place_type<NotifyMotionArgs>, *args);
 }
 
 void QueuedInputListener::notifySwitch(const NotifySwitchArgs* args) {
-    mArgsQueue.push_back(new NotifySwitchArgs(*args));
+    mArgsQueue.emplace_back(std::in_place_type<NotifySwitchArgs>, *args);
 }
 
 void QueuedInputListener::notifyDeviceReset(const NotifyDeviceResetArgs* args) {
-    mArgsQueue.push_back(new NotifyDeviceResetArgs(*args));
+    mArgsQueue.emplace_back(std::in_place_type<NotifyDeviceResetArgs>, *args);
 }
 
 void QueuedInputListener::flush() {
-    size_t count = mArgsQueue.size();
-    for (size_t i = 0; i < count; i++) {
-        NotifyArgs* args = mArgsQueue[i];
-        args->notify(mInnerListener);
-        delete args;
+    for (const QueuedArgs& args : mArgsQueue) {
+        std::visit([this](const auto& queuedArgs) { queuedArgs.notify(mInnerListener); }, args);
     }
+    // Keeps the capacity of the queue for the next batch of events.
     mArgsQueue.clear();
 }
 
@@ -1674,6 +1674,330 @@ void CookedPointerData::copyFrom(const CookedPointerData& other) {
 }
 
 
+// --- Pointer id assignment ---
+
+struct PointerDistanceHeapElement {
+    uint64_t distance; // squared distance
+    uint32_t currentPointerIndex;
+    uint32_t lastPointerIndex;
+};
+
+// Squared distances are clamped when looking for the optimal assignment so that the sum of
+// the costs of all the pairs cannot overflow.
+static constexpr int64_t MAX_POINTER_DISTANCE = (1LL << 48) - 1;
+
+// Cost of pairing pointers with different tool types, which are never matched. It is larger
+// than any sum of distances so that such a pair is only used when nothing else is left.
+static constexpr int64_t UNMATCHABLE_POINTER_COST = 1LL << 56;
+
+static void setPointerId(RawPointerData* current, uint32_t currentPointerIndex, uint32_t id) {
+    current->pointers[currentPointerIndex].id = id;
+    current->idToIndex[id] = currentPointerIndex;
+    current->markIdBit(id, current->isHovering(currentPointerIndex));
+}
+
+static void matchPointer(const RawPointerData& last, uint32_t lastPointerIndex,
+        RawPointerData* current, uint32_t currentPointerIndex,
+        BitSet32* outMatchedCurrentBits, BitSet32* outUsedIdBits) {
+    uint32_t id = last.pointers[lastPointerIndex].id;
+    setPointerId(current, currentPointerIndex, id);
+    outMatchedCurrentBits->markBit(currentPointerIndex);
+    outUsedIdBits->markBit(id);
+}
+
+static void matchPointersGreedily(const RawPointerData& last, RawPointerData* current,
+        BitSet32* outMatchedCurrentBits, BitSet32* outUsedIdBits) {
+    uint32_t currentPointerCount = current->pointerCount;
+    uint32_t lastPointerCount = last.pointerCount;
+
+    // We build a heap of squared euclidean distances between current and last pointers
+    // associated with the current and last pointer indices.  Then, we find the best
+    // match (by distance) for each current pointer.
+    // The pointers must have the same tool type but it is possible for them to
+    // transition from hovering to touching or vice-versa while retaining the same id.
+    PointerDistanceHeapElement heap[MAX_POINTERS * MAX_POINTERS];
+
+    uint32_t heapSize = 0;
+    for (uint32_t currentPointerIndex = 0; currentPointerIndex < currentPointerCount;
+            currentPointerIndex++) {
+        for (uint32_t lastPointerIndex = 0; lastPointerIndex < lastPointerCount;
+                lastPointerIndex++) {
+            const RawPointerData::Pointer& currentPointer =
+                    current->pointers[currentPointerIndex];
+            const RawPointerData::Pointer& lastPointer =
+                    last.pointers[lastPointerIndex];
+            if (currentPointer.toolType == lastPointer.toolType) {
+                int64_t deltaX = currentPointer.x - lastPointer.x;
+                int64_t deltaY = currentPointer.y - lastPointer.y;
+
+                uint64_t distance = uint64_t(deltaX * deltaX + deltaY * deltaY);
+
+                // Insert new element into the heap (sift up).
+                heap[heapSize].currentPointerIndex = currentPointerIndex;
+                heap[heapSize].lastPointerIndex = lastPointerIndex;
+                heap[heapSize].distance = distance;
+                heapSize += 1;
+            }
+        }
+    }
+
+    // Heapify
+    for (uint32_t startIndex = heapSize / 2; startIndex != 0; ) {
+        startIndex -= 1;
+        for (uint32_t parentIndex = startIndex; ;) {
+            uint32_t childIndex = parentIndex * 2 + 1;
+            if (childIndex >= heapSize) {
+                break;
+            }
+
+            if (childIndex + 1 < heapSize
+                    && heap[childIndex + 1].distance < heap[childIndex].distance) {
+                childIndex += 1;
+            }
+
+            if (heap[parentIndex].distance <= heap[childIndex].distance) {
+                break;
+            }
+
+            swap(heap[parentIndex], heap[childIndex]);
+            parentIndex = childIndex;
+        }
+    }
+
+#if DEBUG_POINTER_ASSIGNMENT
+    ALOGD("assignPointerIds - initial distance min-heap: size=%d", heapSize);
+    for (size_t i = 0; i < heapSize; i++) {
+        ALOGD("  heap[%zu]: cur=%" PRIu32 ", last=%" PRIu32 ", distance=%" PRIu64,
+                i, heap[i].currentPointerIndex, heap[i].lastPointerIndex,
+                heap[i].distance);
+    }
+#endif
+
+    // Pull matches out by increasing order of distance.
+    // To avoid reassigning pointers that have already been matched, the loop keeps track
+    // of which last and current pointers have been matched using the matchedXXXBits variables.
+    // It also tracks the used pointer id bits.
+    BitSet32 matchedLastBits(0);
+    bool first = true;
+    for (uint32_t i = min(currentPointerCount, lastPointerCount); heapSize > 0 && i > 0; i--) {
+        while (heapSize > 0) {
+            if (first) {
+                // The first time through the loop, we just consume the root element of
+                // the heap (the one with smallest distance).
+                first = false;
+            } else {
+                // Previous iterations consumed the root element of the heap.
+                // Pop root element off of the heap (sift down).
+                heap[0] = heap[heapSize];
+                for (uint32_t parentIndex = 0; ;) {
+                    uint32_t childIndex = parentIndex * 2 + 1;
+                    if (childIndex >= heapSize) {
+                        break;
+                    }
+
+                    if (childIndex + 1 < heapSize
+                            && heap[childIndex + 1].distance < heap[childIndex].distance) {
+                        childIndex += 1;
+                    }
+
+                    if (heap[parentIndex].distance <= heap[childIndex].distance) {
+                        break;
+                    }
+
+                    swap(heap[parentIndex], heap[childIndex]);
+                    parentIndex = childIndex;
+                }
+
+#if DEBUG_POINTER_ASSIGNMENT
+                ALOGD("assignPointerIds - reduced distance min-heap: size=%d", heapSize);
+                for (size_t i = 0; i < heapSize; i++) {
+                    ALOGD("  heap[%zu]: cur=%" PRIu32 ", last=%" PRIu32 ", distance=%" PRIu64,
+                            i, heap[i].currentPointerIndex, heap[i].lastPointerIndex,
+                            heap[i].distance);
+                }
+#endif
+            }
+
+            heapSize -= 1;
+
+            uint32_t currentPointerIndex = heap[0].currentPointerIndex;
+            if (outMatchedCurrentBits->hasBit(currentPointerIndex)) continue; // already matched
+
+            uint32_t lastPointerIndex = heap[0].lastPointerIndex;
+            if (matchedLastBits.hasBit(lastPointerIndex)) continue; // already matched
+
+            matchedLastBits.markBit(lastPointerIndex);
+            matchPointer(last, lastPointerIndex, current, currentPointerIndex,
+                    outMatchedCurrentBits, outUsedIdBits);
+
+#if DEBUG_POINTER_ASSIGNMENT
+            ALOGD("assignPointerIds - matched: cur=%" PRIu32 ", last=%" PRIu32
+                    ", id=%" PRIu32 ", distance=%" PRIu64,
+                    lastPointerIndex, currentPointerIndex,
+                    last.pointers[lastPointerIndex].id, heap[0].distance);
+#endif
+            break;
+        }
+    }
+
+}
+
+/*
+ * Finds the assignment of current pointers to last pointers with the minimal sum of squared
+ * distances using the Hungarian algorithm, in O(n^3) for n = max(current, last) pointers.
+ * The cost matrix is padded to a square with zero cost dummy pointers; pointers paired with a
+ * dummy, or with a pointer of another tool type, are left unmatched.
+ */
+static void matchPointersOptimally(const RawPointerData& last, RawPointerData* current,
+        BitSet32* outMatchedCurrentBits, BitSet32* outUsedIdBits) {
+    const uint32_t currentPointerCount = current->pointerCount;
+    const uint32_t lastPointerCount = last.pointerCount;
+    const uint32_t n = currentPointerCount > lastPointerCount
+            ? currentPointerCount : lastPointerCount;
+
+    // Rows are current pointers and columns are last pointers.
+    int64_t cost[MAX_POINTERS][MAX_POINTERS];
+    for (uint32_t i = 0; i < n; i++) {
+        for (uint32_t j = 0; j < n; j++) {
+            if (i >= currentPointerCount || j >= lastPointerCount) {
+                cost[i][j] = 0;
+                continue;
+            }
+            const RawPointerData::Pointer& currentPointer = current->pointers[i];
+            const RawPointerData::Pointer& lastPointer = last.pointers[j];
+            if (currentPointer.toolType != lastPointer.toolType) {
+                cost[i][j] = UNMATCHABLE_POINTER_COST;
+                continue;
+            }
+            int64_t deltaX = currentPointer.x - lastPointer.x;
+            int64_t deltaY = currentPointer.y - lastPointer.y;
+            cost[i][j] = min(deltaX * deltaX + deltaY * deltaY, MAX_POINTER_DISTANCE);
+        }
+    }
+
+    // Potentials of the rows (u) and columns (v), 1-based with column 0 as the source.
+    // rowForColumn[j] is the row assigned to column j, or 0 if none.
+    const int64_t infinity = INT64_MAX;
+    int64_t u[MAX_POINTERS + 1] = {};
+    int64_t v[MAX_POINTERS + 1] = {};
+    uint32_t rowForColumn[MAX_POINTERS + 1] = {};
+    uint32_t previousColumn[MAX_POINTERS + 1] = {};
+    for (uint32_t row = 1; row <= n; row++) {
+        // Find the shortest augmenting path from the new row to a free column.
+        int64_t minSlack[MAX_POINTERS + 1];
+        bool visited[MAX_POINTERS + 1];
+        for (uint32_t j = 0; j <= n; j++) {
+            minSlack[j] = infinity;
+            visited[j] = false;
+        }
+        rowForColumn[0] = row;
+        uint32_t column = 0;
+        do {
+            visited[column] = true;
+            const uint32_t i = rowForColumn[column];
+            int64_t delta = infinity;
+            uint32_t nextColumn = 0;
+            for (uint32_t j = 1; j <= n; j++) {
+                if (visited[j]) {
+                    continue;
+                }
+                int64_t slack = cost[i - 1][j - 1] - u[i] - v[j];
+                if (slack < minSlack[j]) {
+                    minSlack[j] = slack;
+                    previousColumn[j] = column;
+                }
+                if (minSlack[j] < delta) {
+                    delta = minSlack[j];
+                    nextColumn = j;
+                }
+            }
+            for (uint32_t j = 0; j <= n; j++) {
+                if (visited[j]) {
+                    u[rowForColumn[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minSlack[j] -= delta;
+                }
+            }
+            column = nextColumn;
+        } while (rowForColumn[column] != 0);
+
+        // Flip the assignments along the path.
+        do {
+            uint32_t previous = previousColumn[column];
+            rowForColumn[column] = rowForColumn[previous];
+            column = previous;
+        } while (column != 0);
+    }
+
+    for (uint32_t j = 1; j <= lastPointerCount; j++) {
+        uint32_t i = rowForColumn[j];
+        if (i == 0 || i > currentPointerCount
+                || cost[i - 1][j - 1] == UNMATCHABLE_POINTER_COST) {
+            continue;
+        }
+        matchPointer(last, j - 1, current, i - 1, outMatchedCurrentBits, outUsedIdBits);
+
+#if DEBUG_POINTER_ASSIGNMENT
+        ALOGD("assignPointerIds - matched: cur=%" PRIu32 ", last=%" PRIu32
+                ", id=%" PRIu32 ", distance=%" PRId64,
+                i - 1, j - 1, last.pointers[j - 1].id, cost[i - 1][j - 1]);
+#endif
+    }
+}
+
+void assignPointerIds(PointerIdAssignment assignment, const RawPointerData& last,
+        RawPointerData* current) {
+    uint32_t currentPointerCount = current->pointerCount;
+    uint32_t lastPointerCount = last.pointerCount;
+
+    current->clearIdBits();
+
+    if (currentPointerCount == 0) {
+        // No pointers to assign.
+        return;
+    }
+
+    if (lastPointerCount == 0) {
+        // All pointers are new.
+        for (uint32_t i = 0; i < currentPointerCount; i++) {
+            setPointerId(current, i, i);
+        }
+        return;
+    }
+
+    if (currentPointerCount == 1 && lastPointerCount == 1
+            && current->pointers[0].toolType == last.pointers[0].toolType) {
+        // Only one pointer and no change in count so it must have the same id as before.
+        setPointerId(current, 0, last.pointers[0].id);
+        return;
+    }
+
+    // General case.
+    BitSet32 matchedCurrentBits(0);
+    BitSet32 usedIdBits(0);
+    switch (assignment) {
+    case POINTER_ID_ASSIGNMENT_OPTIMAL:
+        matchPointersOptimally(last, current, &matchedCurrentBits, &usedIdBits);
+        break;
+    default:
+        matchPointersGreedily(last, current, &matchedCurrentBits, &usedIdBits);
+        break;
+    }
+
+    // Assign fresh ids to pointers that were not matched in the process.
+    for (uint32_t i = currentPointerCount - matchedCurrentBits.count(); i != 0; i--) {
+        uint32_t currentPointerIndex = matchedCurrentBits.markFirstUnmarkedBit();
+        uint32_t id = usedIdBits.markFirstUnmarkedBit();
+        setPointerId(current, currentPointerIndex, id);
+
+#if DEBUG_POINTER_ASSIGNMENT
+        ALOGD("assignPointerIds - assigned: cur=%" PRIu32 ", id=%" PRIu32, currentPointerIndex, id);
+#endif
+    }
+}
+
+
 // --- SingleTouchMotionAccumulator ---
 
 SingleTouchMotionAccumulator::SingleTouchMotionAccumulator() {
@@ -3380,6 +3704,21 @@ void TouchInputMapper::configureParameters() {
     mParameters.wake = getDevice()->isExternal();
     getDevice()->getConfiguration().tryGetProperty(String8("touch.wake"),
             mParameters.wake);
+
+    // Ids are only assigned by the input reader for devices that do not report tracking ids.
+    mParameters.pointerIdAssignment = POINTER_ID_ASSIGNMENT_GREEDY;
+    String8 pointerIdAssignmentString;
+    if (getDevice()->getConfiguration().tryGetProperty(String8("touch.pointerIdAssignment"),
+            pointerIdAssignmentString)) {
+        if (pointerIdAssignmentString == "greedy") {
+            mParameters.pointerIdAssignment = POINTER_ID_ASSIGNMENT_GREEDY;
+        } else if (pointerIdAssignmentString == "optimal") {
+            mParameters.pointerIdAssignment = POINTER_ID_ASSIGNMENT_OPTIMAL;
+        } else if (pointerIdAssignmentString != "default") {
+            ALOGW("Invalid value for touch.pointerIdAssignment: '%s'",
+                    pointerIdAssignmentString.string());
+        }
+    }
 }
 
 void TouchInputMapper::dumpParameters(std::string& dump) {
@@ -3420,6 +3759,17 @@ void TouchInputMapper::dumpParameters(std::string& dump) {
             mParameters.uniqueDisplayId.c_str());
     dump += StringPrintf(INDENT4 "OrientationAware: %s\n",
             toString(mParameters.orientationAware));
+
+    switch (mParameters.pointerIdAssignment) {
+    case POINTER_ID_ASSIGNMENT_GREEDY:
+        dump += INDENT4 "PointerIdAssignment: greedy\n";
+        break;
+    case POINTER_ID_ASSIGNMENT_OPTIMAL:
+        dump += INDENT4 "PointerIdAssignment: optimal\n";
+        break;
+    default:
+        ALOG_ASSERT(false);
+    }
 }
 
 void TouchInputMapper::configureRawPointerAxes() {
@@ -3669,6 +4019,7 @@ void TouchInputMapper::configureSurface(nsecs_t when, bool* outResetNeeded) {
         mYTranslate = -mSurfaceTop;
         mXPrecision = 1.0f / mXScale;
         mYPrecision = 1.0f / mYScale;
+        configureSurfaceAxisTransforms();
 
         mOrientedRanges.x.axis = AMOTION_EVENT_AXIS_X;
         mOrientedRanges.x.source = mSource;
@@ -4356,7 +4707,8 @@ void TouchInputMapper::sync(nsecs_t when) {
 
     // Assign pointer ids.
     if (!mHavePointerIds) {
-        assignPointerIds(last, next);
+        assignPointerIds(mParameters.pointerIdAssignment, last->rawPointerData,
+                &next->rawPointerData);
     }
 
 #if DEBUG_RAW_EVENTS
@@ -4957,6 +5309,66 @@ const BitSet32& TouchInputMapper::findActiveIdBits(const CookedPointerData& cook
     return cookedPointerData.hoveringIdBits;
 }
 
+void TouchInputMapper::configureSurfaceAxisTransforms() {
+    const int32_t minX = mRawPointerAxes.x.minValue;
+    const int32_t maxX = mRawPointerAxes.x.maxValue;
+    const int32_t minY = mRawPointerAxes.y.minValue;
+    const int32_t maxY = mRawPointerAxes.y.maxValue;
+
+    switch (mSurfaceOrientation) {
+    case DISPLAY_ORIENTATION_90:
+        mSurfaceXTransform = { true, false, minY, mYScale, mYTranslate };
+        mSurfaceYTransform = { false, true, maxX, mXScale, mXTranslate };
+        break;
+    case DISPLAY_ORIENTATION_180:
+        mSurfaceXTransform = { false, true, maxX, mXScale, 0 };
+        mSurfaceYTransform = { true, true, maxY, mYScale, mYTranslate };
+        break;
+    case DISPLAY_ORIENTATION_270:
+        mSurfaceXTransform = { true, true, maxY, mYScale, 0 };
+        mSurfaceYTransform = { false, false, minX, mXScale, mXTranslate };
+        break;
+    default:
+        mSurfaceXTransform = { false, false, minX, mXScale, mXTranslate };
+        mSurfaceYTransform = { true, false, minY, mYScale, mYTranslate };
+        break;
+    }
+}
+
+/*
+ * Maps raw coordinates onto a surface axis. The raw coordinates are either the affine
+ * transformed positions (float) or the coverage box edges (int32_t); the subtraction is done
+ * in that type, as it always has been, so that the cooked values do not change.
+ */
+template <typename T>
+void TouchInputMapper::transformToSurfaceAxis(const SurfaceAxisTransform& transform,
+        const T* raw, float* outSurface, uint32_t count) {
+    const int32_t origin = transform.origin;
+    const float scale = transform.scale;
+    const float translate = transform.translate;
+    if (transform.flip) {
+        for (uint32_t i = 0; i < count; i++) {
+            outSurface[i] = float(origin - raw[i]) * scale + translate;
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            outSurface[i] = float(raw[i] - origin) * scale + translate;
+        }
+    }
+}
+
+/*
+ * Appends a value to pointer coords that were just cleared. Equivalent to
+ * PointerCoords::setAxisValue() as long as the axes are appended in increasing order,
+ * but without looking up and shifting the values that are already there.
+ */
+static inline void appendAxisValue(PointerCoords& coords, int32_t axis, float value) {
+    if (value != 0) { // axes with value 0 are not stored
+        coords.values[BitSet64::count(coords.bits)] = value;
+        BitSet64::markBit(coords.bits, axis);
+    }
+}
+
 void TouchInputMapper::cookPointerData() {
     uint32_t currentPointerCount = mCurrentRawState.rawPointerData.pointerCount;
 
@@ -4971,250 +5383,305 @@ void TouchInputMapper::cookPointerData() {
 
     if (mCurrentCookedState.cookedPointerData.pointerCount == 0) {
         mCurrentCookedState.buttonState = 0;
-    } else {
-        mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
+        return;
     }
+    mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
 
     // Walk through the the active pointers and map device coordinates onto
     // surface coordinates and adjust for display orientation.
-    for (uint32_t i = 0; i < currentPointerCount; i++) {
-        const RawPointerData::Pointer& in = mCurrentRawState.rawPointerData.pointers[i];
-
-        // Size
-        float touchMajor, touchMinor, toolMajor, toolMinor, size;
-        switch (mCalibration.sizeCalibration) {
-        case Calibration::SIZE_CALIBRATION_GEOMETRIC:
-        case Calibration::SIZE_CALIBRATION_DIAMETER:
-        case Calibration::SIZE_CALIBRATION_BOX:
-        case Calibration::SIZE_CALIBRATION_AREA:
-            if (mRawPointerAxes.touchMajor.valid && mRawPointerAxes.toolMajor.valid) {
-                touchMajor = in.touchMajor;
-                touchMinor = mRawPointerAxes.touchMinor.valid ? in.touchMinor : in.touchMajor;
-                toolMajor = in.toolMajor;
-                toolMinor = mRawPointerAxes.toolMinor.valid ? in.toolMinor : in.toolMajor;
-                size = mRawPointerAxes.touchMinor.valid
-                        ? avg(in.touchMajor, in.touchMinor) : in.touchMajor;
-            } else if (mRawPointerAxes.touchMajor.valid) {
-                toolMajor = touchMajor = in.touchMajor;
-                toolMinor = touchMinor = mRawPointerAxes.touchMinor.valid
-                        ? in.touchMinor : in.touchMajor;
-                size = mRawPointerAxes.touchMinor.valid
-                        ? avg(in.touchMajor, in.touchMinor) : in.touchMajor;
-            } else if (mRawPointerAxes.toolMajor.valid) {
-                touchMajor = toolMajor = in.toolMajor;
-                touchMinor = toolMinor = mRawPointerAxes.toolMinor.valid
-                        ? in.toolMinor : in.toolMajor;
-                size = mRawPointerAxes.toolMinor.valid
-                        ? avg(in.toolMajor, in.toolMinor) : in.toolMajor;
-            } else {
-                ALOG_ASSERT(false, "No touch or tool axes.  "
-                        "Size calibration should have been resolved to NONE.");
-                touchMajor = 0;
-                touchMinor = 0;
-                toolMajor = 0;
-                toolMinor = 0;
-                size = 0;
+    // Each step below handles one group of axes for all pointers at once so that the
+    // calibration, which is the same for every pointer, is resolved once per sample and the
+    // inner loops are plain arithmetic over arrays that the compiler can vectorize.
+    const RawPointerData::Pointer* in = mCurrentRawState.rawPointerData.pointers;
+    const uint32_t count = currentPointerCount;
+
+    // Size
+    float touchMajor[MAX_POINTERS], touchMinor[MAX_POINTERS];
+    float toolMajor[MAX_POINTERS], toolMinor[MAX_POINTERS];
+    float size[MAX_POINTERS];
+    switch (mCalibration.sizeCalibration) {
+    case Calibration::SIZE_CALIBRATION_GEOMETRIC:
+    case Calibration::SIZE_CALIBRATION_DIAMETER:
+    case Calibration::SIZE_CALIBRATION_BOX:
+    case Calibration::SIZE_CALIBRATION_AREA: {
+        const bool haveTouchMinor = mRawPointerAxes.touchMinor.valid;
+        const bool haveToolMinor = mRawPointerAxes.toolMinor.valid;
+        if (mRawPointerAxes.touchMajor.valid && mRawPointerAxes.toolMajor.valid) {
+            for (uint32_t i = 0; i < count; i++) {
+                touchMajor[i] = in[i].touchMajor;
+                touchMinor[i] = haveTouchMinor ? in[i].touchMinor : in[i].touchMajor;
+                toolMajor[i] = in[i].toolMajor;
+                toolMinor[i] = haveToolMinor ? in[i].toolMinor : in[i].toolMajor;
+                size[i] = haveTouchMinor
+                        ? avg(in[i].touchMajor, in[i].touchMinor) : in[i].touchMajor;
+            }
+        } else if (mRawPointerAxes.touchMajor.valid) {
+            for (uint32_t i = 0; i < count; i++) {
+                toolMajor[i] = touchMajor[i] = in[i].touchMajor;
+                toolMinor[i] = touchMinor[i] = haveTouchMinor
+                        ? in[i].touchMinor : in[i].touchMajor;
+                size[i] = haveTouchMinor
+                        ? avg(in[i].touchMajor, in[i].touchMinor) : in[i].touchMajor;
+            }
+        } else if (mRawPointerAxes.toolMajor.valid) {
+            for (uint32_t i = 0; i < count; i++) {
+                touchMajor[i] = toolMajor[i] = in[i].toolMajor;
+                touchMinor[i] = toolMinor[i] = haveToolMinor
+                        ? in[i].toolMinor : in[i].toolMajor;
+                size[i] = haveToolMinor
+                        ? avg(in[i].toolMajor, in[i].toolMinor) : in[i].toolMajor;
+            }
+        } else {
+            ALOG_ASSERT(false, "No touch or tool axes.  "
+                    "Size calibration should have been resolved to NONE.");
+            for (uint32_t i = 0; i < count; i++) {
+                touchMajor[i] = 0;
+                touchMinor[i] = 0;
+                toolMajor[i] = 0;
+                toolMinor[i] = 0;
+                size[i] = 0;
             }
+        }
 
-            if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
-                uint32_t touchingCount =
-                        mCurrentRawState.rawPointerData.touchingIdBits.count();
-                if (touchingCount > 1) {
-                    touchMajor /= touchingCount;
-                    touchMinor /= touchingCount;
-                    toolMajor /= touchingCount;
-                    toolMinor /= touchingCount;
-                    size /= touchingCount;
+        if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
+            uint32_t touchingCount =
+                    mCurrentRawState.rawPointerData.touchingIdBits.count();
+            if (touchingCount > 1) {
+                for (uint32_t i = 0; i < count; i++) {
+                    touchMajor[i] /= touchingCount;
+                    touchMinor[i] /= touchingCount;
+                    toolMajor[i] /= touchingCount;
+                    toolMinor[i] /= touchingCount;
+                    size[i] /= touchingCount;
                 }
             }
+        }
 
-            if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_GEOMETRIC) {
-                touchMajor *= mGeometricScale;
-                touchMinor *= mGeometricScale;
-                toolMajor *= mGeometricScale;
-                toolMinor *= mGeometricScale;
-            } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_AREA) {
-                touchMajor = touchMajor > 0 ? sqrtf(touchMajor) : 0;
-                touchMinor = touchMajor;
-                toolMajor = toolMajor > 0 ? sqrtf(toolMajor) : 0;
-                toolMinor = toolMajor;
-            } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_DIAMETER) {
-                touchMinor = touchMajor;
-                toolMinor = toolMajor;
+        if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_GEOMETRIC) {
+            for (uint32_t i = 0; i < count; i++) {
+                touchMajor[i] *= mGeometricScale;
+                touchMinor[i] *= mGeometricScale;
+                toolMajor[i] *= mGeometricScale;
+                toolMinor[i] *= mGeometricScale;
+            }
+        } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_AREA) {
+            for (uint32_t i = 0; i < count; i++) {
+                touchMajor[i] = touchMajor[i] > 0 ? sqrtf(touchMajor[i]) : 0;
+                touchMinor[i] = touchMajor[i];
+                toolMajor[i] = toolMajor[i] > 0 ? sqrtf(toolMajor[i]) : 0;
+                toolMinor[i] = toolMajor[i];
             }
+        } else if (mCalibration.sizeCalibration == Calibration::SIZE_CALIBRATION_DIAMETER) {
+            for (uint32_t i = 0; i < count; i++) {
+                touchMinor[i] = touchMajor[i];
+                toolMinor[i] = toolMajor[i];
+            }
+        }
 
-            mCalibration.applySizeScaleAndBias(&touchMajor);
-            mCalibration.applySizeScaleAndBias(&touchMinor);
-            mCalibration.applySizeScaleAndBias(&toolMajor);
-            mCalibration.applySizeScaleAndBias(&toolMinor);
-            size *= mSizeScale;
-            break;
-        default:
-            touchMajor = 0;
-            touchMinor = 0;
-            toolMajor = 0;
-            toolMinor = 0;
-            size = 0;
-            break;
+        for (uint32_t i = 0; i < count; i++) {
+            mCalibration.applySizeScaleAndBias(&touchMajor[i]);
+            mCalibration.applySizeScaleAndBias(&touchMinor[i]);
+            mCalibration.applySizeScaleAndBias(&toolMajor[i]);
+            mCalibration.applySizeScaleAndBias(&toolMinor[i]);
+            size[i] *= mSizeScale;
+        }
+        break;
+    }
+    default:
+        for (uint32_t i = 0; i < count; i++) {
+            touchMajor[i] = 0;
+            touchMinor[i] = 0;
+            toolMajor[i] = 0;
+            toolMinor[i] = 0;
+            size[i] = 0;
         }
+        break;
+    }
 
-        // Pressure
-        float pressure;
-        switch (mCalibration.pressureCalibration) {
-        case Calibration::PRESSURE_CALIBRATION_PHYSICAL:
-        case Calibration::PRESSURE_CALIBRATION_AMPLITUDE:
-            pressure = in.pressure * mPressureScale;
-            break;
-        default:
-            pressure = in.isHovering ? 0 : 1;
-            break;
+    // Pressure
+    float pressure[MAX_POINTERS];
+    switch (mCalibration.pressureCalibration) {
+    case Calibration::PRESSURE_CALIBRATION_PHYSICAL:
+    case Calibration::PRESSURE_CALIBRATION_AMPLITUDE:
+        for (uint32_t i = 0; i < count; i++) {
+            pressure[i] = in[i].pressure * mPressureScale;
         }
+        break;
+    default:
+        for (uint32_t i = 0; i < count; i++) {
+            pressure[i] = in[i].isHovering ? 0 : 1;
+        }
+        break;
+    }
 
-        // Tilt and Orientation
-        float tilt;
-        float orientation;
-        if (mHaveTilt) {
-            float tiltXAngle = (in.tiltX - mTiltXCenter) * mTiltXScale;
-            float tiltYAngle = (in.tiltY - mTiltYCenter) * mTiltYScale;
-            orientation = atan2f(-sinf(tiltXAngle), sinf(tiltYAngle));
-            tilt = acosf(cosf(tiltXAngle) * cosf(tiltYAngle));
-        } else {
-            tilt = 0;
+    // Tilt and Orientation
+    float tilt[MAX_POINTERS];
+    float orientation[MAX_POINTERS];
+    if (mHaveTilt) {
+        for (uint32_t i = 0; i < count; i++) {
+            float tiltXAngle = (in[i].tiltX - mTiltXCenter) * mTiltXScale;
+            float tiltYAngle = (in[i].tiltY - mTiltYCenter) * mTiltYScale;
+            orientation[i] = atan2f(-sinf(tiltXAngle), sinf(tiltYAngle));
+            tilt[i] = acosf(cosf(tiltXAngle) * cosf(tiltYAngle));
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            tilt[i] = 0;
+        }
 
-            switch (mCalibration.orientationCalibration) {
-            case Calibration::ORIENTATION_CALIBRATION_INTERPOLATED:
-                orientation = in.orientation * mOrientationScale;
-                break;
-            case Calibration::ORIENTATION_CALIBRATION_VECTOR: {
-                int32_t c1 = signExtendNybble((in.orientation & 0xf0) >> 4);
-                int32_t c2 = signExtendNybble(in.orientation & 0x0f);
+        switch (mCalibration.orientationCalibration) {
+        case Calibration::ORIENTATION_CALIBRATION_INTERPOLATED:
+            for (uint32_t i = 0; i < count; i++) {
+                orientation[i] = in[i].orientation * mOrientationScale;
+            }
+            break;
+        case Calibration::ORIENTATION_CALIBRATION_VECTOR:
+            for (uint32_t i = 0; i < count; i++) {
+                int32_t c1 = signExtendNybble((in[i].orientation & 0xf0) >> 4);
+                int32_t c2 = signExtendNybble(in[i].orientation & 0x0f);
                 if (c1 != 0 || c2 != 0) {
-                    orientation = atan2f(c1, c2) * 0.5f;
+                    orientation[i] = atan2f(c1, c2) * 0.5f;
                     float confidence = hypotf(c1, c2);
                     float scale = 1.0f + confidence / 16.0f;
-                    touchMajor *= scale;
-                    touchMinor /= scale;
-                    toolMajor *= scale;
-                    toolMinor /= scale;
+                    touchMajor[i] *= scale;
+                    touchMinor[i] /= scale;
+                    toolMajor[i] *= scale;
+                    toolMinor[i] /= scale;
                 } else {
-                    orientation = 0;
+                    orientation[i] = 0;
                 }
-                break;
-            }
-            default:
-                orientation = 0;
             }
-        }
-
-        // Distance
-        float distance;
-        switch (mCalibration.distanceCalibration) {
-        case Calibration::DISTANCE_CALIBRATION_SCALED:
-            distance = in.distance * mDistanceScale;
             break;
         default:
-            distance = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                orientation[i] = 0;
+            }
         }
+    }
 
-        // Coverage
-        int32_t rawLeft, rawTop, rawRight, rawBottom;
-        switch (mCalibration.coverageCalibration) {
-        case Calibration::COVERAGE_CALIBRATION_BOX:
-            rawLeft = (in.toolMinor & 0xffff0000) >> 16;
-            rawRight = in.toolMinor & 0x0000ffff;
-            rawBottom = in.toolMajor & 0x0000ffff;
-            rawTop = (in.toolMajor & 0xffff0000) >> 16;
-            break;
-        default:
-            rawLeft = rawTop = rawRight = rawBottom = 0;
-            break;
+    // Distance
+    float distance[MAX_POINTERS];
+    switch (mCalibration.distanceCalibration) {
+    case Calibration::DISTANCE_CALIBRATION_SCALED:
+        for (uint32_t i = 0; i < count; i++) {
+            distance[i] = in[i].distance * mDistanceScale;
         }
-
-        // Adjust X,Y coords for device calibration
-        // TODO: Adjust coverage coords?
-        float xTransformed = in.x, yTransformed = in.y;
-        mAffineTransform.applyTo(xTransformed, yTransformed);
-
-        // Adjust X, Y, and coverage coords for surface orientation.
-        float x, y;
-        float left, top, right, bottom;
-
-        switch (mSurfaceOrientation) {
-        case DISPLAY_ORIENTATION_90:
-            x = float(yTransformed - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            y = float(mRawPointerAxes.x.maxValue - xTransformed) * mXScale + mXTranslate;
-            left = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            right = float(rawBottom- mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            bottom = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale + mXTranslate;
-            top = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale + mXTranslate;
-            orientation -= M_PI_2;
-            if (mOrientedRanges.haveOrientation && orientation < mOrientedRanges.orientation.min) {
-                orientation += (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
+        break;
+    default:
+        for (uint32_t i = 0; i < count; i++) {
+            distance[i] = 0;
+        }
+    }
+
+    // Adjust X,Y coords for device calibration
+    // TODO: Adjust coverage coords?
+    float xTransformed[MAX_POINTERS], yTransformed[MAX_POINTERS];
+    for (uint32_t i = 0; i < count; i++) {
+        xTransformed[i] = in[i].x;
+        yTransformed[i] = in[i].y;
+        mAffineTransform.applyTo(xTransformed[i], yTransformed[i]);
+    }
+
+    // Adjust X, Y, and coverage coords for surface orientation.
+    float x[MAX_POINTERS], y[MAX_POINTERS];
+    transformToSurfaceAxis(mSurfaceXTransform,
+            mSurfaceXTransform.fromRawY ? yTransformed : xTransformed, x, count);
+    transformToSurfaceAxis(mSurfaceYTransform,
+            mSurfaceYTransform.fromRawY ? yTransformed : xTransformed, y, count);
+
+    const bool haveCoverage =
+            mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX;
+    float left[MAX_POINTERS], top[MAX_POINTERS], right[MAX_POINTERS], bottom[MAX_POINTERS];
+    if (haveCoverage) {
+        int32_t rawLeft[MAX_POINTERS], rawTop[MAX_POINTERS];
+        int32_t rawRight[MAX_POINTERS], rawBottom[MAX_POINTERS];
+        for (uint32_t i = 0; i < count; i++) {
+            rawLeft[i] = (in[i].toolMinor & 0xffff0000) >> 16;
+            rawRight[i] = in[i].toolMinor & 0x0000ffff;
+            rawBottom[i] = in[i].toolMajor & 0x0000ffff;
+            rawTop[i] = (in[i].toolMajor & 0xffff0000) >> 16;
+        }
+
+        // When an axis is flipped, the low edge of the box on the surface comes from the
+        // high edge of the box on the device.
+        const int32_t* rawXLow = mSurfaceXTransform.fromRawY ? rawTop : rawLeft;
+        const int32_t* rawXHigh = mSurfaceXTransform.fromRawY ? rawBottom : rawRight;
+        const int32_t* rawYLow = mSurfaceYTransform.fromRawY ? rawTop : rawLeft;
+        const int32_t* rawYHigh = mSurfaceYTransform.fromRawY ? rawBottom : rawRight;
+        if (mSurfaceXTransform.flip) {
+            swap(rawXLow, rawXHigh);
+        }
+        if (mSurfaceYTransform.flip) {
+            swap(rawYLow, rawYHigh);
+        }
+        transformToSurfaceAxis(mSurfaceXTransform, rawXLow, left, count);
+        transformToSurfaceAxis(mSurfaceXTransform, rawXHigh, right, count);
+        transformToSurfaceAxis(mSurfaceYTransform, rawYLow, top, count);
+        transformToSurfaceAxis(mSurfaceYTransform, rawYHigh, bottom, count);
+    }
+
+    const float orientationMin = mOrientedRanges.orientation.min;
+    const float orientationMax = mOrientedRanges.orientation.max;
+    switch (mSurfaceOrientation) {
+    case DISPLAY_ORIENTATION_90:
+        for (uint32_t i = 0; i < count; i++) {
+            orientation[i] -= M_PI_2;
+            if (mOrientedRanges.haveOrientation && orientation[i] < orientationMin) {
+                orientation[i] += (orientationMax - orientationMin);
             }
-            break;
-        case DISPLAY_ORIENTATION_180:
-            x = float(mRawPointerAxes.x.maxValue - xTransformed) * mXScale;
-            y = float(mRawPointerAxes.y.maxValue - yTransformed) * mYScale + mYTranslate;
-            left = float(mRawPointerAxes.x.maxValue - rawRight) * mXScale;
-            right = float(mRawPointerAxes.x.maxValue - rawLeft) * mXScale;
-            bottom = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale + mYTranslate;
-            top = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale + mYTranslate;
-            orientation -= M_PI;
-            if (mOrientedRanges.haveOrientation && orientation < mOrientedRanges.orientation.min) {
-                orientation += (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
+        }
+        break;
+    case DISPLAY_ORIENTATION_180:
+        for (uint32_t i = 0; i < count; i++) {
+            orientation[i] -= M_PI;
+            if (mOrientedRanges.haveOrientation && orientation[i] < orientationMin) {
+                orientation[i] += (orientationMax - orientationMin);
             }
-            break;
-        case DISPLAY_ORIENTATION_270:
-            x = float(mRawPointerAxes.y.maxValue - yTransformed) * mYScale;
-            y = float(xTransformed - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            left = float(mRawPointerAxes.y.maxValue - rawBottom) * mYScale;
-            right = float(mRawPointerAxes.y.maxValue - rawTop) * mYScale;
-            bottom = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            top = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            orientation += M_PI_2;
-            if (mOrientedRanges.haveOrientation && orientation > mOrientedRanges.orientation.max) {
-                orientation -= (mOrientedRanges.orientation.max - mOrientedRanges.orientation.min);
+        }
+        break;
+    case DISPLAY_ORIENTATION_270:
+        for (uint32_t i = 0; i < count; i++) {
+            orientation[i] += M_PI_2;
+            if (mOrientedRanges.haveOrientation && orientation[i] > orientationMax) {
+                orientation[i] -= (orientationMax - orientationMin);
             }
-            break;
-        default:
-            x = float(xTransformed - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            y = float(yTransformed - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            left = float(rawLeft - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            right = float(rawRight - mRawPointerAxes.x.minValue) * mXScale + mXTranslate;
-            bottom = float(rawBottom - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            top = float(rawTop - mRawPointerAxes.y.minValue) * mYScale + mYTranslate;
-            break;
         }
+        break;
+    default:
+        break;
+    }
 
-        // Write output coords.
+    for (uint32_t i = 0; i < count; i++) {
+        // Write output coords, in increasing axis order.
         PointerCoords& out = mCurrentCookedState.cookedPointerData.pointerCoords[i];
         out.clear();
-        out.setAxisValue(AMOTION_EVENT_AXIS_X, x);
-        out.setAxisValue(AMOTION_EVENT_AXIS_Y, y);
-        out.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, pressure);
-        out.setAxisValue(AMOTION_EVENT_AXIS_SIZE, size);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, touchMajor);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, touchMinor);
-        out.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, orientation);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
-        out.setAxisValue(AMOTION_EVENT_AXIS_DISTANCE, distance);
-        if (mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX) {
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, left);
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_2, top);
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_3, right);
-            out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_4, bottom);
-        } else {
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_X, x[i]);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_Y, y[i]);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_PRESSURE, pressure[i]);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_SIZE, size[i]);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_TOUCH_MAJOR, touchMajor[i]);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_TOUCH_MINOR, touchMinor[i]);
+        if (!haveCoverage) {
+            appendAxisValue(out, AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor[i]);
+            appendAxisValue(out, AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor[i]);
+        }
+        appendAxisValue(out, AMOTION_EVENT_AXIS_ORIENTATION, orientation[i]);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_DISTANCE, distance[i]);
+        appendAxisValue(out, AMOTION_EVENT_AXIS_TILT, tilt[i]);
+        if (haveCoverage) {
+            appendAxisValue(out, AMOTION_EVENT_AXIS_GENERIC_1, left[i]);
+            appendAxisValue(out, AMOTION_EVENT_AXIS_GENERIC_2, top[i]);
+            appendAxisValue(out, AMOTION_EVENT_AXIS_GENERIC_3, right[i]);
+            appendAxisValue(out, AMOTION_EVENT_AXIS_GENERIC_4, bottom[i]);
         }
 
         // Write output properties.
         PointerProperties& properties =
                 mCurrentCookedState.cookedPointerData.pointerProperties[i];
-        uint32_t id = in.id;
+        uint32_t id = in[i].id;
         properties.clear();
         properties.id = id;
-        properties.toolType = in.toolType;
+        properties.toolType = in[i].toolType;
 
         // Write id index.
         mCurrentCookedState.cookedPointerData.idToIndex[id] = i;
@@ -6612,193 +7079,6 @@ const TouchInputMapper::VirtualKey* TouchInputMapper::findVirtualKeyHit(int32_t
     return nullptr;
 }
 
-void TouchInputMapper::assignPointerIds(const RawState* last, RawState* current) {
-    uint32_t currentPointerCount = current->rawPointerData.pointerCount;
-    uint32_t lastPointerCount = last->rawPointerData.pointerCount;
-
-    current->rawPointerData.clearIdBits();
-
-    if (currentPointerCount == 0) {
-        // No pointers to assign.
-        return;
-    }
-
-    if (lastPointerCount == 0) {
-        // All pointers are new.
-        for (uint32_t i = 0; i < currentPointerCount; i++) {
-            uint32_t id = i;
-            current->rawPointerData.pointers[i].id = id;
-            current->rawPointerData.idToIndex[id] = i;
-            current->rawPointerData.markIdBit(id, current->rawPointerData.isHovering(i));
-        }
-        return;
-    }
-
-    if (currentPointerCount == 1 && lastPointerCount == 1
-            && current->rawPointerData.pointers[0].toolType
-                    == last->rawPointerData.pointers[0].toolType) {
-        // Only one pointer and no change in count so it must have the same id as before.
-        uint32_t id = last->rawPointerData.pointers[0].id;
-        current->rawPointerData.pointers[0].id = id;
-        current->rawPointerData.idToIndex[id] = 0;
-        current->rawPointerData.markIdBit(id, current->rawPointerData.isHovering(0));
-        return;
-    }
-
-    // General case.
-    // We build a heap of squared euclidean distances between current and last pointers
-    // associated with the current and last pointer indices.  Then, we find the best
-    // match (by distance) for each current pointer.
-    // The pointers must have the same tool type but it is possible for them to
-    // transition from hovering to touching or vice-versa while retaining the same id.
-    PointerDistanceHeapElement heap[MAX_POINTERS * MAX_POINTERS];
-
-    uint32_t heapSize = 0;
-    for (uint32_t currentPointerIndex = 0; currentPointerIndex < currentPointerCount;
-            currentPointerIndex++) {
-        for (uint32_t lastPointerIndex = 0; lastPointerIndex < lastPointerCount;
-                lastPointerIndex++) {
-            const RawPointerData::Pointer& currentPointer =
-                    current->rawPointerData.pointers[currentPointerIndex];
-            const RawPointerData::Pointer& lastPointer =
-                    last->rawPointerData.pointers[lastPointerIndex];
-            if (currentPointer.toolType == lastPointer.toolType) {
-                int64_t deltaX = currentPointer.x - lastPointer.x;
-                int64_t deltaY = currentPointer.y - lastPointer.y;
-
-                uint64_t distance = uint64_t(deltaX * deltaX + deltaY * deltaY);
-
-                // Insert new element into the heap (sift up).
-                heap[heapSize].currentPointerIndex = currentPointerIndex;
-                heap[heapSize].lastPointerIndex = lastPointerIndex;
-                heap[heapSize].distance = distance;
-                heapSize += 1;
-            }
-        }
-    }
-
-    // Heapify
-    for (uint32_t startIndex = heapSize / 2; startIndex != 0; ) {
-        startIndex -= 1;
-        for (uint32_t parentIndex = startIndex; ;) {
-            uint32_t childIndex = parentIndex * 2 + 1;
-            if (childIndex >= heapSize) {
-                break;
-            }
-
-            if (childIndex + 1 < heapSize
-                    && heap[childIndex + 1].distance < heap[childIndex].distance) {
-                childIndex += 1;
-            }
-
-            if (heap[parentIndex].distance <= heap[childIndex].distance) {
-                break;
-            }
-
-            swap(heap[parentIndex], heap[childIndex]);
-            parentIndex = childIndex;
-        }
-    }
-
-#if DEBUG_POINTER_ASSIGNMENT
-    ALOGD("assignPointerIds - initial distance min-heap: size=%d", heapSize);
-    for (size_t i = 0; i < heapSize; i++) {
-        ALOGD("  heap[%zu]: cur=%" PRIu32 ", last=%" PRIu32 ", distance=%" PRIu64,
-                i, heap[i].currentPointerIndex, heap[i].lastPointerIndex,
-                heap[i].distance);
-    }
-#endif
-
-    // Pull matches out by increasing order of distance.
-    // To avoid reassigning pointers that have already been matched, the loop keeps track
-    // of which last and current pointers have been matched using the matchedXXXBits variables.
-    // It also tracks the used pointer id bits.
-    BitSet32 matchedLastBits(0);
-    BitSet32 matchedCurrentBits(0);
-    BitSet32 usedIdBits(0);
-    bool first = true;
-    for (uint32_t i = min(currentPointerCount, lastPointerCount); heapSize > 0 && i > 0; i--) {
-        while (heapSize > 0) {
-            if (first) {
-                // The first time through the loop, we just consume the root element of
-                // the heap (the one with smallest distance).
-                first = false;
-            } else {
-                // Previous iterations consumed the root element of the heap.
-                // Pop root element off of the heap (sift down).
-                heap[0] = heap[heapSize];
-                for (uint32_t parentIndex = 0; ;) {
-                    uint32_t childIndex = parentIndex * 2 + 1;
-                    if (childIndex >= heapSize) {
-                        break;
-                    }
-
-                    if (childIndex + 1 < heapSize
-                            && heap[childIndex + 1].distance < heap[childIndex].distance) {
-                        childIndex += 1;
-                    }
-
-                    if (heap[parentIndex].distance <= heap[childIndex].distance) {
-                        break;
-                    }
-
-                    swap(heap[parentIndex], heap[childIndex]);
-                    parentIndex = childIndex;
-                }
-
-#if DEBUG_POINTER_ASSIGNMENT
-                ALOGD("assignPointerIds - reduced distance min-heap: size=%d", heapSize);
-                for (size_t i = 0; i < heapSize; i++) {
-                    ALOGD("  heap[%zu]: cur=%" PRIu32 ", last=%" PRIu32 ", distance=%" PRIu64,
-                            i, heap[i].currentPointerIndex, heap[i].lastPointerIndex,
-                            heap[i].distance);
-                }
-#endif
-            }
-
-            heapSize -= 1;
-
-            uint32_t currentPointerIndex = heap[0].currentPointerIndex;
-            if (matchedCurrentBits.hasBit(currentPointerIndex)) continue; // already matched
-
-            uint32_t lastPointerIndex = heap[0].lastPointerIndex;
-            if (matchedLastBits.hasBit(lastPointerIndex)) continue; // already matched
-
-            matchedCurrentBits.markBit(currentPointerIndex);
-            matchedLastBits.markBit(lastPointerIndex);
-
-            uint32_t id = last->rawPointerData.pointers[lastPointerIndex].id;
-            current->rawPointerData.pointers[currentPointerIndex].id = id;
-            current->rawPointerData.idToIndex[id] = currentPointerIndex;
-            current->rawPointerData.markIdBit(id,
-                    current->rawPointerData.isHovering(currentPointerIndex));
-            usedIdBits.markBit(id);
-
-#if DEBUG_POINTER_ASSIGNMENT
-            ALOGD("assignPointerIds - matched: cur=%" PRIu32 ", last=%" PRIu32
-                    ", id=%" PRIu32 ", distance=%" PRIu64,
-                    lastPointerIndex, currentPointerIndex, id, heap[0].distance);
-#endif
-            break;
-        }
-    }
-
-    // Assign fresh ids to pointers that were not matched in the process.
-    for (uint32_t i = currentPointerCount - matchedCurrentBits.count(); i != 0; i--) {
-        uint32_t currentPointerIndex = matchedCurrentBits.markFirstUnmarkedBit();
-        uint32_t id = usedIdBits.markFirstUnmarkedBit();
-
-        current->rawPointerData.pointers[currentPointerIndex].id = id;
-        current->rawPointerData.idToIndex[id] = currentPointerIndex;
-        current->rawPointerData.markIdBit(id,
-                current->rawPointerData.isHovering(currentPointerIndex));
-
-#if DEBUG_POINTER_ASSIGNMENT
-        ALOGD("assignPointerIds - assigned: cur=%" PRIu32 ", id=%" PRIu32, currentPointerIndex, id);
-#endif
-    }
-}
-
 int32_t TouchInputMapper::getKeyCodeState(uint32_t sourceMask, int32_t keyCode) {
     if (mCurrentVirtualKey.down && mCurrentVirtualKey.keyCode == keyCode) {
         return AKEY_STATE_VIRTUAL;
@@ -536,6 +536,28 @@ struct RawPointerData {
 };
 
 
+/*
+ * How the pointers of a touch sample are matched with the pointers of the previous sample
+ * when the device does not report tracking ids.
+ */
+enum PointerIdAssignment {
+    // Repeatedly matches the two closest pointers that are not matched yet.
+    // A contact that moves further than its distance to a neighbor between two samples
+    // takes the id of the neighbor.
+    POINTER_ID_ASSIGNMENT_GREEDY,
+    // Matches the pointers so that the sum of the squared distances between matched
+    // pointers is minimal.
+    POINTER_ID_ASSIGNMENT_OPTIMAL,
+};
+
+/*
+ * Assigns ids to the pointers of the current sample. Pointers that match a pointer of the
+ * last sample with the same tool type keep its id, the others get unused ids.
+ */
+void assignPointerIds(PointerIdAssignment assignment, const RawPointerData& last,
+        RawPointerData* current);
+
+
 /* Cooked data for a collection of pointers including a pointer id mapping table. */
 struct CookedPointerData {
     uint32_t pointerCount;
@@ -1089,6 +1111,8 @@ protected:
         };
         GestureMode gestureMode;
 
+        PointerIdAssignment pointerIdAssignment;
+
         bool wake;
     } mParameters;
 
@@ -1319,6 +1343,20 @@ private:
     float mYScale;
     float mYPrecision;
 
+    // Maps a raw X or Y coordinate onto a surface axis for the current surface orientation:
+    //   surface = float(flip ? origin - raw : raw - origin) * scale + translate
+    struct SurfaceAxisTransform {
+        bool fromRawY;
+        bool flip;
+        int32_t origin;
+        float scale;
+        float translate;
+    };
+
+    // Transforms onto the surface X and Y axes, precomputed by configureSurface().
+    SurfaceAxisTransform mSurfaceXTransform;
+    SurfaceAxisTransform mSurfaceYTransform;
+
     float mGeometricScale;
 
     float mPressureScale;
@@ -1400,12 +1438,6 @@ private:
     // The maximum swipe width.
     float mPointerGestureMaxSwipeWidth;
 
-    struct PointerDistanceHeapElement {
-        uint32_t currentPointerIndex : 8;
-        uint32_t lastPointerIndex : 8;
-        uint64_t distance : 48; // squared distance
-    };
-
     enum PointerUsage {
         POINTER_USAGE_NONE,
         POINTER_USAGE_GESTURES,
@@ -1601,6 +1633,10 @@ private:
     void dispatchButtonRelease(nsecs_t when, uint32_t policyFlags);
     void dispatchButtonPress(nsecs_t when, uint32_t policyFlags);
     const BitSet32& findActiveIdBits(const CookedPointerData& cookedPointerData);
+    void configureSurfaceAxisTransforms();
+    template <typename T>
+    static void transformToSurfaceAxis(const SurfaceAxisTransform& transform,
+            const T* raw, float* outSurface, uint32_t count);
     void cookPointerData();
     void abortTouches(nsecs_t when, uint32_t policyFlags);
 
@@ -1649,8 +1685,6 @@ private:
     bool isPointInsideSurface(int32_t x, int32_t y);
     const VirtualKey* findVirtualKeyHit(int32_t x, int32_t y);
 
-    static void assignPointerIds(const RawState* last, RawState* current);
-
     void reportEventForStatistics(nsecs_t evdevTime);
 
     const char* modeToString(DeviceMode deviceMode);
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GeteventRecording.h"
+
+#include <android-base/stringprintf.h>
+#include <linux/input.h>
+
+#include <sstream>
+
+#include <math.h>
+#include <stdlib.h>
+
+using android::base::StringPrintf;
+
+namespace android {
+
+// --- Evdev labels ---
+
+struct EvdevLabel {
+    const char* literal;
+    int32_t value;
+};
+
+#define DEFINE_EVDEV_LABEL(label) { #label, label }
+
+static const EvdevLabel EVDEV_TYPES[] = {
+    DEFINE_EVDEV_LABEL(EV_SYN),
+    DEFINE_EVDEV_LABEL(EV_KEY),
+    DEFINE_EVDEV_LABEL(EV_REL),
+    DEFINE_EVDEV_LABEL(EV_ABS),
+    DEFINE_EVDEV_LABEL(EV_MSC),
+    DEFINE_EVDEV_LABEL(EV_SW),
+    DEFINE_EVDEV_LABEL(EV_LED),
+    { nullptr, 0 }
+};
+
+static const EvdevLabel EVDEV_SYN_CODES[] = {
+    DEFINE_EVDEV_LABEL(SYN_REPORT),
+    DEFINE_EVDEV_LABEL(SYN_CONFIG),
+    DEFINE_EVDEV_LABEL(SYN_MT_REPORT),
+    DEFINE_EVDEV_LABEL(SYN_DROPPED),
+    { nullptr, 0 }
+};
+
+static const EvdevLabel EVDEV_ABS_CODES[] = {
+    DEFINE_EVDEV_LABEL(ABS_X),
+    DEFINE_EVDEV_LABEL(ABS_Y),
+    DEFINE_EVDEV_LABEL(ABS_PRESSURE),
+    DEFINE_EVDEV_LABEL(ABS_DISTANCE),
+    DEFINE_EVDEV_LABEL(ABS_TILT_X),
+    DEFINE_EVDEV_LABEL(ABS_TILT_Y),
+    DEFINE_EVDEV_LABEL(ABS_TOOL_WIDTH),
+    DEFINE_EVDEV_LABEL(ABS_MT_SLOT),
+    DEFINE_EVDEV_LABEL(ABS_MT_TOUCH_MAJOR),
+    DEFINE_EVDEV_LABEL(ABS_MT_TOUCH_MINOR),
+    DEFINE_EVDEV_LABEL(ABS_MT_WIDTH_MAJOR),
+    DEFINE_EVDEV_LABEL(ABS_MT_WIDTH_MINOR),
+    DEFINE_EVDEV_LABEL(ABS_MT_ORIENTATION),
+    DEFINE_EVDEV_LABEL(ABS_MT_POSITION_X),
+    DEFINE_EVDEV_LABEL(ABS_MT_POSITION_Y),
+    DEFINE_EVDEV_LABEL(ABS_MT_TOOL_TYPE),
+    DEFINE_EVDEV_LABEL(ABS_MT_BLOB_ID),
+    DEFINE_EVDEV_LABEL(ABS_MT_TRACKING_ID),
+    DEFINE_EVDEV_LABEL(ABS_MT_PRESSURE),
+    DEFINE_EVDEV_LABEL(ABS_MT_DISTANCE),
+    { nullptr, 0 }
+};
+
+static const EvdevLabel EVDEV_KEY_CODES[] = {
+    DEFINE_EVDEV_LABEL(BTN_TOUCH),
+    DEFINE_EVDEV_LABEL(BTN_TOOL_FINGER),
+    DEFINE_EVDEV_LABEL(BTN_TOOL_PEN),
+    DEFINE_EVDEV_LABEL(BTN_TOOL_RUBBER),
+    DEFINE_EVDEV_LABEL(BTN_TOOL_DOUBLETAP),
+    DEFINE_EVDEV_LABEL(BTN_TOOL_TRIPLETAP),
+    DEFINE_EVDEV_LABEL(BTN_TOOL_QUADTAP),
+    DEFINE_EVDEV_LABEL(BTN_STYLUS),
+    DEFINE_EVDEV_LABEL(BTN_STYLUS2),
+    DEFINE_EVDEV_LABEL(KEY_BACK),
+    DEFINE_EVDEV_LABEL(KEY_HOMEPAGE),
+    DEFINE_EVDEV_LABEL(KEY_POWER),
+    DEFINE_EVDEV_LABEL(KEY_VOLUMEDOWN),
+    DEFINE_EVDEV_LABEL(KEY_VOLUMEUP),
+    { nullptr, 0 }
+};
+
+static const EvdevLabel EVDEV_MSC_CODES[] = {
+    DEFINE_EVDEV_LABEL(MSC_SCAN),
+    DEFINE_EVDEV_LABEL(MSC_TIMESTAMP),
+    { nullptr, 0 }
+};
+
+static const EvdevLabel EVDEV_REL_CODES[] = {
+    DEFINE_EVDEV_LABEL(REL_X),
+    DEFINE_EVDEV_LABEL(REL_Y),
+    DEFINE_EVDEV_LABEL(REL_WHEEL),
+    DEFINE_EVDEV_LABEL(REL_HWHEEL),
+    { nullptr, 0 }
+};
+
+static const EvdevLabel EVDEV_KEY_VALUES[] = {
+    { "UP", 0 },
+    { "DOWN", 1 },
+    { "REPEAT", 2 },
+    { nullptr, 0 }
+};
+
+#undef DEFINE_EVDEV_LABEL
+
+static const EvdevLabel* getCodeLabels(int32_t type) {
+    switch (type) {
+    case EV_SYN:
+        return EVDEV_SYN_CODES;
+    case EV_KEY:
+        return EVDEV_KEY_CODES;
+    case EV_REL:
+        return EVDEV_REL_CODES;
+    case EV_ABS:
+        return EVDEV_ABS_CODES;
+    case EV_MSC:
+        return EVDEV_MSC_CODES;
+    default:
+        return nullptr;
+    }
+}
+
+// Parses a label printed by "getevent -l", or the hex number printed by plain "getevent".
+static bool parseLabel(const std::string& token, const EvdevLabel* labels, int32_t* outValue) {
+    if (labels) {
+        for (const EvdevLabel* label = labels; label->literal; label++) {
+            if (token == label->literal) {
+                *outValue = label->value;
+                return true;
+            }
+        }
+    }
+    if (token.empty() || token.size() > 8
+            || token.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        return false;
+    }
+    *outValue = static_cast<int32_t>(strtoul(token.c_str(), nullptr, 16));
+    return true;
+}
+
+
+// --- RecordedEvdevEvent ---
+
+bool parseGeteventRecording(const std::string& recording,
+        std::vector<RecordedEvdevEvent>* outEvents, std::string* outError) {
+    std::istringstream lines(recording);
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+
+        // "getevent -t" prefixes events with "[ seconds.microseconds]".
+        size_t position = line.find_first_not_of(" \t");
+        if (position == std::string::npos) {
+            continue;
+        }
+        nsecs_t when = 0;
+        if (line[position] == '[') {
+            size_t end = line.find(']', position);
+            if (end == std::string::npos) {
+                *outError = StringPrintf("line %zu: unterminated timestamp", lineNumber);
+                return false;
+            }
+            const char* start = line.c_str() + position + 1;
+            char* parsed;
+            double seconds = strtod(start, &parsed);
+            size_t parsedEnd = line.find_first_not_of(" \t", parsed - line.c_str());
+            if (parsed == start || parsedEnd != end || !(seconds >= 0)) {
+                *outError = StringPrintf("line %zu: invalid timestamp '%s'", lineNumber,
+                        line.substr(position, end - position + 1).c_str());
+                return false;
+            }
+            when = static_cast<nsecs_t>(llround(seconds * 1000000)) * 1000;
+            position = line.find_first_not_of(" \t", end + 1);
+            if (position == std::string::npos) {
+                continue;
+            }
+        }
+
+        // Skips the device list printed on startup and anything else that is not an event.
+        if (line.compare(position, 11, "/dev/input/") != 0) {
+            continue;
+        }
+        size_t colon = line.find(':', position);
+        if (colon == std::string::npos) {
+            continue;
+        }
+
+        RecordedEvdevEvent event;
+        event.when = when;
+        event.devicePath = line.substr(position, colon - position);
+
+        std::istringstream fields(line.substr(colon + 1));
+        std::string type, code, value;
+        if (!(fields >> type >> code >> value)) {
+            *outError = StringPrintf("line %zu: expected type, code and value", lineNumber);
+            return false;
+        }
+        if (!parseLabel(type, EVDEV_TYPES, &event.type)) {
+            *outError = StringPrintf("line %zu: unknown event type '%s'", lineNumber,
+                    type.c_str());
+            return false;
+        }
+        if (!parseLabel(code, getCodeLabels(event.type), &event.code)) {
+            *outError = StringPrintf("line %zu: unknown event code '%s'", lineNumber,
+                    code.c_str());
+            return false;
+        }
+        if (!parseLabel(value, event.type == EV_KEY ? EVDEV_KEY_VALUES : nullptr,
+                &event.value)) {
+            *outError = StringPrintf("line %zu: invalid event value '%s'", lineNumber,
+                    value.c_str());
+            return false;
+        }
+        outEvents->push_back(event);
+    }
+    return true;
+}
+
+} // namespace android
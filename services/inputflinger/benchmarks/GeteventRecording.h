@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_GETEVENT_RECORDING_H
+#define _UI_GETEVENT_RECORDING_H
+
+#include <utils/Timers.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace android {
+
+// --- RecordedEvdevEvent ---
+
+struct RecordedEvdevEvent {
+    nsecs_t when;
+    std::string devicePath;
+    int32_t type;
+    int32_t code;
+    int32_t value;
+};
+
+/*
+ * Parses a recording in the format printed by "getevent -lt" (or "getevent -t"):
+ *
+ *   [   51727.497891] /dev/input/event2: EV_ABS       ABS_MT_TRACKING_ID   00000035
+ *   [   51727.497891] /dev/input/event2: EV_SYN       SYN_REPORT           00000000
+ *
+ * Lines that are not events, such as the device list printed by getevent on startup, are
+ * skipped. Events without a timestamp have a time of 0.
+ * Returns false and sets outError if an event line could not be parsed.
+ */
+bool parseGeteventRecording(const std::string& recording,
+        std::vector<RecordedEvdevEvent>* outEvents, std::string* outError);
+
+} // namespace android
+
+#endif // _UI_GETEVENT_RECORDING_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "InputListener.h"
+
+namespace android {
+
+// --- FakeInputListener ---
+
+// Stands in for the classifier and dispatcher: only looks at the events it is given.
+class FakeInputListener : public InputListenerInterface {
+public:
+    size_t eventCount = 0;
+    float checksum = 0;
+
+protected:
+    virtual ~FakeInputListener() { }
+
+public:
+    virtual void notifyConfigurationChanged(const NotifyConfigurationChangedArgs*) {
+        eventCount++;
+    }
+
+    virtual void notifyKey(const NotifyKeyArgs*) { eventCount++; }
+
+    virtual void notifyMotion(const NotifyMotionArgs* args) {
+        eventCount++;
+        checksum += args->pointerCoords[args->pointerCount - 1].getX();
+    }
+
+    virtual void notifySwitch(const NotifySwitchArgs*) { eventCount++; }
+
+    virtual void notifyDeviceReset(const NotifyDeviceResetArgs*) { eventCount++; }
+};
+
+// A recorded touch stream: one finger going down, moving with the given number of fingers
+// and going up, as reported by a touch mapper for each evdev SYN_REPORT.
+static std::vector<NotifyMotionArgs> generateTouchStream(uint32_t pointerCount, size_t moves) {
+    std::vector<NotifyMotionArgs> stream;
+    PointerProperties properties[MAX_POINTERS];
+    PointerCoords coords[MAX_POINTERS];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        properties[i].clear();
+        properties[i].id = i;
+        properties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    }
+
+    for (size_t n = 0; n < moves + 2; n++) {
+        int32_t action = AMOTION_EVENT_ACTION_MOVE;
+        uint32_t count = pointerCount;
+        if (n == 0) {
+            action = AMOTION_EVENT_ACTION_DOWN;
+            count = 1;
+        } else if (n == moves + 1) {
+            action = AMOTION_EVENT_ACTION_UP;
+            count = 1;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            coords[i].clear();
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 + 10 * i + n);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 200 + 10 * i + n);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 1);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_SIZE, 0.5);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, 10);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, 10);
+        }
+        const nsecs_t eventTime = n * 8000000;
+        stream.emplace_back(n/*sequenceNum*/, eventTime, 1/*deviceId*/, AINPUT_SOURCE_TOUCHSCREEN,
+                ADISPLAY_ID_DEFAULT, 0/*policyFlags*/, action, 0/*actionButton*/, 0/*flags*/,
+                AMETA_NONE, 0/*buttonState*/, MotionClassification::NONE,
+                AMOTION_EVENT_EDGE_FLAG_NONE, 0/*deviceTimestamp*/, count, properties, coords,
+                0/*xPrecision*/, 0/*yPrecision*/, 0/*downTime*/,
+                std::vector<TouchVideoFrame>());
+    }
+    return stream;
+}
+
+// Queues every event of the stream and flushes after each one, like InputReader::loopOnce
+// does for a single SYN_REPORT.
+static void BM_QueuedInputListener_MotionStream(benchmark::State& state) {
+    sp<FakeInputListener> listener = new FakeInputListener();
+    sp<QueuedInputListener> queuedListener = new QueuedInputListener(listener);
+    const std::vector<NotifyMotionArgs> stream = generateTouchStream(state.range(0), 100);
+
+    for (auto _ : state) {
+        for (const NotifyMotionArgs& args : stream) {
+            queuedListener->notifyMotion(&args);
+            queuedListener->flush();
+        }
+    }
+    benchmark::DoNotOptimize(listener->checksum);
+    state.SetItemsProcessed(listener->eventCount);
+}
+BENCHMARK(BM_QueuedInputListener_MotionStream)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+
+// Queues the whole stream before flushing, like a reader that fell behind draining a burst of
+// evdev events in one loop.
+static void BM_QueuedInputListener_MotionBurst(benchmark::State& state) {
+    sp<FakeInputListener> listener = new FakeInputListener();
+    sp<QueuedInputListener> queuedListener = new QueuedInputListener(listener);
+    const std::vector<NotifyMotionArgs> stream = generateTouchStream(state.range(0), 100);
+
+    for (auto _ : state) {
+        for (const NotifyMotionArgs& args : stream) {
+            queuedListener->notifyMotion(&args);
+        }
+        queuedListener->flush();
+    }
+    benchmark::DoNotOptimize(listener->checksum);
+    state.SetItemsProcessed(listener->eventCount);
+}
+BENCHMARK(BM_QueuedInputListener_MotionBurst)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,698 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InputReplay"
+
+#include "InputReplay.h"
+
+#include <binder/Binder.h>
+#include <linux/input.h>
+
+#include <algorithm>
+
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <time.h>
+
+namespace android {
+
+// Time to wait for the dispatcher to deliver the events of a frame to the window.
+static constexpr nsecs_t RECEIVE_TIMEOUT = 500 * 1000000LL;
+
+// Device ids are assigned in the order the devices first appear in the recording.
+static constexpr int32_t FIRST_DEVICE_ID = 1;
+
+static const int32_t INJECTOR_PID = 999;
+static const int32_t INJECTOR_UID = 1001;
+
+
+// --- ReplayEventHub ---
+
+ReplayEventHub::ReplayEventHub() : mNextFrame(0) {
+}
+
+ReplayEventHub::~ReplayEventHub() {
+}
+
+void ReplayEventHub::addDevices(const std::vector<RecordedEvdevEvent>& recording,
+        int32_t displayWidth, int32_t displayHeight) {
+    std::scoped_lock _l(mLock);
+
+    // Axis ranges are not part of the recording, so they are taken from the values seen.
+    std::map<std::string, std::map<int, int32_t>> maxAxisValues;
+    std::vector<std::string> paths;
+    for (const RecordedEvdevEvent& event : recording) {
+        auto [it, added] = maxAxisValues.try_emplace(event.devicePath);
+        if (added) {
+            paths.push_back(event.devicePath);
+        }
+        if (event.type == EV_ABS) {
+            int32_t& maxValue = it->second[event.code];
+            maxValue = std::max(maxValue, event.value);
+        }
+    }
+
+    std::vector<RawEvent> addedEvents;
+    for (const std::string& path : paths) {
+        const std::map<int, int32_t>& axes = maxAxisValues[path];
+        if (axes.find(ABS_MT_POSITION_X) == axes.end()
+                || axes.find(ABS_MT_POSITION_Y) == axes.end()) {
+            continue;
+        }
+
+        int32_t deviceId = FIRST_DEVICE_ID + int32_t(mDevices.size());
+        Device& device = mDevices[deviceId];
+        device.identifier.name = "replay:" + path;
+        device.identifier.location = path;
+        device.identifier.descriptor = path;
+        device.configuration.addProperty(String8("touch.deviceType"), String8("touchScreen"));
+        device.enabled = true;
+        for (const auto& [axis, maxValue] : axes) {
+            RawAbsoluteAxisInfo info;
+            info.clear();
+            info.valid = true;
+            switch (axis) {
+            case ABS_MT_POSITION_X:
+                info.maxValue = std::max(maxValue, displayWidth - 1);
+                break;
+            case ABS_MT_POSITION_Y:
+                info.maxValue = std::max(maxValue, displayHeight - 1);
+                break;
+            case ABS_MT_SLOT:
+                info.maxValue = std::max(maxValue, 9);
+                break;
+            case ABS_MT_TRACKING_ID:
+                info.maxValue = 65535;
+                break;
+            default:
+                info.maxValue = std::max(maxValue, 255);
+                break;
+            }
+            device.absoluteAxes[axis] = info;
+        }
+        mDeviceIdsByPath[path] = deviceId;
+
+        RawEvent added = {};
+        added.deviceId = deviceId;
+        added.type = DEVICE_ADDED;
+        addedEvents.push_back(added);
+    }
+
+    RawEvent finished = {};
+    finished.type = FINISHED_DEVICE_SCAN;
+    addedEvents.push_back(finished);
+    mFrames.push_back(std::move(addedEvents));
+}
+
+size_t ReplayEventHub::queueRecording(const std::vector<RecordedEvdevEvent>& recording) {
+    std::scoped_lock _l(mLock);
+
+    size_t frameCount = 0;
+    std::vector<RawEvent> frame;
+    for (const RecordedEvdevEvent& event : recording) {
+        auto it = mDeviceIdsByPath.find(event.devicePath);
+        if (it == mDeviceIdsByPath.end()) {
+            continue;
+        }
+
+        RawEvent rawEvent;
+        rawEvent.when = 0;
+        rawEvent.deviceId = it->second;
+        rawEvent.type = event.type;
+        rawEvent.code = event.code;
+        rawEvent.value = event.value;
+        frame.push_back(rawEvent);
+
+        if (event.type == EV_SYN && event.code == SYN_REPORT) {
+            mFrames.push_back(std::move(frame));
+            frame.clear();
+            frameCount++;
+        }
+    }
+    // An incomplete frame at the end of the recording is dropped, as the reader would
+    // wait for its SYN_REPORT forever.
+    return frameCount;
+}
+
+bool ReplayEventHub::hasQueuedEvents() const {
+    std::scoped_lock _l(mLock);
+    return mNextFrame < mFrames.size();
+}
+
+const ReplayEventHub::Device* ReplayEventHub::getDevice(int32_t deviceId) const {
+    auto it = mDevices.find(deviceId);
+    return it != mDevices.end() ? &it->second : nullptr;
+}
+
+uint32_t ReplayEventHub::getDeviceClasses(int32_t deviceId) const {
+    std::scoped_lock _l(mLock);
+    return getDevice(deviceId) ? INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT : 0;
+}
+
+InputDeviceIdentifier ReplayEventHub::getDeviceIdentifier(int32_t deviceId) const {
+    std::scoped_lock _l(mLock);
+    const Device* device = getDevice(deviceId);
+    return device ? device->identifier : InputDeviceIdentifier();
+}
+
+int32_t ReplayEventHub::getDeviceControllerNumber(int32_t) const {
+    return 0;
+}
+
+void ReplayEventHub::getConfiguration(int32_t deviceId, PropertyMap* outConfiguration) const {
+    std::scoped_lock _l(mLock);
+    const Device* device = getDevice(deviceId);
+    if (device) {
+        *outConfiguration = device->configuration;
+    }
+}
+
+status_t ReplayEventHub::getAbsoluteAxisInfo(int32_t deviceId, int axis,
+        RawAbsoluteAxisInfo* outAxisInfo) const {
+    std::scoped_lock _l(mLock);
+    const Device* device = getDevice(deviceId);
+    if (device) {
+        auto it = device->absoluteAxes.find(axis);
+        if (it != device->absoluteAxes.end()) {
+            *outAxisInfo = it->second;
+            return OK;
+        }
+    }
+    outAxisInfo->clear();
+    return -1;
+}
+
+bool ReplayEventHub::hasRelativeAxis(int32_t, int) const {
+    return false;
+}
+
+bool ReplayEventHub::hasInputProperty(int32_t, int property) const {
+    return property == INPUT_PROP_DIRECT;
+}
+
+status_t ReplayEventHub::mapKey(int32_t, int32_t, int32_t, int32_t, int32_t*, int32_t*,
+        uint32_t*) const {
+    return NAME_NOT_FOUND;
+}
+
+status_t ReplayEventHub::mapAxis(int32_t, int32_t, AxisInfo*) const {
+    return NAME_NOT_FOUND;
+}
+
+void ReplayEventHub::setExcludedDevices(const std::vector<std::string>&) {
+}
+
+size_t ReplayEventHub::getEvents(int, RawEvent* buffer, size_t bufferSize) {
+    std::scoped_lock _l(mLock);
+    if (mNextFrame >= mFrames.size()) {
+        return 0;
+    }
+
+    std::vector<RawEvent>& frame = mFrames[mNextFrame];
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    size_t count = std::min(frame.size(), bufferSize);
+    for (size_t i = 0; i < count; i++) {
+        buffer[i] = frame[i];
+        buffer[i].when = now;
+    }
+    if (count < frame.size()) {
+        frame.erase(frame.begin(), frame.begin() + count);
+    } else {
+        mNextFrame++;
+    }
+    return count;
+}
+
+std::vector<TouchVideoFrame> ReplayEventHub::getVideoFrames(int32_t) {
+    return {};
+}
+
+int32_t ReplayEventHub::getScanCodeState(int32_t, int32_t) const {
+    return AKEY_STATE_UNKNOWN;
+}
+
+int32_t ReplayEventHub::getKeyCodeState(int32_t, int32_t) const {
+    return AKEY_STATE_UNKNOWN;
+}
+
+int32_t ReplayEventHub::getSwitchState(int32_t, int32_t) const {
+    return AKEY_STATE_UNKNOWN;
+}
+
+status_t ReplayEventHub::getAbsoluteAxisValue(int32_t, int32_t, int32_t* outValue) const {
+    // Touches still in progress at the start of the recording are not reported.
+    *outValue = 0;
+    return -1;
+}
+
+bool ReplayEventHub::markSupportedKeyCodes(int32_t, size_t, const int32_t*, uint8_t*) const {
+    return false;
+}
+
+bool ReplayEventHub::hasScanCode(int32_t, int32_t) const {
+    return false;
+}
+
+bool ReplayEventHub::hasLed(int32_t, int32_t) const {
+    return false;
+}
+
+void ReplayEventHub::setLedState(int32_t, int32_t, bool) {
+}
+
+void ReplayEventHub::getVirtualKeyDefinitions(int32_t,
+        std::vector<VirtualKeyDefinition>& outVirtualKeys) const {
+    outVirtualKeys.clear();
+}
+
+sp<KeyCharacterMap> ReplayEventHub::getKeyCharacterMap(int32_t) const {
+    return nullptr;
+}
+
+bool ReplayEventHub::setKeyboardLayoutOverlay(int32_t, const sp<KeyCharacterMap>&) {
+    return false;
+}
+
+void ReplayEventHub::vibrate(int32_t, nsecs_t) {
+}
+
+void ReplayEventHub::cancelVibrate(int32_t) {
+}
+
+void ReplayEventHub::requestReopenDevices() {
+}
+
+void ReplayEventHub::wake() {
+}
+
+void ReplayEventHub::dump(std::string&) {
+}
+
+void ReplayEventHub::monitor() {
+}
+
+bool ReplayEventHub::isDeviceEnabled(int32_t deviceId) {
+    std::scoped_lock _l(mLock);
+    const Device* device = getDevice(deviceId);
+    return device && device->enabled;
+}
+
+status_t ReplayEventHub::enableDevice(int32_t deviceId) {
+    std::scoped_lock _l(mLock);
+    auto it = mDevices.find(deviceId);
+    if (it == mDevices.end()) {
+        return BAD_VALUE;
+    }
+    it->second.enabled = true;
+    return OK;
+}
+
+status_t ReplayEventHub::disableDevice(int32_t deviceId) {
+    std::scoped_lock _l(mLock);
+    auto it = mDevices.find(deviceId);
+    if (it == mDevices.end()) {
+        return BAD_VALUE;
+    }
+    it->second.enabled = false;
+    return OK;
+}
+
+
+// --- LatencyStats ---
+
+void LatencyStats::clear() {
+    mSamples.clear();
+    mSorted = true;
+}
+
+void LatencyStats::record(nsecs_t latency) {
+    mSorted = mSorted && (mSamples.empty() || mSamples.back() <= latency);
+    mSamples.push_back(latency);
+}
+
+nsecs_t LatencyStats::percentile(double percentile) {
+    if (mSamples.empty()) {
+        return 0;
+    }
+    if (!mSorted) {
+        std::sort(mSamples.begin(), mSamples.end());
+        mSorted = true;
+    }
+    size_t index = static_cast<size_t>(ceil(percentile / 100 * mSamples.size()));
+    return mSamples[std::min(std::max(index, size_t(1)), mSamples.size()) - 1];
+}
+
+
+// --- InputReplayPipeline::StageListener ---
+
+/* Measures the latency of the events leaving a stage and forwards them to the next one. */
+class InputReplayPipeline::StageListener : public InputListenerInterface {
+public:
+    explicit StageListener(const sp<InputListenerInterface>& innerListener) :
+            mInnerListener(innerListener), mStats(nullptr) {
+    }
+
+    void setStats(LatencyStats* stats) {
+        mStats = stats;
+    }
+
+protected:
+    virtual ~StageListener() { }
+
+public:
+    virtual void notifyConfigurationChanged(const NotifyConfigurationChangedArgs* args) {
+        mInnerListener->notifyConfigurationChanged(args);
+    }
+
+    virtual void notifyKey(const NotifyKeyArgs* args) {
+        record(args->eventTime);
+        mInnerListener->notifyKey(args);
+    }
+
+    virtual void notifyMotion(const NotifyMotionArgs* args) {
+        record(args->eventTime);
+        mInnerListener->notifyMotion(args);
+    }
+
+    virtual void notifySwitch(const NotifySwitchArgs* args) {
+        mInnerListener->notifySwitch(args);
+    }
+
+    virtual void notifyDeviceReset(const NotifyDeviceResetArgs* args) {
+        mInnerListener->notifyDeviceReset(args);
+    }
+
+private:
+    void record(nsecs_t eventTime) {
+        if (mStats) {
+            mStats->record(systemTime(SYSTEM_TIME_MONOTONIC) - eventTime);
+        }
+    }
+
+    sp<InputListenerInterface> mInnerListener;
+    LatencyStats* mStats;
+};
+
+
+// --- InputReplayPipeline::ReaderPolicy ---
+
+class InputReplayPipeline::ReaderPolicy : public InputReaderPolicyInterface {
+public:
+    ReaderPolicy() {
+        DisplayViewport viewport;
+        viewport.displayId = ADISPLAY_ID_DEFAULT;
+        viewport.orientation = DISPLAY_ORIENTATION_0;
+        viewport.logicalLeft = 0;
+        viewport.logicalTop = 0;
+        viewport.logicalRight = DISPLAY_WIDTH;
+        viewport.logicalBottom = DISPLAY_HEIGHT;
+        viewport.physicalLeft = 0;
+        viewport.physicalTop = 0;
+        viewport.physicalRight = DISPLAY_WIDTH;
+        viewport.physicalBottom = DISPLAY_HEIGHT;
+        viewport.deviceWidth = DISPLAY_WIDTH;
+        viewport.deviceHeight = DISPLAY_HEIGHT;
+        viewport.uniqueId = "local:0";
+        viewport.type = ViewportType::VIEWPORT_INTERNAL;
+        mConfig.setDisplayViewports({viewport});
+    }
+
+protected:
+    virtual ~ReaderPolicy() { }
+
+public:
+    virtual void getReaderConfiguration(InputReaderConfiguration* outConfig) {
+        *outConfig = mConfig;
+    }
+
+    virtual sp<PointerControllerInterface> obtainPointerController(int32_t) {
+        return nullptr;
+    }
+
+    virtual void notifyInputDevicesChanged(const std::vector<InputDeviceInfo>&) {
+    }
+
+    virtual sp<KeyCharacterMap> getKeyboardLayoutOverlay(const InputDeviceIdentifier&) {
+        return nullptr;
+    }
+
+    virtual std::string getDeviceAlias(const InputDeviceIdentifier&) {
+        return "";
+    }
+
+    virtual TouchAffineTransformation getTouchAffineTransformation(const std::string&,
+            int32_t) {
+        return TouchAffineTransformation();
+    }
+
+private:
+    InputReaderConfiguration mConfig;
+};
+
+
+// --- InputReplayPipeline::DispatcherPolicy ---
+
+class InputReplayPipeline::DispatcherPolicy : public InputDispatcherPolicyInterface {
+protected:
+    virtual ~DispatcherPolicy() { }
+
+public:
+    virtual void notifyConfigurationChanged(nsecs_t) {
+    }
+
+    virtual nsecs_t notifyANR(const sp<InputApplicationHandle>&, const sp<IBinder>&,
+            const std::string& reason) {
+        ALOGE("Replay window is not responding: %s", reason.c_str());
+        return 0;
+    }
+
+    virtual void notifyInputChannelBroken(const sp<IBinder>&) {
+    }
+
+    virtual void notifyFocusChanged(const sp<IBinder>&, const sp<IBinder>&) {
+    }
+
+    virtual void getDispatcherConfiguration(InputDispatcherConfiguration* outConfig) {
+        *outConfig = mConfig;
+    }
+
+    virtual bool filterInputEvent(const InputEvent*, uint32_t) {
+        return true;
+    }
+
+    virtual void interceptKeyBeforeQueueing(const KeyEvent*, uint32_t& policyFlags) {
+        policyFlags |= POLICY_FLAG_PASS_TO_USER;
+    }
+
+    virtual void interceptMotionBeforeQueueing(int32_t, nsecs_t, uint32_t& policyFlags) {
+        policyFlags |= POLICY_FLAG_PASS_TO_USER;
+    }
+
+    virtual nsecs_t interceptKeyBeforeDispatching(const sp<IBinder>&, const KeyEvent*,
+            uint32_t) {
+        return 0;
+    }
+
+    virtual bool dispatchUnhandledKey(const sp<IBinder>&, const KeyEvent*, uint32_t,
+            KeyEvent*) {
+        return false;
+    }
+
+    virtual void notifySwitch(nsecs_t, uint32_t, uint32_t, uint32_t) {
+    }
+
+    virtual void pokeUserActivity(nsecs_t, int32_t, int32_t) {
+    }
+
+    virtual bool checkInjectEventsPermissionNonReentrant(int32_t, int32_t) {
+        return false;
+    }
+
+    virtual void onPointerDownOutsideFocus(const sp<IBinder>&) {
+    }
+
+private:
+    InputDispatcherConfiguration mConfig;
+};
+
+
+// --- InputReplayPipeline::ReplayWindowHandle ---
+
+class InputReplayPipeline::ReplayWindowHandle : public InputWindowHandle {
+public:
+    ReplayWindowHandle(const sp<InputApplicationHandle>& application,
+            const sp<InputChannel>& serverChannel) {
+        application->updateInfo();
+        mInfo.applicationInfo = *application->getInfo();
+        mInfo.token = serverChannel->getToken();
+    }
+
+    virtual bool updateInfo() {
+        const Rect frame(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        mInfo.name = "InputReplayWindow";
+        mInfo.layoutParamsFlags = 0;
+        mInfo.layoutParamsType = InputWindowInfo::TYPE_APPLICATION;
+        mInfo.dispatchingTimeout = RECEIVE_TIMEOUT;
+        mInfo.frameLeft = frame.left;
+        mInfo.frameTop = frame.top;
+        mInfo.frameRight = frame.right;
+        mInfo.frameBottom = frame.bottom;
+        mInfo.globalScaleFactor = 1.0;
+        mInfo.touchableRegion.clear();
+        mInfo.addTouchableRegion(frame);
+        mInfo.visible = true;
+        mInfo.canReceiveKeys = true;
+        mInfo.hasFocus = true;
+        mInfo.hasWallpaper = false;
+        mInfo.paused = false;
+        mInfo.layer = 0;
+        mInfo.ownerPid = INJECTOR_PID;
+        mInfo.ownerUid = INJECTOR_UID;
+        mInfo.inputFeatures = 0;
+        mInfo.displayId = ADISPLAY_ID_DEFAULT;
+        return true;
+    }
+};
+
+class ReplayApplicationHandle : public InputApplicationHandle {
+public:
+    virtual bool updateInfo() {
+        mInfo.name = "InputReplayApplication";
+        mInfo.dispatchingTimeout = RECEIVE_TIMEOUT;
+        return true;
+    }
+};
+
+
+// --- InputReplayPipeline ---
+
+std::atomic<uint64_t> InputReplayPipeline::sAllocationCount(0);
+
+InputReplayPipeline::InputReplayPipeline(const std::vector<RecordedEvdevEvent>& recording) :
+        mRecording(recording) {
+    mDispatcherPolicy = new DispatcherPolicy();
+    mDispatcher = new InputDispatcher(mDispatcherPolicy);
+    mDispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    mDispatcherThread = new InputDispatcherThread(mDispatcher);
+    mDispatcherThread->run("InputReplayDispatcher", PRIORITY_URGENT_DISPLAY);
+
+    // Same listener chain as InputManager, with a probe after the reader and the classifier.
+    mClassifierOutput = new StageListener(mDispatcher);
+    mClassifier = new InputClassifier(mClassifierOutput);
+    mReaderOutput = new StageListener(mClassifier);
+
+    InputChannel::openInputChannelPair("InputReplayWindow", mServerChannel, mClientChannel);
+    mServerChannel->setToken(new BBinder());
+    mDispatcher->registerInputChannel(mServerChannel, ADISPLAY_ID_DEFAULT);
+    mConsumer = new InputConsumer(mClientChannel);
+
+    mApplication = new ReplayApplicationHandle();
+    mWindow = new ReplayWindowHandle(mApplication, mServerChannel);
+    mDispatcher->setFocusedApplication(ADISPLAY_ID_DEFAULT, mApplication);
+    mDispatcher->setInputWindows({mWindow}, ADISPLAY_ID_DEFAULT);
+
+    mEventHub = new ReplayEventHub();
+    mEventHub->addDevices(mRecording, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    mReaderPolicy = new ReaderPolicy();
+    mReader = new InputReader(mEventHub, mReaderPolicy, mReaderOutput);
+    drainReader();
+}
+
+InputReplayPipeline::~InputReplayPipeline() {
+    mDispatcherThread->requestExit();
+    // Also wakes up the dispatcher thread so that it can exit.
+    mDispatcher->unregisterInputChannel(mServerChannel);
+    mDispatcherThread->requestExitAndWait();
+    delete mConsumer;
+}
+
+void InputReplayPipeline::drainReader() {
+    while (mEventHub->hasQueuedEvents()) {
+        mReader->loopOnce();
+    }
+    // Processes the configuration changes caused by the added devices.
+    mReader->loopOnce();
+}
+
+void InputReplayPipeline::replay(Stats* outStats) {
+    const size_t frames = mEventHub->queueRecording(mRecording);
+    mReaderOutput->setStats(&outStats->readerLatency);
+    mClassifierOutput->setStats(&outStats->classifierLatency);
+
+    timespec cpuStart;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+    const uint64_t allocationsStart = sAllocationCount.load(std::memory_order_relaxed);
+
+    while (mEventHub->hasQueuedEvents()) {
+        const size_t sentEvents = outStats->readerLatency.count();
+        mReader->loopOnce();
+        // A frame can produce no event, e.g. when it only changes the slot, or several, e.g. a
+        // pointer going down and the others moving.
+        if (!receiveEvents(outStats, outStats->readerLatency.count() - sentEvents)) {
+            ALOGE("Timed out waiting for the replayed events to be dispatched");
+            break;
+        }
+    }
+
+    timespec cpuEnd;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuEnd);
+    outStats->frames += frames;
+    outStats->cpuTime += (cpuEnd.tv_sec - cpuStart.tv_sec) * 1000000000LL
+            + (cpuEnd.tv_nsec - cpuStart.tv_nsec);
+    outStats->allocations += sAllocationCount.load(std::memory_order_relaxed)
+            - allocationsStart;
+
+    mReaderOutput->setStats(nullptr);
+    mClassifierOutput->setStats(nullptr);
+}
+
+bool InputReplayPipeline::receiveEvents(Stats* outStats, size_t count) {
+    const nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + RECEIVE_TIMEOUT;
+    while (count > 0) {
+        uint32_t seq;
+        InputEvent* event;
+        int motionEventType;
+        int touchMoveNumber;
+        bool flag;
+        status_t status = mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1,
+                &seq, &event, &motionEventType, &touchMoveNumber, &flag);
+        if (status == OK) {
+            const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+            nsecs_t eventTime = event->getType() == AINPUT_EVENT_TYPE_MOTION
+                    ? static_cast<MotionEvent*>(event)->getEventTime()
+                    : static_cast<KeyEvent*>(event)->getEventTime();
+            outStats->windowLatency.record(now - eventTime);
+            outStats->receivedEvents++;
+            mConsumer->sendFinishedSignal(seq, true /*handled*/);
+            count--;
+            continue;
+        }
+        if (status != WOULD_BLOCK) {
+            return false;
+        }
+
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (now >= deadline) {
+            return false;
+        }
+        pollfd fd = { mClientChannel->getFd(), POLLIN, 0 };
+        poll(&fd, 1, toMillisecondTimeoutDelay(now, deadline));
+    }
+    return true;
+}
+
+} // namespace android
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_REPLAY_H
+#define _UI_INPUT_REPLAY_H
+
+#include "EventHub.h"
+#include "GeteventRecording.h"
+#include "InputClassifier.h"
+#include "InputDispatcher.h"
+#include "InputListener.h"
+#include "InputReader.h"
+
+#include <input/InputTransport.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/*
+ * Replays evdev recordings through the real InputReader -> InputClassifier -> InputDispatcher
+ * pipeline and measures how long each event takes to get through it.
+ * Recordings are read by parseGeteventRecording().
+ *
+ * Every device of the recording that reports multi-touch positions is replayed as a
+ * touchscreen covering the whole display, and events of other devices are ignored.
+ */
+
+// --- ReplayEventHub ---
+
+/*
+ * An EventHub that returns the events of a recording, one evdev frame (the events up to and
+ * including a SYN_REPORT) per call to getEvents(), like the real EventHub does when the reader
+ * keeps up with the device. Events are stamped with the time they are returned so that
+ * latencies measure the pipeline only.
+ */
+class ReplayEventHub : public EventHubInterface {
+public:
+    ReplayEventHub();
+
+    // Adds the devices of the recording and queues their DEVICE_ADDED events.
+    void addDevices(const std::vector<RecordedEvdevEvent>& recording,
+            int32_t displayWidth, int32_t displayHeight);
+
+    // Queues the frames of the recording. Returns the number of frames queued.
+    size_t queueRecording(const std::vector<RecordedEvdevEvent>& recording);
+
+    bool hasQueuedEvents() const;
+
+protected:
+    virtual ~ReplayEventHub();
+
+public:
+    virtual uint32_t getDeviceClasses(int32_t deviceId) const;
+    virtual InputDeviceIdentifier getDeviceIdentifier(int32_t deviceId) const;
+    virtual int32_t getDeviceControllerNumber(int32_t deviceId) const;
+    virtual void getConfiguration(int32_t deviceId, PropertyMap* outConfiguration) const;
+    virtual status_t getAbsoluteAxisInfo(int32_t deviceId, int axis,
+            RawAbsoluteAxisInfo* outAxisInfo) const;
+    virtual bool hasRelativeAxis(int32_t deviceId, int axis) const;
+    virtual bool hasInputProperty(int32_t deviceId, int property) const;
+    virtual status_t mapKey(int32_t deviceId, int32_t scanCode, int32_t usageCode,
+            int32_t metaState, int32_t* outKeycode, int32_t *outMetaState,
+            uint32_t* outFlags) const;
+    virtual status_t mapAxis(int32_t deviceId, int32_t scanCode, AxisInfo* outAxisInfo) const;
+    virtual void setExcludedDevices(const std::vector<std::string>& devices);
+    virtual size_t getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSize);
+    virtual std::vector<TouchVideoFrame> getVideoFrames(int32_t deviceId);
+    virtual int32_t getScanCodeState(int32_t deviceId, int32_t scanCode) const;
+    virtual int32_t getKeyCodeState(int32_t deviceId, int32_t keyCode) const;
+    virtual int32_t getSwitchState(int32_t deviceId, int32_t sw) const;
+    virtual status_t getAbsoluteAxisValue(int32_t deviceId, int32_t axis,
+            int32_t* outValue) const;
+    virtual bool markSupportedKeyCodes(int32_t deviceId, size_t numCodes,
+            const int32_t* keyCodes, uint8_t* outFlags) const;
+    virtual bool hasScanCode(int32_t deviceId, int32_t scanCode) const;
+    virtual bool hasLed(int32_t deviceId, int32_t led) const;
+    virtual void setLedState(int32_t deviceId, int32_t led, bool on);
+    virtual void getVirtualKeyDefinitions(int32_t deviceId,
+            std::vector<VirtualKeyDefinition>& outVirtualKeys) const;
+    virtual sp<KeyCharacterMap> getKeyCharacterMap(int32_t deviceId) const;
+    virtual bool setKeyboardLayoutOverlay(int32_t deviceId, const sp<KeyCharacterMap>& map);
+    virtual void vibrate(int32_t deviceId, nsecs_t duration);
+    virtual void cancelVibrate(int32_t deviceId);
+    virtual void requestReopenDevices();
+    virtual void wake();
+    virtual void dump(std::string& dump);
+    virtual void monitor();
+    virtual bool isDeviceEnabled(int32_t deviceId);
+    virtual status_t enableDevice(int32_t deviceId);
+    virtual status_t disableDevice(int32_t deviceId);
+
+private:
+    struct Device {
+        InputDeviceIdentifier identifier;
+        PropertyMap configuration;
+        std::map<int, RawAbsoluteAxisInfo> absoluteAxes;
+        std::map<int32_t, int32_t> absoluteAxisValues;
+        bool enabled;
+    };
+
+    const Device* getDevice(int32_t deviceId) const;
+
+    mutable std::mutex mLock;
+    std::map<int32_t, Device> mDevices;
+    std::map<std::string, int32_t> mDeviceIdsByPath;
+    // Each frame is returned by a single call to getEvents().
+    std::vector<std::vector<RawEvent>> mFrames;
+    size_t mNextFrame;
+};
+
+
+// --- LatencyStats ---
+
+/* Records latency samples and reports their percentiles. */
+class LatencyStats {
+public:
+    void clear();
+    void record(nsecs_t latency);
+    size_t count() const { return mSamples.size(); }
+
+    // Returns the latency below which the given percentage of the samples fall.
+    nsecs_t percentile(double percentile);
+
+private:
+    std::vector<nsecs_t> mSamples;
+    bool mSorted = true;
+};
+
+
+// --- InputReplayPipeline ---
+
+/*
+ * The real input pipeline fed by a ReplayEventHub and dispatching to a single fake window
+ * covering the display.
+ *
+ * Latencies are measured from the time an evdev frame is returned by the event hub to the
+ * time the resulting event leaves the reader, leaves the classifier and is received by the
+ * window.
+ */
+class InputReplayPipeline {
+public:
+    struct Stats {
+        size_t frames = 0;
+        size_t receivedEvents = 0;
+        LatencyStats readerLatency;
+        LatencyStats classifierLatency;
+        LatencyStats windowLatency;
+        // Process CPU time (all threads) spent replaying the recording.
+        nsecs_t cpuTime = 0;
+        // Number of heap allocations made while replaying, as counted by the allocation
+        // counter, or 0 if the binary does not count allocations.
+        uint64_t allocations = 0;
+    };
+
+    static const int32_t DISPLAY_WIDTH = 1080;
+    static const int32_t DISPLAY_HEIGHT = 1920;
+
+    explicit InputReplayPipeline(const std::vector<RecordedEvdevEvent>& recording);
+    ~InputReplayPipeline();
+
+    // Replays the recording once and adds the measurements to outStats.
+    void replay(Stats* outStats);
+
+    /*
+     * Counts heap allocations. A benchmark binary that replaces operator new can increment
+     * this counter so that replay() reports allocations per event.
+     */
+    static std::atomic<uint64_t> sAllocationCount;
+
+private:
+    class StageListener;
+    class ReaderPolicy;
+    class DispatcherPolicy;
+    class ReplayWindowHandle;
+
+    void drainReader();
+    // Receives the given number of events in the window, or returns false on timeout.
+    bool receiveEvents(Stats* outStats, size_t count);
+
+    const std::vector<RecordedEvdevEvent> mRecording;
+    sp<ReplayEventHub> mEventHub;
+    sp<ReaderPolicy> mReaderPolicy;
+    sp<DispatcherPolicy> mDispatcherPolicy;
+    sp<InputDispatcher> mDispatcher;
+    sp<InputDispatcherThread> mDispatcherThread;
+    sp<StageListener> mClassifierOutput;
+    sp<InputClassifier> mClassifier;
+    sp<StageListener> mReaderOutput;
+    sp<InputReader> mReader;
+    sp<InputApplicationHandle> mApplication;
+    sp<ReplayWindowHandle> mWindow;
+    sp<InputChannel> mServerChannel;
+    sp<InputChannel> mClientChannel;
+    InputConsumer* mConsumer;
+    PreallocatedInputEventFactory mEventFactory;
+};
+
+} // namespace android
+
+#endif // _UI_INPUT_REPLAY_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "InputReplay.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+
+#include <log/log.h>
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+using android::base::StringAppendF;
+
+// Counts the heap allocations made by the whole pipeline, on all threads.
+void* operator new(size_t size) {
+    android::InputReplayPipeline::sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size);
+    LOG_ALWAYS_FATAL_IF(!ptr, "out of memory");
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace android {
+
+// Frames are reported every 8ms, like a 120Hz touchscreen.
+static constexpr nsecs_t FRAME_INTERVAL = 8 * 1000000;
+
+/*
+ * Generates a "getevent -lt" recording of the given number of fingers going down one after
+ * the other, swiping across the screen and lifting, using the multi-touch slot protocol.
+ */
+static std::string generateSwipeRecording(int32_t fingers, int32_t moves) {
+    std::string recording;
+    nsecs_t when = s2ns(1);
+    int32_t trackingId = 100;
+    auto addEvent = [&](const char* type, const char* code, int32_t value) {
+        StringAppendF(&recording,
+                "[%8" PRId64 ".%06" PRId64 "] /dev/input/event2: %-12s %-20s %08x\n",
+                when / 1000000000, (when % 1000000000) / 1000, type, code, value);
+    };
+    auto addPosition = [&](int32_t finger, int32_t step) {
+        addEvent("EV_ABS", "ABS_MT_SLOT", finger);
+        addEvent("EV_ABS", "ABS_MT_POSITION_X", 100 + 150 * finger + step * 4);
+        addEvent("EV_ABS", "ABS_MT_POSITION_Y", 300 + step * 10);
+        addEvent("EV_ABS", "ABS_MT_TOUCH_MAJOR", 10 + step % 3);
+        addEvent("EV_ABS", "ABS_MT_PRESSURE", 40 + step % 5);
+    };
+    auto endFrame = [&]() {
+        addEvent("EV_SYN", "SYN_REPORT", 0);
+        when += FRAME_INTERVAL;
+    };
+
+    for (int32_t finger = 0; finger < fingers; finger++) {
+        addEvent("EV_ABS", "ABS_MT_SLOT", finger);
+        addEvent("EV_ABS", "ABS_MT_TRACKING_ID", trackingId++);
+        addPosition(finger, 0);
+        if (finger == 0) {
+            addEvent("EV_KEY", "BTN_TOUCH", 1);
+        }
+        endFrame();
+    }
+    for (int32_t step = 1; step <= moves; step++) {
+        for (int32_t finger = 0; finger < fingers; finger++) {
+            addPosition(finger, step);
+        }
+        endFrame();
+    }
+    for (int32_t finger = fingers - 1; finger >= 0; finger--) {
+        addEvent("EV_ABS", "ABS_MT_SLOT", finger);
+        addEvent("EV_ABS", "ABS_MT_TRACKING_ID", -1);
+        if (finger == 0) {
+            addEvent("EV_KEY", "BTN_TOUCH", 0);
+        }
+        endFrame();
+    }
+    return recording;
+}
+
+static void reportStats(benchmark::State& state, InputReplayPipeline::Stats& stats) {
+    const double events = std::max(stats.receivedEvents, size_t(1));
+    const auto micros = [](nsecs_t latency) { return latency / 1000.0; };
+    state.counters["reader_p50_us"] = micros(stats.readerLatency.percentile(50));
+    state.counters["reader_p99_us"] = micros(stats.readerLatency.percentile(99));
+    state.counters["classifier_p50_us"] = micros(stats.classifierLatency.percentile(50));
+    state.counters["classifier_p99_us"] = micros(stats.classifierLatency.percentile(99));
+    state.counters["window_p50_us"] = micros(stats.windowLatency.percentile(50));
+    state.counters["window_p90_us"] = micros(stats.windowLatency.percentile(90));
+    state.counters["window_p99_us"] = micros(stats.windowLatency.percentile(99));
+    state.counters["cpu_us_per_event"] = micros(stats.cpuTime) / events;
+    state.counters["allocs_per_event"] = stats.allocations / events;
+    state.SetItemsProcessed(stats.receivedEvents);
+}
+
+static void replay(benchmark::State& state, const std::vector<RecordedEvdevEvent>& recording) {
+    InputReplayPipeline pipeline(recording);
+    InputReplayPipeline::Stats stats;
+    for (auto _ : state) {
+        pipeline.replay(&stats);
+    }
+    if (stats.receivedEvents == 0) {
+        state.SkipWithError("No events were dispatched to the window");
+        return;
+    }
+    reportStats(state, stats);
+}
+
+static void BM_InputReplay_Swipe(benchmark::State& state) {
+    std::vector<RecordedEvdevEvent> recording;
+    std::string error;
+    if (!parseGeteventRecording(generateSwipeRecording(state.range(0), 100), &recording,
+            &error)) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+    replay(state, recording);
+}
+BENCHMARK(BM_InputReplay_Swipe)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+
+/*
+ * Replays a recording captured on a device with "getevent -lt > recording.txt", given by the
+ * INPUT_REPLAY_RECORDING environment variable.
+ */
+static void BM_InputReplay_Recording(benchmark::State& state) {
+    const char* path = getenv("INPUT_REPLAY_RECORDING");
+    if (!path) {
+        state.SkipWithError("INPUT_REPLAY_RECORDING is not set");
+        return;
+    }
+    std::string text;
+    if (!android::base::ReadFileToString(path, &text)) {
+        state.SkipWithError("Could not read the recording");
+        return;
+    }
+    std::vector<RecordedEvdevEvent> recording;
+    std::string error;
+    if (!parseGeteventRecording(text, &recording, &error)) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+    replay(state, recording);
+}
+BENCHMARK(BM_InputReplay_Recording);
+
+} // namespace android
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "InputReader.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace android {
+
+static constexpr size_t TRACE_SAMPLES = 256;
+
+/*
+ * A synthetic multi-contact trace of a device that does not report tracking ids.
+ * The fingers start in a grid and each one moves with its own velocity plus some jitter,
+ * and the fingers are reported in a different order in each sample.
+ */
+struct PointerTrace {
+    std::vector<RawPointerData> samples;
+    // fingers[sample][pointerIndex] is the finger reported at that index.
+    std::vector<std::vector<uint32_t>> fingers;
+};
+
+static PointerTrace generatePointerTrace(uint32_t fingerCount, int32_t speed) {
+    std::mt19937 random(fingerCount);
+    std::uniform_int_distribution<int32_t> velocity(-speed, speed);
+    std::uniform_int_distribution<int32_t> jitter(-4, 4);
+
+    std::vector<int32_t> x(fingerCount), y(fingerCount), vx(fingerCount), vy(fingerCount);
+    std::vector<uint32_t> order(fingerCount);
+    for (uint32_t i = 0; i < fingerCount; i++) {
+        x[i] = 200 + 150 * (i % 4);
+        y[i] = 300 + 200 * (i / 4);
+        vx[i] = velocity(random);
+        vy[i] = velocity(random);
+        order[i] = i;
+    }
+
+    PointerTrace trace;
+    trace.samples.resize(TRACE_SAMPLES);
+    trace.fingers.resize(TRACE_SAMPLES);
+    for (size_t s = 0; s < TRACE_SAMPLES; s++) {
+        std::shuffle(order.begin(), order.end(), random);
+        RawPointerData& sample = trace.samples[s];
+        sample.clear();
+        sample.pointerCount = fingerCount;
+        for (uint32_t i = 0; i < fingerCount; i++) {
+            const uint32_t finger = order[i];
+            RawPointerData::Pointer& pointer = sample.pointers[i];
+            pointer.x = x[finger];
+            pointer.y = y[finger];
+            pointer.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+            pointer.isHovering = false;
+            trace.fingers[s].push_back(finger);
+            x[finger] += vx[finger] + jitter(random);
+            y[finger] += vy[finger] + jitter(random);
+        }
+    }
+    return trace;
+}
+
+/*
+ * Assigns ids over the whole trace and reports the number of times a finger was given a
+ * different id than in the previous sample. The fingers never lift, so every change is a
+ * swap made by the matcher.
+ */
+static void assignIdsOverTrace(benchmark::State& state, PointerIdAssignment assignment) {
+    const uint32_t fingerCount = state.range(0);
+    const PointerTrace trace = generatePointerTrace(fingerCount, state.range(1));
+
+    RawPointerData last, current;
+    // The ids assigned to each finger in each sample.
+    std::vector<uint32_t> ids(TRACE_SAMPLES * fingerCount);
+    size_t samples = 0;
+    for (auto _ : state) {
+        last.clear();
+        for (size_t s = 0; s < TRACE_SAMPLES; s++) {
+            current.copyFrom(trace.samples[s]);
+            assignPointerIds(assignment, last, &current);
+            for (uint32_t i = 0; i < fingerCount; i++) {
+                ids[s * fingerCount + trace.fingers[s][i]] = current.pointers[i].id;
+            }
+            last.copyFrom(current);
+        }
+        samples += TRACE_SAMPLES;
+    }
+
+    size_t idChanges = 0;
+    for (size_t i = fingerCount; i < ids.size(); i++) {
+        if (ids[i] != ids[i - fingerCount]) {
+            idChanges += 1;
+        }
+    }
+    state.counters["id_changes"] = idChanges;
+    state.SetItemsProcessed(samples);
+}
+
+static void BM_AssignPointerIds_Greedy(benchmark::State& state) {
+    assignIdsOverTrace(state, POINTER_ID_ASSIGNMENT_GREEDY);
+}
+
+static void BM_AssignPointerIds_Optimal(benchmark::State& state) {
+    assignIdsOverTrace(state, POINTER_ID_ASSIGNMENT_OPTIMAL);
+}
+
+// Arguments are the number of fingers and the maximum distance a finger moves per sample.
+static void pointerTraceArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t fingers : {int64_t(2), int64_t(5), int64_t(10), int64_t(MAX_POINTERS)}) {
+        for (int64_t speed : {20, 120}) {
+            b->Args({fingers, speed});
+        }
+    }
+}
+
+BENCHMARK(BM_AssignPointerIds_Greedy)->Apply(pointerTraceArgs);
+BENCHMARK(BM_AssignPointerIds_Optimal)->Apply(pointerTraceArgs);
+
+} // namespace android
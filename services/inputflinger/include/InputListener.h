@@ -17,6 +17,7 @@
 #ifndef _UI_INPUT_LISTENER_H
 #define _UI_INPUT_LISTENER_H
 
+#include <variant>
 #include <vector>
 
 #include <input/Input.h>
@@ -203,6 +204,9 @@ public:
 /*
  * An implementation of the listener interface that queues up and defers dispatch
  * of decoded events until flushed.
+ *
+ * Events are stored in place in a queue that keeps its capacity across flushes, so once the
+ * queue has grown to its working size, queueing an event copies it without allocating.
  */
 class QueuedInputListener : public InputListenerInterface {
 protected:
@@ -220,8 +224,11 @@ public:
     void flush();
 
 private:
+    using QueuedArgs = std::variant<NotifyConfigurationChangedArgs, NotifyKeyArgs,
+            NotifyMotionArgs, NotifySwitchArgs, NotifyDeviceResetArgs>;
+
     sp<InputListenerInterface> mInnerListener;
-    std::vector<NotifyArgs*> mArgsQueue;
+    std::vector<QueuedArgs> mArgsQueue;
 };
 
 } // namespace android
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GeteventRecording.h"
+
+#include <gtest/gtest.h>
+#include <linux/input.h>
+
+namespace android {
+
+// --- GeteventRecordingTest ---
+
+static std::vector<RecordedEvdevEvent> parse(const std::string& recording) {
+    std::vector<RecordedEvdevEvent> events;
+    std::string error;
+    EXPECT_TRUE(parseGeteventRecording(recording, &events, &error)) << error;
+    return events;
+}
+
+static std::string parseError(const std::string& recording) {
+    std::vector<RecordedEvdevEvent> events;
+    std::string error;
+    EXPECT_FALSE(parseGeteventRecording(recording, &events, &error));
+    return error;
+}
+
+TEST(GeteventRecordingTest, ParsesLabels) {
+    std::vector<RecordedEvdevEvent> events = parse(
+            "/dev/input/event2: EV_ABS       ABS_MT_TRACKING_ID   00000035\n"
+            "/dev/input/event2: EV_KEY       BTN_TOUCH            DOWN\n"
+            "/dev/input/event2: EV_SYN       SYN_REPORT           00000000\n");
+
+    ASSERT_EQ(3U, events.size());
+    ASSERT_EQ("/dev/input/event2", events[0].devicePath);
+    ASSERT_EQ(EV_ABS, events[0].type);
+    ASSERT_EQ(ABS_MT_TRACKING_ID, events[0].code);
+    ASSERT_EQ(0x35, events[0].value);
+    ASSERT_EQ(EV_KEY, events[1].type);
+    ASSERT_EQ(BTN_TOUCH, events[1].code);
+    ASSERT_EQ(1, events[1].value);
+    ASSERT_EQ(EV_SYN, events[2].type);
+    ASSERT_EQ(SYN_REPORT, events[2].code);
+    ASSERT_EQ(0, events[2].value);
+}
+
+TEST(GeteventRecordingTest, ParsesHexNumbers) {
+    // Plain "getevent" prints numbers instead of labels. The value is printed as 32 bits.
+    std::vector<RecordedEvdevEvent> events = parse(
+            "/dev/input/event2: 0003 0039 ffffffff\n"
+            "/dev/input/event2: 0001 014a 00000000\n");
+
+    ASSERT_EQ(2U, events.size());
+    ASSERT_EQ(EV_ABS, events[0].type);
+    ASSERT_EQ(ABS_MT_TRACKING_ID, events[0].code);
+    ASSERT_EQ(-1, events[0].value);
+    ASSERT_EQ(EV_KEY, events[1].type);
+    ASSERT_EQ(BTN_TOUCH, events[1].code);
+    ASSERT_EQ(0, events[1].value);
+}
+
+TEST(GeteventRecordingTest, ParsesTimestamps) {
+    std::vector<RecordedEvdevEvent> events = parse(
+            "[   51727.497891] /dev/input/event2: EV_ABS ABS_MT_POSITION_X 00000010\n"
+            "[51727.505891] /dev/input/event2: EV_SYN SYN_REPORT 00000000\n"
+            "/dev/input/event2: EV_SYN SYN_REPORT 00000000\n");
+
+    ASSERT_EQ(3U, events.size());
+    ASSERT_EQ(51727497891000LL, events[0].when);
+    ASSERT_EQ(51727505891000LL, events[1].when);
+    // Events without a timestamp are at time 0.
+    ASSERT_EQ(0, events[2].when);
+}
+
+TEST(GeteventRecordingTest, SkipsLinesThatAreNotEvents) {
+    std::vector<RecordedEvdevEvent> events = parse(
+            "add device 1: /dev/input/event2\n"
+            "  name:     \"touchscreen\"\n"
+            "\n"
+            "   \t\n"
+            "[   51727.497891]\n"
+            "could not get driver version for /dev/input/mouse0, Not a typewriter\n"
+            "/dev/input/event2: EV_SYN SYN_REPORT 00000000\r\n");
+
+    ASSERT_EQ(1U, events.size());
+    ASSERT_EQ(EV_SYN, events[0].type);
+}
+
+TEST(GeteventRecordingTest, KeepsTheDeviceOfEachEvent) {
+    std::vector<RecordedEvdevEvent> events = parse(
+            "[ 1.000000] /dev/input/event2: EV_ABS ABS_MT_POSITION_X 00000010\n"
+            "[ 1.000100] /dev/input/event5: EV_KEY KEY_VOLUMEUP DOWN\n"
+            "[ 1.000200] /dev/input/event2: EV_SYN SYN_REPORT 00000000\n"
+            "[ 1.000300] /dev/input/event5: EV_SYN SYN_REPORT 00000000\n");
+
+    ASSERT_EQ(4U, events.size());
+    ASSERT_EQ("/dev/input/event2", events[0].devicePath);
+    ASSERT_EQ("/dev/input/event5", events[1].devicePath);
+    ASSERT_EQ(KEY_VOLUMEUP, events[1].code);
+    ASSERT_EQ("/dev/input/event2", events[2].devicePath);
+    ASSERT_EQ("/dev/input/event5", events[3].devicePath);
+    ASSERT_EQ(1000300000LL, events[3].when);
+}
+
+TEST(GeteventRecordingTest, RejectsMalformedTimestamps) {
+    ASSERT_EQ("line 2: unterminated timestamp", parseError(
+            "/dev/input/event2: EV_SYN SYN_REPORT 00000000\n"
+            "[   51727.497891 /dev/input/event2: EV_SYN SYN_REPORT 00000000\n"));
+    ASSERT_EQ("line 1: invalid timestamp '[ abc]'",
+            parseError("[ abc] /dev/input/event2: EV_SYN SYN_REPORT 00000000\n"));
+    ASSERT_EQ("line 1: invalid timestamp '[ 1.5s]'",
+            parseError("[ 1.5s] /dev/input/event2: EV_SYN SYN_REPORT 00000000\n"));
+    ASSERT_EQ("line 1: invalid timestamp '[-1.0]'",
+            parseError("[-1.0] /dev/input/event2: EV_SYN SYN_REPORT 00000000\n"));
+}
+
+TEST(GeteventRecordingTest, RejectsMalformedEvents) {
+    ASSERT_EQ("line 1: expected type, code and value",
+            parseError("/dev/input/event2: EV_SYN SYN_REPORT\n"));
+    ASSERT_EQ("line 1: unknown event type 'EV_BOGUS'",
+            parseError("/dev/input/event2: EV_BOGUS SYN_REPORT 00000000\n"));
+    ASSERT_EQ("line 1: unknown event code 'ABS_BOGUS'",
+            parseError("/dev/input/event2: EV_ABS ABS_BOGUS 00000000\n"));
+    // Codes are only looked up among the labels of their type.
+    ASSERT_EQ("line 1: unknown event code 'SYN_REPORT'",
+            parseError("/dev/input/event2: EV_ABS SYN_REPORT 00000000\n"));
+    ASSERT_EQ("line 1: invalid event value 'DOWN'",
+            parseError("/dev/input/event2: EV_ABS ABS_MT_POSITION_X DOWN\n"));
+    ASSERT_EQ("line 1: invalid event value '100000000'",
+            parseError("/dev/input/event2: EV_ABS ABS_MT_POSITION_X 100000000\n"));
+    ASSERT_EQ("line 1: invalid event value '-1'",
+            parseError("/dev/input/event2: EV_ABS ABS_MT_POSITION_X -1\n"));
+}
+
+TEST(GeteventRecordingTest, ReportsTheLineOfTheFirstError) {
+    ASSERT_EQ("line 3: unknown event type 'EV_BOGUS'", parseError(
+            "add device 1: /dev/input/event2\n"
+            "/dev/input/event2: EV_SYN SYN_REPORT 00000000\n"
+            "/dev/input/event2: EV_BOGUS SYN_REPORT 00000000\n"
+            "/dev/input/event2: EV_BOGUS SYN_REPORT 00000000\n"));
+}
+
+} // namespace android
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InputListener.h"
+#include <gtest/gtest.h>
+
+#include "TestInputListener.h"
+
+namespace android {
+
+// --- QueuedInputListenerTest ---
+
+static NotifyMotionArgs generateMotionArgs(uint32_t sequenceNum, uint32_t pointerCount) {
+    PointerProperties properties[MAX_POINTERS];
+    PointerCoords coords[MAX_POINTERS];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        properties[i].clear();
+        properties[i].id = i;
+        properties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        coords[i].clear();
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 10 * i + sequenceNum);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 20 * i + sequenceNum);
+    }
+    return NotifyMotionArgs(sequenceNum, 100 + sequenceNum/*eventTime*/, 3/*deviceId*/,
+            AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT, 0/*policyFlags*/,
+            AMOTION_EVENT_ACTION_MOVE, 0/*actionButton*/, 0/*flags*/, AMETA_NONE,
+            0/*buttonState*/, MotionClassification::NONE, AMOTION_EVENT_EDGE_FLAG_NONE,
+            0/*deviceTimestamp*/, pointerCount, properties, coords, 0/*xPrecision*/,
+            0/*yPrecision*/, 100/*downTime*/, {}/*videoFrames*/);
+}
+
+class QueuedInputListenerTest : public testing::Test {
+protected:
+    sp<TestInputListener> mTestListener;
+    sp<QueuedInputListener> mQueuedListener;
+
+    virtual void SetUp() override {
+        mTestListener = new TestInputListener();
+        mQueuedListener = new QueuedInputListener(mTestListener);
+    }
+
+    virtual void TearDown() override {
+        mQueuedListener.clear();
+        mTestListener.clear();
+    }
+};
+
+TEST_F(QueuedInputListenerTest, EventsAreDeferredUntilFlush) {
+    NotifyKeyArgs keyArgs(1/*sequenceNum*/, 2/*eventTime*/, 3/*deviceId*/, AINPUT_SOURCE_KEYBOARD,
+            ADISPLAY_ID_DEFAULT, 0/*policyFlags*/, AKEY_EVENT_ACTION_DOWN, 0/*flags*/,
+            AKEYCODE_HOME, 5/*scanCode*/, AMETA_NONE, 2/*downTime*/);
+    NotifyMotionArgs motionArgs = generateMotionArgs(2, 3);
+
+    mQueuedListener->notifyKey(&keyArgs);
+    mQueuedListener->notifyMotion(&motionArgs);
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyKeyWasNotCalled());
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasNotCalled());
+
+    mQueuedListener->flush();
+    NotifyKeyArgs outKeyArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyKeyWasCalled(&outKeyArgs));
+    ASSERT_EQ(keyArgs, outKeyArgs);
+    NotifyMotionArgs outMotionArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasCalled(&outMotionArgs));
+    ASSERT_EQ(motionArgs, outMotionArgs);
+}
+
+TEST_F(QueuedInputListenerTest, AllEventTypesAreForwardedUnmodified) {
+    NotifyConfigurationChangedArgs configurationArgs(1/*sequenceNum*/, 2/*eventTime*/);
+    NotifySwitchArgs switchArgs(2/*sequenceNum*/, 3/*eventTime*/, 0/*policyFlags*/,
+            1/*switchValues*/, 1/*switchMask*/);
+    NotifyDeviceResetArgs resetArgs(3/*sequenceNum*/, 4/*eventTime*/, 5/*deviceId*/);
+
+    mQueuedListener->notifyConfigurationChanged(&configurationArgs);
+    mQueuedListener->notifySwitch(&switchArgs);
+    mQueuedListener->notifyDeviceReset(&resetArgs);
+    mQueuedListener->flush();
+
+    NotifyConfigurationChangedArgs outConfigurationArgs;
+    ASSERT_NO_FATAL_FAILURE(
+            mTestListener->assertNotifyConfigurationChangedWasCalled(&outConfigurationArgs));
+    ASSERT_EQ(configurationArgs, outConfigurationArgs);
+    NotifySwitchArgs outSwitchArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifySwitchWasCalled(&outSwitchArgs));
+    ASSERT_EQ(switchArgs, outSwitchArgs);
+    NotifyDeviceResetArgs outResetArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyDeviceResetWasCalled(&outResetArgs));
+    ASSERT_EQ(resetArgs, outResetArgs);
+}
+
+/**
+ * The queue is reused across flushes. Events queued after a flush must not be mixed up with
+ * the events of the previous batch.
+ */
+TEST_F(QueuedInputListenerTest, QueueIsReusedAcrossFlushes) {
+    for (uint32_t batch = 0; batch < 3; batch++) {
+        std::vector<NotifyMotionArgs> sent;
+        for (uint32_t i = 0; i < 5; i++) {
+            sent.push_back(generateMotionArgs(batch * 10 + i, i + 1));
+            mQueuedListener->notifyMotion(&sent.back());
+        }
+        mQueuedListener->flush();
+
+        for (const NotifyMotionArgs& args : sent) {
+            NotifyMotionArgs outArgs;
+            ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasCalled(&outArgs));
+            ASSERT_EQ(args, outArgs);
+        }
+        ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasNotCalled());
+    }
+}
+
+} // namespace android
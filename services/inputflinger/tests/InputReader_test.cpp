@@ -21,6 +21,9 @@
 #include <inttypes.h>
 #include <math.h>
 
+#include <algorithm>
+#include <random>
+
 
 namespace android {
 
@@ -3172,6 +3175,148 @@ TEST_F(CursorInputMapperTest, Process_ShouldHandleDisplayId) {
 }
 
 
+// --- PointerIdAssignmentTest ---
+
+class PointerIdAssignmentTest : public testing::Test {
+protected:
+    static void addPointer(RawPointerData* data, int32_t x, int32_t y,
+            int32_t toolType = AMOTION_EVENT_TOOL_TYPE_FINGER) {
+        RawPointerData::Pointer& pointer = data->pointers[data->pointerCount++];
+        memset(&pointer, 0, sizeof(pointer));
+        pointer.x = x;
+        pointer.y = y;
+        pointer.toolType = toolType;
+    }
+
+    // Assigns ids to the pointers of a sample that has no previous sample.
+    static void assignFirstIds(RawPointerData* data) {
+        RawPointerData none;
+        assignPointerIds(POINTER_ID_ASSIGNMENT_GREEDY, none, data);
+    }
+
+    /*
+     * Generates a trace of fingers in a row that swipe along the row, moving further than
+     * the distance between two fingers between two samples, and checks that each finger
+     * keeps its id. The fingers are reported in a different order in each sample.
+     */
+    static void assertIdsStableOverParallelSwipe(PointerIdAssignment assignment,
+            uint32_t fingerCount) {
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int32_t> jitter(-3, 3);
+        int32_t order[MAX_POINTERS];
+        for (uint32_t i = 0; i < fingerCount; i++) {
+            order[i] = i;
+        }
+
+        RawPointerData last;
+        uint32_t fingerIds[MAX_POINTERS];
+        for (int32_t step = 0; step < 100; step++) {
+            std::shuffle(order, order + fingerCount, random);
+            RawPointerData current;
+            for (uint32_t i = 0; i < fingerCount; i++) {
+                int32_t finger = order[i];
+                addPointer(&current, 100 + finger * 30 + step * 45 + jitter(random),
+                        300 + jitter(random));
+            }
+            assignPointerIds(assignment, last, &current);
+
+            for (uint32_t i = 0; i < fingerCount; i++) {
+                uint32_t id = current.pointers[i].id;
+                if (step == 0) {
+                    fingerIds[order[i]] = id;
+                } else {
+                    ASSERT_EQ(fingerIds[order[i]], id)
+                            << "finger " << order[i] << " changed id at step " << step;
+                }
+                ASSERT_EQ(i, current.idToIndex[id]);
+            }
+            last.copyFrom(current);
+        }
+    }
+};
+
+TEST_F(PointerIdAssignmentTest, Greedy_MatchesClosestPointersFirst) {
+    RawPointerData last;
+    addPointer(&last, 0, 0);
+    addPointer(&last, 100, 0);
+    assignFirstIds(&last);
+
+    // Both pointers moved right by more than half of the distance between them.
+    RawPointerData current;
+    addPointer(&current, 60, 0);
+    addPointer(&current, 170, 0);
+    assignPointerIds(POINTER_ID_ASSIGNMENT_GREEDY, last, &current);
+
+    ASSERT_EQ(uint32_t(1), current.pointers[0].id);
+    ASSERT_EQ(uint32_t(0), current.pointers[1].id);
+}
+
+TEST_F(PointerIdAssignmentTest, Optimal_MinimizesTotalDistance) {
+    RawPointerData last;
+    addPointer(&last, 0, 0);
+    addPointer(&last, 100, 0);
+    assignFirstIds(&last);
+
+    RawPointerData current;
+    addPointer(&current, 60, 0);
+    addPointer(&current, 170, 0);
+    assignPointerIds(POINTER_ID_ASSIGNMENT_OPTIMAL, last, &current);
+
+    ASSERT_EQ(uint32_t(0), current.pointers[0].id);
+    ASSERT_EQ(uint32_t(1), current.pointers[1].id);
+    ASSERT_EQ(uint32_t(0), current.idToIndex[0]);
+    ASSERT_EQ(uint32_t(1), current.idToIndex[1]);
+}
+
+TEST_F(PointerIdAssignmentTest, Optimal_OnlyMatchesPointersWithSameToolType) {
+    RawPointerData last;
+    addPointer(&last, 0, 0, AMOTION_EVENT_TOOL_TYPE_STYLUS);
+    addPointer(&last, 10, 0);
+    assignFirstIds(&last);
+
+    // The stylus is lifted and the finger moves to where it was.
+    RawPointerData current;
+    addPointer(&current, 0, 0);
+    assignPointerIds(POINTER_ID_ASSIGNMENT_OPTIMAL, last, &current);
+
+    ASSERT_EQ(uint32_t(1), current.pointers[0].id);
+}
+
+TEST_F(PointerIdAssignmentTest, Optimal_AssignsUnusedIdsToNewPointers) {
+    RawPointerData first;
+    addPointer(&first, 0, 0);
+    addPointer(&first, 100, 0);
+    addPointer(&first, 200, 0);
+    assignFirstIds(&first);
+
+    // The middle pointer is lifted.
+    RawPointerData last;
+    addPointer(&last, 0, 0);
+    addPointer(&last, 200, 0);
+    assignPointerIds(POINTER_ID_ASSIGNMENT_OPTIMAL, first, &last);
+    ASSERT_EQ(uint32_t(0), last.pointers[0].id);
+    ASSERT_EQ(uint32_t(2), last.pointers[1].id);
+
+    // A new pointer goes down and takes the smallest unused id.
+    RawPointerData current;
+    addPointer(&current, 500, 500);
+    addPointer(&current, 5, 0);
+    addPointer(&current, 205, 0);
+    assignPointerIds(POINTER_ID_ASSIGNMENT_OPTIMAL, last, &current);
+    ASSERT_EQ(uint32_t(1), current.pointers[0].id);
+    ASSERT_EQ(uint32_t(0), current.pointers[1].id);
+    ASSERT_EQ(uint32_t(2), current.pointers[2].id);
+}
+
+TEST_F(PointerIdAssignmentTest, Optimal_KeepsIdsOverParallelSwipe) {
+    for (uint32_t fingerCount : {2, 5, 10, MAX_POINTERS}) {
+        SCOPED_TRACE(fingerCount);
+        ASSERT_NO_FATAL_FAILURE(
+                assertIdsStableOverParallelSwipe(POINTER_ID_ASSIGNMENT_OPTIMAL, fingerCount));
+    }
+}
+
+
 // --- TouchInputMapperTest ---
 
 class TouchInputMapperTest : public InputMapperTest {
@@ -5094,6 +5239,50 @@ TEST_F(MultiTouchInputMapperTest, Process_NormalMultiTouchGesture_WithoutTrackin
     ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasNotCalled());
 }
 
+TEST_F(MultiTouchInputMapperTest, Process_WithoutTrackingIds_OptimalPointerIdAssignment) {
+    MultiTouchInputMapper* mapper = new MultiTouchInputMapper(mDevice);
+    addConfigurationProperty("touch.deviceType", "touchScreen");
+    addConfigurationProperty("touch.pointerIdAssignment", "optimal");
+    prepareDisplay(DISPLAY_ORIENTATION_0);
+    prepareAxes(POSITION);
+    addMapperAndConfigure(mapper);
+
+    NotifyMotionArgs motionArgs;
+
+    // Two fingers down at once.
+    int32_t x1 = 100, y1 = 200, x2 = 200, y2 = 200;
+    processPosition(mapper, x1, y1);
+    processMTSync(mapper);
+    processPosition(mapper, x2, y2);
+    processMTSync(mapper);
+    processSync(mapper);
+
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&motionArgs));
+    ASSERT_EQ(AMOTION_EVENT_ACTION_DOWN, motionArgs.action);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&motionArgs));
+    ASSERT_EQ(AMOTION_EVENT_ACTION_POINTER_DOWN | (1 << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT),
+            motionArgs.action);
+
+    // Both fingers move right by more than half of the distance between them. The
+    // greedy assignment would swap their ids.
+    x1 += 60; x2 += 70;
+    processPosition(mapper, x1, y1);
+    processMTSync(mapper);
+    processPosition(mapper, x2, y2);
+    processMTSync(mapper);
+    processSync(mapper);
+
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&motionArgs));
+    ASSERT_EQ(AMOTION_EVENT_ACTION_MOVE, motionArgs.action);
+    ASSERT_EQ(size_t(2), motionArgs.pointerCount);
+    ASSERT_EQ(0, motionArgs.pointerProperties[0].id);
+    ASSERT_EQ(1, motionArgs.pointerProperties[1].id);
+    ASSERT_NO_FATAL_FAILURE(assertPointerCoords(motionArgs.pointerCoords[0],
+            toDisplayX(x1), toDisplayY(y1), 1, 0, 0, 0, 0, 0, 0, 0));
+    ASSERT_NO_FATAL_FAILURE(assertPointerCoords(motionArgs.pointerCoords[1],
+            toDisplayX(x2), toDisplayY(y2), 1, 0, 0, 0, 0, 0, 0, 0));
+}
+
 TEST_F(MultiTouchInputMapperTest, Process_NormalMultiTouchGesture_WithTrackingIds) {
     MultiTouchInputMapper* mapper = new MultiTouchInputMapper(mDevice);
     addConfigurationProperty("touch.deviceType", "touchScreen");
@@ -5651,6 +5840,40 @@ TEST_F(MultiTouchInputMapperTest, Process_PressureAxis_AmplitudeCalibration) {
             x, y, pressure, 0, 0, 0, 0, 0, 0, 0));
 }
 
+TEST_F(MultiTouchInputMapperTest, Process_CoverageBox_WhenOrientationAware_RotatesBox) {
+    MultiTouchInputMapper* mapper = new MultiTouchInputMapper(mDevice);
+    addConfigurationProperty("touch.deviceType", "touchScreen");
+    prepareDisplay(DISPLAY_ORIENTATION_90);
+    prepareAxes(POSITION | TOOL | MINOR);
+    addConfigurationProperty("touch.coverage.calibration", "box");
+    addMapperAndConfigure(mapper);
+
+    // The box is reported as (top << 16 | bottom) in the tool major axis and
+    // (left << 16 | right) in the tool minor axis.
+    int32_t rawLeft = RAW_X_MAX - toRawX(90) + RAW_X_MIN;
+    int32_t rawRight = RAW_X_MAX - toRawX(70) + RAW_X_MIN;
+    int32_t rawTop = toRawY(40);
+    int32_t rawBottom = toRawY(60);
+
+    processPosition(mapper, RAW_X_MAX - toRawX(80) + RAW_X_MIN, toRawY(50));
+    processToolMajor(mapper, rawTop << 16 | rawBottom);
+    processToolMinor(mapper, rawLeft << 16 | rawRight);
+    processMTSync(mapper);
+    processSync(mapper);
+
+    NotifyMotionArgs args;
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&args));
+    const PointerCoords& coords = args.pointerCoords[0];
+    ASSERT_NEAR(50, coords.getAxisValue(AMOTION_EVENT_AXIS_X), 1);
+    ASSERT_NEAR(80, coords.getAxisValue(AMOTION_EVENT_AXIS_Y), 1);
+    ASSERT_NEAR(40, coords.getAxisValue(AMOTION_EVENT_AXIS_GENERIC_1), 1); // left
+    ASSERT_NEAR(70, coords.getAxisValue(AMOTION_EVENT_AXIS_GENERIC_2), 1); // top
+    ASSERT_NEAR(60, coords.getAxisValue(AMOTION_EVENT_AXIS_GENERIC_3), 1); // right
+    ASSERT_NEAR(90, coords.getAxisValue(AMOTION_EVENT_AXIS_GENERIC_4), 1); // bottom
+    ASSERT_EQ(0, coords.getAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR));
+    ASSERT_EQ(0, coords.getAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR));
+}
+
 TEST_F(MultiTouchInputMapperTest, Process_ShouldHandleAllButtons) {
     MultiTouchInputMapper* mapper = new MultiTouchInputMapper(mDevice);
     addConfigurationProperty("touch.deviceType", "touchScreen");
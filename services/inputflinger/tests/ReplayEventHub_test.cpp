@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InputReplay.h"
+
+#include <gtest/gtest.h>
+#include <linux/input.h>
+
+namespace android {
+
+static const int32_t DISPLAY_WIDTH = 1080;
+static const int32_t DISPLAY_HEIGHT = 1920;
+
+// --- ReplayEventHubTest ---
+
+class ReplayEventHubTest : public testing::Test {
+protected:
+    sp<ReplayEventHub> mEventHub;
+
+    virtual void SetUp() override {
+        mEventHub = new ReplayEventHub();
+    }
+
+    virtual void TearDown() override {
+        mEventHub.clear();
+    }
+
+    void addDevices(const std::string& text, std::vector<RecordedEvdevEvent>* outRecording) {
+        std::string error;
+        ASSERT_TRUE(parseGeteventRecording(text, outRecording, &error)) << error;
+        mEventHub->addDevices(*outRecording, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    }
+
+    std::vector<RawEvent> getEvents(size_t bufferSize = 16) {
+        std::vector<RawEvent> events(bufferSize);
+        events.resize(mEventHub->getEvents(0, events.data(), bufferSize));
+        return events;
+    }
+
+    static void assertRawEvent(const RawEvent& event, int32_t deviceId, int32_t type,
+            int32_t code, int32_t value) {
+        ASSERT_EQ(deviceId, event.deviceId);
+        ASSERT_EQ(type, event.type);
+        ASSERT_EQ(code, event.code);
+        ASSERT_EQ(value, event.value);
+    }
+};
+
+// A touchscreen at event3, buttons at event5 and a second touchscreen at event2.
+static const char* MULTI_DEVICE_RECORDING =
+        "[ 1.000000] /dev/input/event3: EV_ABS ABS_MT_TRACKING_ID 00000001\n"
+        "[ 1.000000] /dev/input/event3: EV_ABS ABS_MT_POSITION_X 00000010\n"
+        "[ 1.000000] /dev/input/event3: EV_ABS ABS_MT_POSITION_Y 00000020\n"
+        "[ 1.000000] /dev/input/event3: EV_SYN SYN_REPORT 00000000\n"
+        "[ 1.001000] /dev/input/event5: EV_KEY KEY_VOLUMEUP DOWN\n"
+        "[ 1.001000] /dev/input/event5: EV_SYN SYN_REPORT 00000000\n"
+        "[ 1.002000] /dev/input/event2: EV_ABS ABS_MT_TRACKING_ID 00000002\n"
+        "[ 1.002000] /dev/input/event2: EV_ABS ABS_MT_POSITION_X 00000fff\n"
+        "[ 1.002000] /dev/input/event2: EV_ABS ABS_MT_POSITION_Y 00000030\n"
+        "[ 1.002000] /dev/input/event2: EV_ABS ABS_MT_PRESSURE 00000010\n"
+        "[ 1.002000] /dev/input/event2: EV_SYN SYN_REPORT 00000000\n"
+        "[ 1.008000] /dev/input/event3: EV_ABS ABS_MT_TRACKING_ID ffffffff\n"
+        "[ 1.008000] /dev/input/event3: EV_SYN SYN_REPORT 00000000\n"
+        "[ 1.010000] /dev/input/event2: EV_ABS ABS_MT_POSITION_X 00000011\n";
+
+TEST_F(ReplayEventHubTest, AddDevices_AddsTouchscreensInTheOrderTheyAppear) {
+    std::vector<RecordedEvdevEvent> recording;
+    ASSERT_NO_FATAL_FAILURE(addDevices(MULTI_DEVICE_RECORDING, &recording));
+
+    std::vector<RawEvent> events = getEvents();
+    ASSERT_EQ(3U, events.size());
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[0], 1, EventHubInterface::DEVICE_ADDED, 0, 0));
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[1], 2, EventHubInterface::DEVICE_ADDED, 0, 0));
+    ASSERT_EQ(EventHubInterface::FINISHED_DEVICE_SCAN, events[2].type);
+
+    ASSERT_EQ("/dev/input/event3", mEventHub->getDeviceIdentifier(1).location);
+    ASSERT_EQ("/dev/input/event2", mEventHub->getDeviceIdentifier(2).location);
+    ASSERT_EQ(uint32_t(INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT),
+            mEventHub->getDeviceClasses(1));
+    // The buttons do not report positions, so they are not replayed.
+    ASSERT_EQ(0U, mEventHub->getDeviceClasses(3));
+    ASSERT_FALSE(mEventHub->hasQueuedEvents());
+}
+
+TEST_F(ReplayEventHubTest, AddDevices_DerivesAxisRangesFromTheRecording) {
+    std::vector<RecordedEvdevEvent> recording;
+    ASSERT_NO_FATAL_FAILURE(addDevices(MULTI_DEVICE_RECORDING, &recording));
+
+    RawAbsoluteAxisInfo info;
+    // Ranges cover at least the display, and every value recorded.
+    ASSERT_EQ(OK, mEventHub->getAbsoluteAxisInfo(2, ABS_MT_POSITION_X, &info));
+    ASSERT_TRUE(info.valid);
+    ASSERT_EQ(0xfff, info.maxValue);
+    ASSERT_EQ(OK, mEventHub->getAbsoluteAxisInfo(2, ABS_MT_POSITION_Y, &info));
+    ASSERT_EQ(DISPLAY_HEIGHT - 1, info.maxValue);
+    ASSERT_EQ(OK, mEventHub->getAbsoluteAxisInfo(2, ABS_MT_PRESSURE, &info));
+    ASSERT_EQ(255, info.maxValue);
+    ASSERT_EQ(OK, mEventHub->getAbsoluteAxisInfo(1, ABS_MT_TRACKING_ID, &info));
+    ASSERT_EQ(65535, info.maxValue);
+
+    // Axes that are not in the recording of the device are not reported.
+    ASSERT_NE(OK, mEventHub->getAbsoluteAxisInfo(1, ABS_MT_PRESSURE, &info));
+    ASSERT_FALSE(info.valid);
+    ASSERT_NE(OK, mEventHub->getAbsoluteAxisInfo(3, ABS_MT_POSITION_X, &info));
+}
+
+TEST_F(ReplayEventHubTest, QueueRecording_ReturnsOneFramePerCall) {
+    std::vector<RecordedEvdevEvent> recording;
+    ASSERT_NO_FATAL_FAILURE(addDevices(MULTI_DEVICE_RECORDING, &recording));
+    getEvents();
+
+    // The frame of the buttons is ignored, and so is the last event, as its frame is not
+    // complete.
+    ASSERT_EQ(3U, mEventHub->queueRecording(recording));
+    ASSERT_TRUE(mEventHub->hasQueuedEvents());
+
+    std::vector<RawEvent> events = getEvents();
+    ASSERT_EQ(4U, events.size());
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[0], 1, EV_ABS, ABS_MT_TRACKING_ID, 1));
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[3], 1, EV_SYN, SYN_REPORT, 0));
+    // Events are stamped when they are returned, not with their recorded time.
+    ASSERT_NE(s2ns(1), events[0].when);
+    ASSERT_EQ(events[0].when, events[3].when);
+
+    events = getEvents();
+    ASSERT_EQ(5U, events.size());
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[3], 2, EV_ABS, ABS_MT_PRESSURE, 0x10));
+
+    events = getEvents();
+    ASSERT_EQ(2U, events.size());
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[0], 1, EV_ABS, ABS_MT_TRACKING_ID, -1));
+
+    ASSERT_FALSE(mEventHub->hasQueuedEvents());
+    ASSERT_EQ(0U, getEvents().size());
+}
+
+TEST_F(ReplayEventHubTest, GetEvents_SplitsFramesLargerThanTheBuffer) {
+    std::vector<RecordedEvdevEvent> recording;
+    ASSERT_NO_FATAL_FAILURE(addDevices(MULTI_DEVICE_RECORDING, &recording));
+    getEvents();
+    mEventHub->queueRecording(recording);
+
+    std::vector<RawEvent> events = getEvents(3);
+    ASSERT_EQ(3U, events.size());
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[2], 1, EV_ABS, ABS_MT_POSITION_Y, 0x20));
+    events = getEvents(3);
+    ASSERT_EQ(1U, events.size());
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[0], 1, EV_SYN, SYN_REPORT, 0));
+    events = getEvents(3);
+    ASSERT_EQ(3U, events.size());
+    ASSERT_NO_FATAL_FAILURE(assertRawEvent(events[0], 2, EV_ABS, ABS_MT_TRACKING_ID, 2));
+}
+
+} // namespace android
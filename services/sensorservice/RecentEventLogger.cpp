@@ -20,6 +20,7 @@
 #include <utils/Timers.h>
 
 #include <inttypes.h>
+#include <string.h>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -30,50 +31,123 @@ namespace {
     constexpr size_t LOG_SIZE_LARGE = 50;  // larger samples for debugging
 }// unnamed namespace
 
-RecentEventLogger::RecentEventLogger(int sensorType) :
+RecentEventLogger::RecentEventLogger(int sensorType, bool keepLastEvent) :
         mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
-        mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false),
+        mPayloadSize(payloadSizeBySensorType(sensorType)),
+        mCapacity(logSizeBySensorType(sensorType)), mEventCount(0),
+        mSequences(new std::atomic<uint64_t>[mCapacity]),
+        mTimestamps(new std::atomic<int64_t>[mCapacity]),
+        mWallTimes(new std::atomic<int64_t>[mCapacity]),
+        mPayloads(new std::atomic<uint32_t>[mCapacity * mPayloadSize]),
+        mKeepLastEvent(keepLastEvent), mLastEventSequence(0), mMaskData(false),
         mIsLastEventCurrent(false) {
-    // blank
+    for (size_t i = 0; i < mCapacity; ++i) {
+        mSequences[i].store(0, std::memory_order_relaxed);
+    }
 }
 
 void RecentEventLogger::addEvent(const sensors_event_t& event) {
-    std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
-    mIsLastEventCurrent = true;
+    const uint64_t index = mEventCount.load(std::memory_order_relaxed);
+    const size_t entry = index % mCapacity;
+
+    timespec wallTime;
+    clock_gettime(CLOCK_REALTIME, &wallTime);
+
+    uint32_t payload[16];
+    static_assert(sizeof(payload) == sizeof(event.data), "unexpected sensor event data size");
+    memcpy(payload, event.data, mPayloadSize * sizeof(uint32_t));
+
+    mSequences[entry].store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mTimestamps[entry].store(event.timestamp, std::memory_order_relaxed);
+    mWallTimes[entry].store(seconds_to_nanoseconds(wallTime.tv_sec) + wallTime.tv_nsec,
+            std::memory_order_relaxed);
+    for (size_t k = 0; k < mPayloadSize; ++k) {
+        mPayloads[entry * mPayloadSize + k].store(payload[k], std::memory_order_relaxed);
+    }
+    mSequences[entry].store(2 * index + 2, std::memory_order_release);
+    mEventCount.store(index + 1, std::memory_order_release);
+
+    if (mKeepLastEvent) {
+        uint32_t words[EVENT_WORDS];
+        memcpy(words, &event, sizeof(words));
+
+        const uint64_t sequence = mLastEventSequence.load(std::memory_order_relaxed);
+        mLastEventSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t k = 0; k < EVENT_WORDS; ++k) {
+            mLastEvent[k].store(words[k], std::memory_order_relaxed);
+        }
+        mLastEventSequence.store(sequence + 2, std::memory_order_release);
+    }
+    mIsLastEventCurrent.store(true, std::memory_order_release);
 }
 
 bool RecentEventLogger::isEmpty() const {
-    return mRecentEvents.size() == 0;
+    return mEventCount.load(std::memory_order_acquire) == 0;
 }
 
 void RecentEventLogger::setLastEventStale() {
-    std::lock_guard<std::mutex> lk(mLock);
-    mIsLastEventCurrent = false;
+    mIsLastEventCurrent.store(false, std::memory_order_release);
 }
 
 std::string RecentEventLogger::dump() const {
-    std::lock_guard<std::mutex> lk(mLock);
+    struct Entry {
+        int64_t timestamp;
+        int64_t wallTime;
+        uint32_t payload[16];
+    };
+
+    // Take a consistent copy of the logged events first, newest first, then format it.
+    const uint64_t count = mEventCount.load(std::memory_order_acquire);
+    const uint64_t first = count > mCapacity ? count - mCapacity : 0;
+    std::unique_ptr<Entry[]> entries(new Entry[count - first]);
+    size_t numEntries = 0;
+    for (uint64_t index = count; index-- > first;) {
+        const size_t entry = index % mCapacity;
+        Entry& copy = entries[numEntries];
+
+        const uint64_t sequence = mSequences[entry].load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) {
+            // Being overwritten by a newer event.
+            continue;
+        }
+        copy.timestamp = mTimestamps[entry].load(std::memory_order_relaxed);
+        copy.wallTime = mWallTimes[entry].load(std::memory_order_relaxed);
+        for (size_t k = 0; k < mPayloadSize; ++k) {
+            copy.payload[k] = mPayloads[entry * mPayloadSize + k].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mSequences[entry].load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        numEntries++;
+    }
 
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
-    int j = 0;
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
-        struct tm * timeinfo = localtime(&(ev.mWallTime.tv_sec));
-        buffer.appendFormat("\t%2d (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
-                ++j, ev.mEvent.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
-                (int) ns2ms(ev.mWallTime.tv_nsec));
+    const bool maskData = mMaskData.load(std::memory_order_relaxed);
+    buffer.appendFormat("last %zu events\n", numEntries);
+    for (size_t i = 0; i < numEntries; ++i) {
+        const Entry& ev = entries[i];
+        const time_t wallTimeSec = static_cast<time_t>(ev.wallTime / 1000000000);
+        struct tm * timeinfo = localtime(&wallTimeSec);
+        buffer.appendFormat("\t%2zu (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
+                i + 1, ev.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+                (int) ns2ms(ev.wallTime % 1000000000));
 
         // data
-        if (!mMaskData) {
+        if (!maskData) {
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                buffer.appendFormat("%" PRIu64 ", ", ev.mEvent.u64.step_counter);
+                uint64_t stepCounter;
+                memcpy(&stepCounter, ev.payload, sizeof(stepCounter));
+                buffer.appendFormat("%" PRIu64 ", ", stepCounter);
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    buffer.appendFormat("%.2f, ", ev.mEvent.data[k]);
+                    float value;
+                    memcpy(&value, &ev.payload[k], sizeof(value));
+                    buffer.appendFormat("%.2f, ", value);
                 }
             }
         } else {
@@ -93,15 +167,28 @@ void RecentEventLogger::setFormat(std::string format) {
 }
 
 bool RecentEventLogger::populateLastEventIfCurrent(sensors_event_t *event) const {
-    std::lock_guard<std::mutex> lk(mLock);
-
-    if (mIsLastEventCurrent && mRecentEvents.size()) {
-        // Index 0 contains the latest event emplace()'ed
-        *event = mRecentEvents[0].mEvent;
-        return true;
-    } else {
+    if (!mKeepLastEvent || !mIsLastEventCurrent.load(std::memory_order_acquire) ||
+            isEmpty()) {
         return false;
     }
+
+    // The writer only holds the sequence odd for the duration of a short copy, so retry until
+    // a consistent event is read.
+    uint32_t words[EVENT_WORDS];
+    uint64_t sequence;
+    do {
+        sequence = mLastEventSequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+        for (size_t k = 0; k < EVENT_WORDS; ++k) {
+            words[k] = mLastEvent[k].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || mLastEventSequence.load(std::memory_order_relaxed) != sequence);
+
+    memcpy(event, words, sizeof(words));
+    return true;
 }
 
 
@@ -118,8 +205,12 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
     return LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
+size_t RecentEventLogger::payloadSizeBySensorType(int sensorType) {
+    // The step counter is a 64-bit value, everything else is dumped as floats.
+    if (sensorType == SENSOR_TYPE_STEP_COUNTER) {
+        return sizeof(uint64_t) / sizeof(uint32_t);
+    }
+    return eventSizeBySensorType(sensorType);
 }
 
 } // namespace SensorServiceUtil
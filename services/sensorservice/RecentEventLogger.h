@@ -17,13 +17,13 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 #define ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 
-#include "RingBuffer.h"
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
-#include <mutex>
+#include <atomic>
+#include <memory>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -33,9 +33,16 @@ namespace SensorServiceUtil {
 // generated from the sensor are stored in this buffer.  The buffer is NOT cleared when the sensor
 // unregisters and as a result very old data in the dumpsys output can be seen, which is an intended
 // behavior.
+//
+// addEvent() is called for every event of every sensor, so it is lock-free and only stores the
+// timestamps and the sensor-type-specific part of the event data. Events are published with a
+// per-entry sequence number, and readers skip entries that are overwritten while being read.
+// addEvent() must only be called from one thread at a time.
 class RecentEventLogger : public Dumpable {
 public:
-    explicit RecentEventLogger(int sensorType);
+    // If keepLastEvent is true, the full last event is kept for populateLastEventIfCurrent(),
+    // which is only needed for on-change sensors.
+    explicit RecentEventLogger(int sensorType, bool keepLastEvent = true);
     void addEvent(const sensors_event_t& event);
 
     // Populate event with the last recorded sensor event if it is not stale. An event is
@@ -51,23 +58,34 @@ public:
     virtual void setFormat(std::string format) override;
 
 protected:
-    struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
-        timespec mWallTime;
-        sensors_event_t mEvent;
-    };
-
     const int mSensorType;
     const size_t mEventSize;
 
-    mutable std::mutex mLock;
-    RingBuffer<SensorEventLog> mRecentEvents;
-
-    bool mMaskData;
-    bool mIsLastEventCurrent;
+    // Number of 32-bit words of event data logged per event.
+    const size_t mPayloadSize;
+    const size_t mCapacity;
+    // Total number of events ever added. Event i is stored in entry i % mCapacity.
+    std::atomic<uint64_t> mEventCount;
+    // Per-entry sequence number, 2 * i + 1 while event i is written and 2 * i + 2 once complete.
+    std::unique_ptr<std::atomic<uint64_t>[]> mSequences;
+    std::unique_ptr<std::atomic<int64_t>[]> mTimestamps;
+    std::unique_ptr<std::atomic<int64_t>[]> mWallTimes;
+    std::unique_ptr<std::atomic<uint32_t>[]> mPayloads;
+
+    static constexpr size_t EVENT_WORDS = sizeof(sensors_event_t) / sizeof(uint32_t);
+    static_assert(sizeof(sensors_event_t) % sizeof(uint32_t) == 0,
+                  "sensors_event_t is not a whole number of words");
+    const bool mKeepLastEvent;
+    // Odd while the last event is being written.
+    std::atomic<uint64_t> mLastEventSequence;
+    std::atomic<uint32_t> mLastEvent[EVENT_WORDS];
+
+    std::atomic<bool> mMaskData;
+    std::atomic<bool> mIsLastEventCurrent;
 
 private:
     static size_t logSizeBySensorType(int sensorType);
+    static size_t payloadSizeBySensorType(int sensorType);
 };
 
 } // namespace SensorServiceUtil
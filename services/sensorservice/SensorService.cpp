@@ -311,7 +311,10 @@ const Sensor& SensorService::registerSensor(SensorInterface* s, bool isDebug, bo
     int handle = s->getSensor().getHandle();
     int type = s->getSensor().getType();
     if (mSensors.add(handle, s, isDebug, isVirtual)){
-        mRecentEvent.emplace(handle, new SensorServiceUtil::RecentEventLogger(type));
+        // Only on-change sensors replay their last event to new connections.
+        bool keepLastEvent = s->getSensor().getReportingMode() == AREPORTING_MODE_ON_CHANGE;
+        mRecentEvent.emplace(handle,
+                new SensorServiceUtil::RecentEventLogger(type, keepLastEvent));
         return s->getSensor();
     } else {
         return mSensors.getNonSensor();
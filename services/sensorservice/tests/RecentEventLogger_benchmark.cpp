@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RecentEventLogger.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using android::SensorServiceUtil::RecentEventLogger;
+
+namespace {
+
+// Simulates the poll loop of SensorService logging events for 20 active sensors, each reporting
+// at 1 kHz. One iteration logs one millisecond worth of events.
+constexpr size_t kNumSensors = 20;
+
+const int kSensorTypes[] = {
+        SENSOR_TYPE_ACCELEROMETER, SENSOR_TYPE_GYROSCOPE, SENSOR_TYPE_MAGNETIC_FIELD,
+        SENSOR_TYPE_ROTATION_VECTOR, SENSOR_TYPE_GAME_ROTATION_VECTOR,
+        SENSOR_TYPE_STEP_COUNTER, SENSOR_TYPE_LIGHT, SENSOR_TYPE_PROXIMITY,
+        SENSOR_TYPE_PRESSURE, SENSOR_TYPE_GRAVITY,
+};
+
+std::vector<std::unique_ptr<RecentEventLogger>> createLoggers() {
+    std::vector<std::unique_ptr<RecentEventLogger>> loggers;
+    for (size_t i = 0; i < kNumSensors; ++i) {
+        const int type = kSensorTypes[i % (sizeof(kSensorTypes) / sizeof(kSensorTypes[0]))];
+        const bool keepLastEvent = type == SENSOR_TYPE_LIGHT || type == SENSOR_TYPE_PROXIMITY;
+        loggers.emplace_back(new RecentEventLogger(type, keepLastEvent));
+    }
+    return loggers;
+}
+
+void logEvents(benchmark::State& state,
+               const std::vector<std::unique_ptr<RecentEventLogger>>& loggers) {
+    sensors_event_t event = {};
+    event.version = sizeof(event);
+    int64_t timestamp = 0;
+    while (state.KeepRunning()) {
+        timestamp += 1000000;
+        for (size_t i = 0; i < loggers.size(); ++i) {
+            event.sensor = static_cast<int32_t>(i);
+            event.timestamp = timestamp;
+            event.data[0] = static_cast<float>(i);
+            event.data[1] = static_cast<float>(timestamp % 1000);
+            loggers[i]->addEvent(event);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * loggers.size());
+}
+
+void BM_RecentEventLogger_AddEvent(benchmark::State& state) {
+    auto loggers = createLoggers();
+    logEvents(state, loggers);
+}
+BENCHMARK(BM_RecentEventLogger_AddEvent);
+
+// Same as above while another thread keeps dumping all the loggers, as dumpsys sensorservice
+// would.
+void BM_RecentEventLogger_AddEventWhileDumping(benchmark::State& state) {
+    auto loggers = createLoggers();
+    std::atomic<bool> done(false);
+    std::thread dumper([&loggers, &done]() {
+        while (!done) {
+            for (const auto& logger : loggers) {
+                benchmark::DoNotOptimize(logger->dump());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    logEvents(state, loggers);
+    done = true;
+    dumper.join();
+}
+BENCHMARK(BM_RecentEventLogger_AddEventWhileDumping);
+
+void BM_RecentEventLogger_Dump(benchmark::State& state) {
+    auto loggers = createLoggers();
+    sensors_event_t event = {};
+    for (int64_t i = 0; i < 100; ++i) {
+        event.timestamp = i * 1000000;
+        for (const auto& logger : loggers) {
+            logger->addEvent(event);
+        }
+    }
+    while (state.KeepRunning()) {
+        for (const auto& logger : loggers) {
+            benchmark::DoNotOptimize(logger->dump());
+        }
+    }
+}
+BENCHMARK(BM_RecentEventLogger_Dump);
+
+} // namespace
+
+BENCHMARK_MAIN();
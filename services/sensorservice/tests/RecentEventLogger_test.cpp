@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RecentEventLogger.h"
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace android {
+namespace SensorServiceUtil {
+namespace {
+
+sensors_event_t makeEvent(int sensorType, int64_t timestamp, float value) {
+    sensors_event_t event = {};
+    event.version = sizeof(event);
+    event.type = sensorType;
+    event.timestamp = timestamp;
+    for (size_t i = 0; i < 16; ++i) {
+        event.data[i] = value;
+    }
+    return event;
+}
+
+// Returns the lines of the dump that describe events.
+std::vector<std::string> dumpEventLines(const RecentEventLogger& logger) {
+    std::vector<std::string> lines;
+    std::istringstream dump(logger.dump());
+    std::string line;
+    while (std::getline(dump, line)) {
+        if (line.find("(ts=") != std::string::npos) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+TEST(RecentEventLoggerTest, emptyLoggerHasNoEvents) {
+    RecentEventLogger logger(SENSOR_TYPE_LIGHT);
+    sensors_event_t event;
+
+    EXPECT_TRUE(logger.isEmpty());
+    EXPECT_FALSE(logger.populateLastEventIfCurrent(&event));
+    EXPECT_EQ("last 0 events\n", logger.dump());
+}
+
+TEST(RecentEventLoggerTest, formatsFloatData) {
+    RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+    logger.addEvent(makeEvent(SENSOR_TYPE_ACCELEROMETER, 1000000000, 1.5f));
+
+    const std::vector<std::string> lines = dumpEventLines(logger);
+    ASSERT_EQ(1u, lines.size());
+    EXPECT_NE(std::string::npos, lines[0].find("ts=1.000000000"));
+    EXPECT_NE(std::string::npos, lines[0].find(") 1.50, 1.50, 1.50, "));
+    EXPECT_EQ(std::string::npos, lines[0].find("1.50, 1.50, 1.50, 1.50"));
+}
+
+TEST(RecentEventLoggerTest, formatsStepCounterAsInteger) {
+    RecentEventLogger logger(SENSOR_TYPE_STEP_COUNTER);
+    sensors_event_t event = makeEvent(SENSOR_TYPE_STEP_COUNTER, 1, 0);
+    event.u64.step_counter = 12345678901ull;
+    logger.addEvent(event);
+
+    const std::vector<std::string> lines = dumpEventLines(logger);
+    ASSERT_EQ(1u, lines.size());
+    EXPECT_NE(std::string::npos, lines[0].find(") 12345678901, "));
+}
+
+TEST(RecentEventLoggerTest, masksPrivateData) {
+    RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+    logger.addEvent(makeEvent(SENSOR_TYPE_ACCELEROMETER, 1, 1.5f));
+
+    logger.setFormat("mask_data");
+    std::string dump = logger.dump();
+    EXPECT_NE(std::string::npos, dump.find("[value masked]"));
+    EXPECT_EQ(std::string::npos, dump.find("1.50"));
+
+    logger.setFormat("");
+    dump = logger.dump();
+    EXPECT_EQ(std::string::npos, dump.find("[value masked]"));
+    EXPECT_NE(std::string::npos, dump.find("1.50"));
+}
+
+TEST(RecentEventLoggerTest, dumpsNewestEventsAfterWraparound) {
+    // The log of gyroscopes holds 10 events.
+    RecentEventLogger logger(SENSOR_TYPE_GYROSCOPE);
+    for (int i = 1; i <= 25; ++i) {
+        logger.addEvent(makeEvent(SENSOR_TYPE_GYROSCOPE, i * 1000000000ll, i));
+    }
+
+    const std::vector<std::string> lines = dumpEventLines(logger);
+    ASSERT_EQ(10u, lines.size());
+    EXPECT_NE(std::string::npos, lines.front().find("ts=25.000000000"));
+    EXPECT_NE(std::string::npos, lines.front().find(") 25.00, "));
+    EXPECT_NE(std::string::npos, lines.back().find("ts=16.000000000"));
+    EXPECT_NE(std::string::npos, lines.back().find(") 16.00, "));
+}
+
+TEST(RecentEventLoggerTest, replaysLastEventAfterWraparound) {
+    RecentEventLogger logger(SENSOR_TYPE_PROXIMITY);
+    for (int i = 1; i <= 100; ++i) {
+        logger.addEvent(makeEvent(SENSOR_TYPE_PROXIMITY, i, i));
+    }
+
+    sensors_event_t event;
+    ASSERT_TRUE(logger.populateLastEventIfCurrent(&event));
+    EXPECT_EQ(100, event.timestamp);
+    EXPECT_EQ(SENSOR_TYPE_PROXIMITY, event.type);
+    EXPECT_EQ(100.0f, event.data[0]);
+
+    logger.setLastEventStale();
+    EXPECT_FALSE(logger.populateLastEventIfCurrent(&event));
+
+    logger.addEvent(makeEvent(SENSOR_TYPE_PROXIMITY, 101, 101));
+    ASSERT_TRUE(logger.populateLastEventIfCurrent(&event));
+    EXPECT_EQ(101, event.timestamp);
+}
+
+TEST(RecentEventLoggerTest, doesNotKeepLastEventUnlessAsked) {
+    RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER, false /* keepLastEvent */);
+    logger.addEvent(makeEvent(SENSOR_TYPE_ACCELEROMETER, 1, 1));
+
+    sensors_event_t event;
+    EXPECT_FALSE(logger.isEmpty());
+    EXPECT_FALSE(logger.populateLastEventIfCurrent(&event));
+}
+
+// Every event carries its index in all of its data, so that readers can tell a torn event.
+TEST(RecentEventLoggerTest, readersSeeConsistentEventsWhileWriterRuns) {
+    constexpr int kNumEvents = 100000;
+    RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+
+    std::atomic<bool> done(false);
+    std::thread writer([&] {
+        for (int i = 1; i <= kNumEvents; ++i) {
+            logger.addEvent(makeEvent(SENSOR_TYPE_ACCELEROMETER, i, i));
+        }
+        done = true;
+    });
+
+    bool lastEventConsistent = true;
+    bool dumpConsistent = true;
+    int64_t lastTimestamp = 0;
+    bool lastTimestampMonotonic = true;
+    while (!done) {
+        sensors_event_t event;
+        if (logger.populateLastEventIfCurrent(&event)) {
+            for (size_t i = 0; i < 16; ++i) {
+                lastEventConsistent &= event.data[i] == static_cast<float>(event.timestamp);
+            }
+            lastTimestampMonotonic &= event.timestamp >= lastTimestamp;
+            lastTimestamp = event.timestamp;
+        }
+
+        for (const std::string& line : dumpEventLines(logger)) {
+            double timestamp;
+            float x, y, z;
+            const char* data = strchr(line.c_str(), ')');
+            dumpConsistent &= sscanf(strstr(line.c_str(), "ts="), "ts=%lf", &timestamp) == 1 &&
+                    data && sscanf(data, ") %f, %f, %f, ", &x, &y, &z) == 3 && x == y &&
+                    y == z && x == static_cast<float>(llround(timestamp * 1e9));
+        }
+    }
+    writer.join();
+
+    EXPECT_TRUE(lastEventConsistent);
+    EXPECT_TRUE(lastTimestampMonotonic);
+    EXPECT_TRUE(dumpConsistent);
+}
+
+} // namespace
+} // namespace SensorServiceUtil
+} // namespace android
@@ -106,6 +106,12 @@ status_t Client::createWithSurfaceParent(const String8& name, uint32_t w, uint32
                                  nullptr, layer);
 }
 
+status_t Client::createSurfaces(const std::vector<SurfaceCreationArgs>& args,
+                                std::vector<SurfaceCreationResult>* outResults) {
+    // We rely on createLayers to check permissions.
+    return mFlinger->createLayers(this, args, outResults);
+}
+
 status_t Client::clearLayerFrameStats(const sp<IBinder>& handle) const {
     sp<Layer> layer = getLayerUser(handle);
     if (layer == nullptr) {
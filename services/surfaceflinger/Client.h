@@ -66,6 +66,9 @@ private:
 
     virtual status_t getLayerFrameStats(const sp<IBinder>& handle, FrameStats* outStats) const;
 
+    virtual status_t createSurfaces(const std::vector<SurfaceCreationArgs>& args,
+                                    std::vector<SurfaceCreationResult>* outResults);
+
     // constant
     sp<SurfaceFlinger> mFlinger;
 
@@ -57,6 +57,7 @@ public:
     MOCK_METHOD3(setOutputBuffer, status_t(DisplayId, const sp<Fence>&, const sp<GraphicBuffer>&));
     MOCK_METHOD1(clearReleaseFences, void(DisplayId));
     MOCK_METHOD2(getHdrCapabilities, status_t(DisplayId, HdrCapabilities*));
+    MOCK_CONST_METHOD1(getEdidCapabilities, std::optional<EdidCapabilities>(DisplayId));
     MOCK_CONST_METHOD1(getSupportedPerFrameMetadata, int32_t(DisplayId));
     MOCK_CONST_METHOD2(getRenderIntents, std::vector<ui::RenderIntent>(DisplayId, ui::ColorMode));
     MOCK_METHOD2(getDataspaceSaturationMatrix, mat4(DisplayId, ui::Dataspace));
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <numeric>
 #include <optional>
 
@@ -31,19 +32,155 @@ namespace {
 
 using byte_view = std::basic_string_view<uint8_t>;
 
+constexpr size_t kEdidBlockLength = 128;
 constexpr size_t kEdidHeaderLength = 5;
+constexpr size_t kDescriptorLength = 18;
 
 constexpr uint16_t kFallbackEdidManufacturerId = 0;
 constexpr uint16_t kVirtualEdidManufacturerId = 0xffffu;
 
+constexpr uint8_t kRangeLimitsDescriptorType = 0xfd;
+
 std::optional<uint8_t> getEdidDescriptorType(const byte_view& view) {
-    if (view.size() < kEdidHeaderLength || view[0] || view[1] || view[2] || view[4]) {
+    if (view.size() < kEdidHeaderLength || view[0] || view[1] || view[2]) {
+        return {};
+    }
+
+    // The range limits descriptor uses the last header byte for rate offsets.
+    if (view[4] && view[3] != kRangeLimitsDescriptorType) {
         return {};
     }
 
     return view[3];
 }
 
+// Returns nothing if the 18-byte block is a display descriptor rather than a timing.
+std::optional<DetailedTiming> parseDetailedTiming(const byte_view& view) {
+    if (view.size() < kDescriptorLength) {
+        return {};
+    }
+
+    // Pixel clock in units of 10 kHz, where 0 marks a display descriptor.
+    const uint32_t pixelClock = view[0] | (view[1] << 8);
+    if (pixelClock == 0) {
+        return {};
+    }
+
+    // 12-bit values whose upper nibbles are packed together.
+    const uint16_t width = view[2] | ((view[4] & 0xf0) << 4);
+    const uint16_t horizontalBlanking = view[3] | ((view[4] & 0x0f) << 8);
+    const uint16_t height = view[5] | ((view[7] & 0xf0) << 4);
+    const uint16_t verticalBlanking = view[6] | ((view[7] & 0x0f) << 8);
+
+    const uint32_t totalPixels = (width + horizontalBlanking) * (height + verticalBlanking);
+    if (width == 0 || height == 0 || totalPixels == 0) {
+        ALOGW("Invalid EDID: detailed timing has no active pixels.");
+        return {};
+    }
+
+    const uint32_t pixelClockKhz = pixelClock * 10;
+    return DetailedTiming{pixelClockKhz, width, height, pixelClockKhz * 1000.f / totalPixels};
+}
+
+std::optional<RefreshRateRange> parseRangeLimits(const byte_view& descriptor) {
+    // Byte 4 holds the offsets, followed by the vertical rate limits.
+    if (descriptor.size() < 7) {
+        return {};
+    }
+
+    const uint8_t offsets = descriptor[4];
+    const uint16_t min = descriptor[5] + ((offsets & 0b11) == 0b11 ? 255 : 0);
+    const uint16_t max = descriptor[6] + (offsets & 0b10 ? 255 : 0);
+    if (min == 0 || min > max) {
+        ALOGW("Invalid EDID: vertical rate limits are out of order.");
+        return {};
+    }
+
+    return RefreshRateRange{min, max};
+}
+
+// Decodes a luminance code value of the HDR static metadata data block to cd/m^2.
+float getMaxLuminance(uint8_t codeValue) {
+    return 50.f * std::pow(2.f, codeValue / 32.f);
+}
+
+std::optional<HdrStaticMetadata> parseHdrStaticMetadata(const byte_view& payload) {
+    // Extended tag, supported EOTFs and supported metadata descriptors are mandatory.
+    if (payload.size() < 3) {
+        return {};
+    }
+
+    HdrStaticMetadata metadata{payload[1], 0.f, 0.f, 0.f};
+    if (payload.size() > 3 && payload[3]) {
+        metadata.maxLuminance = getMaxLuminance(payload[3]);
+    }
+    if (payload.size() > 4 && payload[4]) {
+        metadata.maxAverageLuminance = getMaxLuminance(payload[4]);
+    }
+    if (payload.size() > 5 && metadata.maxLuminance > 0.f) {
+        const float ratio = payload[5] / 255.f;
+        metadata.minLuminance = metadata.maxLuminance * ratio * ratio / 100.f;
+    }
+    return metadata;
+}
+
+std::optional<RefreshRateRange> parseHdmiForumVrrRange(const byte_view& payload) {
+    // The VRR range follows the OUI, version, TMDS rate and three bytes of flags.
+    if (payload.size() < 10) {
+        return {};
+    }
+
+    const uint16_t min = payload[8] & 0x3f;
+    const uint16_t max = ((payload[8] & 0xc0) << 2) | payload[9];
+    if (min == 0 || max <= min) {
+        // Either VRR is not supported, or its maximum is not limited by the display.
+        return {};
+    }
+
+    return RefreshRateRange{min, max};
+}
+
+void parseCtaExtension(const byte_view& block, EdidCapabilities* capabilities) {
+    // Offset of the detailed timings, which end the data block collection.
+    const size_t timingsOffset = block[2];
+    if (timingsOffset < 4 || timingsOffset > kEdidBlockLength - 1) {
+        // An offset of 0 means there are neither data blocks nor timings.
+        ALOGW_IF(timingsOffset, "Invalid EDID: CTA extension has invalid timing offset.");
+        return;
+    }
+
+    constexpr uint8_t kVendorSpecificTag = 3;
+    constexpr uint8_t kExtendedTag = 7;
+    constexpr uint8_t kHdrStaticMetadataExtendedTag = 6;
+    constexpr uint32_t kHdmiForumOui = 0xc45dd8;
+
+    byte_view dataBlocks = block.substr(4, timingsOffset - 4);
+    while (!dataBlocks.empty()) {
+        const uint8_t tag = dataBlocks[0] >> 5;
+        const size_t length = dataBlocks[0] & 0x1f;
+        if (length + 1 > dataBlocks.size()) {
+            ALOGW("Invalid EDID: CTA data block is truncated.");
+            break;
+        }
+
+        const byte_view payload = dataBlocks.substr(1, length);
+        if (tag == kExtendedTag && length > 0 && payload[0] == kHdrStaticMetadataExtendedTag) {
+            capabilities->hdrStaticMetadata = parseHdrStaticMetadata(payload);
+        } else if (tag == kVendorSpecificTag && length >= 3 &&
+                   (payload[0] | (payload[1] << 8) | (payload[2] << 16)) == kHdmiForumOui) {
+            capabilities->vrrRange = parseHdmiForumVrrRange(payload);
+        }
+
+        dataBlocks.remove_prefix(length + 1);
+    }
+
+    if (!capabilities->preferredTiming) {
+        // The first timing is the native format of the display.
+        capabilities->preferredTiming = parseDetailedTiming(
+                block.substr(timingsOffset, kEdidBlockLength - 1 - timingsOffset));
+    }
+}
+
 std::string_view parseEdidText(const byte_view& view) {
     std::string_view text(reinterpret_cast<const char*>(view.data()), view.size());
     text = text.substr(0, text.find('\n'));
@@ -87,7 +224,6 @@ std::optional<Edid> parseEdid(const DisplayIdentificationData& edid) {
         ALOGW("Invalid EDID: structure is truncated.");
         // Attempt parsing even if EDID is malformed.
     } else {
-        ALOGW_IF(edid[126] != 0, "EDID extensions are currently unsupported.");
         ALOGW_IF(std::accumulate(edid.begin(), edid.begin() + kMinLength, static_cast<uint8_t>(0)),
                  "Invalid EDID: structure does not checksum.");
     }
@@ -120,17 +256,27 @@ std::optional<Edid> parseEdid(const DisplayIdentificationData& edid) {
     std::string_view displayName;
     std::string_view serialNumber;
     std::string_view asciiText;
+    EdidCapabilities capabilities;
 
     constexpr size_t kDescriptorCount = 4;
-    constexpr size_t kDescriptorLength = 18;
 
     for (size_t i = 0; i < kDescriptorCount; i++) {
         if (view.size() < kDescriptorLength) {
             break;
         }
 
+        if (i == 0) {
+            // The first descriptor holds the preferred timing, if any.
+            capabilities.preferredTiming = parseDetailedTiming(view);
+        }
+
         if (const auto type = getEdidDescriptorType(view)) {
             byte_view descriptor(view.data(), kDescriptorLength);
+
+            if (*type == kRangeLimitsDescriptorType) {
+                capabilities.refreshRateRange = parseRangeLimits(descriptor);
+            }
+
             descriptor.remove_prefix(kEdidHeaderLength);
 
             switch (*type) {
@@ -162,7 +308,22 @@ std::optional<Edid> parseEdid(const DisplayIdentificationData& edid) {
         return {};
     }
 
-    return Edid{manufacturerId, *pnpId, displayName};
+    if (edid.size() >= kMinLength) {
+        constexpr uint8_t kCtaExtensionTag = 0x02;
+
+        const size_t extensionCount = edid[126];
+        ALOGW_IF(edid.size() < kMinLength * (extensionCount + 1),
+                 "Invalid EDID: extensions are truncated.");
+
+        for (size_t i = 1; i <= extensionCount && kMinLength * (i + 1) <= edid.size(); i++) {
+            const byte_view block(edid.data() + kMinLength * i, kMinLength);
+            if (block[0] == kCtaExtensionTag) {
+                parseCtaExtension(block, &capabilities);
+            }
+        }
+    }
+
+    return Edid{manufacturerId, *pnpId, displayName, capabilities};
 }
 
 std::optional<PnpId> getPnpId(uint16_t manufacturerId) {
@@ -192,7 +353,7 @@ std::optional<DisplayIdentificationInfo> parseDisplayIdentificationData(
     // observed to change on some displays with multiple inputs.
     const auto hash = static_cast<uint32_t>(std::hash<std::string_view>()(edid->displayName));
     return DisplayIdentificationInfo{DisplayId::fromEdid(port, edid->manufacturerId, hash),
-                                     std::string(edid->displayName)};
+                                     std::string(edid->displayName), edid->capabilities};
 }
 
 DisplayId getFallbackDisplayId(uint8_t port) {
@@ -203,4 +364,38 @@ DisplayId getVirtualDisplayId(uint32_t id) {
     return DisplayId::fromEdid(0, kVirtualEdidManufacturerId, id);
 }
 
+std::optional<DisplayIdentificationInfo> DisplayIdentificationCache::parse(
+        uint8_t port, const DisplayIdentificationData& data) {
+    const size_t hash = std::hash<std::string_view>()(
+            std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+
+    std::lock_guard lock(mMutex);
+    const auto it = std::find_if(mEntries.begin(), mEntries.end(), [&](const Entry& entry) {
+        return entry.hash == hash && entry.port == port && entry.data == data;
+    });
+    if (it != mEntries.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, it);
+        mHitCount++;
+        return it->info;
+    }
+
+    mMissCount++;
+    auto info = parseDisplayIdentificationData(port, data);
+    mEntries.push_front({hash, port, data, info});
+    if (mEntries.size() > mCapacity) {
+        mEntries.pop_back();
+    }
+    return info;
+}
+
+size_t DisplayIdentificationCache::getHitCount() const {
+    std::lock_guard lock(mMutex);
+    return mHitCount;
+}
+
+size_t DisplayIdentificationCache::getMissCount() const {
+    std::lock_guard lock(mMutex);
+    return mMissCount;
+}
+
 } // namespace android
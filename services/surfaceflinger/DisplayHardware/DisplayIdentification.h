@@ -18,11 +18,14 @@
 
 #include <array>
 #include <cstdint>
+#include <list>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include <android-base/thread_annotations.h>
 #include <ui/GraphicTypes.h>
 
 namespace android {
@@ -50,9 +53,60 @@ inline std::string to_string(DisplayId displayId) {
 
 using DisplayIdentificationData = std::vector<uint8_t>;
 
+// Timing of an EDID detailed timing descriptor.
+struct DetailedTiming {
+    uint32_t pixelClockKhz;
+    uint16_t width;
+    uint16_t height;
+    // Refresh rate in Hz.
+    float refreshRate;
+};
+
+// Range of refresh rates in Hz, inclusive.
+struct RefreshRateRange {
+    uint16_t min;
+    uint16_t max;
+
+    bool contains(float refreshRate) const {
+        // Ranges are given in whole Hz, so allow for rates such as 59.94 Hz.
+        return refreshRate > min - 1 && refreshRate < max + 1;
+    }
+};
+
+// HDR static metadata data block of a CTA-861 extension.
+struct HdrStaticMetadata {
+    enum Eotf : uint8_t {
+        TRADITIONAL_SDR = 1 << 0,
+        TRADITIONAL_HDR = 1 << 1,
+        SMPTE_ST2084 = 1 << 2,
+        HLG = 1 << 3,
+    };
+
+    // Bitmask of supported Eotf values.
+    uint8_t eotfs;
+    // Desired content luminance in cd/m^2, or 0 if not given.
+    float maxLuminance;
+    float maxAverageLuminance;
+    float minLuminance;
+};
+
+// Capabilities of a display beyond its identity, parsed from its EDID and CTA-861 extensions.
+struct EdidCapabilities {
+    // Timing the display is best viewed at.
+    std::optional<DetailedTiming> preferredTiming;
+    // Refresh rates accepted by the display, from its display range limits descriptor.
+    std::optional<RefreshRateRange> refreshRateRange;
+    // Refresh rates the display can vary between in variable refresh rate mode, from its HDMI
+    // Forum vendor-specific data block. Fixed refresh rates outside of it may still be accepted,
+    // so it does not narrow refreshRateRange.
+    std::optional<RefreshRateRange> vrrRange;
+    std::optional<HdrStaticMetadata> hdrStaticMetadata;
+};
+
 struct DisplayIdentificationInfo {
     DisplayId id;
     std::string name;
+    EdidCapabilities capabilities;
 };
 
 // NUL-terminated plug and play ID.
@@ -62,6 +116,7 @@ struct Edid {
     uint16_t manufacturerId;
     PnpId pnpId;
     std::string_view displayName;
+    EdidCapabilities capabilities;
 };
 
 bool isEdid(const DisplayIdentificationData&);
@@ -75,6 +130,38 @@ std::optional<DisplayIdentificationInfo> parseDisplayIdentificationData(
 DisplayId getFallbackDisplayId(uint8_t port);
 DisplayId getVirtualDisplayId(uint32_t id);
 
+// Remembers the identification of recently connected displays by the content of their EDID, so
+// that displays reconnecting do not have it parsed again. Thread-safe.
+class DisplayIdentificationCache {
+public:
+    static constexpr size_t kDefaultCapacity = 8;
+
+    explicit DisplayIdentificationCache(size_t capacity = kDefaultCapacity)
+          : mCapacity(capacity) {}
+
+    // Same as parseDisplayIdentificationData, but only parses data not seen recently.
+    std::optional<DisplayIdentificationInfo> parse(uint8_t port, const DisplayIdentificationData&);
+
+    size_t getHitCount() const;
+    size_t getMissCount() const;
+
+private:
+    struct Entry {
+        size_t hash;
+        uint8_t port;
+        DisplayIdentificationData data;
+        std::optional<DisplayIdentificationInfo> info;
+    };
+
+    const size_t mCapacity;
+
+    mutable std::mutex mMutex;
+    // Most recently used first.
+    std::list<Entry> mEntries GUARDED_BY(mMutex);
+    size_t mHitCount GUARDED_BY(mMutex) = 0;
+    size_t mMissCount GUARDED_BY(mMutex) = 0;
+};
+
 } // namespace android
 
 namespace std {
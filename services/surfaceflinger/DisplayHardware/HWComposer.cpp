@@ -152,6 +152,8 @@ std::optional<DisplayIdentificationInfo> HWComposer::onHotplug(hwc2_display_t hw
 
         info = onHotplugConnect(hwcDisplayId);
         if (!info) return {};
+
+        mDisplayData[info->id].edidCapabilities = info->capabilities;
     }
 
     ALOGV("%s: %s %s display %s with HWC ID %" PRIu64, __FUNCTION__, to_string(connection).c_str(),
@@ -719,6 +721,11 @@ status_t HWComposer::getHdrCapabilities(DisplayId displayId, HdrCapabilities* ou
     return NO_ERROR;
 }
 
+std::optional<EdidCapabilities> HWComposer::getEdidCapabilities(DisplayId displayId) const {
+    RETURN_IF_INVALID_DISPLAY(displayId, {});
+    return mDisplayData.at(displayId).edidCapabilities;
+}
+
 int32_t HWComposer::getSupportedPerFrameMetadata(DisplayId displayId) const {
     RETURN_IF_INVALID_DISPLAY(displayId, 0);
     return mDisplayData.at(displayId).hwcDisplay->getSupportedPerFrameMetadata();
@@ -855,7 +862,7 @@ std::optional<DisplayIdentificationInfo> HWComposer::onHotplugConnect(hwc2_displ
     std::optional<DisplayIdentificationInfo> info;
 
     if (mHasMultiDisplaySupport) {
-        info = parseDisplayIdentificationData(port, data);
+        info = mIdentificationCache.parse(port, data);
         ALOGE_IF(!info, "Failed to parse identification data for display %" PRIu64, hwcDisplayId);
     } else if (mInternalHwcDisplayId && mExternalHwcDisplayId) {
         ALOGE("Ignoring connection of tertiary display %" PRIu64, hwcDisplayId);
@@ -120,6 +120,9 @@ public:
     // Fetches the HDR capabilities of the given display
     virtual status_t getHdrCapabilities(DisplayId displayId, HdrCapabilities* outCapabilities) = 0;
 
+    // Returns the capabilities parsed from the EDID of the given display, if it has one.
+    virtual std::optional<EdidCapabilities> getEdidCapabilities(DisplayId displayId) const = 0;
+
     virtual int32_t getSupportedPerFrameMetadata(DisplayId displayId) const = 0;
 
     // Returns the available RenderIntent of the given display.
@@ -259,6 +262,8 @@ public:
     // Fetches the HDR capabilities of the given display
     status_t getHdrCapabilities(DisplayId displayId, HdrCapabilities* outCapabilities) override;
 
+    std::optional<EdidCapabilities> getEdidCapabilities(DisplayId displayId) const override;
+
     int32_t getSupportedPerFrameMetadata(DisplayId displayId) const override;
 
     // Returns the available RenderIntent of the given display.
@@ -342,6 +347,7 @@ private:
         sp<Fence> outbufAcquireFence = Fence::NO_FENCE;
         mutable std::unordered_map<int32_t,
                 std::shared_ptr<const HWC2::Display::Config>> configMap;
+        EdidCapabilities edidCapabilities;
 
         bool validateWasSkipped;
         HWC2::Error presentError;
@@ -365,6 +371,7 @@ private:
     std::optional<hwc2_display_t> mInternalHwcDisplayId;
     std::optional<hwc2_display_t> mExternalHwcDisplayId;
     bool mHasMultiDisplaySupport = false;
+    DisplayIdentificationCache mIdentificationCache;
 
     std::unordered_set<DisplayId> mFreeVirtualDisplayIds;
     uint32_t mNextVirtualDisplayId = 0;
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "VirtualDisplaySinkFeeder"
+
+#include "VirtualDisplaySinkFeeder.h"
+
+#include <pthread.h>
+
+#include <chrono>
+
+#include <log/log.h>
+
+namespace android {
+namespace {
+
+using namespace std::chrono_literals;
+
+// How long the dequeue thread waits before asking again a sink which had no buffer to spare.
+constexpr auto kRetryDelay = 2ms;
+
+// Longest time BACK_PRESSURE waits for a buffer, so that a sink which stopped consuming frames
+// cannot stall composition of the other displays.
+constexpr auto kMaxBackPressure = 20ms;
+
+} // namespace
+
+VirtualDisplaySinkFeeder::VirtualDisplaySinkFeeder(const sp<IGraphicBufferProducer>& sink,
+                                                   Policy policy, const std::string& name)
+      : mSink(sink), mPolicy(policy), mName(name) {
+    if (mSink->setMaxDequeuedBufferCount(1 + kExtraBuffers) == NO_ERROR) {
+        mMaxDequeuedCount = 1 + kExtraBuffers;
+    } else {
+        ALOGW("[%s] Sink has no buffers to spare, frames are fed one at a time", mName.c_str());
+    }
+
+    mDequeueThread = std::thread([this] { dequeueThreadMain(); });
+    pthread_setname_np(mDequeueThread.native_handle(), "VdsSinkDequeue");
+    mQueueThread = std::thread([this] { queueThreadMain(); });
+    pthread_setname_np(mQueueThread.native_handle(), "VdsSinkQueue");
+}
+
+VirtualDisplaySinkFeeder::~VirtualDisplaySinkFeeder() {
+    {
+        std::lock_guard lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_all();
+    mDequeueThread.join();
+    // The queue thread only exits once the frames handed to it are queued.
+    mQueueThread.join();
+
+    std::lock_guard lock(mMutex);
+    if (mReadyBuffer) {
+        mSink->cancelBuffer(mReadyBuffer->slot, mReadyBuffer->fence);
+        mReadyBuffer.reset();
+    }
+}
+
+status_t VirtualDisplaySinkFeeder::dequeueBuffer(int* outSlot, sp<Fence>* outFence,
+                                                 sp<GraphicBuffer>* outBuffer, uint32_t width,
+                                                 uint32_t height, PixelFormat format,
+                                                 uint64_t usage) NO_THREAD_SAFETY_ANALYSIS {
+    const BufferParams params{width, height, format, usage};
+    const nsecs_t start = systemTime();
+
+    std::unique_lock lock(mMutex);
+    const bool paramsChanged = !mParams || !(*mParams == params);
+    mParams = params;
+    mCondition.notify_all();
+
+    status_t releaseAll = 0;
+    const auto bufferOrError = [&]() NO_THREAD_SAFETY_ANALYSIS {
+        if (mReadyBuffer && !(mReadyBuffer->params == params)) {
+            // Handed back to the sink, and replaced by the dequeue thread with a matching one.
+            releaseAll |= mReadyBuffer->flags & IGraphicBufferProducer::RELEASE_ALL_BUFFERS;
+            mOperations.push_back({mReadyBuffer->slot, std::nullopt, mReadyBuffer->fence});
+            mReadyBuffer.reset();
+            mCondition.notify_all();
+        }
+        return mReadyBuffer || mDequeueError != NO_ERROR || !mRunning;
+    };
+    if (mPolicy == Policy::DROP_FRAMES && !paramsChanged) {
+        // A buffer of new parameters is worth waiting for, since none could have been prefetched.
+        if (!bufferOrError()) {
+            mStats.framesDropped++;
+            return WOULD_BLOCK;
+        }
+    } else if (!mCondition.wait_for(lock, kMaxBackPressure, bufferOrError)) {
+        ALOGV("[%s] Timed out waiting for a sink buffer", mName.c_str());
+        mStats.dequeueWaitTime += systemTime() - start;
+        mStats.framesDropped++;
+        return WOULD_BLOCK;
+    }
+    mStats.dequeueWaitTime += systemTime() - start;
+
+    if (!mReadyBuffer) {
+        const status_t error = mRunning ? mDequeueError : NO_INIT;
+        // Lets the dequeue thread try again for the next frame.
+        mDequeueError = NO_ERROR;
+        mCondition.notify_all();
+        return error;
+    }
+
+    ReadyBuffer ready = std::move(*mReadyBuffer);
+    mReadyBuffer.reset();
+    mCondition.notify_all();
+
+    status_t result = (ready.flags | releaseAll) & IGraphicBufferProducer::RELEASE_ALL_BUFFERS;
+    if (result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS) {
+        for (auto& buffer : mHandedOutBuffers) {
+            buffer.clear();
+        }
+    }
+    // Ready buffers discarded above may have taken the reallocation flag of this slot with them.
+    if (mHandedOutBuffers[ready.slot] != ready.buffer) {
+        mHandedOutBuffers[ready.slot] = ready.buffer;
+        result |= IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION;
+    }
+
+    *outSlot = ready.slot;
+    *outFence = ready.fence;
+    *outBuffer = ready.buffer;
+    return result;
+}
+
+void VirtualDisplaySinkFeeder::queueBuffer(int slot,
+                                           const IGraphicBufferProducer::QueueBufferInput& input) {
+    {
+        std::lock_guard lock(mMutex);
+        if (mPolicy == Policy::DROP_FRAMES) {
+            for (Operation& operation : mOperations) {
+                if (operation.input) {
+                    // Superseded by this frame before the sink got to it.
+                    operation.fence = operation.input->fence;
+                    operation.input.reset();
+                    mStats.framesDropped++;
+                }
+            }
+        }
+        mOperations.push_back({slot, input, nullptr});
+    }
+    mCondition.notify_all();
+}
+
+void VirtualDisplaySinkFeeder::cancelBuffer(int slot, const sp<Fence>& fence) {
+    {
+        std::lock_guard lock(mMutex);
+        mOperations.push_back({slot, std::nullopt, fence});
+    }
+    mCondition.notify_all();
+}
+
+bool VirtualDisplaySinkFeeder::takeQueueBufferOutput(
+        IGraphicBufferProducer::QueueBufferOutput* output) {
+    std::lock_guard lock(mMutex);
+    if (!mQueueBufferOutput) {
+        return false;
+    }
+    *output = std::move(*mQueueBufferOutput);
+    mQueueBufferOutput.reset();
+    return true;
+}
+
+status_t VirtualDisplaySinkFeeder::setMaxDequeuedBufferCount(int maxDequeuedBuffers) {
+    const status_t result = mSink->setMaxDequeuedBufferCount(maxDequeuedBuffers + kExtraBuffers);
+    if (result == NO_ERROR) {
+        {
+            std::lock_guard lock(mMutex);
+            mMaxDequeuedCount = maxDequeuedBuffers + kExtraBuffers;
+        }
+        mCondition.notify_all();
+    }
+    return result;
+}
+
+VirtualDisplaySinkFeeder::Stats VirtualDisplaySinkFeeder::getStats() const {
+    std::lock_guard lock(mMutex);
+    return mStats;
+}
+
+void VirtualDisplaySinkFeeder::dequeueThreadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this]() NO_THREAD_SAFETY_ANALYSIS {
+            return !mRunning ||
+                    (mParams && !mReadyBuffer && mDequeueError == NO_ERROR &&
+                     mDequeuedCount < mMaxDequeuedCount);
+        });
+        if (!mRunning) {
+            return;
+        }
+
+        const BufferParams params = *mParams;
+        mDequeuedCount++;
+        lock.unlock();
+
+        int slot = BufferQueueDefs::INVALID_BUFFER_SLOT;
+        sp<Fence> fence;
+        status_t result = mSink->dequeueBuffer(&slot, &fence, params.width, params.height,
+                                               params.format, params.usage, nullptr, nullptr);
+        if (result >= 0) {
+            if (result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS) {
+                for (auto& buffer : mBuffers) {
+                    buffer.clear();
+                }
+            }
+            if ((result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) ||
+                mBuffers[slot] == nullptr) {
+                const status_t status = mSink->requestBuffer(slot, &mBuffers[slot]);
+                if (status < 0) {
+                    mBuffers[slot].clear();
+                    mSink->cancelBuffer(slot, fence);
+                    result = status;
+                }
+            }
+        }
+
+        lock.lock();
+        if (result < 0) {
+            mDequeuedCount--;
+            if (result == WOULD_BLOCK || result == TIMED_OUT) {
+                mCondition.wait_for(lock, kRetryDelay,
+                                   [this]() NO_THREAD_SAFETY_ANALYSIS { return !mRunning; });
+            } else {
+                ALOGE("[%s] Failed to dequeue a sink buffer: %d", mName.c_str(), result);
+                mDequeueError = result;
+                mCondition.notify_all();
+            }
+            continue;
+        }
+
+        ALOGV("[%s] Sink buffer ready in slot %d", mName.c_str(), slot);
+        mReadyBuffer = ReadyBuffer{slot, fence, mBuffers[slot], result, params};
+        mCondition.notify_all();
+    }
+}
+
+void VirtualDisplaySinkFeeder::queueThreadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this]() NO_THREAD_SAFETY_ANALYSIS {
+            return !mRunning || !mOperations.empty();
+        });
+        if (mOperations.empty()) {
+            return;
+        }
+
+        Operation operation = std::move(mOperations.front());
+        mOperations.pop_front();
+        lock.unlock();
+
+        std::optional<IGraphicBufferProducer::QueueBufferOutput> output;
+        if (operation.input) {
+            IGraphicBufferProducer::QueueBufferOutput qbo;
+            const status_t result = mSink->queueBuffer(operation.slot, *operation.input, &qbo);
+            if (result == NO_ERROR) {
+                output = std::move(qbo);
+            } else {
+                ALOGE("[%s] Failed to queue sink buffer in slot %d: %d", mName.c_str(),
+                      operation.slot, result);
+            }
+        } else {
+            mSink->cancelBuffer(operation.slot, operation.fence);
+        }
+
+        lock.lock();
+        if (output) {
+            mQueueBufferOutput = std::move(output);
+            mStats.framesQueued++;
+        }
+        mDequeuedCount--;
+        mCondition.notify_all();
+    }
+}
+
+} // namespace android
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <android-base/thread_annotations.h>
+#include <gui/BufferQueueDefs.h>
+#include <gui/IGraphicBufferProducer.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/StrongPointer.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/*
+ * Moves the buffer traffic with the sink of a virtual display off the thread composing it. A
+ * dequeue thread keeps a sink buffer ready for the next frame, and a queue thread hands composed
+ * frames to the sink, so that composition only waits on the sink when it has no buffer to spare,
+ * and never on the binder calls into the process that consumes the frames.
+ *
+ * The feeder holds up to kExtraBuffers sink buffers on top of the one being composed into, and
+ * raises the maximum dequeued buffer count of the sink accordingly.
+ */
+class VirtualDisplaySinkFeeder {
+public:
+    enum class Policy {
+        // Waits for the sink to have a buffer ready, as the synchronous path does.
+        BACK_PRESSURE,
+        // Fails with WOULD_BLOCK when the sink has no buffer ready, so that the frame can be
+        // dropped, and replaces frames still waiting to be queued with newer ones.
+        DROP_FRAMES,
+    };
+
+    // One buffer ready for the next frame, and one being queued.
+    static constexpr int kExtraBuffers = 2;
+
+    struct Stats {
+        size_t framesQueued = 0;
+        // Frames for which no buffer was ready, and frames replaced before being queued.
+        size_t framesDropped = 0;
+        // Time dequeueBuffer waited for the dequeue thread.
+        nsecs_t dequeueWaitTime = 0;
+    };
+
+    VirtualDisplaySinkFeeder(const sp<IGraphicBufferProducer>& sink, Policy policy,
+                             const std::string& name);
+    ~VirtualDisplaySinkFeeder();
+
+    // Same as IGraphicBufferProducer::dequeueBuffer, but takes a buffer already dequeued from the
+    // sink, which is returned along with its slot.
+    status_t dequeueBuffer(int* outSlot, sp<Fence>* outFence, sp<GraphicBuffer>* outBuffer,
+                           uint32_t width, uint32_t height, PixelFormat format, uint64_t usage);
+
+    // Hands a dequeued buffer back to the sink, asynchronously.
+    void queueBuffer(int slot, const IGraphicBufferProducer::QueueBufferInput& input);
+    void cancelBuffer(int slot, const sp<Fence>& fence);
+
+    // Moves the output of the last completed queueBuffer into output, if there was one since the
+    // previous call.
+    bool takeQueueBufferOutput(IGraphicBufferProducer::QueueBufferOutput* output);
+
+    // Sets the number of buffers the producer may dequeue, on top of which the feeder has its own.
+    status_t setMaxDequeuedBufferCount(int maxDequeuedBuffers);
+
+    Stats getStats() const;
+
+private:
+    struct BufferParams {
+        uint32_t width;
+        uint32_t height;
+        PixelFormat format;
+        uint64_t usage;
+
+        bool operator==(const BufferParams& other) const {
+            return width == other.width && height == other.height && format == other.format &&
+                    usage == other.usage;
+        }
+    };
+
+    struct ReadyBuffer {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        // Flags of the dequeue from the sink.
+        status_t flags;
+        BufferParams params;
+    };
+
+    struct Operation {
+        int slot;
+        // Set for queueBuffer, or the buffer is cancelled with the fence.
+        std::optional<IGraphicBufferProducer::QueueBufferInput> input;
+        sp<Fence> fence;
+    };
+
+    void dequeueThreadMain();
+    void queueThreadMain();
+
+    const sp<IGraphicBufferProducer> mSink;
+    const Policy mPolicy;
+    const std::string mName;
+
+    // Only accessed by the dequeue thread.
+    sp<GraphicBuffer> mBuffers[BufferQueueDefs::NUM_BUFFER_SLOTS];
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+
+    bool mRunning GUARDED_BY(mMutex) = true;
+    // Unknown until the first call to dequeueBuffer.
+    std::optional<BufferParams> mParams GUARDED_BY(mMutex);
+    std::optional<ReadyBuffer> mReadyBuffer GUARDED_BY(mMutex);
+    // Error of the last dequeue from the sink, reported by the next dequeueBuffer.
+    status_t mDequeueError GUARDED_BY(mMutex) = NO_ERROR;
+    std::deque<Operation> mOperations GUARDED_BY(mMutex);
+    // Last buffer handed out by dequeueBuffer for each slot.
+    sp<GraphicBuffer> mHandedOutBuffers[BufferQueueDefs::NUM_BUFFER_SLOTS] GUARDED_BY(mMutex);
+    // Sink buffers dequeued and not yet queued or cancelled.
+    int mDequeuedCount GUARDED_BY(mMutex) = 0;
+    int mMaxDequeuedCount GUARDED_BY(mMutex) = 1;
+
+    std::optional<IGraphicBufferProducer::QueueBufferOutput> mQueueBufferOutput GUARDED_BY(mMutex);
+    Stats mStats GUARDED_BY(mMutex);
+
+    std::thread mDequeueThread;
+    std::thread mQueueThread;
+};
+
+} // namespace android
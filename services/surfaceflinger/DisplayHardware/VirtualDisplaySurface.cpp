@@ -19,6 +19,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include "HWComposer.h"
 #include "SurfaceFlinger.h"
 
@@ -52,6 +54,33 @@ static const char* dbgCompositionTypeStr(compositionengine::DisplaySurface::Comp
     }
 }
 
+static std::optional<VirtualDisplaySinkFeeder::Policy> sinkFeederPolicyForMode(int sinkMode) {
+    switch (sinkMode) {
+        case 1:
+            return VirtualDisplaySinkFeeder::Policy::BACK_PRESSURE;
+        case 2:
+            return VirtualDisplaySinkFeeder::Policy::DROP_FRAMES;
+        default:
+            return std::nullopt;
+    }
+}
+
+class VirtualDisplaySurface::SinkCallTimer {
+public:
+    explicit SinkCallTimer(SinkCallStats& stats) : mStats(stats), mStart(systemTime()) {}
+
+    ~SinkCallTimer() {
+        const nsecs_t elapsed = systemTime() - mStart;
+        mStats.calls++;
+        mStats.totalTime += elapsed;
+        mStats.maxTime = std::max(mStats.maxTime, elapsed);
+    }
+
+private:
+    SinkCallStats& mStats;
+    const nsecs_t mStart;
+};
+
 VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
                                              const std::optional<DisplayId>& displayId,
                                              const sp<IGraphicBufferProducer>& sink,
@@ -64,6 +93,7 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
         mDisplayName(name),
         mSource{},
         mDefaultOutputFormat(HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED),
+        mSinkFeederPolicy(sinkFeederPolicyForMode(SurfaceFlinger::virtualDisplaySinkMode)),
         mOutputFormat(HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED),
         mOutputUsage(GRALLOC_USAGE_HW_COMPOSER),
         mProducerSlotSource(0),
@@ -265,33 +295,41 @@ void VirtualDisplaySurface::onFrameCommitted() {
 
     if (mOutputProducerSlot >= 0) {
         int sslot = mapProducer2SourceSlot(SOURCE_SINK, mOutputProducerSlot);
-        QueueBufferOutput qbo;
         VDS_LOGV("onFrameCommitted: queue sink sslot=%d", sslot);
         if (retireFence->isValid() && mMustRecompose) {
-            status_t result = mSource[SOURCE_SINK]->queueBuffer(sslot,
+            queueSinkBuffer(sslot,
                     QueueBufferInput(
                         systemTime(), false /* isAutoTimestamp */,
                         HAL_DATASPACE_UNKNOWN,
                         Rect(mSinkBufferWidth, mSinkBufferHeight),
                         NATIVE_WINDOW_SCALING_MODE_FREEZE, 0 /* transform */,
-                        retireFence),
-                    &qbo);
-            if (result == NO_ERROR) {
-                updateQueueBufferOutput(std::move(qbo));
-            }
+                        retireFence));
         } else {
             // If the surface hadn't actually been updated, then we only went
             // through the motions of updating the display to keep our state
             // machine happy. We cancel the buffer to avoid triggering another
             // re-composition and causing an infinite loop.
-            mSource[SOURCE_SINK]->cancelBuffer(sslot, retireFence);
+            cancelSinkBuffer(sslot, retireFence);
         }
     }
 
     resetPerFrameState();
 }
 
-void VirtualDisplaySurface::dumpAsString(String8& /* result */) const {
+void VirtualDisplaySurface::dumpAsString(String8& result) const {
+    const SinkCallStats& calls = mSinkCallStats;
+    result.appendFormat("  VirtualDisplaySurface: sink %s, %zu calls from the composition thread "
+                        "(%.3f ms total, %.3f ms average, %.3f ms max)\n",
+                        mSinkFeeder ? "fed asynchronously" : "fed synchronously", calls.calls,
+                        ns2us(calls.totalTime) / 1000.0,
+                        calls.calls ? ns2us(calls.totalTime / calls.calls) / 1000.0 : 0.0,
+                        ns2us(calls.maxTime) / 1000.0);
+    if (mSinkFeeder) {
+        const VirtualDisplaySinkFeeder::Stats stats = mSinkFeeder->getStats();
+        result.appendFormat("   frames queued: %zu, dropped: %zu, waited %.3f ms for buffers\n",
+                            stats.framesQueued, stats.framesDropped,
+                            ns2us(stats.dequeueWaitTime) / 1000.0);
+    }
 }
 
 void VirtualDisplaySurface::resizeBuffers(const uint32_t w, const uint32_t h) {
@@ -308,6 +346,11 @@ const sp<Fence>& VirtualDisplaySurface::getClientTargetAcquireFence() const {
 status_t VirtualDisplaySurface::requestBuffer(int pslot,
         sp<GraphicBuffer>* outBuf) {
     if (!mDisplayId) {
+        if (mSinkFeeder) {
+            *outBuf = mProducerBuffers[pslot];
+            return NO_ERROR;
+        }
+        SinkCallTimer timer(mSinkCallStats);
         return mSource[SOURCE_SINK]->requestBuffer(pslot, outBuf);
     }
 
@@ -321,7 +364,16 @@ status_t VirtualDisplaySurface::requestBuffer(int pslot,
 
 status_t VirtualDisplaySurface::setMaxDequeuedBufferCount(
         int maxDequeuedBuffers) {
-    return mSource[SOURCE_SINK]->setMaxDequeuedBufferCount(maxDequeuedBuffers);
+    status_t result;
+    if (mSinkFeeder) {
+        result = mSinkFeeder->setMaxDequeuedBufferCount(maxDequeuedBuffers);
+    } else {
+        result = mSource[SOURCE_SINK]->setMaxDequeuedBufferCount(maxDequeuedBuffers);
+    }
+    if (result == NO_ERROR) {
+        mMaxDequeuedBuffers = maxDequeuedBuffers;
+    }
+    return result;
 }
 
 status_t VirtualDisplaySurface::setAsyncMode(bool async) {
@@ -340,9 +392,23 @@ status_t VirtualDisplaySurface::dequeueBuffer(Source source,
                 dbgSourceStr(source), usage);
     }
 
-    status_t result =
-            mSource[source]->dequeueBuffer(sslot, fence, mSinkBufferWidth, mSinkBufferHeight,
-                                           format, usage, nullptr, nullptr);
+    status_t result;
+    sp<GraphicBuffer> sinkBuffer;
+    if (source == SOURCE_SINK) {
+        SinkCallTimer timer(mSinkCallStats);
+        startSinkFeederIfNeeded();
+        if (mSinkFeeder) {
+            result = mSinkFeeder->dequeueBuffer(sslot, fence, &sinkBuffer, mSinkBufferWidth,
+                                                mSinkBufferHeight, format, usage);
+        } else {
+            result = mSource[source]->dequeueBuffer(sslot, fence, mSinkBufferWidth,
+                                                    mSinkBufferHeight, format, usage, nullptr,
+                                                    nullptr);
+        }
+    } else {
+        result = mSource[source]->dequeueBuffer(sslot, fence, mSinkBufferWidth, mSinkBufferHeight,
+                                                format, usage, nullptr, nullptr);
+    }
     if (result < 0)
         return result;
     int pslot = mapSource2ProducerSlot(source, *sslot);
@@ -364,7 +430,14 @@ status_t VirtualDisplaySurface::dequeueBuffer(Source source,
                 mProducerBuffers[i].clear();
         }
     }
-    if (result & BUFFER_NEEDS_REALLOCATION) {
+    if (sinkBuffer != nullptr) {
+        // The feeder already requested the buffer.
+        mProducerBuffers[pslot] = sinkBuffer;
+    } else if (result & BUFFER_NEEDS_REALLOCATION) {
+        std::optional<SinkCallTimer> timer;
+        if (source == SOURCE_SINK) {
+            timer.emplace(mSinkCallStats);
+        }
         auto status = mSource[source]->requestBuffer(*sslot, &mProducerBuffers[pslot]);
         if (status < 0) {
             mProducerBuffers[pslot].clear();
@@ -385,6 +458,19 @@ status_t VirtualDisplaySurface::dequeueBuffer(int* pslot, sp<Fence>* fence, uint
                                               uint64_t* outBufferAge,
                                               FrameEventHistoryDelta* outTimestamps) {
     if (!mDisplayId) {
+        SinkCallTimer timer(mSinkCallStats);
+        startSinkFeederIfNeeded();
+        if (mSinkFeeder) {
+            sp<GraphicBuffer> buffer;
+            status_t result = mSinkFeeder->dequeueBuffer(pslot, fence, &buffer, w, h, format, usage);
+            if (result >= 0) {
+                mProducerBuffers[*pslot] = buffer;
+            }
+            if (outBufferAge) {
+                *outBufferAge = 0;
+            }
+            return result;
+        }
         return mSource[SOURCE_SINK]->dequeueBuffer(pslot, fence, w, h, format, usage, outBufferAge,
                                                    outTimestamps);
     }
@@ -472,6 +558,13 @@ status_t VirtualDisplaySurface::attachBuffer(int* /* outSlot */,
 status_t VirtualDisplaySurface::queueBuffer(int pslot,
         const QueueBufferInput& input, QueueBufferOutput* output) {
     if (!mDisplayId) {
+        if (mSinkFeeder) {
+            queueSinkBuffer(pslot, input);
+            // The sink may not have taken this frame yet, so this is the output of an earlier one.
+            *output = std::move(mQueueBufferOutput);
+            return NO_ERROR;
+        }
+        SinkCallTimer timer(mSinkCallStats);
         return mSource[SOURCE_SINK]->queueBuffer(pslot, input, output);
     }
 
@@ -531,7 +624,7 @@ status_t VirtualDisplaySurface::queueBuffer(int pslot,
 status_t VirtualDisplaySurface::cancelBuffer(int pslot,
         const sp<Fence>& fence) {
     if (!mDisplayId) {
-        return mSource[SOURCE_SINK]->cancelBuffer(mapProducer2SourceSlot(SOURCE_SINK, pslot), fence);
+        return cancelSinkBuffer(mapProducer2SourceSlot(SOURCE_SINK, pslot), fence);
     }
 
     VDS_LOGW_IF(mDbgState != DBG_STATE_GLES,
@@ -539,6 +632,9 @@ status_t VirtualDisplaySurface::cancelBuffer(int pslot,
             dbgStateStr());
     VDS_LOGV("cancelBuffer pslot=%d", pslot);
     Source source = fbSourceForCompositionType(mCompositionType);
+    if (source == SOURCE_SINK) {
+        return cancelSinkBuffer(mapProducer2SourceSlot(source, pslot), fence);
+    }
     return mSource[source]->cancelBuffer(
             mapProducer2SourceSlot(source, pslot), fence);
 }
@@ -564,6 +660,7 @@ status_t VirtualDisplaySurface::connect(const sp<IProducerListener>& listener,
     status_t result = mSource[SOURCE_SINK]->connect(listener, api,
             producerControlledByApp, &qbo);
     if (result == NO_ERROR) {
+        mSinkConnected = true;
         updateQueueBufferOutput(std::move(qbo));
         // This moves the frame timestamps and keeps a copy of all other fields.
         *output = std::move(mQueueBufferOutput);
@@ -572,6 +669,10 @@ status_t VirtualDisplaySurface::connect(const sp<IProducerListener>& listener,
 }
 
 status_t VirtualDisplaySurface::disconnect(int api, DisconnectMode mode) {
+    // The buffers the feeder holds are handed back first, since the sink frees
+    // its slots on disconnect.
+    mSinkFeeder.reset();
+    mSinkConnected = false;
     return mSource[SOURCE_SINK]->disconnect(api, mode);
 }
 
@@ -634,6 +735,45 @@ void VirtualDisplaySurface::updateQueueBufferOutput(
     mQueueBufferOutput.transformHint = 0;
 }
 
+status_t VirtualDisplaySurface::queueSinkBuffer(int sslot, const QueueBufferInput& input) {
+    SinkCallTimer timer(mSinkCallStats);
+    QueueBufferOutput qbo;
+    if (mSinkFeeder) {
+        mSinkFeeder->queueBuffer(sslot, input);
+        if (!mSinkFeeder->takeQueueBufferOutput(&qbo)) {
+            return NO_ERROR;
+        }
+    } else {
+        status_t result = mSource[SOURCE_SINK]->queueBuffer(sslot, input, &qbo);
+        if (result != NO_ERROR) {
+            return result;
+        }
+    }
+    updateQueueBufferOutput(std::move(qbo));
+    return NO_ERROR;
+}
+
+void VirtualDisplaySurface::startSinkFeederIfNeeded() {
+    if (mSinkFeeder || !mSinkFeederPolicy || !mSinkConnected) {
+        return;
+    }
+    // The feeder reserves extra buffers of the sink, which only works once it is connected.
+    mSinkFeeder = std::make_unique<VirtualDisplaySinkFeeder>(mSource[SOURCE_SINK],
+                                                             *mSinkFeederPolicy, mDisplayName);
+    if (mMaxDequeuedBuffers) {
+        mSinkFeeder->setMaxDequeuedBufferCount(*mMaxDequeuedBuffers);
+    }
+}
+
+status_t VirtualDisplaySurface::cancelSinkBuffer(int sslot, const sp<Fence>& fence) {
+    SinkCallTimer timer(mSinkCallStats);
+    if (mSinkFeeder) {
+        mSinkFeeder->cancelBuffer(sslot, fence);
+        return NO_ERROR;
+    }
+    return mSource[SOURCE_SINK]->cancelBuffer(sslot, fence);
+}
+
 void VirtualDisplaySurface::resetPerFrameState() {
     mCompositionType = COMPOSITION_UNKNOWN;
     mFbFence = Fence::NO_FENCE;
@@ -646,8 +786,7 @@ status_t VirtualDisplaySurface::refreshOutputBuffer() {
     LOG_FATAL_IF(!mDisplayId);
 
     if (mOutputProducerSlot >= 0) {
-        mSource[SOURCE_SINK]->cancelBuffer(
-                mapProducer2SourceSlot(SOURCE_SINK, mOutputProducerSlot),
+        cancelSinkBuffer(mapProducer2SourceSlot(SOURCE_SINK, mOutputProducerSlot),
                 mOutputFence);
     }
 
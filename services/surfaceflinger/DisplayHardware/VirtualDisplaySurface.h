@@ -17,6 +17,7 @@
 #ifndef ANDROID_SF_VIRTUAL_DISPLAY_SURFACE_H
 #define ANDROID_SF_VIRTUAL_DISPLAY_SURFACE_H
 
+#include <memory>
 #include <optional>
 #include <string>
 
@@ -26,6 +27,7 @@
 #include <gui/IGraphicBufferProducer.h>
 
 #include "DisplayIdentification.h"
+#include "VirtualDisplaySinkFeeder.h"
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -72,6 +74,11 @@ class IProducerListener;
  * buffer for HWC, and a separate buffer is dequeued from the sink and used as
  * the HWC output buffer. When HWC composition is complete, the scratch buffer
  * is released and the output buffer is queued to the sink.
+ *
+ * By default all calls into the sink are made from the composition thread.
+ * When SurfaceFlinger::virtualDisplaySinkMode asks for it, they go through a
+ * VirtualDisplaySinkFeeder instead, which dequeues sink buffers ahead of time
+ * and queues finished ones from its own threads.
  */
 class VirtualDisplaySurface : public compositionengine::DisplaySurface,
                               public BnGraphicBufferProducer,
@@ -141,6 +148,9 @@ private:
     status_t dequeueBuffer(Source source, PixelFormat format, uint64_t usage,
             int* sslot, sp<Fence>* fence);
     void updateQueueBufferOutput(QueueBufferOutput&& qbo);
+    status_t queueSinkBuffer(int sslot, const QueueBufferInput& input);
+    status_t cancelSinkBuffer(int sslot, const sp<Fence>& fence);
+    void startSinkFeederIfNeeded();
     void resetPerFrameState();
     status_t refreshOutputBuffer();
 
@@ -161,6 +171,8 @@ private:
     const std::string mDisplayName;
     sp<IGraphicBufferProducer> mSource[2]; // indexed by SOURCE_*
     uint32_t mDefaultOutputFormat;
+    // Set when sink buffers are handled off the composition thread.
+    const std::optional<VirtualDisplaySinkFeeder::Policy> mSinkFeederPolicy;
 
     //
     // Inter-frame state
@@ -193,6 +205,25 @@ private:
     // dequeued from the sink, and are used when queueing the buffer.
     uint32_t mSinkBufferWidth, mSinkBufferHeight;
 
+    // Null unless mSinkFeederPolicy is set. Created on the first sink dequeue
+    // after connect(), and destroyed on disconnect(), as the sink frees its
+    // slots then and only takes a buffer count while connected.
+    std::unique_ptr<VirtualDisplaySinkFeeder> mSinkFeeder;
+    bool mSinkConnected = false;
+    // The last count passed to setMaxDequeuedBufferCount(), handed to the
+    // feeder when it is created.
+    std::optional<int> mMaxDequeuedBuffers;
+
+    // Time the composition thread spends in calls to the sink, reported by
+    // dumpAsString.
+    struct SinkCallStats {
+        size_t calls = 0;
+        nsecs_t totalTime = 0;
+        nsecs_t maxTime = 0;
+    };
+    class SinkCallTimer;
+    SinkCallStats mSinkCallStats;
+
     //
     // Intra-frame state
     //
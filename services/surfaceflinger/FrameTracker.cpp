@@ -76,6 +76,14 @@ void FrameTracker::advanceFrame() {
 
     // Update the statistic to include the frame we just finished.
     updateStatsLocked(mOffset);
+    if (mFrameRecords[mOffset].frameReadyFence == nullptr &&
+            mFrameRecords[mOffset].actualPresentFence == nullptr) {
+        recordLatenciesLocked(mOffset);
+    }
+
+    // Pick up the fences of the previous frames that have signaled since, so
+    // that their latencies are recorded before their records are reused.
+    processFencesLocked();
 
     // Advance to the next frame.
     mOffset = (mOffset+1) % NUM_FRAME_RECORDS;
@@ -132,6 +140,8 @@ void FrameTracker::clearStats() {
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
     mFrameRecords[mOffset].frameReadyTime = INT64_MAX;
     mFrameRecords[mOffset].actualPresentTime = INT64_MAX;
+    mPresentLatencies.clear();
+    mReadyLatencies.clear();
 }
 
 void FrameTracker::getStats(FrameStats* outStats) const {
@@ -197,6 +207,10 @@ void FrameTracker::processFencesLocked() const {
 
         if (updated) {
             updateStatsLocked(idx);
+            if (records[idx].frameReadyFence == nullptr &&
+                    records[idx].actualPresentFence == nullptr) {
+                recordLatenciesLocked(idx);
+            }
         }
     }
 }
@@ -232,6 +246,21 @@ void FrameTracker::updateStatsLocked(size_t newFrameIdx) const {
     }
 }
 
+void FrameTracker::recordLatenciesLocked(size_t idx) const {
+    const FrameRecord& record = mFrameRecords[idx];
+    const auto isValid = [](nsecs_t time) { return time > 0 && time < INT64_MAX; };
+    if (!isValid(record.desiredPresentTime)) {
+        return;
+    }
+
+    if (isValid(record.actualPresentTime)) {
+        mPresentLatencies.record(record.actualPresentTime - record.desiredPresentTime);
+    }
+    if (isValid(record.frameReadyTime)) {
+        mReadyLatencies.record(record.frameReadyTime - record.desiredPresentTime);
+    }
+}
+
 void FrameTracker::resetFrameCountersLocked() {
     for (int i = 0; i < NUM_FRAME_BUCKETS; i++) {
         mNumFrames[i] = 0;
@@ -267,4 +296,20 @@ void FrameTracker::dumpStats(std::string& result) const {
     result.append("\n");
 }
 
+void FrameTracker::dumpLatencyPercentiles(std::string& result) const {
+    Mutex::Autolock lock(mMutex);
+    processFencesLocked();
+
+    const auto dumpHistogram = [&](const char* name, const LatencyHistogram& histogram) {
+        base::StringAppendF(&result,
+                            "  %-7s frames=%" PRIu64 " p50=%.2fms p90=%.2fms p95=%.2fms "
+                            "p99=%.2fms max=%.2fms\n",
+                            name, histogram.getCount(), histogram.getPercentile(50) / 1e6,
+                            histogram.getPercentile(90) / 1e6, histogram.getPercentile(95) / 1e6,
+                            histogram.getPercentile(99) / 1e6, histogram.getMax() / 1e6);
+    };
+    dumpHistogram("present", mPresentLatencies);
+    dumpHistogram("ready", mReadyLatencies);
+}
+
 } // namespace android
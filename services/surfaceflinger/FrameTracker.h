@@ -25,6 +25,8 @@
 #include <utils/Timers.h>
 #include <utils/RefBase.h>
 
+#include "LatencyHistogram.h"
+
 namespace android {
 
 class String8;
@@ -34,6 +36,9 @@ class String8;
 // mutexing must be done at a higher level if multi-threaded access is
 // possible.
 //
+// The latencies of all the frames, not only the ones still in the circular
+// buffer, are also counted in histograms from which percentiles can be read.
+//
 // Some of the time values tracked may be set either as a specific timestamp
 // or a fence.  When a non-nullptr fence is set for a given time value, the
 // signal time of that fence is used instead of the timestamp.
@@ -92,6 +97,18 @@ public:
     // dumpStats dump appends the current frame display time history to the result string.
     void dumpStats(std::string& result) const;
 
+    // dumpLatencyPercentiles appends percentiles of the frame latencies to the
+    // result string.
+    void dumpLatencyPercentiles(std::string& result) const;
+
+    // getPresentLatencies returns the histogram of the time from the desired
+    // present time of the frames to the time they became visible.
+    const LatencyHistogram& getPresentLatencies() const { return mPresentLatencies; }
+
+    // getReadyLatencies returns the histogram of the time from the desired
+    // present time of the frames to the time they became ready.
+    const LatencyHistogram& getReadyLatencies() const { return mReadyLatencies; }
+
     //get previous frame gfx info.
     nsecs_t getPreviousGfxInfo();
 
@@ -121,6 +138,10 @@ private:
     // about the frame times.
     void updateStatsLocked(size_t newFrameIdx) const;
 
+    // recordLatenciesLocked counts the latencies of the given frame, once all
+    // its fences have signaled, in the latency histograms.
+    void recordLatenciesLocked(size_t idx) const;
+
     // resetFrameCounteresLocked sets all elements of the mNumFrames array to
     // 0.
     void resetFrameCountersLocked();
@@ -155,6 +176,12 @@ private:
     // all frames with duration greater than 2^(NUM_FRAME_BUCKETS-1).
     int32_t mNumFrames[NUM_FRAME_BUCKETS];
 
+    // mPresentLatencies and mReadyLatencies count the latencies of all the
+    // tracked frames. They are lock-free, so they can be read without holding
+    // mMutex.
+    mutable LatencyHistogram mPresentLatencies;
+    mutable LatencyHistogram mReadyLatencies;
+
     // mDisplayPeriod is the display refresh period of the display for which
     // this FrameTracker is gathering information.
     nsecs_t mDisplayPeriod;
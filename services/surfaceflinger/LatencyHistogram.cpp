@@ -0,0 +1,108 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+void LatencyHistogram::record(nsecs_t latency) {
+    latency = std::max(latency, nsecs_t(0));
+    mCounts[bucketForLatency(latency)].fetch_add(1, std::memory_order_relaxed);
+
+    nsecs_t max = mMax.load(std::memory_order_relaxed);
+    while (latency > max &&
+           !mMax.compare_exchange_weak(max, latency, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::clear() {
+    for (auto& count : mCounts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const {
+    uint64_t total = 0;
+    for (const auto& count : mCounts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+nsecs_t LatencyHistogram::getPercentile(float percentile) const {
+    std::array<uint32_t, NUM_BUCKETS> counts;
+    uint64_t total = 0;
+    for (uint32_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+        counts[bucket] = mCounts[bucket].load(std::memory_order_relaxed);
+        total += counts[bucket];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const uint64_t rank =
+            std::max(uint64_t(std::ceil(total * std::clamp(percentile, 0.0f, 100.0f) / 100)),
+                     uint64_t(1));
+    uint64_t seen = 0;
+    for (uint32_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+        seen += counts[bucket];
+        if (seen >= rank) {
+            return std::min(latencyForBucket(bucket), getMax());
+        }
+    }
+    return getMax();
+}
+
+nsecs_t LatencyHistogram::getMax() const {
+    return mMax.load(std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::bucketForLatency(nsecs_t latency) {
+    const uint64_t micros = uint64_t(latency) / 1000;
+    if (micros < LINEAR_BUCKETS) {
+        return uint32_t(micros);
+    }
+
+    const uint32_t exponent = 63 - __builtin_clzll(micros);
+    if (exponent >= FIRST_EXPONENT + EXPONENTS) {
+        return NUM_BUCKETS - 1;
+    }
+    const uint32_t subBucket = uint32_t(micros >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return LINEAR_BUCKETS + (exponent - FIRST_EXPONENT) * SUB_BUCKETS + subBucket;
+}
+
+nsecs_t LatencyHistogram::latencyForBucket(uint32_t bucket) {
+    if (bucket < LINEAR_BUCKETS) {
+        return nsecs_t(bucket) * 1000 + 500;
+    }
+
+    const uint32_t exponent = FIRST_EXPONENT + (bucket - LINEAR_BUCKETS) / SUB_BUCKETS;
+    const uint32_t subBucket = (bucket - LINEAR_BUCKETS) % SUB_BUCKETS;
+    const uint32_t shift = exponent - SUB_BUCKET_BITS;
+    const nsecs_t lowerMicros = nsecs_t(SUB_BUCKETS + subBucket) << shift;
+    const nsecs_t widthMicros = nsecs_t(1) << shift;
+    return lowerMicros * 1000 + widthMicros * 500;
+}
+
+} // namespace android
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace android {
+
+/*
+ * A fixed size histogram of latencies from which percentiles can be read, in the style of an
+ * HDR histogram: latencies below 32us are counted with a 1us precision, and longer latencies
+ * in buckets that are 1/16th of their power of two wide, so percentiles are within about 6% of
+ * the exact value. Latencies of up to about 67s are counted, longer ones are counted as 67s.
+ *
+ * Recording is lock-free and can run concurrently with reading percentiles, in which case the
+ * percentiles may or may not include the latencies being recorded.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    // Counts a latency. Negative latencies are counted as 0.
+    void record(nsecs_t latency);
+
+    void clear();
+
+    // Returns the number of latencies counted.
+    uint64_t getCount() const;
+
+    // Returns the latency below which the given percentage of the latencies fall, or 0 if no
+    // latency was counted.
+    nsecs_t getPercentile(float percentile) const;
+
+    // Returns the longest latency counted.
+    nsecs_t getMax() const;
+
+private:
+    static constexpr uint32_t LINEAR_BUCKETS = 32;
+    static constexpr uint32_t SUB_BUCKET_BITS = 4;
+    static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // Latencies in microseconds up to 2^(FIRST_EXPONENT + EXPONENTS).
+    static constexpr uint32_t FIRST_EXPONENT = 5;
+    static constexpr uint32_t EXPONENTS = 21;
+    static constexpr uint32_t NUM_BUCKETS = LINEAR_BUCKETS + EXPONENTS * SUB_BUCKETS;
+
+    static uint32_t bucketForLatency(nsecs_t latency);
+    // Returns the latency in the middle of the given bucket.
+    static nsecs_t latencyForBucket(uint32_t bucket);
+
+    std::array<std::atomic<uint32_t>, NUM_BUCKETS> mCounts;
+    std::atomic<nsecs_t> mMax;
+};
+
+} // namespace android
@@ -669,6 +669,12 @@ bool Layer::isSecureCamera() const {
 void Layer::setVisibleRegion(const Region& visibleRegion) {
     // always called from main thread
     this->visibleRegion = visibleRegion;
+
+    float area = 0.f;
+    for (const Rect& rect : visibleRegion) {
+        area += float(rect.getWidth()) * float(rect.getHeight());
+    }
+    mFlinger->mScheduler->setLayerArea(mSchedulerLayerHandle, area);
 }
 
 void Layer::setCoveredRegion(const Region& coveredRegion) {
@@ -1402,6 +1408,14 @@ void Layer::dumpFrameStats(std::string& result) const {
     mFrameTracker.dumpStats(result);
 }
 
+void Layer::dumpFrameLatencyPercentiles(std::string& result) const {
+    if (mFrameTracker.getPresentLatencies().getCount() == 0) {
+        return;
+    }
+    StringAppendF(&result, "%s\n", getName().string());
+    mFrameTracker.dumpLatencyPercentiles(result);
+}
+
 void Layer::clearFrameStats() {
     mFrameTracker.clearStats();
 }
@@ -2012,6 +2026,15 @@ void Layer::writeToProto(LayerProto* layerInfo, LayerVector::StateSet stateSet,
                                        [&]() { return layerInfo->mutable_source_bounds(); });
         LayerProtoHelper::writeToProto(mScreenBounds,
                                        [&]() { return layerInfo->mutable_screen_bounds(); });
+
+        const LatencyHistogram& presentLatencies = mFrameTracker.getPresentLatencies();
+        if (presentLatencies.getCount() > 0) {
+            FrameLatencyProto* frameLatencyProto = layerInfo->mutable_frame_latency();
+            LayerProtoHelper::writeToProto(presentLatencies,
+                                           frameLatencyProto->mutable_present_latency());
+            LayerProtoHelper::writeToProto(mFrameTracker.getReadyLatencies(),
+                                           frameLatencyProto->mutable_ready_latency());
+        }
     }
 }
 
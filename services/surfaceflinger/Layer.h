@@ -644,6 +644,7 @@ public:
     static void miniDumpHeader(std::string& result);
     void miniDump(std::string& result, const sp<DisplayDevice>& display) const;
     void dumpFrameStats(std::string& result) const;
+    void dumpFrameLatencyPercentiles(std::string& result) const;
     void dumpFrameEvents(std::string& result);
     void clearFrameStats();
     void logFrameStats();
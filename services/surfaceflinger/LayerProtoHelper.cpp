@@ -106,6 +106,16 @@ void LayerProtoHelper::writeToProto(const ui::Transform& transform,
     }
 }
 
+void LayerProtoHelper::writeToProto(const LatencyHistogram& histogram,
+                                    LatencyPercentilesProto* latencyPercentilesProto) {
+    latencyPercentilesProto->set_count(histogram.getCount());
+    latencyPercentilesProto->set_p50_ns(histogram.getPercentile(50));
+    latencyPercentilesProto->set_p90_ns(histogram.getPercentile(90));
+    latencyPercentilesProto->set_p95_ns(histogram.getPercentile(95));
+    latencyPercentilesProto->set_p99_ns(histogram.getPercentile(99));
+    latencyPercentilesProto->set_max_ns(histogram.getMax());
+}
+
 void LayerProtoHelper::writeToProto(const sp<GraphicBuffer>& buffer,
                                     std::function<ActiveBufferProto*()> getActiveBufferProto) {
     if (buffer->getWidth() != 0 || buffer->getHeight() != 0 || buffer->getStride() != 0 ||
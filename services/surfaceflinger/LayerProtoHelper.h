@@ -38,6 +38,8 @@ public:
     static void writeToProto(const Region& region, std::function<RegionProto*()> getRegionProto);
     static void writeToProto(const half4 color, std::function<ColorProto*()> getColorProto);
     static void writeToProto(const ui::Transform& transform, TransformProto* transformProto);
+    static void writeToProto(const LatencyHistogram& histogram,
+                             LatencyPercentilesProto* latencyPercentilesProto);
     static void writeToProto(const sp<GraphicBuffer>& buffer,
                              std::function<ActiveBufferProto*()> getActiveBufferProto);
     static void writeToProto(const InputWindowInfo& inputInfo,
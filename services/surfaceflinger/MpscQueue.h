@@ -0,0 +1,87 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace android {
+
+/*
+ * An unbounded multiple producer, single consumer FIFO queue. Pushing never blocks and takes a
+ * single atomic exchange, so producers do not contend with each other or with the consumer on a
+ * lock. Items pushed by one thread are popped in the order they were pushed.
+ *
+ * Any thread can push. Only one thread at a time can pop, for instance by doing so under a lock.
+ * Items must be default constructible and movable.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : mHead(new Node), mTail(mHead.load()) {}
+
+    ~MpscQueue() {
+        Node* node = mTail.load(std::memory_order_relaxed);
+        while (node) {
+            Node* next = node->next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T item) {
+        Node* node = new Node;
+        node->item = std::move(item);
+        Node* previous = mHead.exchange(node);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Moves the oldest item to outItem, and returns false if there is none. An item that is being
+    // pushed may not be popped yet, though empty() already returns false for it.
+    bool pop(T* outItem) {
+        Node* tail = mTail.load(std::memory_order_relaxed);
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+
+        *outItem = std::move(next->item);
+        mTail.store(next, std::memory_order_release);
+        delete tail;
+        return true;
+    }
+
+    // Can be called from any thread, though the answer may be stale by the time it returns if
+    // another thread pushes or pops.
+    bool empty() const { return mHead.load() == mTail.load(); }
+
+private:
+    struct Node {
+        T item;
+        std::atomic<Node*> next{nullptr};
+    };
+
+    // The last pushed node. Producers append to it.
+    std::atomic<Node*> mHead;
+    // The last popped node, whose item was moved out, or the initial node.
+    std::atomic<Node*> mTail;
+};
+
+} // namespace android
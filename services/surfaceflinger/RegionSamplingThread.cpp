@@ -457,7 +457,8 @@ void RegionSamplingThread::captureSample() {
     }
 
     bool ignored;
-    mFlinger.captureScreenCommon(renderArea, traverseLayers, buffer, false, ignored);
+    mFlinger.captureScreenCommon(renderArea, traverseLayers, buffer, false, ignored,
+                                 nullptr /* outCapture */);
 
     std::vector<Descriptor> activeDescriptors;
     for (const auto& descriptor : descriptors) {
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameRateEstimator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "SchedulerUtils.h"
+
+namespace android {
+namespace scheduler {
+
+FrameRateEstimator::FrameRateEstimator(nsecs_t minFramePeriod)
+      : mMinFramePeriod(minFramePeriod) {}
+
+void FrameRateEstimator::addPresentTime(nsecs_t presentTime) {
+    if (mLastPresentTime == 0) {
+        // First frame
+        mLastPresentTime = presentTime;
+        return;
+    }
+
+    const nsecs_t timeDiff = presentTime - mLastPresentTime;
+    mLastPresentTime = presentTime;
+    // Ignore time diff that are too high - those are stale values
+    if (timeDiff > OBSOLETE_TIME_EPSILON_NS.count()) return;
+
+    mFramePeriods.push_back(std::max(timeDiff, mMinFramePeriod));
+    if (mFramePeriods.size() > HISTORY_SIZE) {
+        mFramePeriods.pop_front();
+    }
+}
+
+FrameRateEstimator::Estimate FrameRateEstimator::getEstimate() const {
+    if (mFramePeriods.empty()) {
+        return {1e9f / mMinFramePeriod, 1.f};
+    }
+
+    std::vector<int64_t> periods(mFramePeriods.begin(), mFramePeriods.end());
+    const nsecs_t median = calculate_median(&periods);
+    const nsecs_t tolerance = median * INLIER_TOLERANCE;
+
+    // Consecutive intervals are added up until they are close to a multiple of the median
+    // interval, and then count as that many frames. That way, a frame presented late and the
+    // next one presented early count as two frames, content that did not change for a few frames
+    // does not skew the period, and the jitter of consecutive intervals cancels out.
+    nsecs_t sum = 0;
+    nsecs_t frames = 0;
+    nsecs_t pending = 0;
+    size_t matchingCount = 0;
+    for (nsecs_t period : mFramePeriods) {
+        if (std::abs(period - median) <= tolerance) {
+            matchingCount++;
+        }
+
+        pending += period;
+        const nsecs_t pendingFrames = (pending + median / 2) / median;
+        if (pendingFrames > 0 && std::abs(pending - pendingFrames * median) <= tolerance) {
+            sum += pending;
+            frames += pendingFrames;
+            pending = 0;
+        }
+    }
+
+    const float confidence = float(matchingCount) / float(mFramePeriods.size());
+    if (frames == 0) {
+        return {1e9f / median, confidence};
+    }
+    return {1e9f / (sum / frames), confidence};
+}
+
+void FrameRateEstimator::clear() {
+    mLastPresentTime = 0;
+    mFramePeriods.clear();
+}
+
+} // namespace scheduler
+} // namespace android
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include <utils/Timers.h>
+
+namespace android {
+namespace scheduler {
+
+/*
+ * Estimates the rate at which a layer produces content from the intervals between its present
+ * times. The frame period is measured in multiples of the median interval, so that dropped
+ * frames, late frames and pacing jitter do not skew it the way they skew a plain mean of the
+ * intervals. The fraction of intervals close to the median interval is the confidence of the
+ * estimate.
+ */
+class FrameRateEstimator {
+public:
+    struct Estimate {
+        float fps = 0.f;
+        // Fraction of the recent frame intervals that match the estimated period, from 0 to 1.
+        float confidence = 0.f;
+    };
+
+    // Intervals shorter than minFramePeriod are counted as minFramePeriod.
+    explicit FrameRateEstimator(nsecs_t minFramePeriod);
+
+    // Records the present time of a frame. Intervals longer than OBSOLETE_TIME_EPSILON_NS
+    // are stale and ignored. A present time of 0 means the layer does not set present times.
+    void addPresentTime(nsecs_t presentTime);
+
+    // Returns the estimated content rate. If no interval was recorded, the estimate is the
+    // rate of minFramePeriod, with full confidence.
+    Estimate getEstimate() const;
+
+    void clear();
+
+    static constexpr size_t HISTORY_SIZE = 30;
+    // Intervals within this fraction of the median interval match the frame period.
+    static constexpr float INLIER_TOLERANCE = 0.25f;
+
+private:
+    const nsecs_t mMinFramePeriod;
+    nsecs_t mLastPresentTime = 0;
+    std::deque<nsecs_t> mFramePeriods;
+};
+
+} // namespace scheduler
+} // namespace android
@@ -16,96 +16,96 @@
 
 #include "IdleTimer.h"
 
-#include <chrono>
-#include <thread>
+#include "TimerDispatcher.h"
 
 namespace android {
 namespace scheduler {
 
 IdleTimer::IdleTimer(const Interval& interval, const ResetCallback& resetCallback,
                      const TimeoutCallback& timeoutCallback)
-      : mInterval(interval), mResetCallback(resetCallback), mTimeoutCallback(timeoutCallback) {}
+      : mDispatcher(TimerDispatcher::getInstance()),
+        mInterval(interval),
+        mResetCallback(resetCallback),
+        mTimeoutCallback(timeoutCallback) {}
 
 IdleTimer::~IdleTimer() {
     stop();
 }
 
 void IdleTimer::start() {
-    {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mState = TimerState::RESET;
-    }
-    mThread = std::thread(&IdleTimer::loop, this);
+    mDeadline = nextDeadline();
+    mState = TimerState::RESET;
+    mDispatcher->add(this);
 }
 
 void IdleTimer::stop() {
-    {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mState = TimerState::STOPPED;
-    }
-    mCondition.notify_all();
-    if (mThread.joinable()) {
-        mThread.join();
+    mState = TimerState::STOPPED;
+    mDispatcher->remove(this);
+}
+
+void IdleTimer::reset() {
+    mDeadline = nextDeadline();
+
+    // A waiting timer picks up the new deadline when the previous one expires. Only an idle
+    // timer needs the dispatcher to fire the reset callback.
+    TimerState state = TimerState::IDLE;
+    if (mState.compare_exchange_strong(state, TimerState::RESET)) {
+        mDispatcher->wake();
     }
 }
 
-void IdleTimer::loop() {
-    while (true) {
-        bool triggerReset = false;
-        bool triggerTimeout = false;
-        {
-            std::lock_guard<std::mutex> lock(mMutex);
-            if (mState == TimerState::STOPPED) {
-                break;
-            }
-
-            if (mState == TimerState::IDLE) {
-                mCondition.wait(mMutex);
-                continue;
-            }
-
-            if (mState == TimerState::RESET) {
-                triggerReset = true;
-            }
-        }
-        if (triggerReset && mResetCallback) {
-            mResetCallback();
-        }
+nsecs_t IdleTimer::nextDeadline() const {
+    return systemTime(SYSTEM_TIME_MONOTONIC) +
+            std::chrono::duration_cast<std::chrono::nanoseconds>(mInterval).count();
+}
 
-        { // lock the mutex again. someone might have called stop meanwhile
-            std::lock_guard<std::mutex> lock(mMutex);
-            if (mState == TimerState::STOPPED) {
-                break;
-            }
-
-            auto triggerTime = std::chrono::steady_clock::now() + mInterval;
-            mState = TimerState::WAITING;
-            while (mState == TimerState::WAITING) {
-                constexpr auto zero = std::chrono::steady_clock::duration::zero();
-                auto waitTime = triggerTime - std::chrono::steady_clock::now();
-                if (waitTime > zero) mCondition.wait_for(mMutex, waitTime);
-                if (mState == TimerState::RESET) {
-                    triggerTime = std::chrono::steady_clock::now() + mInterval;
-                    mState = TimerState::WAITING;
-                } else if (mState == TimerState::WAITING &&
-                           (triggerTime - std::chrono::steady_clock::now()) <= zero) {
-                    triggerTimeout = true;
-                    mState = TimerState::IDLE;
-                }
-            }
-        }
-        if (triggerTimeout && mTimeoutCallback) {
-            mTimeoutCallback();
+IdleTimer::Callback IdleTimer::poll(nsecs_t now, nsecs_t* outDeadline) {
+    TimerState state = mState;
+    if (state == TimerState::RESET) {
+        if (!mState.compare_exchange_strong(state, TimerState::WAITING)) {
+            // Stopped meanwhile.
+            return Callback::NONE;
         }
+        *outDeadline = mDeadline;
+        return Callback::RESET;
     }
-} // namespace scheduler
 
-void IdleTimer::reset() {
-    {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mState = TimerState::RESET;
+    if (state != TimerState::WAITING) {
+        return Callback::NONE;
+    }
+
+    const nsecs_t deadline = mDeadline;
+    if (deadline > now) {
+        *outDeadline = deadline;
+        return Callback::NONE;
+    }
+
+    if (!mState.compare_exchange_strong(state, TimerState::IDLE)) {
+        return Callback::NONE;
+    }
+
+    // reset() may have moved the deadline without seeing the timer idle, in which case the timer
+    // keeps waiting. If it did see the timer idle, the timer is reset and the dispatcher woken up.
+    const nsecs_t newDeadline = mDeadline;
+    state = TimerState::IDLE;
+    if (newDeadline > now && mState.compare_exchange_strong(state, TimerState::WAITING)) {
+        *outDeadline = newDeadline;
+        return Callback::NONE;
+    }
+    return Callback::TIMEOUT;
+}
+
+void IdleTimer::runCallback(Callback callback) {
+    switch (callback) {
+        case Callback::RESET:
+            if (mResetCallback) mResetCallback();
+            break;
+        case Callback::TIMEOUT:
+            if (mTimeoutCallback) mTimeoutCallback();
+            break;
+        case Callback::NONE:
+            break;
     }
-    mCondition.notify_all();
 }
 
 } // namespace scheduler
@@ -16,18 +16,24 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
-#include <thread>
+#include <functional>
+#include <memory>
 
-#include <android-base/thread_annotations.h>
+#include <utils/Timers.h>
 
 namespace android {
 namespace scheduler {
 
+class TimerDispatcher;
+
 /*
  * Class that sets off a timer for a given interval, and fires a callback when the
  * interval expires.
+ *
+ * The callbacks of all the IdleTimers run on the thread of a shared TimerDispatcher. Resetting a
+ * timer that has not expired only updates its deadline, and does not wake that thread up.
  */
 class IdleTimer {
 public:
@@ -47,9 +53,11 @@ public:
     void reset();
 
 private:
+    friend class TimerDispatcher;
+
     // Enum to track in what state is the timer.
     enum class TimerState {
-        // The internal timer thread has been destroyed, and no state is
+        // The timer is not registered with the dispatcher, and no state is
         // tracked.
         // Possible state transitions: RESET
         STOPPED = 0,
@@ -65,20 +73,23 @@ private:
         IDLE = 3
     };
 
-    // Function that loops until the condition for stopping is met.
-    void loop();
+    enum class Callback { NONE, RESET, TIMEOUT };
 
-    // Thread waiting for timer to expire.
-    std::thread mThread;
+    // Called by the dispatcher to advance the state of the timer. Returns the callback to run,
+    // and the time at which the timer needs to be polled again in outDeadline, if any.
+    Callback poll(nsecs_t now, nsecs_t* outDeadline);
+    void runCallback(Callback callback);
 
-    // Condition used to notify mThread.
-    std::condition_variable_any mCondition;
+    nsecs_t nextDeadline() const;
 
-    // Lock used for synchronizing the waiting thread with the application thread.
-    std::mutex mMutex;
+    // Dispatcher running the callbacks.
+    const std::shared_ptr<TimerDispatcher> mDispatcher;
 
     // Current timer state
-    TimerState mState GUARDED_BY(mMutex) = TimerState::RESET;
+    std::atomic<TimerState> mState = TimerState::STOPPED;
+
+    // Time at which the timer expires unless it is reset, in SYSTEM_TIME_MONOTONIC.
+    std::atomic<nsecs_t> mDeadline = 0;
 
     // Interval after which timer expires.
     const Interval mInterval;
@@ -18,12 +18,15 @@
 
 #include "LayerHistory.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
 #include <cstdint>
 #include <limits>
 #include <numeric>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <cutils/properties.h>
 #include <utils/Log.h>
@@ -69,54 +72,46 @@ void LayerHistory::destroyLayer(const int64_t id) {
     }
 }
 
-void LayerHistory::insert(const std::unique_ptr<LayerHandle>& layerHandle, nsecs_t presentTime,
-                          bool isHdr) {
-    std::shared_ptr<LayerInfo> layerInfo;
-    {
-        std::lock_guard lock(mLock);
-        auto layerInfoIterator = mInactiveLayerInfos.find(layerHandle->mId);
-        if (layerInfoIterator != mInactiveLayerInfos.end()) {
-            layerInfo = layerInfoIterator->second;
+std::shared_ptr<LayerInfo> LayerHistory::getLayerInfo(
+        const std::unique_ptr<LayerHandle>& layerHandle, bool activate) {
+    std::lock_guard lock(mLock);
+    auto layerInfoIterator = mInactiveLayerInfos.find(layerHandle->mId);
+    if (layerInfoIterator != mInactiveLayerInfos.end()) {
+        auto layerInfo = layerInfoIterator->second;
+        if (activate) {
             mInactiveLayerInfos.erase(layerInfoIterator);
             mActiveLayerInfos.insert({layerHandle->mId, layerInfo});
-        } else {
-            layerInfoIterator = mActiveLayerInfos.find(layerHandle->mId);
-            if (layerInfoIterator != mActiveLayerInfos.end()) {
-                layerInfo = layerInfoIterator->second;
-            } else {
-                ALOGW("Inserting information about layer that is not registered: %" PRId64,
-                      layerHandle->mId);
-                return;
-            }
         }
+        return layerInfo;
+    }
+
+    layerInfoIterator = mActiveLayerInfos.find(layerHandle->mId);
+    if (layerInfoIterator != mActiveLayerInfos.end()) {
+        return layerInfoIterator->second;
+    }
+
+    ALOGW("Inserting information about layer that is not registered: %" PRId64, layerHandle->mId);
+    return nullptr;
+}
+
+void LayerHistory::insert(const std::unique_ptr<LayerHandle>& layerHandle, nsecs_t presentTime,
+                          bool isHdr) {
+    if (const auto layerInfo = getLayerInfo(layerHandle, true)) {
+        layerInfo->setLastPresentTime(presentTime);
+        layerInfo->setHDRContent(isHdr);
     }
-    layerInfo->setLastPresentTime(presentTime);
-    layerInfo->setHDRContent(isHdr);
 }
 
 void LayerHistory::setVisibility(const std::unique_ptr<LayerHandle>& layerHandle, bool visible) {
-    std::shared_ptr<LayerInfo> layerInfo;
-    {
-        std::lock_guard lock(mLock);
-        auto layerInfoIterator = mInactiveLayerInfos.find(layerHandle->mId);
-        if (layerInfoIterator != mInactiveLayerInfos.end()) {
-            layerInfo = layerInfoIterator->second;
-            if (visible) {
-                mInactiveLayerInfos.erase(layerInfoIterator);
-                mActiveLayerInfos.insert({layerHandle->mId, layerInfo});
-            }
-        } else {
-            layerInfoIterator = mActiveLayerInfos.find(layerHandle->mId);
-            if (layerInfoIterator != mActiveLayerInfos.end()) {
-                layerInfo = layerInfoIterator->second;
-            } else {
-                ALOGW("Inserting information about layer that is not registered: %" PRId64,
-                      layerHandle->mId);
-                return;
-            }
-        }
+    if (const auto layerInfo = getLayerInfo(layerHandle, visible)) {
+        layerInfo->setVisibility(visible);
+    }
+}
+
+void LayerHistory::setArea(const std::unique_ptr<LayerHandle>& layerHandle, float area) {
+    if (const auto layerInfo = getLayerInfo(layerHandle, false)) {
+        layerInfo->setArea(area);
     }
-    layerInfo->setVisibility(visible);
 }
 
 std::pair<float, bool> LayerHistory::getDesiredRefreshRateAndHDR() {
@@ -126,20 +121,40 @@ std::pair<float, bool> LayerHistory::getDesiredRefreshRateAndHDR() {
 
     removeIrrelevantLayers();
 
-    // Iterate through all layers that have been recently updated, and find the max refresh rate.
+    // Each layer that has been recently updated votes for the refresh rate its content needs,
+    // weighted by its visible area. Layers that are not composed yet have no area, and count
+    // as one pixel.
+    struct Vote {
+        float refreshRate;
+        float weight;
+    };
+    std::vector<Vote> votes;
+    votes.reserve(mActiveLayerInfos.size());
+    float totalWeight = 0.f;
     for (const auto& [layerId, layerInfo] : mActiveLayerInfos) {
-        const float layerRefreshRate = layerInfo->getDesiredRefreshRate();
+        const auto [layerRefreshRate, confidence] = layerInfo->getDesiredRefreshRate();
+        const float area = layerInfo->getArea();
         if (mTraceEnabled) {
             // Store the refresh rate in traces for easy debugging.
             std::string layerName = "LFPS " + layerInfo->getName();
             ATRACE_INT(layerName.c_str(), std::round(layerRefreshRate));
-            ALOGD("%s: %f", layerName.c_str(), std::round(layerRefreshRate));
+            ALOGD("%s: %f (confidence %.2f, area %.0f)", layerName.c_str(),
+                  std::round(layerRefreshRate), confidence, area);
         }
-        if (layerInfo->isRecentlyActive() && layerRefreshRate > newRefreshRate) {
-            newRefreshRate = layerRefreshRate;
+        if (layerInfo->isRecentlyActive()) {
+            const float weight = std::max(area, 1.f);
+            votes.push_back({layerRefreshRate, weight});
+            totalWeight += weight;
         }
         isHDR |= layerInfo->getHDRContent();
     }
+
+    for (const auto& vote : votes) {
+        if (vote.weight >= totalWeight * MIN_VOTE_SHARE && vote.refreshRate > newRefreshRate) {
+            newRefreshRate = vote.refreshRate;
+        }
+    }
+
     if (mTraceEnabled) {
         ALOGD("LayerHistory DesiredRefreshRate: %.2f", newRefreshRate);
     }
@@ -60,9 +60,13 @@ public:
     void insert(const std::unique_ptr<LayerHandle>& layerHandle, nsecs_t presentTime, bool isHdr);
     // Method for setting layer visibility
     void setVisibility(const std::unique_ptr<LayerHandle>& layerHandle, bool visible);
+    // Method for setting the area of the layer that is visible on screen, in pixels.
+    void setArea(const std::unique_ptr<LayerHandle>& layerHandle, float area);
 
-    // Returns the desired refresh rate, which is a max refresh rate of all the current
-    // layers. See go/content-fps-detection-in-scheduler for more information.
+    // Returns the desired refresh rate, which is the max refresh rate of the current layers
+    // that hold at least MIN_VOTE_SHARE of the visible area of the current layers, so that
+    // small layers such as a spinner do not keep the display at a high refresh rate.
+    // See go/content-fps-detection-in-scheduler for more information.
     std::pair<float, bool> getDesiredRefreshRateAndHDR();
 
     // Clears all layer history.
@@ -71,7 +75,13 @@ public:
     // Removes the handle and the object from the map.
     void destroyLayer(const int64_t id);
 
+    static constexpr float MIN_VOTE_SHARE = 0.1f;
+
 private:
+    // Returns the info of the given layer, and marks the layer as active if activate is true.
+    std::shared_ptr<LayerInfo> getLayerInfo(const std::unique_ptr<LayerHandle>& layerHandle,
+                                            bool activate);
+
     // Removes the layers that have been idle for a given amount of time from mLayerInfos.
     void removeIrrelevantLayers() REQUIRES(mLock);
 
@@ -28,6 +28,7 @@
 #include <utils/Mutex.h>
 #include <utils/Timers.h>
 
+#include "FrameRateEstimator.h"
 #include "SchedulerUtils.h"
 
 namespace android {
@@ -37,38 +38,6 @@ namespace scheduler {
  * This class represents information about individial layers.
  */
 class LayerInfo {
-    /**
-     * Struct that keeps the information about the refresh rate for last
-     * HISTORY_SIZE frames. This is used to better determine the refresh rate
-     * for individual layers.
-     */
-    class RefreshRateHistory {
-    public:
-        explicit RefreshRateHistory(nsecs_t minRefreshDuration)
-              : mMinRefreshDuration(minRefreshDuration) {}
-        void insertRefreshRate(int refreshRate) {
-            mElements.push_back(refreshRate);
-            if (mElements.size() > HISTORY_SIZE) {
-                mElements.pop_front();
-            }
-        }
-
-        float getRefreshRateAvg() const {
-            if (mElements.empty()) {
-                return 1e9f / mMinRefreshDuration;
-            }
-
-            return scheduler::calculate_mean(mElements);
-        }
-
-        void clearHistory() { mElements.clear(); }
-
-    private:
-        std::deque<nsecs_t> mElements;
-        static constexpr size_t HISTORY_SIZE = 30;
-        const nsecs_t mMinRefreshDuration;
-    };
-
     /**
      * Struct that keeps the information about the present time for last
      * HISTORY_SIZE frames. This is used to better determine whether the given layer
@@ -162,14 +131,31 @@ public:
         return mPresentTimeHistory.isRelevant();
     }
 
-    // Calculate the average refresh rate.
-    float getDesiredRefreshRate() const {
+    // Sets the area of the layer that is visible on screen, in pixels.
+    void setArea(float area) {
+        std::lock_guard lock(mLock);
+        mArea = area;
+    }
+
+    float getArea() const {
+        std::lock_guard lock(mLock);
+        return mArea;
+    }
+
+    // Returns the refresh rate that the layer content needs, and the confidence in it. Layers
+    // without a dominant frame period need the max refresh rate to avoid judder.
+    FrameRateEstimator::Estimate getDesiredRefreshRate() const {
         std::lock_guard lock(mLock);
 
         if (mPresentTimeHistory.isLowActivityLayer()) {
-            return 1e9f / mLowActivityRefreshDuration;
+            return {1e9f / mLowActivityRefreshDuration, 1.f};
         }
-        return mRefreshRateHistory.getRefreshRateAvg();
+
+        auto estimate = mFrameRateEstimator.getEstimate();
+        if (estimate.confidence < MIN_CONFIDENCE) {
+            estimate.fps = 1e9f / mMinRefreshDuration;
+        }
+        return estimate;
     }
 
     bool getHDRContent() {
@@ -193,21 +179,24 @@ public:
 
     void clearHistory() {
         std::lock_guard lock(mLock);
-        mRefreshRateHistory.clearHistory();
+        mFrameRateEstimator.clear();
         mPresentTimeHistory.clearHistory();
     }
 
 private:
+    // Content with fewer frame intervals matching its dominant period varies its frame rate.
+    static constexpr float MIN_CONFIDENCE = 0.5f;
+
     const std::string mName;
     const nsecs_t mMinRefreshDuration;
     const nsecs_t mLowActivityRefreshDuration;
     mutable std::mutex mLock;
     nsecs_t mLastUpdatedTime GUARDED_BY(mLock) = 0;
-    nsecs_t mLastPresentTime GUARDED_BY(mLock) = 0;
-    RefreshRateHistory mRefreshRateHistory GUARDED_BY(mLock);
+    FrameRateEstimator mFrameRateEstimator GUARDED_BY(mLock);
     PresentTimeHistory mPresentTimeHistory GUARDED_BY(mLock);
     bool mIsHDR GUARDED_BY(mLock) = false;
     bool mIsVisible GUARDED_BY(mLock) = false;
+    float mArea GUARDED_BY(mLock) = 0.f;
 };
 
 } // namespace scheduler
@@ -142,6 +142,21 @@ public:
             configIdToVsyncPeriod.emplace_back(i, configs.at(i)->getVsyncPeriod());
         }
 
+        // Leave out the configs the display reports it cannot refresh at, unless that is all of
+        // them, in which case the reported range is more likely wrong than the configs.
+        if (mSupportedRange) {
+            const auto isUnsupported = [this](const std::pair<int, nsecs_t>& config) {
+                return config.second > 0 && !mSupportedRange->contains(1e9f / config.second);
+            };
+            if (!std::all_of(configIdToVsyncPeriod.begin(), configIdToVsyncPeriod.end(),
+                             isUnsupported)) {
+                configIdToVsyncPeriod.erase(std::remove_if(configIdToVsyncPeriod.begin(),
+                                                           configIdToVsyncPeriod.end(),
+                                                           isUnsupported),
+                                            configIdToVsyncPeriod.end());
+            }
+        }
+
         // Sort the configs based on Refresh rate.
         std::sort(configIdToVsyncPeriod.begin(), configIdToVsyncPeriod.end(),
                   [](const std::pair<int, nsecs_t>& a, const std::pair<int, nsecs_t>& b) {
@@ -189,6 +204,16 @@ public:
 
     void setActiveConfig(int config) { mActiveConfig = config; }
 
+    // Sets the refresh rates the display supports according to the range limits of its EDID, if
+    // it has one. Takes effect on the next call to populate().
+    void setSupportedRange(std::optional<RefreshRateRange> range) { mSupportedRange = range; }
+    std::optional<RefreshRateRange> getSupportedRange() const { return mSupportedRange; }
+
+    // Sets the range the display can vary its refresh rate in, if its EDID has one. It does not
+    // filter configs: a display with a VRR range still accepts fixed rates outside of it.
+    void setVrrRange(std::optional<RefreshRateRange> range) { mVrrRange = range; }
+    std::optional<RefreshRateRange> getVrrRange() const { return mVrrRange; }
+
     RefreshRateType getMaxPerfRefreshRateType() const { return mMaxPerfRefreshRateType; }
 
     // Update the allowed Display Config(s) based on Smart Panel attribute.
@@ -234,6 +259,8 @@ public:
 private:
     std::map<RefreshRateType, std::shared_ptr<RefreshRate>> mRefreshRates;
     int mActiveConfig = 0;
+    std::optional<RefreshRateRange> mSupportedRange;
+    std::optional<RefreshRateRange> mVrrRange;
     RefreshRateType mMaxPerfRefreshRateType = RefreshRateType::PERFORMANCE;
 };
 
@@ -43,6 +43,7 @@
 #include "LayerInfo.h"
 #include "SchedulerUtils.h"
 #include "SurfaceFlingerProperties.h"
+#include "TimerDispatcher.h"
 
 namespace android {
 
@@ -366,6 +367,11 @@ void Scheduler::setLayerVisibility(
     mLayerHistory.setVisibility(layerHandle, visible);
 }
 
+void Scheduler::setLayerArea(
+        const std::unique_ptr<scheduler::LayerHistory::LayerHandle>& layerHandle, float area) {
+    mLayerHistory.setArea(layerHandle, area);
+}
+
 void Scheduler::withPrimaryDispSync(std::function<void(DispSync&)> const& fn) {
     fn(*mPrimaryDispSync);
 }
@@ -518,6 +524,10 @@ std::string Scheduler::doDump() {
     std::ostringstream stream;
     stream << "+  Idle timer interval: " << mSetIdleTimerMs << " ms" << std::endl;
     stream << "+  Touch timer interval: " << mSetTouchTimerMs << " ms" << std::endl;
+    if (mIdleTimer || mTouchTimer || mDisplayPowerTimer) {
+        stream << "+  Timer dispatcher wakeups: "
+               << scheduler::TimerDispatcher::getInstance()->getWakeupCount() << std::endl;
+    }
     return stream.str();
 }
 
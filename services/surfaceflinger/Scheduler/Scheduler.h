@@ -164,6 +164,9 @@ public:
     // Stores visibility for a layer.
     void setLayerVisibility(
             const std::unique_ptr<scheduler::LayerHistory::LayerHandle>& layerHandle, bool visible);
+    // Stores the visible area of a layer, which weighs its refresh rate vote.
+    void setLayerArea(const std::unique_ptr<scheduler::LayerHistory::LayerHandle>& layerHandle,
+                      float area);
     // Updates FPS based on the most content presented.
     void updateFpsBasedOnContent();
     // Callback that gets invoked when Scheduler wants to change the refresh rate.
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "TimerDispatcher"
+
+#include "TimerDispatcher.h"
+
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <log/log.h>
+#include <utils/Timers.h>
+
+#include "IdleTimer.h"
+
+namespace android {
+namespace scheduler {
+
+namespace {
+
+// Looper ident of the timerfd.
+constexpr int TIMER_FD_IDENT = 1;
+
+} // namespace
+
+std::shared_ptr<TimerDispatcher> TimerDispatcher::getInstance() {
+    static std::mutex sMutex;
+    static std::weak_ptr<TimerDispatcher> sInstance;
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::shared_ptr<TimerDispatcher> instance = sInstance.lock();
+    if (!instance) {
+        instance = std::make_shared<TimerDispatcher>();
+        sInstance = instance;
+    }
+    return instance;
+}
+
+TimerDispatcher::TimerDispatcher()
+      : mLooper(new Looper(false)),
+        mTimerFd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+    LOG_ALWAYS_FATAL_IF(mTimerFd < 0, "timerfd_create failed: %s", strerror(errno));
+    mLooper->addFd(mTimerFd, TIMER_FD_IDENT, Looper::EVENT_INPUT, nullptr, nullptr);
+    mThread = std::thread(&TimerDispatcher::loop, this);
+}
+
+TimerDispatcher::~TimerDispatcher() {
+    mStopping = true;
+    mLooper->wake();
+    mThread.join();
+}
+
+void TimerDispatcher::add(IdleTimer* timer) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (std::find(mTimers.begin(), mTimers.end(), timer) == mTimers.end()) {
+            mTimers.push_back(timer);
+        }
+    }
+    wake();
+}
+
+void TimerDispatcher::remove(IdleTimer* timer) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTimers.erase(std::remove(mTimers.begin(), mTimers.end(), timer), mTimers.end());
+    }
+    // Wait for the callbacks that were already collected.
+    std::lock_guard<std::mutex> lock(mCallbackMutex);
+}
+
+void TimerDispatcher::wake() {
+    mLooper->wake();
+}
+
+void TimerDispatcher::loop() {
+    pthread_setname_np(pthread_self(), "IdleTimers");
+
+    while (!mStopping) {
+        const int ident = mLooper->pollOnce(-1);
+        mWakeupCount++;
+        if (ident == TIMER_FD_IDENT) {
+            uint64_t expirations;
+            read(mTimerFd, &expirations, sizeof(expirations));
+        }
+        dispatch();
+    }
+}
+
+void TimerDispatcher::dispatch() {
+    std::lock_guard<std::mutex> callbackLock(mCallbackMutex);
+
+    std::vector<std::pair<IdleTimer*, IdleTimer::Callback>> callbacks;
+    nsecs_t nextDeadline = INT64_MAX;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (IdleTimer* timer : mTimers) {
+            nsecs_t deadline = INT64_MAX;
+            const IdleTimer::Callback callback = timer->poll(now, &deadline);
+            if (callback != IdleTimer::Callback::NONE) {
+                callbacks.emplace_back(timer, callback);
+            }
+            nextDeadline = std::min(nextDeadline, deadline);
+        }
+    }
+
+    // Arm the timer before running the callbacks, since they may reset timers.
+    armTimerFd(nextDeadline);
+
+    for (const auto& [timer, callback] : callbacks) {
+        timer->runCallback(callback);
+    }
+}
+
+void TimerDispatcher::armTimerFd(nsecs_t deadline) {
+    itimerspec spec = {};
+    if (deadline != INT64_MAX) {
+        // A zero it_value disarms the timer, so round already expired deadlines up to 1ns.
+        deadline = std::max(deadline, nsecs_t(1));
+        spec.it_value.tv_sec = deadline / 1000000000;
+        spec.it_value.tv_nsec = deadline % 1000000000;
+    }
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        ALOGE("timerfd_settime failed: %s", strerror(errno));
+    }
+}
+
+} // namespace scheduler
+} // namespace android
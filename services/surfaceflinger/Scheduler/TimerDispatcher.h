@@ -0,0 +1,84 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+#include <utils/Looper.h>
+#include <utils/Timers.h>
+
+namespace android {
+namespace scheduler {
+
+class IdleTimer;
+
+/*
+ * Runs the callbacks of all the started IdleTimers on a single thread, which sleeps on a Looper
+ * until the earliest deadline of the timers, using a single timerfd.
+ *
+ * IdleTimers only wake the thread up when their callbacks need to run. Resetting a timer that is
+ * waiting moves its deadline with an atomic store, and the thread picks up the new deadline when
+ * the old one expires, so frequent resets cost neither a syscall nor a context switch.
+ */
+class TimerDispatcher {
+public:
+    // Returns the dispatcher shared by all the IdleTimers, which exists for as long as any of
+    // them does.
+    static std::shared_ptr<TimerDispatcher> getInstance();
+
+    TimerDispatcher();
+    ~TimerDispatcher();
+
+    void add(IdleTimer* timer) EXCLUDES(mMutex);
+    // Once this returns, the callbacks of the timer are not running and will not run anymore.
+    // Must not be called from a callback.
+    void remove(IdleTimer* timer) EXCLUDES(mMutex, mCallbackMutex);
+
+    // Wakes the thread up to run the callbacks of the timers that changed state.
+    void wake();
+
+    // Returns how many times the thread has woken up since it started.
+    uint64_t getWakeupCount() const { return mWakeupCount; }
+
+private:
+    void loop();
+    void dispatch() EXCLUDES(mMutex, mCallbackMutex);
+    void armTimerFd(nsecs_t deadline);
+
+    const sp<Looper> mLooper;
+    const base::unique_fd mTimerFd;
+
+    std::mutex mMutex;
+    std::vector<IdleTimer*> mTimers GUARDED_BY(mMutex);
+
+    // Held while running the callbacks, so that remove() can wait for them to complete.
+    std::mutex mCallbackMutex;
+
+    std::atomic<bool> mStopping = false;
+    std::atomic<uint64_t> mWakeupCount = 0;
+
+    std::thread mThread;
+};
+
+} // namespace scheduler
+} // namespace android
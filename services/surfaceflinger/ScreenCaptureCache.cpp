@@ -0,0 +1,235 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "ScreenCaptureCache"
+
+#include "ScreenCaptureCache.h"
+
+#include <android-base/stringprintf.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <iterator>
+
+namespace android {
+
+using base::StringAppendF;
+
+bool ScreenCaptureCache::Key::operator==(const Key& other) const {
+    return uid == other.uid && pid == other.pid && source == other.source &&
+            excludedLayers == other.excludedLayers && sourceCrop == other.sourceCrop &&
+            reqWidth == other.reqWidth && reqHeight == other.reqHeight &&
+            reqDataspace == other.reqDataspace && reqPixelFormat == other.reqPixelFormat &&
+            rotation == other.rotation && useIdentityTransform == other.useIdentityTransform &&
+            captureSecureLayers == other.captureSecureLayers &&
+            childrenOnly == other.childrenOnly;
+}
+
+ScreenCaptureCache::ScreenCaptureCache(size_t capacity) : mCapacity(capacity) {}
+
+void ScreenCaptureCache::setCapacity(size_t capacity) {
+    std::vector<Entry> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCapacity = capacity;
+        while (mEntries.size() > mCapacity) {
+            evicted.push_back(std::move(mEntries.back()));
+            mEntries.pop_back();
+        }
+    }
+    // The buffers are freed here, outside of the lock.
+}
+
+void ScreenCaptureCache::invalidate() {
+    mGeneration++;
+    if (mHasEntries) {
+        clear();
+    }
+}
+
+bool ScreenCaptureCache::isEnabled() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mCapacity > 0;
+}
+
+bool ScreenCaptureCache::get(const Key& key, sp<GraphicBuffer>* outBuffer,
+                             bool* outCapturedSecureLayers) {
+    sp<GraphicBuffer> staleBuffer;
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = std::find_if(mEntries.begin(), mEntries.end(),
+                           [&](const Entry& entry) { return entry.key == key; });
+    if (it == mEntries.end()) {
+        return false;
+    }
+
+    if (it->generation != mGeneration) {
+        // Release the buffer after the lock, since freeing it may take a while.
+        staleBuffer = std::move(it->buffer);
+        mEntries.erase(it);
+        return false;
+    }
+
+    *outBuffer = it->buffer;
+    *outCapturedSecureLayers = it->capturedSecureLayers;
+    std::rotate(mEntries.begin(), it, it + 1);
+    return true;
+}
+
+void ScreenCaptureCache::put(const Key& key, uint64_t generation, const sp<GraphicBuffer>& buffer,
+                             bool capturedSecureLayers) {
+    std::vector<Entry> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mCapacity == 0) {
+            return;
+        }
+
+        const uint64_t currentGeneration = mGeneration;
+        auto it = std::remove_if(mEntries.begin(), mEntries.end(), [&](const Entry& entry) {
+            return entry.key == key || entry.generation != currentGeneration;
+        });
+        std::move(it, mEntries.end(), std::back_inserter(evicted));
+        mEntries.erase(it, mEntries.end());
+
+        if (generation != currentGeneration) {
+            // The drawing state changed while the capture was rendered.
+            return;
+        }
+
+        if (mEntries.size() >= mCapacity) {
+            evicted.push_back(std::move(mEntries.back()));
+            mEntries.pop_back();
+        }
+        mEntries.insert(mEntries.begin(), Entry{key, generation, buffer, capturedSecureLayers});
+        mHasEntries = true;
+    }
+    // The buffers are freed here, outside of the lock.
+}
+
+void ScreenCaptureCache::clear() {
+    std::vector<Entry> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        evicted.swap(mEntries);
+        mHasEntries = false;
+    }
+}
+
+size_t ScreenCaptureCache::size() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+// ---------------------------------------------------------------------------
+
+void ScreenCaptureStats::record(const Capture& capture) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCaptureCount++;
+    if (capture.cacheHit) {
+        mCacheHitCount++;
+    }
+    if (capture.result != NO_ERROR) {
+        mFailureCount++;
+    }
+    mCaptures[mNextCapture] = capture;
+    mNextCapture = (mNextCapture + 1) % MAX_CAPTURES;
+}
+
+void ScreenCaptureStats::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCaptureCount = 0;
+    mCacheHitCount = 0;
+    mFailureCount = 0;
+    mCaptures.fill(Capture());
+    mNextCapture = 0;
+}
+
+namespace {
+
+// Returns the given percentile of the samples, in milliseconds.
+float percentileMs(std::vector<nsecs_t>& samples, size_t percentile) {
+    if (samples.empty()) {
+        return 0.0f;
+    }
+    const size_t index = std::min(samples.size() * percentile / 100, samples.size() - 1);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index] / 1e6f;
+}
+
+void appendPercentiles(std::string& result, const char* name, std::vector<nsecs_t>& samples) {
+    StringAppendF(&result, "  %-10s p50=%.3fms p90=%.3fms p99=%.3fms\n", name,
+                  percentileMs(samples, 50), percentileMs(samples, 90),
+                  percentileMs(samples, 99));
+}
+
+} // namespace
+
+void ScreenCaptureStats::dump(std::string& result) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    StringAppendF(&result, "Screen captures: %" PRIu64 " (cache hits: %" PRIu64
+                  ", failed: %" PRIu64 ")\n",
+                  mCaptureCount, mCacheHitCount, mFailureCount);
+
+    const size_t count = std::min(mCaptureCount, uint64_t(MAX_CAPTURES));
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<nsecs_t> hits, misses, allocation, wait, render, gpu;
+    for (size_t i = 0; i < count; i++) {
+        const Capture& capture = mCaptures[(mNextCapture + MAX_CAPTURES - 1 - i) % MAX_CAPTURES];
+        if (capture.result != NO_ERROR) {
+            continue;
+        }
+        if (capture.cacheHit) {
+            hits.push_back(capture.total);
+        } else {
+            misses.push_back(capture.total);
+            allocation.push_back(capture.allocation);
+            wait.push_back(capture.wait);
+            render.push_back(capture.render);
+            gpu.push_back(capture.gpu);
+        }
+    }
+
+    StringAppendF(&result, "Latency of the last %zu captures (%zu cache hits):\n", count,
+                  hits.size());
+    appendPercentiles(result, "hit", hits);
+    appendPercentiles(result, "miss", misses);
+    appendPercentiles(result, "allocation", allocation);
+    appendPercentiles(result, "wait", wait);
+    appendPercentiles(result, "render", render);
+    appendPercentiles(result, "gpu", gpu);
+
+    result.append("Recent captures:\n");
+    for (size_t i = 0; i < std::min(count, MAX_DUMPED_CAPTURES); i++) {
+        const Capture& capture = mCaptures[(mNextCapture + MAX_CAPTURES - 1 - i) % MAX_CAPTURES];
+        StringAppendF(&result,
+                      "  %10" PRId64 "ms pid=%d %ux%u %s total=%.3fms allocation=%.3fms "
+                      "wait=%.3fms render=%.3fms gpu=%.3fms",
+                      ns2ms(capture.time), capture.pid, capture.width, capture.height,
+                      capture.cacheHit ? "hit " : "miss", capture.total / 1e6f,
+                      capture.allocation / 1e6f, capture.wait / 1e6f, capture.render / 1e6f,
+                      capture.gpu / 1e6f);
+        if (capture.result != NO_ERROR) {
+            StringAppendF(&result, " error=%d", capture.result);
+        }
+        result.append("\n");
+    }
+}
+
+} // namespace android
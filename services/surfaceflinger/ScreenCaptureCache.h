@@ -0,0 +1,154 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/GraphicTypes.h>
+#include <ui/Rect.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/*
+ * Remembers the last screenshots taken by clients so that a client that captures the same area
+ * again before anything changed gets a copy of its previous capture, without a render on the
+ * main thread. The capacity is shared by all clients: the least recently used capture is
+ * dropped first, whichever client took it.
+ *
+ * The cache holds the buffer that the client got for its capture, so a client that writes into
+ * its screenshot gets those writes back in a copy of a repeated capture. It is disabled unless
+ * debug.sf.screenshot_cache_size is set, for clients known to poll an unchanged screen.
+ */
+class ScreenCaptureCache {
+public:
+    // Everything that the content of a capture depends on, besides the drawing state.
+    struct Key {
+        // The client that took the capture. The uid keeps a reused pid from getting the
+        // capture of a process of another app.
+        uid_t uid = 0;
+        pid_t pid = 0;
+        // The display or the layer that is captured.
+        const void* source = nullptr;
+        // Layers excluded from a layer capture, sorted.
+        std::vector<const void*> excludedLayers;
+        Rect sourceCrop;
+        uint32_t reqWidth = 0;
+        uint32_t reqHeight = 0;
+        ui::Dataspace reqDataspace = ui::Dataspace::UNKNOWN;
+        ui::PixelFormat reqPixelFormat = ui::PixelFormat::RGBA_8888;
+        uint32_t rotation = 0;
+        bool useIdentityTransform = false;
+        bool captureSecureLayers = false;
+        bool childrenOnly = false;
+
+        bool operator==(const Key& other) const;
+    };
+
+    explicit ScreenCaptureCache(size_t capacity);
+
+    void setCapacity(size_t capacity);
+    bool isEnabled() const;
+
+    // Marks every cached capture as out of date and releases their buffers. Called whenever
+    // the drawing state changes.
+    void invalidate();
+
+    // The generation to pass to put() for a capture that is about to be rendered.
+    uint64_t getGeneration() const { return mGeneration; }
+
+    // Returns true and the buffer of a capture with the given key if nothing changed since it
+    // was rendered. The buffer was returned to the client of the capture, so only a copy of it
+    // may be returned again.
+    bool get(const Key& key, sp<GraphicBuffer>* outBuffer, bool* outCapturedSecureLayers);
+
+    // Caches a capture rendered at the given generation.
+    void put(const Key& key, uint64_t generation, const sp<GraphicBuffer>& buffer,
+             bool capturedSecureLayers);
+
+    void clear();
+    size_t size() const;
+
+private:
+    struct Entry {
+        Key key;
+        uint64_t generation;
+        sp<GraphicBuffer> buffer;
+        bool capturedSecureLayers;
+    };
+
+    std::atomic<uint64_t> mGeneration = 0;
+    // Whether there are entries to release on invalidate(), to keep the main thread off the
+    // lock while the cache is empty.
+    std::atomic<bool> mHasEntries = false;
+
+    mutable std::mutex mMutex;
+    size_t mCapacity GUARDED_BY(mMutex);
+    // The most recently used entry first.
+    std::vector<Entry> mEntries GUARDED_BY(mMutex);
+};
+
+/*
+ * Latency statistics of the screenshots taken by clients, printed by
+ * "dumpsys SurfaceFlinger --screenshots".
+ */
+class ScreenCaptureStats {
+public:
+    struct Capture {
+        nsecs_t time = 0;
+        pid_t pid = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        status_t result = NO_ERROR;
+        bool cacheHit = false;
+        // Time spent allocating the output buffer.
+        nsecs_t allocation = 0;
+        // Time spent waiting for the main thread, including retries while a refresh is pending.
+        nsecs_t wait = 0;
+        // Time spent composing the capture on the main thread.
+        nsecs_t render = 0;
+        // Time spent waiting for the GPU to finish rendering.
+        nsecs_t gpu = 0;
+        // Time from the request to the reply.
+        nsecs_t total = 0;
+    };
+
+    void record(const Capture& capture);
+    void clear();
+    void dump(std::string& result) const;
+
+private:
+    static constexpr size_t MAX_CAPTURES = 128;
+    static constexpr size_t MAX_DUMPED_CAPTURES = 16;
+
+    mutable std::mutex mMutex;
+    uint64_t mCaptureCount GUARDED_BY(mMutex) = 0;
+    uint64_t mCacheHitCount GUARDED_BY(mMutex) = 0;
+    uint64_t mFailureCount GUARDED_BY(mMutex) = 0;
+    // The last MAX_CAPTURES captures, in a ring.
+    std::array<Capture, MAX_CAPTURES> mCaptures GUARDED_BY(mMutex);
+    size_t mNextCapture GUARDED_BY(mMutex) = 0;
+};
+
+} // namespace android
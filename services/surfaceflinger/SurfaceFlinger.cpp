@@ -31,6 +31,7 @@
 #include <mutex>
 #include <optional>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <cutils/properties.h>
 #include <log/log.h>
@@ -246,6 +247,7 @@ const String16 sDump("android.permission.DUMP");
 int64_t SurfaceFlinger::dispSyncPresentTimeOffset;
 bool SurfaceFlinger::useHwcForRgbToYuv;
 uint64_t SurfaceFlinger::maxVirtualDisplaySize;
+int SurfaceFlinger::virtualDisplaySinkMode;
 bool SurfaceFlinger::hasSyncFramework;
 bool SurfaceFlinger::useVrFlinger;
 int64_t SurfaceFlinger::maxFrameBufferAcquiredBuffers;
@@ -347,7 +349,10 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory, SkipInitializationTag)
         mInterceptor(mFactory.createSurfaceInterceptor(this)),
         mTimeStats(mFactory.createTimeStats()),
         mEventQueue(mFactory.createMessageQueue()),
-        mCompositionEngine(mFactory.createCompositionEngine()) {}
+        mCompositionEngine(mFactory.createCompositionEngine()) {
+    // The drawing state is only traversed and modified on the main thread.
+    mDrawingState.enableTraversalCache(mMainThreadId);
+}
 
 SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipInitialization) {
     ALOGI("SurfaceFlinger is starting");
@@ -411,6 +416,9 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("ro.bq.gpu_to_cpu_unsupported", value, "0");
     mGpuToCpuSupported = !atoi(value);
 
+    property_get("debug.sf.virtual_display_sink_mode", value, "0");
+    virtualDisplaySinkMode = atoi(value);
+
     property_get("debug.sf.showupdates", value, "0");
     mDebugRegion = atoi(value);
 
@@ -461,6 +469,9 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.luma_sampling", value, "1");
     mLumaSampling = atoi(value);
 
+    property_get("debug.sf.screenshot_cache_size", value, "0");
+    mScreenCaptureCache.setCapacity(std::max(atoi(value), 0));
+
     char property[PROPERTY_VALUE_MAX] = {0};
     if((property_get("vendor.display.vsync_reliable_on_doze", property, "0") > 0) &&
         (!strncmp(property, "1", PROPERTY_VALUE_MAX ) ||
@@ -913,6 +924,10 @@ void SurfaceFlinger::init() {
 
     int active_config = getHwComposer().getActiveConfigIndex(*display->getId());
     mRefreshRateConfigs.setActiveConfig(active_config);
+    if (const auto capabilities = getHwComposer().getEdidCapabilities(*display->getId())) {
+        mRefreshRateConfigs.setSupportedRange(capabilities->refreshRateRange);
+        mRefreshRateConfigs.setVrrRange(capabilities->vrrRange);
+    }
     mRefreshRateConfigs.populate(getHwComposer().getConfigs(*display->getId()));
     mRefreshRateStats.setConfigMode(active_config);
 
@@ -2072,6 +2087,9 @@ void SurfaceFlinger::onMessageReceived(int32_t what) NO_THREAD_SAFETY_ANALYSIS {
     ATRACE_CALL();
     switch (what) {
         case MessageQueue::INVALIDATE: {
+            // Buffers latched and transactions applied below change what screenshots capture.
+            mScreenCaptureCache.invalidate();
+
             // calculate the expected present time once and use the cached
             // value throughout this frame to make sure all layers are
             // seeing this same value.
@@ -3597,6 +3615,9 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
             }
         });
         mTraversalNeededMainThread = false;
+        // Layers may have committed new z-orders, relatives or layer stacks to their drawing
+        // state.
+        mDrawingState.invalidateTraversalCache();
     }
 
     /*
@@ -3781,6 +3802,8 @@ void SurfaceFlinger::latchAndReleaseBuffer(const sp<Layer>& layer) {
 
 void SurfaceFlinger::commitTransaction()
 {
+    mScreenCaptureCache.invalidate();
+
     if (!mLayersPendingRemoval.isEmpty()) {
         // Notify removed layers now that they can't be drawn from
         for (const auto& l : mLayersPendingRemoval) {
@@ -3811,7 +3834,9 @@ void SurfaceFlinger::commitTransaction()
         // clear the "changed" flags in current state
         mCurrentState.colorMatrixChanged = false;
 
-        mDrawingState.traverseInZOrder([&](Layer* layer) {
+        // This traversal commits the child lists it walks, so it has to see the tree as it is
+        // updated rather than the cached traversal order.
+        mDrawingState.layersSortedByZ.traverseInZOrder(mDrawingState.stateSet, [&](Layer* layer) {
             layer->commitChildList();
 
             // If the layer can be reached when traversing mDrawingState, then the layer is no
@@ -3822,6 +3847,7 @@ void SurfaceFlinger::commitTransaction()
         });
 
         commitOffscreenLayers();
+        mDrawingState.invalidateTraversalCache();
     });
 
     mTransactionPending = false;
@@ -4347,40 +4373,11 @@ status_t SurfaceFlinger::addClientLayer(const sp<Client>& client, const sp<IBind
             parent = parentLayer;
         }
 
-        if (mNumLayers >= MAX_LAYERS) {
-            ALOGE("AddClientLayer failed, mNumLayers (%zu) >= MAX_LAYERS (%zu)", mNumLayers,
-                  MAX_LAYERS);
-            mCurrentState.traverseInZOrder([&](Layer* layer) {
-                const auto& p = layer->getParent();
-                ALOGE("layer (%s) ::  parent (%s).",
-                layer->getName().string(),
-                (p != nullptr) ? p->getName().string() : "no-parent");
-            });
+        if (exceedsMaxLayersLocked()) {
             return NO_MEMORY;
         }
 
-        mLayersByLocalBinderToken.emplace(handle->localBinder(), lbc);
-
-        if (parent == nullptr && addToCurrentState) {
-            mCurrentState.layersSortedByZ.add(lbc);
-        } else if (parent == nullptr) {
-            lbc->onRemovedFromCurrentState();
-        } else if (parent->isRemovedFromCurrentState()) {
-            parent->addChild(lbc);
-            lbc->onRemovedFromCurrentState();
-        } else {
-            parent->addChild(lbc);
-        }
-
-        if (gbc != nullptr) {
-            mGraphicBufferProducerList.insert(IInterface::asBinder(gbc).get());
-            LOG_ALWAYS_FATAL_IF(mGraphicBufferProducerList.size() >
-                                        mMaxGraphicBufferProducerListSize,
-                                "Suspected IGBP leak: %zu IGBPs (%zu max), %zu Layers",
-                                mGraphicBufferProducerList.size(),
-                                mMaxGraphicBufferProducerListSize, mNumLayers);
-        }
-        mLayersAdded = true;
+        addClientLayerLocked(handle, gbc, lbc, parent, addToCurrentState);
     }
 
     // attach this layer to the client
@@ -4389,6 +4386,50 @@ status_t SurfaceFlinger::addClientLayer(const sp<Client>& client, const sp<IBind
     return NO_ERROR;
 }
 
+void SurfaceFlinger::addClientLayerLocked(const sp<IBinder>& handle,
+                                          const sp<IGraphicBufferProducer>& gbc,
+                                          const sp<Layer>& lbc, const sp<Layer>& parent,
+                                          bool addToCurrentState) {
+    mLayersByLocalBinderToken.emplace(handle->localBinder(), lbc);
+
+    if (parent == nullptr && addToCurrentState) {
+        mCurrentState.layersSortedByZ.add(lbc);
+    } else if (parent == nullptr) {
+        lbc->onRemovedFromCurrentState();
+    } else if (parent->isRemovedFromCurrentState()) {
+        parent->addChild(lbc);
+        lbc->onRemovedFromCurrentState();
+    } else {
+        parent->addChild(lbc);
+    }
+
+    if (gbc != nullptr) {
+        mGraphicBufferProducerList.insert(IInterface::asBinder(gbc).get());
+        LOG_ALWAYS_FATAL_IF(mGraphicBufferProducerList.size() >
+                                    mMaxGraphicBufferProducerListSize,
+                            "Suspected IGBP leak: %zu IGBPs (%zu max), %zu Layers",
+                            mGraphicBufferProducerList.size(),
+                            mMaxGraphicBufferProducerListSize, mNumLayers);
+    }
+    mLayersAdded = true;
+}
+
+bool SurfaceFlinger::exceedsMaxLayersLocked() {
+    if (mNumLayers < MAX_LAYERS) {
+        return false;
+    }
+
+    ALOGE("AddClientLayer failed, mNumLayers (%zu) >= MAX_LAYERS (%zu)", mNumLayers,
+          MAX_LAYERS);
+    mCurrentState.traverseInZOrder([&](Layer* layer) {
+        const auto& p = layer->getParent();
+        ALOGE("layer (%s) ::  parent (%s).",
+        layer->getName().string(),
+        (p != nullptr) ? p->getName().string() : "no-parent");
+    });
+    return true;
+}
+
 uint32_t SurfaceFlinger::peekTransactionFlags() {
     return mTransactionFlags;
 }
@@ -4411,32 +4452,75 @@ uint32_t SurfaceFlinger::setTransactionFlags(uint32_t flags,
     return old;
 }
 
+void SurfaceFlinger::drainPendingTransactionsLocked() {
+    std::unique_ptr<TransactionState> transaction;
+    while (mPendingTransactions.pop(&transaction)) {
+        auto& transactionQueue = mTransactionQueues[transaction->applyToken];
+        transactionQueue.push(std::move(*transaction));
+    }
+}
+
+void SurfaceFlinger::applyPendingTransactionsLocked(std::vector<TransactionState>& transactions) {
+    drainPendingTransactionsLocked();
+
+    auto it = mTransactionQueues.begin();
+    while (it != mTransactionQueues.end()) {
+        auto& [applyToken, transactionQueue] = *it;
+
+        while (!transactionQueue.empty()) {
+            auto& transaction = transactionQueue.front();
+            // Transactions that their caller waits for are applied by the main thread, which
+            // never blocks on them.
+            if ((transaction.flags & (eSynchronous | eAnimation)) ||
+                transaction.inputWindowCommands.syncInputWindows ||
+                !transactionIsReadyToBeApplied(transaction.desiredPresentTime,
+                                               transaction.states)) {
+                break;
+            }
+            applyTransactionState(transaction.states, transaction.displays, transaction.flags,
+                                  transaction.inputWindowCommands, transaction.desiredPresentTime,
+                                  transaction.uncacheBuffers, transaction.callback,
+                                  transaction.postTime, transaction.privileged);
+            transactions.push_back(std::move(transaction));
+            transactionQueue.pop();
+        }
+
+        if (transactionQueue.empty()) {
+            it = mTransactionQueues.erase(it);
+            mTransactionCV.broadcast();
+        } else {
+            it = std::next(it, 1);
+        }
+    }
+}
+
 bool SurfaceFlinger::flushTransactionQueues() {
     // to prevent onHandleDestroyed from being called while the lock is held,
-    // we must keep a copy of the transactions (specifically the composer
-    // states) around outside the scope of the lock
-    std::vector<const TransactionState> transactions;
+    // we must keep the transactions (specifically the composer states) around
+    // outside the scope of the lock
+    std::vector<TransactionState> transactions;
     bool flushedATransaction = false;
     {
         Mutex::Autolock _l(mStateLock);
+        drainPendingTransactionsLocked();
 
         auto it = mTransactionQueues.begin();
         while (it != mTransactionQueues.end()) {
             auto& [applyToken, transactionQueue] = *it;
 
             while (!transactionQueue.empty()) {
-                const auto& transaction = transactionQueue.front();
+                auto& transaction = transactionQueue.front();
                 if (!transactionIsReadyToBeApplied(transaction.desiredPresentTime,
                                                    transaction.states)) {
                     setTransactionFlags(eTransactionFlushNeeded);
                     break;
                 }
-                transactions.push_back(transaction);
                 applyTransactionState(transaction.states, transaction.displays, transaction.flags,
-                                      mPendingInputWindowCommands, transaction.desiredPresentTime,
-                                      transaction.buffer, transaction.callback,
-                                      transaction.postTime, transaction.privileged,
-                                      /*isMainThread*/ true);
+                                      transaction.inputWindowCommands,
+                                      transaction.desiredPresentTime, transaction.uncacheBuffers,
+                                      transaction.callback, transaction.postTime,
+                                      transaction.privileged, /*isMainThread*/ true);
+                transactions.push_back(std::move(transaction));
                 transactionQueue.pop();
                 flushedATransaction = true;
             }
@@ -4453,7 +4537,7 @@ bool SurfaceFlinger::flushTransactionQueues() {
 }
 
 bool SurfaceFlinger::transactionFlushNeeded() {
-    return !mTransactionQueues.empty();
+    return !mTransactionQueues.empty() || !mPendingTransactions.empty();
 }
 
 bool SurfaceFlinger::containsAnyInvalidClientState(const Vector<ComposerState>& states) {
@@ -4505,7 +4589,7 @@ void SurfaceFlinger::setTransactionState(const Vector<ComposerState>& states,
                                          const sp<IBinder>& applyToken,
                                          const InputWindowCommands& inputWindowCommands,
                                          int64_t desiredPresentTime,
-                                         const client_cache_t& uncacheBuffer,
+                                         const std::vector<client_cache_t>& uncacheBuffers,
                                          const std::vector<ListenerCallbacks>& listenerCallbacks) {
     ATRACE_CALL();
 
@@ -4513,12 +4597,33 @@ void SurfaceFlinger::setTransactionState(const Vector<ComposerState>& states,
 
     bool privileged = callingThreadHasUnscopedSurfaceFlingerAccess();
 
-    Mutex::Autolock _l(mStateLock);
-
     if (containsAnyInvalidClientState(states)) {
         return;
     }
 
+    // Transactions that the caller does not wait for are handed to the main thread without
+    // taking mStateLock, and applied with the other transactions of the frame.
+    if (!(flags & (eSynchronous | eAnimation)) && !inputWindowCommands.syncInputWindows) {
+        mPendingTransactions.push(
+                std::make_unique<TransactionState>(applyToken, states, displays, flags,
+                                                   inputWindowCommands, desiredPresentTime,
+                                                   uncacheBuffers, listenerCallbacks, postTime,
+                                                   privileged));
+        const auto start = (flags & eEarlyWakeup) ? Scheduler::TransactionStart::EARLY
+                                                  : Scheduler::TransactionStart::NORMAL;
+        setTransactionFlags(eTransactionFlushNeeded, start);
+        return;
+    }
+
+    // Declared before the lock so that the applied transactions, and the layer handles they
+    // hold, are destroyed after it is released.
+    std::vector<TransactionState> pendingTransactions;
+    Mutex::Autolock _l(mStateLock);
+    // Transactions pushed before this one must be applied first. Apply those that are ready
+    // here instead of queueing this one behind them, so that the caller still waits for this
+    // transaction to be committed.
+    applyPendingTransactionsLocked(pendingTransactions);
+
     // If its TransactionQueue already has a pending TransactionState or if it is pending
     auto itr = mTransactionQueues.find(applyToken);
     // if this is an animation frame, wait until prior animation frame has
@@ -4532,27 +4637,29 @@ void SurfaceFlinger::setTransactionState(const Vector<ComposerState>& states,
                          "waiting for animation frame to apply");
                 break;
             }
+            applyPendingTransactionsLocked(pendingTransactions);
             itr = mTransactionQueues.find(applyToken);
         }
     }
     if (itr != mTransactionQueues.end() ||
         !transactionIsReadyToBeApplied(desiredPresentTime, states)) {
-        mTransactionQueues[applyToken].emplace(states, displays, flags, desiredPresentTime,
-                                               uncacheBuffer, listenerCallbacks, postTime,
+        mTransactionQueues[applyToken].emplace(applyToken, states, displays, flags,
+                                               inputWindowCommands, desiredPresentTime,
+                                               uncacheBuffers, listenerCallbacks, postTime,
                                                privileged);
         setTransactionFlags(eTransactionFlushNeeded);
         return;
     }
 
     applyTransactionState(states, displays, flags, inputWindowCommands, desiredPresentTime,
-                          uncacheBuffer, listenerCallbacks, postTime, privileged);
+                          uncacheBuffers, listenerCallbacks, postTime, privileged);
 }
 
 void SurfaceFlinger::applyTransactionState(const Vector<ComposerState>& states,
                                            const Vector<DisplayState>& displays, uint32_t flags,
                                            const InputWindowCommands& inputWindowCommands,
                                            const int64_t desiredPresentTime,
-                                           const client_cache_t& uncacheBuffer,
+                                           const std::vector<client_cache_t>& uncacheBuffers,
                                            const std::vector<ListenerCallbacks>& listenerCallbacks,
                                            const int64_t postTime, bool privileged,
                                            bool isMainThread) {
@@ -4588,6 +4695,15 @@ void SurfaceFlinger::applyTransactionState(const Vector<ComposerState>& states,
         mTransactionCompletedThread.addCallback(listener, callbackIds);
     }
 
+    // Erased before the states are set, so that the buffers they cache fit in the cache of the
+    // client even when it sends both along.
+    for (const client_cache_t& uncacheBuffer : uncacheBuffers) {
+        if (uncacheBuffer.isValid()) {
+            ClientCache::getInstance().erase(uncacheBuffer);
+            getRenderEngine().unbindExternalTextureBuffer(uncacheBuffer.id);
+        }
+    }
+
     uint32_t clientStateFlags = 0;
     for (const ComposerState& state : states) {
         clientStateFlags |= setClientStateLocked(state, desiredPresentTime, listenerCallbacks,
@@ -4602,11 +4718,6 @@ void SurfaceFlinger::applyTransactionState(const Vector<ComposerState>& states,
 
     transactionFlags |= addInputWindowCommands(inputWindowCommands);
 
-    if (uncacheBuffer.isValid()) {
-        ClientCache::getInstance().erase(uncacheBuffer);
-        getRenderEngine().unbindExternalTextureBuffer(uncacheBuffer.id);
-    }
-
     // If a synchronous transaction is explicitly requested without any changes, force a transaction
     // anyway. This can be used as a flush mechanism for previous async transactions.
     // Empty animation transaction can be used to simulate back-pressure, so also force a
@@ -4649,7 +4760,12 @@ void SurfaceFlinger::applyTransactionState(const Vector<ComposerState>& states,
         // another process through setTransactionState.  While a given process may wish
         // to wait on synchronous transactions, the main SF thread should never
         // be blocked.  Therefore, we only wait if isMainThread is false.
-        while (!isMainThread && (mTransactionPending || mPendingSyncInputWindows)) {
+        // Transactions that the caller does not wait for are applied from a binder thread
+        // only ahead of one it waits for, which waits below.
+        const bool callerWaits = (flags & (eSynchronous | eAnimation)) ||
+                inputWindowCommands.syncInputWindows;
+        while (!isMainThread && callerWaits &&
+               (mTransactionPending || mPendingSyncInputWindows)) {
             status_t err = mTransactionCV.waitRelative(mStateLock, s2ns(5));
             if (CC_UNLIKELY(err != NO_ERROR)) {
                 // just in case something goes wrong in SF, return to the
@@ -5017,12 +5133,129 @@ status_t SurfaceFlinger::createLayer(const String8& name, const sp<Client>& clie
             "Expected only one of parentLayer or parentHandle to be non-null. "
             "Programmer error?");
 
-    status_t result = NO_ERROR;
-
     sp<Layer> layer;
 
     String8 uniqueName = getUniqueLayerName(name);
 
+    status_t result = createClientLayer(client, uniqueName, w, h, format, flags,
+                                        std::move(metadata), handle, gbp, &layer);
+    if (result != NO_ERROR) {
+        return result;
+    }
+
+    bool addToCurrentState = callingThreadHasUnscopedSurfaceFlingerAccess();
+    result = addClientLayer(client, *handle, *gbp, layer, parentHandle, parentLayer,
+                            addToCurrentState);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    mInterceptor->saveSurfaceCreation(layer);
+
+    setTransactionFlags(eTransactionNeeded);
+    return result;
+}
+
+status_t SurfaceFlinger::createLayers(const sp<Client>& client,
+                                      const std::vector<SurfaceCreationArgs>& args,
+                                      std::vector<SurfaceCreationResult>* outResults) {
+    ATRACE_CALL();
+
+    if (args.empty() || args.size() > MAX_LAYERS) {
+        return BAD_VALUE;
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        // Parents come first, so that the tree is built in a single pass.
+        if (args[i].parentIndex < -1 || args[i].parentIndex >= int32_t(i) ||
+            (args[i].parentIndex >= 0 && args[i].parentHandle != nullptr)) {
+            ALOGE("createLayers() failed, invalid parent for layer %zu", i);
+            return BAD_VALUE;
+        }
+        if (int32_t(args[i].w | args[i].h) < 0) {
+            ALOGE("createLayers() failed, w or h is negative (w=%d, h=%d)", int(args[i].w),
+                  int(args[i].h));
+            return BAD_VALUE;
+        }
+    }
+
+    const std::vector<String8> uniqueNames = getUniqueLayerNames(args);
+
+    // The layers are only added to the state once all of them are created, and are destroyed
+    // along with their handles otherwise.
+    std::vector<SurfaceCreationResult> results(args.size());
+    std::vector<sp<Layer>> layers(args.size());
+    for (size_t i = 0; i < args.size(); i++) {
+        status_t result = createClientLayer(client, uniqueNames[i], args[i].w, args[i].h,
+                                            args[i].format, args[i].flags, args[i].metadata,
+                                            &results[i].handle, &results[i].gbp, &layers[i]);
+        if (result != NO_ERROR) {
+            return result;
+        }
+    }
+
+    const bool privileged = callingThreadHasUnscopedSurfaceFlingerAccess();
+    const int64_t postTime = systemTime();
+    uint32_t transactionFlags = eTransactionNeeded;
+    {
+        Mutex::Autolock _l(mStateLock);
+        std::vector<sp<Layer>> parents(args.size());
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i].parentHandle != nullptr) {
+                parents[i] = fromHandle(args[i].parentHandle);
+                if (parents[i] == nullptr) {
+                    return NAME_NOT_FOUND;
+                }
+            } else if (args[i].parentIndex >= 0) {
+                parents[i] = layers[args[i].parentIndex];
+            }
+        }
+
+        if (exceedsMaxLayersLocked()) {
+            return NO_MEMORY;
+        }
+
+        for (size_t i = 0; i < args.size(); i++) {
+            addClientLayerLocked(results[i].handle, results[i].gbp, layers[i], parents[i],
+                                 privileged);
+            client->attachLayer(results[i].handle, layers[i]);
+        }
+
+        // Applied like a transaction of the caller, now that the layers can be looked up.
+        Vector<ComposerState> states;
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i].state.what == 0) {
+                continue;
+            }
+            ComposerState state;
+            state.client = client;
+            state.state = args[i].state;
+            state.state.surface = results[i].handle;
+            transactionFlags |= setClientStateLocked(state, -1, {}, postTime, privileged);
+            states.add(state);
+        }
+
+        // The creations are recorded before the transaction that refers to the new layers.
+        for (const sp<Layer>& layer : layers) {
+            mInterceptor->saveSurfaceCreation(layer);
+        }
+        if (!states.isEmpty() && mInterceptor->isEnabled()) {
+            mInterceptor->saveTransaction(states, mCurrentState.displays, {}, 0);
+        }
+    }
+
+    setTransactionFlags(transactionFlags);
+    *outResults = std::move(results);
+    return NO_ERROR;
+}
+
+status_t SurfaceFlinger::createClientLayer(const sp<Client>& client, const String8& uniqueName,
+                                           uint32_t w, uint32_t h, PixelFormat format,
+                                           uint32_t flags, LayerMetadata metadata,
+                                           sp<IBinder>* handle, sp<IGraphicBufferProducer>* gbp,
+                                           sp<Layer>* outLayer) {
+    status_t result = NO_ERROR;
+
+    sp<Layer> layer;
+
     bool primaryDisplayOnly = false;
 
     // window type is WINDOW_TYPE_DONT_SCREENSHOT from SurfaceControl.java
@@ -5079,16 +5312,8 @@ status_t SurfaceFlinger::createLayer(const String8& name, const sp<Client>& clie
         layer->setPrimaryDisplayOnly();
     }
 
-    bool addToCurrentState = callingThreadHasUnscopedSurfaceFlingerAccess();
-    result = addClientLayer(client, *handle, *gbp, layer, parentHandle, parentLayer,
-                            addToCurrentState);
-    if (result != NO_ERROR) {
-        return result;
-    }
-    mInterceptor->saveSurfaceCreation(layer);
-
-    setTransactionFlags(eTransactionNeeded);
-    return result;
+    *outLayer = layer;
+    return NO_ERROR;
 }
 
 String8 SurfaceFlinger::getUniqueLayerName(const String8& name)
@@ -5119,6 +5344,29 @@ String8 SurfaceFlinger::getUniqueLayerName(const String8& name)
     return uniqueName;
 }
 
+std::vector<String8> SurfaceFlinger::getUniqueLayerNames(
+        const std::vector<SurfaceCreationArgs>& args) {
+    std::unordered_set<std::string> names;
+    {
+        Mutex::Autolock lock(mStateLock);
+        mCurrentState.traverseInZOrder(
+                [&](Layer* layer) { names.emplace(layer->getName().string()); });
+    }
+
+    std::vector<String8> uniqueNames;
+    uniqueNames.reserve(args.size());
+    for (const SurfaceCreationArgs& arg : args) {
+        uint32_t dupeCounter = 0;
+        String8 uniqueName;
+        // Names of the batch are taken as well, so that they are unique among themselves.
+        do {
+            uniqueName = arg.name + "#" + String8(std::to_string(dupeCounter++).c_str());
+        } while (!names.emplace(uniqueName.string()).second);
+        uniqueNames.push_back(uniqueName);
+    }
+    return uniqueNames;
+}
+
 status_t SurfaceFlinger::createBufferQueueLayer(const sp<Client>& client, const String8& name,
                                                 uint32_t w, uint32_t h, uint32_t flags,
                                                 LayerMetadata metadata, PixelFormat& format,
@@ -5234,7 +5482,12 @@ void SurfaceFlinger::onInitializeDisplays() {
     d.width = 0;
     d.height = 0;
     displays.add(d);
-    setTransactionState(state, displays, 0, nullptr, mPendingInputWindowCommands, -1, {}, {});
+    {
+        // Apply the state right away, since the power mode below depends on it.
+        Mutex::Autolock _l(mStateLock);
+        applyTransactionState(state, displays, 0, {}, -1, {}, {}, systemTime(),
+                              true /*privileged*/);
+    }
 
     setPowerModeInternal(display, HWC_POWER_MODE_NORMAL);
 
@@ -5500,7 +5753,10 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args,
                 {"--frame-events"s, dumper(&SurfaceFlinger::dumpFrameEventsLocked)},
                 {"--latency"s, argsDumper(&SurfaceFlinger::dumpStatsLocked)},
                 {"--latency-clear"s, argsDumper(&SurfaceFlinger::clearStatsLocked)},
+                {"--latency-percentiles"s,
+                 argsDumper(&SurfaceFlinger::dumpLatencyPercentilesLocked)},
                 {"--list"s, dumper(&SurfaceFlinger::listLayersLocked)},
+                {"--screenshots"s, dumper(&SurfaceFlinger::dumpScreenCaptureStats)},
                 {"--static-screen"s, dumper(&SurfaceFlinger::dumpStaticScreenStats)},
                 {"--timestats"s, protoDumper(&SurfaceFlinger::dumpTimeStats)},
                 {"--vsync"s, dumper(&SurfaceFlinger::dumpVSync)},
@@ -5807,6 +6063,15 @@ void SurfaceFlinger::dumpStatsLocked(const DumpArgs& args, std::string& result)
     }
 }
 
+void SurfaceFlinger::dumpLatencyPercentilesLocked(const DumpArgs& args,
+                                                  std::string& result) const {
+    mCurrentState.traverseInZOrder([&](Layer* layer) {
+        if (args.size() < 2 || String8(args[1]) == layer->getName()) {
+            layer->dumpFrameLatencyPercentiles(result);
+        }
+    });
+}
+
 void SurfaceFlinger::clearStatsLocked(const DumpArgs& args, std::string&) {
     mCurrentState.traverseInZOrder([&](Layer* layer) {
         if (args.size() < 2 || String8(args[1]) == layer->getName()) {
@@ -5840,6 +6105,7 @@ void SurfaceFlinger::appendSfConfigString(std::string& result) const {
     StringAppendF(&result, " PRESENT_TIME_OFFSET=%" PRId64, dispSyncPresentTimeOffset);
     StringAppendF(&result, " FORCE_HWC_FOR_RBG_TO_YUV=%d", useHwcForRgbToYuv);
     StringAppendF(&result, " MAX_VIRT_DISPLAY_DIM=%" PRIu64, maxVirtualDisplaySize);
+    StringAppendF(&result, " VIRT_DISPLAY_SINK_MODE=%d", virtualDisplaySinkMode);
     StringAppendF(&result, " RUNNING_WITHOUT_SYNC_FRAMEWORK=%d", !hasSyncFramework);
     StringAppendF(&result, " NUM_FRAMEBUFFER_SURFACE_BUFFERS=%" PRId64,
                   maxFrameBufferAcquiredBuffers);
@@ -5911,6 +6177,11 @@ void SurfaceFlinger::dumpFrameEventsLocked(std::string& result) {
     }
 }
 
+void SurfaceFlinger::dumpScreenCaptureStats(std::string& result) const {
+    mScreenCaptureStats.dump(result);
+    StringAppendF(&result, "Cached screenshots: %zu\n", mScreenCaptureCache.size());
+}
+
 void SurfaceFlinger::dumpBufferingStats(std::string& result) const {
     result.append("Buffering stats:\n");
     result.append("  [Layer name] <Active time> <Two buffer> "
@@ -5985,7 +6256,24 @@ void SurfaceFlinger::dumpDisplayIdentificationData(std::string& result) const {
 
         StringAppendF(&result, "port=%u pnpId=%s displayName=\"", port, edid->pnpId.data());
         result.append(edid->displayName.data(), edid->displayName.length());
-        result.append("\"\n");
+        result.append("\"");
+
+        const auto& capabilities = edid->capabilities;
+        if (const auto& timing = capabilities.preferredTiming) {
+            StringAppendF(&result, " preferredTiming=%ux%u@%.2fHz", timing->width,
+                          timing->height, timing->refreshRate);
+        }
+        if (const auto& range = capabilities.refreshRateRange) {
+            StringAppendF(&result, " refreshRateRange=[%u, %u]", range->min, range->max);
+        }
+        if (const auto& range = capabilities.vrrRange) {
+            StringAppendF(&result, " vrrRange=[%u, %u]", range->min, range->max);
+        }
+        if (const auto& hdr = capabilities.hdrStaticMetadata) {
+            StringAppendF(&result, " hdrEotfs=0x%x maxLuminance=%.1f minLuminance=%.4f",
+                          hdr->eotfs, hdr->maxLuminance, hdr->minLuminance);
+        }
+        result.append("\n");
     }
 }
 
@@ -6140,6 +6428,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
 
     dumpBufferingStats(result);
 
+    dumpScreenCaptureStats(result);
+    result.append("\n");
+
     /*
      * Dump the visible layer list
      */
@@ -6850,10 +7141,48 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& displayToken,
     DisplayRenderArea renderArea(display, sourceCrop, reqWidth, reqHeight, reqDataspace,
                                  renderAreaRotation, captureSecureLayers);
 
+    ScreenCaptureCache::Key cacheKey;
+    cacheKey.source = display.get();
+    cacheKey.sourceCrop = sourceCrop;
+    cacheKey.reqWidth = reqWidth;
+    cacheKey.reqHeight = reqHeight;
+    cacheKey.reqDataspace = reqDataspace;
+    cacheKey.reqPixelFormat = reqPixelFormat;
+    cacheKey.rotation = renderAreaRotation;
+    cacheKey.useIdentityTransform = useIdentityTransform;
+    cacheKey.captureSecureLayers = captureSecureLayers;
+
     auto traverseLayers = std::bind(&SurfaceFlinger::traverseLayersInDisplay, this, display,
                                     std::placeholders::_1);
     return captureScreenCommon(renderArea, traverseLayers, outBuffer, reqPixelFormat,
-                               useIdentityTransform, outCapturedSecureLayers);
+                               useIdentityTransform, outCapturedSecureLayers, cacheKey);
+}
+
+static status_t copyScreenshot(const sp<GraphicBuffer>& src, const sp<GraphicBuffer>& dst) {
+    ATRACE_CALL();
+    if (src->initCheck() != NO_ERROR || dst->initCheck() != NO_ERROR) {
+        return NO_MEMORY;
+    }
+    void* srcBits = nullptr;
+    status_t err = src->lock(GRALLOC_USAGE_SW_READ_OFTEN, &srcBits);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    void* dstBits = nullptr;
+    err = dst->lock(GRALLOC_USAGE_SW_WRITE_OFTEN, &dstBits);
+    if (err != NO_ERROR) {
+        src->unlock();
+        return err;
+    }
+    const size_t bpp = bytesPerPixel(src->getPixelFormat());
+    const size_t rowBytes = src->getWidth() * bpp;
+    for (uint32_t y = 0; y < src->getHeight(); y++) {
+        memcpy(static_cast<uint8_t*>(dstBits) + y * dst->getStride() * bpp,
+               static_cast<const uint8_t*>(srcBits) + y * src->getStride() * bpp, rowBytes);
+    }
+    dst->unlock();
+    src->unlock();
+    return NO_ERROR;
 }
 
 static Dataspace pickDataspaceFromColorMode(const ColorMode colorMode) {
@@ -6913,12 +7242,19 @@ status_t SurfaceFlinger::captureScreen(uint64_t displayOrLayerStack, Dataspace*
     DisplayRenderArea renderArea(display, Rect(), width, height, *outDataspace, captureOrientation,
                                  false /* captureSecureLayers */);
 
+    ScreenCaptureCache::Key cacheKey;
+    cacheKey.source = display.get();
+    cacheKey.reqWidth = width;
+    cacheKey.reqHeight = height;
+    cacheKey.reqDataspace = *outDataspace;
+    cacheKey.rotation = captureOrientation;
+
     auto traverseLayers = std::bind(&SurfaceFlinger::traverseLayersInDisplay, this, display,
                                     std::placeholders::_1);
     bool ignored = false;
     return captureScreenCommon(renderArea, traverseLayers, outBuffer, ui::PixelFormat::RGBA_8888,
                                false /* useIdentityTransform */,
-                               ignored /* outCapturedSecureLayers */);
+                               ignored /* outCapturedSecureLayers */, cacheKey);
 }
 
 status_t SurfaceFlinger::captureLayers(
@@ -7085,9 +7421,22 @@ status_t SurfaceFlinger::captureLayers(
         });
     };
 
+    ScreenCaptureCache::Key cacheKey;
+    cacheKey.source = parent.get();
+    for (const auto& layer : excludeLayers) {
+        cacheKey.excludedLayers.push_back(layer.get());
+    }
+    std::sort(cacheKey.excludedLayers.begin(), cacheKey.excludedLayers.end());
+    cacheKey.sourceCrop = crop;
+    cacheKey.reqWidth = reqWidth;
+    cacheKey.reqHeight = reqHeight;
+    cacheKey.reqDataspace = reqDataspace;
+    cacheKey.reqPixelFormat = reqPixelFormat;
+    cacheKey.childrenOnly = childrenOnly;
+
     bool outCapturedSecureLayers = false;
     return captureScreenCommon(renderArea, traverseLayers, outBuffer, reqPixelFormat, false,
-                               outCapturedSecureLayers);
+                               outCapturedSecureLayers, cacheKey);
 }
 
 status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
@@ -7095,26 +7444,73 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              sp<GraphicBuffer>* outBuffer,
                                              const ui::PixelFormat reqPixelFormat,
                                              bool useIdentityTransform,
-                                             bool& outCapturedSecureLayers) {
+                                             bool& outCapturedSecureLayers,
+                                             ScreenCaptureCache::Key cacheKey) {
     ATRACE_CALL();
 
+    ScreenCaptureStats::Capture capture;
+    capture.time = systemTime();
+    capture.pid = IPCThreadState::self()->getCallingPid();
+    capture.width = renderArea.getReqWidth();
+    capture.height = renderArea.getReqHeight();
+
     // TODO(b/116112787) Make buffer usage a parameter.
     const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN |
             GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
-    *outBuffer =
-            getFactory().createGraphicBuffer(renderArea.getReqWidth(), renderArea.getReqHeight(),
-                                             static_cast<android_pixel_format>(reqPixelFormat), 1,
-                                             usage, "screenshot");
+    const auto allocateScreenshot = [&]() {
+        return getFactory().createGraphicBuffer(renderArea.getReqWidth(),
+                                                renderArea.getReqHeight(),
+                                                static_cast<android_pixel_format>(reqPixelFormat),
+                                                1, usage, "screenshot");
+    };
+
+    cacheKey.uid = IPCThreadState::self()->getCallingUid();
+    cacheKey.pid = capture.pid;
+    const uint64_t generation = mScreenCaptureCache.getGeneration();
+    sp<GraphicBuffer> cachedBuffer;
+    if (mScreenCaptureCache.get(cacheKey, &cachedBuffer, &outCapturedSecureLayers)) {
+        ATRACE_NAME("Reusing previous screenshot");
+        const bool forSystem = cacheKey.uid == AID_GRAPHICS || cacheKey.uid == AID_SYSTEM;
+        capture.cacheHit = true;
+        if (outCapturedSecureLayers && !forSystem) {
+            ALOGW("FB is protected: PERMISSION_DENIED");
+            capture.result = PERMISSION_DENIED;
+        } else {
+            // The cached buffer is the one this client got for its previous capture, which
+            // it may still use, so it gets a copy.
+            const nsecs_t allocationStart = systemTime();
+            *outBuffer = allocateScreenshot();
+            capture.allocation = systemTime() - allocationStart;
+            capture.result = copyScreenshot(cachedBuffer, *outBuffer);
+            if (capture.result != NO_ERROR) {
+                outBuffer->clear();
+            }
+        }
+        capture.total = systemTime() - capture.time;
+        mScreenCaptureStats.record(capture);
+        return capture.result;
+    }
 
-    return captureScreenCommon(renderArea, traverseLayers, *outBuffer, useIdentityTransform,
-                               outCapturedSecureLayers);
+    const nsecs_t allocationStart = systemTime();
+    *outBuffer = allocateScreenshot();
+    capture.allocation = systemTime() - allocationStart;
+
+    capture.result = captureScreenCommon(renderArea, traverseLayers, *outBuffer,
+                                         useIdentityTransform, outCapturedSecureLayers, &capture);
+    if (capture.result == NO_ERROR) {
+        mScreenCaptureCache.put(cacheKey, generation, *outBuffer, outCapturedSecureLayers);
+    }
+    capture.total = systemTime() - capture.time;
+    mScreenCaptureStats.record(capture);
+    return capture.result;
 }
 
 status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              TraverseLayersFunction traverseLayers,
                                              const sp<GraphicBuffer>& buffer,
                                              bool useIdentityTransform,
-                                             bool& outCapturedSecureLayers) {
+                                             bool& outCapturedSecureLayers,
+                                             ScreenCaptureStats::Capture* outCapture) {
     // This mutex protects syncFd and captureResult for communication of the return values from the
     // main thread back to this Binder thread
     std::mutex captureMutex;
@@ -7122,10 +7518,12 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
     std::unique_lock<std::mutex> captureLock(captureMutex);
     int syncFd = -1;
     std::optional<status_t> captureResult;
+    nsecs_t renderTime = 0;
 
     const int uid = IPCThreadState::self()->getCallingUid();
     const bool forSystem = uid == AID_GRAPHICS || uid == AID_SYSTEM;
 
+    const nsecs_t postTime = systemTime();
     sp<LambdaMessage> message = new LambdaMessage([&] {
         // If there is a refresh pending, bug out early and tell the binder thread to try again
         // after the refresh.
@@ -7137,6 +7535,7 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
             return;
         }
 
+        const nsecs_t renderStart = systemTime();
         status_t result = NO_ERROR;
         int fd = -1;
         {
@@ -7147,10 +7546,12 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                                  outCapturedSecureLayers);
             });
         }
+        const nsecs_t renderEnd = systemTime();
 
         {
             std::unique_lock<std::mutex> captureLock(captureMutex);
             syncFd = fd;
+            renderTime = renderEnd - renderStart;
             captureResult = std::make_optional<status_t>(result);
             captureCondition.notify_one();
         }
@@ -7169,12 +7570,18 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
         }
         result = *captureResult;
     }
+    const nsecs_t renderedTime = systemTime();
 
     if (result == NO_ERROR) {
         sync_wait(syncFd, -1);
         close(syncFd);
     }
 
+    if (outCapture) {
+        outCapture->render = renderTime;
+        outCapture->wait = renderedTime - postTime - renderTime;
+        outCapture->gpu = systemTime() - renderedTime;
+    }
     return result;
 }
 
@@ -7316,12 +7723,50 @@ void SurfaceFlinger::setInputWindowsFinished() {
 
 // ---------------------------------------------------------------------------
 
+bool SurfaceFlinger::State::useTraversalCache() const {
+    if (traversalCacheOwner != std::this_thread::get_id()) {
+        return false;
+    }
+
+    if (!traversalCacheValid) {
+        if (traversalCacheUsers > 0) {
+            return false;
+        }
+
+        ATRACE_NAME("rebuildTraversalCache");
+        traversalCache.clear();
+        layersSortedByZ.traverseInZOrder(stateSet,
+                                         [&](Layer* layer) { traversalCache.emplace_back(layer); });
+        traversalCacheValid = true;
+    }
+    return true;
+}
+
 void SurfaceFlinger::State::traverseInZOrder(const LayerVector::Visitor& visitor) const {
-    layersSortedByZ.traverseInZOrder(stateSet, visitor);
+    if (!useTraversalCache()) {
+        layersSortedByZ.traverseInZOrder(stateSet, visitor);
+        return;
+    }
+
+    traversalCacheUsers++;
+    for (size_t i = 0; i < traversalCache.size(); i++) {
+        visitor(traversalCache[i].get());
+    }
+    traversalCacheUsers--;
 }
 
 void SurfaceFlinger::State::traverseInReverseZOrder(const LayerVector::Visitor& visitor) const {
-    layersSortedByZ.traverseInReverseZOrder(stateSet, visitor);
+    if (!useTraversalCache()) {
+        layersSortedByZ.traverseInReverseZOrder(stateSet, visitor);
+        return;
+    }
+
+    // The reverse z-order traversal visits layers in exactly the opposite order.
+    traversalCacheUsers++;
+    for (auto i = static_cast<int64_t>(traversalCache.size()) - 1; i >= 0; i--) {
+        visitor(traversalCache[i].get());
+    }
+    traversalCacheUsers--;
 }
 
 void SurfaceFlinger::traverseLayersInDisplay(const sp<const DisplayDevice>& display,
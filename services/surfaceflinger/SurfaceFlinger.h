@@ -54,11 +54,13 @@
 #include "FrameTracker.h"
 #include "LayerStats.h"
 #include "LayerVector.h"
+#include "MpscQueue.h"
 #include "Scheduler/RefreshRateConfigs.h"
 #include "Scheduler/RefreshRateStats.h"
 #include "Scheduler/Scheduler.h"
 #include "Scheduler/VSyncModulator.h"
 #include "SurfaceFlingerFactory.h"
+#include "ScreenCaptureCache.h"
 #include "SurfaceTracing.h"
 #include "TransactionCompletedThread.h"
 
@@ -258,6 +260,11 @@ public:
     // Equal to min(max_height, max_width).
     static uint64_t maxVirtualDisplaySize;
 
+    // How VirtualDisplaySurface feeds the sink: 0 from the composition thread,
+    // 1 from its own threads, waiting for the sink to have a buffer, and 2 from
+    // its own threads, dropping frames for which the sink has no buffer.
+    static int virtualDisplaySinkMode;
+
     // Controls the number of buffers SurfaceFlinger will allocate for use in
     // FramebufferSurface
     static int64_t maxFrameBufferAcquiredBuffers;
@@ -421,6 +428,7 @@ private:
             if (colorMatrixChanged) {
                 colorMatrix = other.colorMatrix;
             }
+            invalidateTraversalCache();
             return *this;
         }
 
@@ -433,6 +441,31 @@ private:
 
         void traverseInZOrder(const LayerVector::Visitor& visitor) const;
         void traverseInReverseZOrder(const LayerVector::Visitor& visitor) const;
+
+        // Traversals from the given thread reuse a flattened z-order list of all layers instead
+        // of walking the layer tree and its relative-z lists every time. The owner must call
+        // invalidateTraversalCache() whenever the layer hierarchy, z-order or layer stacks of
+        // this state change. Traversals from other threads always walk the tree.
+        void enableTraversalCache(std::thread::id owner) { traversalCacheOwner = owner; }
+        void invalidateTraversalCache() {
+            traversalCacheValid = false;
+            // Drop the references to the cached layers unless they are being iterated.
+            if (traversalCacheUsers == 0) {
+                traversalCache.clear();
+            }
+        }
+
+    private:
+        bool useTraversalCache() const;
+
+        std::thread::id traversalCacheOwner;
+        // Layers in z-order, grouped by layer stack since layersSortedByZ is sorted by layer
+        // stack first.
+        mutable std::vector<sp<Layer>> traversalCache;
+        mutable bool traversalCacheValid = false;
+        // Number of cached traversals in progress. The cache is not rebuilt while it is
+        // iterated, e.g. when a visitor traverses the state again.
+        mutable int traversalCacheUsers = 0;
     };
 
     /* ------------------------------------------------------------------------
@@ -454,7 +487,8 @@ private:
                              const Vector<DisplayState>& displays, uint32_t flags,
                              const sp<IBinder>& applyToken,
                              const InputWindowCommands& inputWindowCommands,
-                             int64_t desiredPresentTime, const client_cache_t& uncacheBuffer,
+                             int64_t desiredPresentTime,
+                             const std::vector<client_cache_t>& uncacheBuffers,
                              const std::vector<ListenerCallbacks>& listenerCallbacks) override;
     void bootFinished() override;
     bool authenticateSurfaceTexture(
@@ -626,14 +660,24 @@ private:
     /* ------------------------------------------------------------------------
      * Transactions
      */
+    struct TransactionState;
+
     void applyTransactionState(const Vector<ComposerState>& state,
                                const Vector<DisplayState>& displays, uint32_t flags,
                                const InputWindowCommands& inputWindowCommands,
                                const int64_t desiredPresentTime,
-                               const client_cache_t& uncacheBuffer,
+                               const std::vector<client_cache_t>& uncacheBuffers,
                                const std::vector<ListenerCallbacks>& listenerCallbacks,
                                const int64_t postTime, bool privileged, bool isMainThread = false)
             REQUIRES(mStateLock);
+    // Moves the transactions that binder threads pushed to mPendingTransactions into
+    // mTransactionQueues, in the order they were pushed.
+    void drainPendingTransactionsLocked() REQUIRES(mStateLock);
+    // Drains the pending transactions and applies, in order, those at the front of each queue
+    // that are ready and that no caller waits for. The applied transactions are moved to
+    // transactions so that they can be destroyed without mStateLock.
+    void applyPendingTransactionsLocked(std::vector<TransactionState>& transactions)
+            REQUIRES(mStateLock);
     // Returns true if at least one transaction was flushed
     bool flushTransactionQueues();
     // Returns true if there is at least one transaction that needs to be flushed
@@ -664,6 +708,17 @@ private:
                          sp<IBinder>* handle, sp<IGraphicBufferProducer>* gbp,
                          const sp<IBinder>& parentHandle, const sp<Layer>& parentLayer = nullptr);
 
+    // Creates a tree of layers under a single acquisition of mStateLock, see
+    // ISurfaceComposerClient::createSurfaces.
+    status_t createLayers(const sp<Client>& client, const std::vector<SurfaceCreationArgs>& args,
+                          std::vector<SurfaceCreationResult>* outResults);
+
+    // Creates a layer of the type given by flags, which is not yet part of any state.
+    status_t createClientLayer(const sp<Client>& client, const String8& uniqueName, uint32_t w,
+                               uint32_t h, PixelFormat format, uint32_t flags,
+                               LayerMetadata metadata, sp<IBinder>* handle,
+                               sp<IGraphicBufferProducer>* gbp, sp<Layer>* outLayer);
+
     status_t createBufferQueueLayer(const sp<Client>& client, const String8& name, uint32_t w,
                                     uint32_t h, uint32_t flags, LayerMetadata metadata,
                                     PixelFormat& format, sp<IBinder>* outHandle,
@@ -682,6 +737,8 @@ private:
                                   sp<IBinder>* outHandle, sp<Layer>* outLayer);
 
     String8 getUniqueLayerName(const String8& name);
+    // Same as getUniqueLayerName for each name, going through the layers once.
+    std::vector<String8> getUniqueLayerNames(const std::vector<SurfaceCreationArgs>& args);
 
     // called when all clients have released all their references to
     // this layer meaning it is entirely safe to destroy all
@@ -694,6 +751,11 @@ private:
                             const sp<IGraphicBufferProducer>& gbc, const sp<Layer>& lbc,
                             const sp<IBinder>& parentHandle, const sp<Layer>& parentLayer,
                             bool addToCurrentState);
+    void addClientLayerLocked(const sp<IBinder>& handle, const sp<IGraphicBufferProducer>& gbc,
+                              const sp<Layer>& lbc, const sp<Layer>& parent,
+                              bool addToCurrentState) REQUIRES(mStateLock);
+    // Logs the layer tree if there are too many layers to add one more.
+    bool exceedsMaxLayersLocked() REQUIRES(mStateLock);
 
     // Traverse through all the layers and compute and cache its bounds.
     void computeLayerBounds();
@@ -709,12 +771,16 @@ private:
     void renderScreenImplLocked(const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                 ANativeWindowBuffer* buffer, bool useIdentityTransform,
                                 int* outSyncFd);
+    // Returns the buffer of the caller's previous capture with the same key if nothing changed
+    // since then, and renders into a new buffer otherwise.
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  sp<GraphicBuffer>* outBuffer, const ui::PixelFormat reqPixelFormat,
-                                 bool useIdentityTransform, bool& outCapturedSecureLayers);
+                                 bool useIdentityTransform, bool& outCapturedSecureLayers,
+                                 ScreenCaptureCache::Key cacheKey);
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  const sp<GraphicBuffer>& buffer, bool useIdentityTransform,
-                                 bool& outCapturedSecureLayers);
+                                 bool& outCapturedSecureLayers,
+                                 ScreenCaptureStats::Capture* outCapture);
     const sp<DisplayDevice> getDisplayByIdOrLayerStack(uint64_t displayOrLayerStack);
     status_t captureScreenImplLocked(const RenderArea& renderArea,
                                      TraverseLayersFunction traverseLayers,
@@ -956,6 +1022,8 @@ private:
     void listLayersLocked(std::string& result) const;
     void dumpStatsLocked(const DumpArgs& args, std::string& result) const REQUIRES(mStateLock);
     void clearStatsLocked(const DumpArgs& args, std::string& result);
+    void dumpLatencyPercentilesLocked(const DumpArgs& args, std::string& result) const
+            REQUIRES(mStateLock);
     void dumpTimeStats(const DumpArgs& args, bool asProto, std::string& result) const;
     void logFrameStats();
 
@@ -967,6 +1035,7 @@ private:
     void recordBufferingStats(const char* layerName,
             std::vector<OccupancyTracker::Segment>&& history);
     void dumpBufferingStats(std::string& result) const;
+    void dumpScreenCaptureStats(std::string& result) const;
     void dumpDisplayIdentificationData(std::string& result) const;
     void dumpWideColorInfo(std::string& result) const;
     LayersProto dumpProtoInfo(LayerVector::StateSet stateSet,
@@ -1128,6 +1197,9 @@ private:
     bool mTracingEnabled = false;
     bool mTracingEnabledChanged GUARDED_BY(mStateLock) = false;
     LayerStats mLayerStats;
+    // Screenshots of clients, see captureScreenCommon().
+    ScreenCaptureCache mScreenCaptureCache{0};
+    ScreenCaptureStats mScreenCaptureStats;
     const std::shared_ptr<TimeStats> mTimeStats;
     bool mUseHwcVirtualDisplays = false;
     bool mUseFbScaling = false;
@@ -1169,29 +1241,39 @@ private:
         }
     };
     struct TransactionState {
-        TransactionState(const Vector<ComposerState>& composerStates,
+        TransactionState(const sp<IBinder>& applyToken,
+                         const Vector<ComposerState>& composerStates,
                          const Vector<DisplayState>& displayStates, uint32_t transactionFlags,
-                         int64_t desiredPresentTime, const client_cache_t& uncacheBuffer,
+                         const InputWindowCommands& inputWindowCommands,
+                         int64_t desiredPresentTime,
+                         const std::vector<client_cache_t>& uncacheBuffers,
                          const std::vector<ListenerCallbacks>& listenerCallbacks, int64_t postTime,
                          bool privileged)
-              : states(composerStates),
+              : applyToken(applyToken),
+                states(composerStates),
                 displays(displayStates),
                 flags(transactionFlags),
+                inputWindowCommands(inputWindowCommands),
                 desiredPresentTime(desiredPresentTime),
-                buffer(uncacheBuffer),
+                uncacheBuffers(uncacheBuffers),
                 callback(listenerCallbacks),
                 postTime(postTime),
                 privileged(privileged) {}
 
+        sp<IBinder> applyToken;
         Vector<ComposerState> states;
         Vector<DisplayState> displays;
         uint32_t flags;
+        InputWindowCommands inputWindowCommands;
         const int64_t desiredPresentTime;
-        client_cache_t buffer;
+        std::vector<client_cache_t> uncacheBuffers;
         std::vector<ListenerCallbacks> callback;
         const int64_t postTime;
         bool privileged;
     };
+    // Transactions that binder threads pushed without taking mStateLock. They are moved to
+    // mTransactionQueues under mStateLock, which also makes sure there is one consumer at a time.
+    MpscQueue<std::unique_ptr<TransactionState>> mPendingTransactions;
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IBinderHash> mTransactionQueues;
 
     /* ------------------------------------------------------------------------
@@ -190,6 +190,7 @@ public:
     bool displayDeletionFound(const Increment& increment, const int32_t targetId,
             bool foundDisplay);
     bool singleIncrementFound(const Trace& trace, Increment::IncrementCase incrementCase);
+    bool surfaceTreeCreationFound(const Trace& trace);
 
     // Verification of buffer updates
     bool bufferUpdatesFound(const Trace& trace);
@@ -210,6 +211,7 @@ public:
     void secureFlagUpdate(Transaction&);
     void deferredTransactionUpdate(Transaction&);
     void surfaceCreation(Transaction&);
+    void surfaceTreeCreation();
     void displayCreation(Transaction&);
     void displayDeletion(Transaction&);
 
@@ -396,6 +398,21 @@ void SurfaceInterceptorTest::surfaceCreation(Transaction&) {
             PIXEL_FORMAT_RGBA_8888, 0);
 }
 
+void SurfaceInterceptorTest::surfaceTreeCreation() {
+    std::vector<SurfaceCreationArgs> args(1);
+    args[0].name = String8(LAYER_NAME);
+    args[0].w = SIZE_UPDATE;
+    args[0].h = SIZE_UPDATE;
+    args[0].format = PIXEL_FORMAT_RGBA_8888;
+    args[0].state.what = layer_state_t::ePositionChanged;
+    args[0].state.x = POSITION_UPDATE;
+    args[0].state.y = POSITION_UPDATE;
+
+    std::vector<sp<SurfaceControl>> surfaces;
+    ASSERT_EQ(NO_ERROR, mComposerClient->createSurfaces(args, &surfaces));
+    Transaction().apply(true);
+}
+
 void SurfaceInterceptorTest::nBufferUpdates() {
     std::random_device rd;
     std::mt19937_64 gen(rd());
@@ -723,6 +740,29 @@ bool SurfaceInterceptorTest::singleIncrementFound(const Trace& trace,
     return foundIncrement;
 }
 
+bool SurfaceInterceptorTest::surfaceTreeCreationFound(const Trace& trace) {
+    // The initial state of a surface is recorded as a transaction after its creation.
+    const int32_t targetId = getSurfaceId(trace, UNIQUE_LAYER_NAME);
+    bool foundSurface = false;
+    bool foundPosition = false;
+    for (const auto& increment : trace.increment()) {
+        if (increment.increment_case() == increment.kSurfaceCreation) {
+            foundSurface = surfaceCreationFound(increment, foundSurface);
+        } else if (increment.increment_case() == increment.kTransaction) {
+            for (const auto& change : increment.transaction().surface_change()) {
+                if (change.id() == targetId &&
+                    change.SurfaceChange_case() == SurfaceChange::SurfaceChangeCase::kPosition) {
+                    if (!foundSurface) {
+                        return false;
+                    }
+                    foundPosition = positionUpdateFound(change, foundPosition);
+                }
+            }
+        }
+    }
+    return foundSurface && foundPosition;
+}
+
 bool SurfaceInterceptorTest::bufferUpdatesFound(const Trace& trace) {
     uint32_t updates = 0;
     for (const auto& inc : trace.increment()) {
@@ -808,6 +848,11 @@ TEST_F(SurfaceInterceptorTest, InterceptSurfaceCreationWorks) {
             Increment::IncrementCase::kSurfaceCreation);
 }
 
+TEST_F(SurfaceInterceptorTest, InterceptSurfaceTreeCreationWorks) {
+    captureTest(&SurfaceInterceptorTest::surfaceTreeCreation,
+                &SurfaceInterceptorTest::surfaceTreeCreationFound);
+}
+
 TEST_F(SurfaceInterceptorTest, InterceptDisplayCreationWorks) {
     captureTest(&SurfaceInterceptorTest::displayCreation,
             Increment::IncrementCase::kDisplayCreation);
@@ -29,6 +29,7 @@
 #include <binder/ProcessState.h>
 #include <gui/BufferItemConsumer.h>
 #include <gui/IProducerListener.h>
+#include <gui/LayerDebugInfo.h>
 #include <gui/ISurfaceComposer.h>
 #include <gui/LayerState.h>
 #include <gui/Surface.h>
@@ -758,6 +759,65 @@ TEST_P(LayerRenderTypeTransactionTest, SetPositionBasic_BufferQueue) {
     }
 }
 
+TEST_P(LayerRenderTypeTransactionTest, SetPositionMixedAsyncAndSync_BufferQueue) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(layer = createLayer("test", 32, 32));
+    ASSERT_NO_FATAL_FAILURE(fillBufferQueueLayerColor(layer, Color::RED, 32, 32));
+
+    // Asynchronous transactions are queued to the main thread, while synchronous ones are
+    // applied by the binder thread. Both come from the same apply token here, so they must
+    // still be applied in the order they were sent.
+    for (int i = 1; i <= 10; i++) {
+        Transaction().setPosition(layer, 4 * i, 4 * i).apply();
+    }
+    Transaction().setPosition(layer, 5, 10).apply(true);
+    {
+        SCOPED_TRACE("synchronous after asynchronous");
+        const Rect rect(5, 10, 37, 42);
+        auto shot = getScreenCapture();
+        shot->expectColor(rect, Color::RED);
+        shot->expectBorder(rect, Color::BLACK);
+    }
+
+    Transaction().setPosition(layer, 20, 30).apply();
+    Transaction().setPosition(layer, 15, 25).apply(true);
+    Transaction().setPosition(layer, 40, 50).apply();
+    Transaction().apply(true);
+    {
+        SCOPED_TRACE("asynchronous after synchronous");
+        const Rect rect(40, 50, 72, 82);
+        auto shot = getScreenCapture();
+        shot->expectColor(rect, Color::RED);
+        shot->expectBorder(rect, Color::BLACK);
+    }
+}
+
+TEST_F(LayerTransactionTest, SynchronousApplyReturnsAfterCommit) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(layer = createLayer("sync-apply-test", 32, 32));
+    ASSERT_NO_FATAL_FAILURE(fillBufferQueueLayerColor(layer, Color::RED, 32, 32));
+
+    // The layer debug info reports the position the last commit applied, without waiting for
+    // a frame, so it only matches once the synchronous transaction has been committed, even
+    // when asynchronous transactions from the same apply token are still in flight.
+    const auto sf = ComposerService::getComposerService();
+    for (int i = 1; i <= 10; i++) {
+        for (int j = 1; j <= 10; j++) {
+            Transaction().setPosition(layer, 4 * j, 4 * j).apply();
+        }
+        Transaction().setPosition(layer, i, 2 * i).apply(true);
+
+        std::vector<LayerDebugInfo> layers;
+        ASSERT_EQ(NO_ERROR, sf->getLayerDebugInfo(&layers));
+        const auto it = std::find_if(layers.begin(), layers.end(), [](const LayerDebugInfo& info) {
+            return info.mName.find("sync-apply-test") == 0;
+        });
+        ASSERT_NE(layers.end(), it);
+        EXPECT_EQ(static_cast<float>(i), it->mX);
+        EXPECT_EQ(static_cast<float>(2 * i), it->mY);
+    }
+}
+
 TEST_P(LayerRenderTypeTransactionTest, SetPositionRounding_BufferQueue) {
     sp<SurfaceControl> layer;
     ASSERT_NO_FATAL_FAILURE(layer = createLayer("test", 32, 32));
@@ -2699,6 +2759,49 @@ TEST_P(LayerRenderTypeTransactionTest, SetBufferCaching_DestroyedBuffer_BufferSt
     }
 }
 
+TEST_P(LayerRenderTypeTransactionTest, SetBufferCaching_EvictedBuffer_BufferState) {
+    sp<SurfaceControl> layer;
+    ASSERT_NO_FATAL_FAILURE(
+            layer = createLayer("test", 32, 32, ISurfaceComposerClient::eFXSurfaceBufferState));
+
+    std::array<Color, 4> colors = {Color::RED, Color::BLUE, Color::WHITE, Color::GREEN};
+
+    std::array<sp<GraphicBuffer>, 70> buffers;
+
+    size_t idx = 0;
+    for (auto& buffer : buffers) {
+        buffer = new GraphicBuffer(32, 32, PIXEL_FORMAT_RGBA_8888, 1,
+                                   BufferUsage::CPU_READ_OFTEN | BufferUsage::CPU_WRITE_OFTEN |
+                                           BufferUsage::COMPOSER_OVERLAY,
+                                   "test");
+        Color color = colors[idx % colors.size()];
+        fillGraphicBufferColor(buffer, Rect(0, 0, 32, 32), color);
+        idx++;
+    }
+
+    const auto statsBefore = SurfaceComposerClient::getBufferCacheStats();
+    for (auto& buffer : buffers) {
+        Transaction().setBuffer(layer, buffer).apply();
+    }
+    const auto stats = SurfaceComposerClient::getBufferCacheStats();
+    EXPECT_EQ(statsBefore.misses + buffers.size(), stats.misses);
+    // The cache of the client holds 64 buffers.
+    EXPECT_LE(statsBefore.evictions + buffers.size() - 64, stats.evictions);
+    // The evictions are uncached along with the transactions that cache the new buffers.
+    EXPECT_LE(statsBefore.uncaches + stats.evictions - statsBefore.evictions, stats.uncaches);
+
+    // The first buffers were evicted, so they are cached again.
+    for (size_t i = 0; i < 2; i++) {
+        Transaction().setBuffer(layer, buffers[0]).apply();
+
+        auto shot = screenshot();
+        shot->expectColor(Rect(0, 0, mDisplayWidth, mDisplayHeight), colors[0]);
+        shot->expectBorder(Rect(0, 0, mDisplayWidth, mDisplayHeight), Color::BLACK);
+    }
+    EXPECT_EQ(stats.misses + 1, SurfaceComposerClient::getBufferCacheStats().misses);
+    EXPECT_EQ(stats.hits + 1, SurfaceComposerClient::getBufferCacheStats().hits);
+}
+
 TEST_P(LayerRenderTypeTransactionTest, SetTransformRotate90_BufferState) {
     sp<SurfaceControl> layer;
     ASSERT_NO_FATAL_FAILURE(
@@ -2934,6 +3037,50 @@ TEST_F(LayerTransactionTest, ReparentToSelf) {
     }
 }
 
+TEST_F(LayerTransactionTest, CreateSurfacesBuildsTreeWithInitialState) {
+    std::vector<SurfaceCreationArgs> args(2);
+    args[0].name = "parent";
+    args[0].flags = ISurfaceComposerClient::eFXSurfaceContainer;
+    args[0].state.what = layer_state_t::ePositionChanged | layer_state_t::eLayerChanged |
+            layer_state_t::eLayerStackChanged;
+    args[0].state.x = 32;
+    args[0].state.y = 32;
+    args[0].state.z = mLayerZBase;
+    args[0].state.layerStack = mDisplayLayerStack;
+
+    args[1].name = "child";
+    args[1].format = PIXEL_FORMAT_RGBA_8888;
+    args[1].flags = ISurfaceComposerClient::eFXSurfaceColor;
+    args[1].parentIndex = 0;
+    args[1].state.what = layer_state_t::eColorChanged | layer_state_t::eCropChanged_legacy;
+    args[1].state.color = half3(1.0f, 0.0f, 0.0f);
+    args[1].state.crop_legacy = Rect(0, 0, 32, 32);
+
+    std::vector<sp<SurfaceControl>> surfaces;
+    ASSERT_EQ(NO_ERROR, mClient->createSurfaces(args, &surfaces));
+    ASSERT_EQ(args.size(), surfaces.size());
+
+    // Waits for the layers to be committed.
+    Transaction().apply(true);
+    const Rect rect(32, 32, 64, 64);
+    auto shot = screenshot();
+    shot->expectColor(rect, Color::RED);
+    shot->expectBorder(rect, Color::BLACK);
+}
+
+TEST_F(LayerTransactionTest, CreateSurfacesRejectsParentCreatedAfterChild) {
+    std::vector<SurfaceCreationArgs> args(2);
+    args[0].name = "child";
+    args[0].flags = ISurfaceComposerClient::eFXSurfaceContainer;
+    args[0].parentIndex = 1;
+    args[1].name = "parent";
+    args[1].flags = ISurfaceComposerClient::eFXSurfaceContainer;
+
+    std::vector<sp<SurfaceControl>> surfaces;
+    EXPECT_EQ(BAD_VALUE, mClient->createSurfaces(args, &surfaces));
+    EXPECT_TRUE(surfaces.empty());
+}
+
 class ColorTransformHelper {
 public:
     static void DegammaColorSingle(half& s) {
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/ISurfaceComposerClient.h>
+#include <gui/SurfaceComposerClient.h>
+#include <gui/SurfaceControl.h>
+#include <ui/GraphicBuffer.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace {
+
+using Transaction = SurfaceComposerClient::Transaction;
+
+// Each thread is a producer that queues its buffers in turn to its own BufferStateLayer, as
+// apps drawing through BLAST do. Once the buffers of all producers outgrow the buffer cache of
+// the process, every transaction evicts a buffer.
+void BM_BufferCache_Producers(benchmark::State& state) {
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    if (client->initCheck() != NO_ERROR) {
+        state.SkipWithError("Failed to connect to SurfaceFlinger");
+        return;
+    }
+
+    const std::string name = "producer " + std::to_string(state.thread_index);
+    sp<SurfaceControl> layer =
+            client->createSurface(String8(name.c_str()), 0, 0, PIXEL_FORMAT_RGBA_8888,
+                                  ISurfaceComposerClient::eFXSurfaceBufferState);
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (int i = 0; i < state.range(0); i++) {
+        buffers.push_back(new GraphicBuffer(32, 32, PIXEL_FORMAT_RGBA_8888, 1,
+                                            GraphicBuffer::USAGE_HW_COMPOSER, name));
+    }
+
+    // The buffer cache is shared by the threads, which run the benchmark at the same time.
+    const auto statsBefore = SurfaceComposerClient::getBufferCacheStats();
+    size_t index = 0;
+    for (auto _ : state) {
+        Transaction().setBuffer(layer, buffers[index]).apply();
+        index = (index + 1) % buffers.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index == 0) {
+        const auto stats = SurfaceComposerClient::getBufferCacheStats();
+        state.counters["hits"] = benchmark::Counter(double(stats.hits - statsBefore.hits),
+                                                    benchmark::Counter::kIsRate);
+        state.counters["evictions"] =
+                benchmark::Counter(double(stats.evictions - statsBefore.evictions),
+                                   benchmark::Counter::kIsRate);
+    }
+}
+BENCHMARK(BM_BufferCache_Producers)->Arg(3)->Arg(8)->ThreadRange(1, 16)->UseRealTime();
+
+} // namespace
+} // namespace android
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <dirent.h>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DisplayHardware/DisplayIdentification.h"
+
+namespace android {
+namespace {
+
+// The EDIDs in testdata/edid, or in the directory named by EDID_CORPUS_DIR, in the format of the
+// corpus of DisplayIdentificationTest.
+const std::vector<DisplayIdentificationData>& getCorpus() {
+    static const auto* corpus = [] {
+        auto* corpus = new std::vector<DisplayIdentificationData>;
+        const char* dirEnv = getenv("EDID_CORPUS_DIR");
+        const std::string directory =
+                dirEnv ? dirEnv : base::GetExecutableDirectory() + "/testdata/edid";
+        std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(directory.c_str()), closedir);
+        while (const dirent* entry = dir ? readdir(dir.get()) : nullptr) {
+            const std::string name = entry->d_name;
+            if (!base::EndsWith(name, ".txt")) {
+                continue;
+            }
+
+            DisplayIdentificationData data;
+            std::ifstream file(directory + "/" + name);
+            std::string line;
+            while (std::getline(file, line)) {
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                for (const auto& byte : base::Split(base::Trim(line), " ")) {
+                    data.push_back(static_cast<uint8_t>(std::stoul(byte, nullptr, 16)));
+                }
+            }
+            corpus->push_back(std::move(data));
+        }
+        return corpus;
+    }();
+    return *corpus;
+}
+
+// The work done for each hotplug before identification was cached.
+void BM_parseDisplayIdentificationData(benchmark::State& state) {
+    const auto& corpus = getCorpus();
+    if (corpus.empty()) {
+        state.SkipWithError("No EDIDs in corpus");
+        return;
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseDisplayIdentificationData(0, corpus[i++ % corpus.size()]));
+    }
+}
+BENCHMARK(BM_parseDisplayIdentificationData);
+
+// Displays reconnecting, with their EDIDs already in the cache.
+void BM_DisplayIdentificationCache_Hit(benchmark::State& state) {
+    const auto& corpus = getCorpus();
+    if (corpus.empty()) {
+        state.SkipWithError("No EDIDs in corpus");
+        return;
+    }
+
+    DisplayIdentificationCache cache;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.parse(0, corpus[i++ % corpus.size()]));
+    }
+}
+BENCHMARK(BM_DisplayIdentificationCache_Hit);
+
+// New displays connecting, which the cache only adds lookup and insertion to.
+void BM_DisplayIdentificationCache_Miss(benchmark::State& state) {
+    const auto& corpus = getCorpus();
+    if (corpus.empty()) {
+        state.SkipWithError("No EDIDs in corpus");
+        return;
+    }
+
+    DisplayIdentificationCache cache;
+    uint8_t port = 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        // Every port is a different display, and there are more ports than cache entries.
+        benchmark::DoNotOptimize(cache.parse(port++, corpus[i++ % corpus.size()]));
+    }
+}
+BENCHMARK(BM_DisplayIdentificationCache_Miss);
+
+} // namespace
+} // namespace android
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <thread>
+
+#include "Scheduler/IdleTimer.h"
+#include "Scheduler/TimerDispatcher.h"
+
+namespace android {
+namespace scheduler {
+namespace {
+
+using namespace std::chrono_literals;
+
+// Cost of resetting a timer that has not expired, as done for every buffer and touch event.
+void BM_IdleTimerReset(benchmark::State& state) {
+    IdleTimer timer(100ms, [] {}, [] {});
+    timer.start();
+
+    for (auto _ : state) {
+        timer.reset();
+    }
+
+    timer.stop();
+}
+BENCHMARK(BM_IdleTimerReset);
+
+// Resets from several threads at once, as the idle and touch timers get from the binder threads.
+void BM_IdleTimerReset_Contended(benchmark::State& state) {
+    static IdleTimer* timer;
+    if (state.thread_index == 0) {
+        timer = new IdleTimer(100ms, [] {}, [] {});
+        timer->start();
+    }
+
+    for (auto _ : state) {
+        timer->reset();
+    }
+
+    if (state.thread_index == 0) {
+        timer->stop();
+        delete timer;
+    }
+}
+BENCHMARK(BM_IdleTimerReset_Contended)->ThreadRange(2, 8);
+
+// Wakeups of the dispatcher thread while the given number of timers are reset at the given
+// period, i.e. at 1kHz for a touch screen and 60-120Hz for buffers.
+void BM_IdleTimerWakeups(benchmark::State& state) {
+    const auto resetPeriod = std::chrono::microseconds(state.range(0));
+    std::vector<std::unique_ptr<IdleTimer>> timers;
+    for (int i = 0; i < state.range(1); i++) {
+        timers.push_back(std::make_unique<IdleTimer>(100ms, [] {}, [] {}));
+        timers.back()->start();
+    }
+
+    const auto dispatcher = TimerDispatcher::getInstance();
+    const uint64_t startWakeups = dispatcher->getWakeupCount();
+
+    for (auto _ : state) {
+        for (auto& timer : timers) {
+            timer->reset();
+        }
+        std::this_thread::sleep_for(resetPeriod);
+    }
+
+    state.counters["wakeups"] =
+            benchmark::Counter(double(dispatcher->getWakeupCount() - startWakeups),
+                               benchmark::Counter::kIsRate);
+    for (auto& timer : timers) {
+        timer->stop();
+    }
+}
+BENCHMARK(BM_IdleTimerWakeups)
+        ->Args({1000, 1})
+        ->Args({1000, 3})
+        ->Args({8333, 3})
+        ->Args({16666, 3})
+        ->UseRealTime()
+        ->MinTime(2.0);
+
+} // namespace
+} // namespace scheduler
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gmock/gmock.h>
+#include <gui/LayerMetadata.h>
+#include <utils/String8.h>
+
+#include <vector>
+
+#include "ColorLayer.h"
+#include "Layer.h"
+
+#include "TestableScheduler.h"
+#include "TestableSurfaceFlinger.h"
+#include "mock/MockDispSync.h"
+#include "mock/MockEventControlThread.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockMessageQueue.h"
+
+namespace android {
+namespace {
+
+using testing::NiceMock;
+
+constexpr uint32_t kLayerStack = 0;
+constexpr size_t kNumRoots = 50;
+constexpr size_t kNumChildrenPerRoot = 9;
+// One in this many children is placed relative to a layer in the next tree.
+constexpr size_t kRelativeZInterval = 4;
+
+// A SurfaceFlinger with the layer tree of LayerTraversalTest in its drawing state: 50 roots of
+// 9 children each, a quarter of them relative to the next root, for a total of 500 layers.
+class LayerTree {
+public:
+    LayerTree() {
+        mFlinger.mutableEventQueue().reset(new NiceMock<mock::MessageQueue>());
+
+        auto* scheduler = new TestableScheduler(mFlinger.mutableRefreshRateConfigs());
+        scheduler->mutableEventControlThread().reset(new NiceMock<mock::EventControlThread>());
+        scheduler->mutablePrimaryDispSync().reset(new NiceMock<mock::DispSync>());
+        mFlinger.mutableSfConnectionHandle() =
+                scheduler->addConnection(std::make_unique<NiceMock<mock::EventThread>>());
+        mFlinger.mutableScheduler().reset(scheduler);
+
+        std::vector<sp<Layer>> roots;
+        for (size_t i = 0; i < kNumRoots; i++) {
+            sp<Layer> root = createLayer(static_cast<int32_t>(i));
+            mFlinger.mutableDrawingState().layersSortedByZ.add(root);
+            roots.push_back(root);
+        }
+
+        for (size_t i = 0; i < kNumRoots; i++) {
+            for (size_t j = 0; j < kNumChildrenPerRoot; j++) {
+                sp<Layer> child = createLayer(static_cast<int32_t>(j) - 3);
+                mFlinger.mutableLayerDrawingChildren(roots[i]).add(child);
+
+                if (j % kRelativeZInterval == 0 && i + 1 < kNumRoots) {
+                    const sp<Layer>& relativeTo = roots[i + 1];
+                    mFlinger.mutableLayerDrawingState(child).zOrderRelativeOf = relativeTo;
+                    mFlinger.mutableLayerDrawingState(relativeTo).zOrderRelatives.add(child);
+                }
+            }
+        }
+    }
+
+    ~LayerTree() {
+        mFlinger.mutableDrawingState().layersSortedByZ.clear();
+        mLayers.clear();
+    }
+
+    TestableSurfaceFlinger& flinger() { return mFlinger; }
+
+private:
+    sp<Layer> createLayer(int32_t z) {
+        sp<Layer> layer =
+                new ColorLayer(LayerCreationArgs(mFlinger.mFlinger.get(), sp<Client>(),
+                                                 String8("benchmark-layer"), 100, 100, 0,
+                                                 LayerMetadata()));
+        auto& layerDrawingState = mFlinger.mutableLayerDrawingState(layer);
+        layerDrawingState.layerStack = kLayerStack;
+        layerDrawingState.z = z;
+        mLayers.push_back(layer);
+        return layer;
+    }
+
+    TestableSurfaceFlinger mFlinger;
+    std::vector<sp<Layer>> mLayers;
+};
+
+// Walks the layer tree and its relative-z lists, as traversals did before the drawing state
+// cached the z-order.
+void BM_LayerTraversal_TreeWalk(benchmark::State& state) {
+    LayerTree tree;
+    const LayerVector& layersSortedByZ = tree.flinger().mutableDrawingState().layersSortedByZ;
+
+    size_t numVisited = 0;
+    for (auto _ : state) {
+        layersSortedByZ.traverseInZOrder(LayerVector::StateSet::Drawing,
+                                         [&](Layer*) { numVisited++; });
+    }
+    benchmark::DoNotOptimize(numVisited);
+    state.SetItemsProcessed(static_cast<int64_t>(numVisited));
+}
+BENCHMARK(BM_LayerTraversal_TreeWalk);
+
+// Iterates the z-order cached by the drawing state of the main thread.
+void BM_LayerTraversal_Cached(benchmark::State& state) {
+    LayerTree tree;
+
+    size_t numVisited = 0;
+    for (auto _ : state) {
+        tree.flinger().traverseDrawingStateInZOrder([&](Layer*) { numVisited++; });
+    }
+    benchmark::DoNotOptimize(numVisited);
+    state.SetItemsProcessed(static_cast<int64_t>(numVisited));
+}
+BENCHMARK(BM_LayerTraversal_Cached);
+
+} // namespace
+} // namespace android
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <mutex>
+#include <queue>
+
+#include "MpscQueue.h"
+
+namespace android {
+namespace {
+
+// Stands in for a transaction, which binder threads allocate before handing it off.
+struct Transaction {
+    int64_t desiredPresentTime;
+    char states[256];
+};
+
+// The ingestion of transactions before the main thread applied them without taking a lock:
+// binder threads and the main thread take the same mutex for each transaction. Thread 0 is the
+// main thread, and drains the queue every 16 transactions it would have handled.
+void BM_MutexQueue_Contended(benchmark::State& state) {
+    static std::mutex* mutex;
+    static std::queue<std::unique_ptr<Transaction>>* queue;
+    if (state.thread_index == 0) {
+        mutex = new std::mutex;
+        queue = new std::queue<std::unique_ptr<Transaction>>;
+    }
+
+    int count = 0;
+    for (auto _ : state) {
+        if (state.thread_index == 0) {
+            if (++count % 16 == 0) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                while (!queue->empty()) {
+                    benchmark::DoNotOptimize(queue->front()->desiredPresentTime);
+                    queue->pop();
+                }
+            }
+            continue;
+        }
+        auto transaction = std::make_unique<Transaction>();
+        std::lock_guard<std::mutex> lock(*mutex);
+        queue->push(std::move(transaction));
+    }
+
+    if (state.thread_index == 0) {
+        delete queue;
+        delete mutex;
+    }
+}
+BENCHMARK(BM_MutexQueue_Contended)->ThreadRange(2, 8)->UseRealTime();
+
+// The same ingestion through MpscQueue.
+void BM_MpscQueue_Contended(benchmark::State& state) {
+    static MpscQueue<std::unique_ptr<Transaction>>* queue;
+    if (state.thread_index == 0) {
+        queue = new MpscQueue<std::unique_ptr<Transaction>>;
+    }
+
+    int count = 0;
+    for (auto _ : state) {
+        if (state.thread_index == 0) {
+            if (++count % 16 == 0) {
+                std::unique_ptr<Transaction> transaction;
+                while (queue->pop(&transaction)) {
+                    benchmark::DoNotOptimize(transaction->desiredPresentTime);
+                }
+            }
+            continue;
+        }
+        queue->push(std::make_unique<Transaction>());
+    }
+
+    if (state.thread_index == 0) {
+        delete queue;
+    }
+}
+BENCHMARK(BM_MpscQueue_Contended)->ThreadRange(2, 8)->UseRealTime();
+
+} // namespace
+} // namespace android
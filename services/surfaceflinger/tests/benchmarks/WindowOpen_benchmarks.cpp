@@ -0,0 +1,115 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/LayerState.h>
+#include <gui/SurfaceComposerClient.h>
+#include <gui/SurfaceControl.h>
+
+#include <limits>
+#include <vector>
+
+namespace android {
+namespace {
+
+using Transaction = SurfaceComposerClient::Transaction;
+
+// Above the layers of the system UI, so that the windows are composited like any other.
+constexpr int32_t kLayerZ = std::numeric_limits<int32_t>::max() - 256;
+
+// Opens a window made of the given number of surfaces: a root attached to the display, and
+// containers below it for the activity, its decor and its views, as the window manager does.
+void BM_WindowOpen_CreateSurface(benchmark::State& state) {
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    if (client->initCheck() != NO_ERROR) {
+        state.SkipWithError("Failed to connect to SurfaceFlinger");
+        return;
+    }
+
+    std::vector<sp<SurfaceControl>> surfaces;
+    for (auto _ : state) {
+        sp<SurfaceControl> root =
+                client->createSurface(String8("window"), 0, 0, PIXEL_FORMAT_RGBA_8888,
+                                      ISurfaceComposerClient::eFXSurfaceContainer);
+        surfaces.push_back(root);
+        for (int i = 1; i < state.range(0); i++) {
+            surfaces.push_back(
+                    client->createSurface(String8("view"), 0, 0, PIXEL_FORMAT_RGBA_8888,
+                                          ISurfaceComposerClient::eFXSurfaceContainer,
+                                          surfaces[(i - 1) / 2].get()));
+        }
+
+        Transaction t;
+        t.setLayerStack(root, 0).setLayer(root, kLayerZ).setPosition(root, 100, 100);
+        for (size_t i = 1; i < surfaces.size(); i++) {
+            t.setPosition(surfaces[i], 1, 1);
+        }
+        t.apply(true);
+
+        state.PauseTiming();
+        surfaces.clear();
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_WindowOpen_CreateSurface)->Arg(4)->Arg(16)->Arg(64)->UseRealTime();
+
+// The same window, created with its initial state in a single call.
+void BM_WindowOpen_CreateSurfaces(benchmark::State& state) {
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    if (client->initCheck() != NO_ERROR) {
+        state.SkipWithError("Failed to connect to SurfaceFlinger");
+        return;
+    }
+
+    std::vector<SurfaceCreationArgs> args(state.range(0));
+    args[0].name = "window";
+    args[0].state.what = layer_state_t::eLayerStackChanged | layer_state_t::eLayerChanged |
+            layer_state_t::ePositionChanged;
+    args[0].state.layerStack = 0;
+    args[0].state.z = kLayerZ;
+    args[0].state.x = 100;
+    args[0].state.y = 100;
+    for (size_t i = 1; i < args.size(); i++) {
+        args[i].name = "view";
+        args[i].parentIndex = (i - 1) / 2;
+        args[i].state.what = layer_state_t::ePositionChanged;
+        args[i].state.x = 1;
+        args[i].state.y = 1;
+    }
+    for (auto& arg : args) {
+        arg.format = PIXEL_FORMAT_RGBA_8888;
+        arg.flags = ISurfaceComposerClient::eFXSurfaceContainer;
+    }
+
+    std::vector<sp<SurfaceControl>> surfaces;
+    for (auto _ : state) {
+        if (client->createSurfaces(args, &surfaces) != NO_ERROR) {
+            state.SkipWithError("Failed to create surfaces");
+            return;
+        }
+        // Waits for the layers to be committed, like the transaction of the other benchmark.
+        Transaction().apply(true);
+
+        state.PauseTiming();
+        surfaces.clear();
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_WindowOpen_CreateSurfaces)->Arg(4)->Arg(16)->Arg(64)->UseRealTime();
+
+} // namespace
+} // namespace android
@@ -14,6 +14,16 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
+
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -61,6 +71,26 @@ const unsigned char kExternalEedid[] =
         "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
         "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\xc6";
 
+// Extended EDID with HDR static metadata, HDMI Forum VRR range and a 4K timing in its CTA-861
+// extension.
+const unsigned char kHdrVrrEedid[] =
+        "\x00\xff\xff\xff\xff\xff\xff\x00\x1c\xec\xfe\x08\x00\x00\x00\x00"
+        "\x29\x15\x01\x03\x80\x10\x09\x78\x0a\xee\x91\xa3\x54\x4c\x99\x26"
+        "\x0f\x50\x54\xbd\xef\x80\x71\x4f\x81\xc0\x81\x00\x81\x80\x95\x00"
+        "\xa9\xc0\xb3\x00\x01\x01\x02\x3a\x80\x18\x71\x38\x2d\x40\x58\x2c"
+        "\x45\x00\xa0\x5a\x00\x00\x00\x1e\x66\x21\x56\xaa\x51\x00\x1e\x30"
+        "\x46\x8f\x33\x00\xa0\x5a\x00\x00\x00\x1e\x00\x00\x00\xfd\x00\x18"
+        "\x4b\x0f\x51\x17\x00\x0a\x20\x20\x20\x20\x20\x20\x00\x00\x00\xfc"
+        "\x00\x48\x44\x52\x20\x56\x52\x52\x20\x54\x56\x0a\x20\x20\x01\x4a"
+        "\x02\x03\x16\x40\xe6\x06\x0d\x01\x78\x5a\x20\x6a\xd8\x5d\xc4\x01"
+        "\x78\x80\x00\x00\x30\x78\x08\xe8\x00\x30\xf2\x70\x5a\x80\xb0\x58"
+        "\x8a\x00\x50\x1d\x74\x00\x00\x1e\x00\x00\x00\x00\x00\x00\x00\x00"
+        "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\xc8";
+
 template <size_t N>
 DisplayIdentificationData asDisplayIdentificationData(const unsigned char (&bytes)[N]) {
     return DisplayIdentificationData(bytes, bytes + N - 1);
@@ -83,6 +113,11 @@ const DisplayIdentificationData& getExternalEedid() {
     return data;
 }
 
+const DisplayIdentificationData& getHdrVrrEedid() {
+    static const DisplayIdentificationData data = asDisplayIdentificationData(kHdrVrrEedid);
+    return data;
+}
+
 TEST(DisplayIdentificationTest, isEdid) {
     EXPECT_FALSE(isEdid({}));
 
@@ -131,6 +166,95 @@ TEST(DisplayIdentificationTest, parseInvalidEdid) {
     EXPECT_EQ("CN4202137Q", edid->displayName);
 }
 
+TEST(DisplayIdentificationTest, parseEdidCapabilities) {
+    auto edid = parseEdid(getInternalEdid());
+    ASSERT_TRUE(edid);
+    ASSERT_TRUE(edid->capabilities.preferredTiming);
+    EXPECT_EQ(70700u, edid->capabilities.preferredTiming->pixelClockKhz);
+    EXPECT_EQ(1280u, edid->capabilities.preferredTiming->width);
+    EXPECT_EQ(800u, edid->capabilities.preferredTiming->height);
+    EXPECT_NEAR(60.02f, edid->capabilities.preferredTiming->refreshRate, 0.01f);
+    EXPECT_FALSE(edid->capabilities.refreshRateRange);
+    EXPECT_FALSE(edid->capabilities.vrrRange);
+    EXPECT_FALSE(edid->capabilities.hdrStaticMetadata);
+
+    edid = parseEdid(getExternalEdid());
+    ASSERT_TRUE(edid);
+    ASSERT_TRUE(edid->capabilities.preferredTiming);
+    EXPECT_EQ(2560u, edid->capabilities.preferredTiming->width);
+    EXPECT_EQ(1600u, edid->capabilities.preferredTiming->height);
+    EXPECT_NEAR(59.97f, edid->capabilities.preferredTiming->refreshRate, 0.01f);
+    EXPECT_FALSE(edid->capabilities.refreshRateRange);
+    EXPECT_FALSE(edid->capabilities.vrrRange);
+
+    edid = parseEdid(getExternalEedid());
+    ASSERT_TRUE(edid);
+    ASSERT_TRUE(edid->capabilities.preferredTiming);
+    EXPECT_EQ(1920u, edid->capabilities.preferredTiming->width);
+    EXPECT_EQ(1080u, edid->capabilities.preferredTiming->height);
+    EXPECT_NEAR(60.f, edid->capabilities.preferredTiming->refreshRate, 0.01f);
+    ASSERT_TRUE(edid->capabilities.refreshRateRange);
+    EXPECT_EQ(24u, edid->capabilities.refreshRateRange->min);
+    EXPECT_EQ(75u, edid->capabilities.refreshRateRange->max);
+    // The CTA extension has neither HDR static metadata nor an HDMI Forum data block.
+    EXPECT_FALSE(edid->capabilities.vrrRange);
+    EXPECT_FALSE(edid->capabilities.hdrStaticMetadata);
+}
+
+TEST(DisplayIdentificationTest, parseCtaExtension) {
+    auto edid = parseEdid(getHdrVrrEedid());
+    ASSERT_TRUE(edid);
+    EXPECT_STREQ("GGL", edid->pnpId.data());
+    EXPECT_EQ("HDR VRR TV", edid->displayName);
+
+    const auto& capabilities = edid->capabilities;
+    ASSERT_TRUE(capabilities.vrrRange);
+    EXPECT_EQ(48u, capabilities.vrrRange->min);
+    EXPECT_EQ(120u, capabilities.vrrRange->max);
+    // The VRR range is kept apart from the range limits, which still allow 24 to 75Hz.
+    ASSERT_TRUE(capabilities.refreshRateRange);
+    EXPECT_EQ(24u, capabilities.refreshRateRange->min);
+    EXPECT_EQ(75u, capabilities.refreshRateRange->max);
+
+    ASSERT_TRUE(capabilities.hdrStaticMetadata);
+    EXPECT_EQ(HdrStaticMetadata::TRADITIONAL_SDR | HdrStaticMetadata::SMPTE_ST2084 |
+                      HdrStaticMetadata::HLG,
+              capabilities.hdrStaticMetadata->eotfs);
+    EXPECT_NEAR(672.7f, capabilities.hdrStaticMetadata->maxLuminance, 0.1f);
+    EXPECT_NEAR(351.3f, capabilities.hdrStaticMetadata->maxAverageLuminance, 0.1f);
+    EXPECT_NEAR(0.1059f, capabilities.hdrStaticMetadata->minLuminance, 0.0001f);
+
+    // The timing of the base block is preferred over the timings of the extension.
+    ASSERT_TRUE(capabilities.preferredTiming);
+    EXPECT_EQ(1920u, capabilities.preferredTiming->width);
+
+    auto data = getHdrVrrEedid();
+    data[54] = data[55] = 0;
+    edid = parseEdid(data);
+    ASSERT_TRUE(edid);
+    ASSERT_TRUE(edid->capabilities.preferredTiming);
+    EXPECT_EQ(594000u, edid->capabilities.preferredTiming->pixelClockKhz);
+    EXPECT_EQ(3840u, edid->capabilities.preferredTiming->width);
+    EXPECT_EQ(2160u, edid->capabilities.preferredTiming->height);
+    EXPECT_NEAR(60.f, edid->capabilities.preferredTiming->refreshRate, 0.01f);
+
+    // Extensions that are truncated are skipped.
+    data = getHdrVrrEedid();
+    data.resize(200);
+    edid = parseEdid(data);
+    ASSERT_TRUE(edid);
+    EXPECT_FALSE(edid->capabilities.vrrRange);
+    EXPECT_FALSE(edid->capabilities.hdrStaticMetadata);
+
+    // Data blocks running past the timing offset are ignored.
+    data = getHdrVrrEedid();
+    data[128 + 2] = 8;
+    edid = parseEdid(data);
+    ASSERT_TRUE(edid);
+    EXPECT_FALSE(edid->capabilities.vrrRange);
+    EXPECT_FALSE(edid->capabilities.hdrStaticMetadata);
+}
+
 TEST(DisplayIdentificationTest, getPnpId) {
     EXPECT_FALSE(getPnpId(0));
     EXPECT_FALSE(getPnpId(static_cast<uint16_t>(-1)));
@@ -149,6 +273,8 @@ TEST(DisplayIdentificationTest, parseDisplayIdentificationData) {
 
     const auto tertiaryInfo = parseDisplayIdentificationData(2, getExternalEedid());
     ASSERT_TRUE(tertiaryInfo);
+    ASSERT_TRUE(tertiaryInfo->capabilities.refreshRateRange);
+    EXPECT_EQ(75u, tertiaryInfo->capabilities.refreshRateRange->max);
 
     // Display IDs should be unique.
     EXPECT_NE(primaryInfo->id, secondaryInfo->id);
@@ -168,4 +294,182 @@ TEST(DisplayIdentificationTest, getVirtualDisplayId) {
     ASSERT_FALSE(getPnpId(getVirtualDisplayId(0xffff'ffffu)));
 }
 
+TEST(DisplayIdentificationTest, cacheReturnsParsedData) {
+    DisplayIdentificationCache cache;
+
+    const auto info = cache.parse(1, getExternalEedid());
+    ASSERT_TRUE(info);
+    EXPECT_EQ(0u, cache.getHitCount());
+    EXPECT_EQ(1u, cache.getMissCount());
+
+    // Reconnecting the same display is a hit with the same result.
+    const auto cachedInfo = cache.parse(1, getExternalEedid());
+    ASSERT_TRUE(cachedInfo);
+    EXPECT_EQ(info->id, cachedInfo->id);
+    EXPECT_EQ(info->name, cachedInfo->name);
+    ASSERT_TRUE(cachedInfo->capabilities.refreshRateRange);
+    EXPECT_EQ(75u, cachedInfo->capabilities.refreshRateRange->max);
+    EXPECT_EQ(1u, cache.getHitCount());
+
+    // The port is part of the display ID.
+    const auto otherPortInfo = cache.parse(2, getExternalEedid());
+    ASSERT_TRUE(otherPortInfo);
+    EXPECT_NE(info->id, otherPortInfo->id);
+    EXPECT_EQ(2u, cache.getMissCount());
+
+    // Invalid data is remembered as such.
+    EXPECT_FALSE(cache.parse(1, {}));
+    EXPECT_FALSE(cache.parse(1, {}));
+    EXPECT_EQ(2u, cache.getHitCount());
+    EXPECT_EQ(3u, cache.getMissCount());
+}
+
+TEST(DisplayIdentificationTest, cacheMissesOnChangedData) {
+    DisplayIdentificationCache cache;
+    ASSERT_TRUE(cache.parse(0, getExternalEdid()));
+
+    auto data = getExternalEdid();
+    data[97] = '\x1b';
+    const auto info = cache.parse(0, data);
+    ASSERT_TRUE(info);
+    EXPECT_EQ("CN4202137Q", info->name);
+    EXPECT_EQ(0u, cache.getHitCount());
+}
+
+TEST(DisplayIdentificationTest, cacheEvictsLeastRecentlyUsed) {
+    DisplayIdentificationCache cache(2);
+    cache.parse(0, getInternalEdid());
+    cache.parse(0, getExternalEdid());
+    cache.parse(0, getInternalEdid());
+    EXPECT_EQ(1u, cache.getHitCount());
+
+    // Evicts the external EDID, which was used less recently.
+    cache.parse(0, getExternalEedid());
+    cache.parse(0, getInternalEdid());
+    EXPECT_EQ(2u, cache.getHitCount());
+    cache.parse(0, getExternalEdid());
+    EXPECT_EQ(2u, cache.getHitCount());
+    EXPECT_EQ(4u, cache.getMissCount());
+}
+
+/*
+ * Parses EDIDs mutated from a corpus, to check that malformed data from displays never reads out
+ * of bounds, which the address sanitizer this test runs with would catch, and never yields
+ * inconsistent capabilities. The corpus is the EDIDs in testdata/edid, or in the directory named
+ * by EDID_CORPUS_DIR, where EDIDs dumped from a device can be added. Each file holds the bytes of
+ * an EDID in hexadecimal, with lines starting with '#' being comments.
+ */
+std::string getCorpusDirectory() {
+    if (const char* dir = getenv("EDID_CORPUS_DIR")) {
+        return dir;
+    }
+    return base::GetExecutableDirectory() + "/testdata/edid";
+}
+
+std::vector<DisplayIdentificationData> loadCorpus(const std::string& directory) {
+    std::vector<DisplayIdentificationData> corpus;
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(directory.c_str()), closedir);
+    if (!dir) {
+        return corpus;
+    }
+
+    while (const dirent* entry = readdir(dir.get())) {
+        const std::string name = entry->d_name;
+        if (!base::EndsWith(name, ".txt")) {
+            continue;
+        }
+
+        DisplayIdentificationData data;
+        std::ifstream file(directory + "/" + name);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            for (const auto& byte : base::Split(base::Trim(line), " ")) {
+                data.push_back(static_cast<uint8_t>(std::stoul(byte, nullptr, 16)));
+            }
+        }
+        corpus.push_back(std::move(data));
+    }
+    return corpus;
+}
+
+void mutate(std::mt19937& random, DisplayIdentificationData* data) {
+    std::uniform_int_distribution<int> byteValue(0, 0xff);
+    const int mutations = std::uniform_int_distribution<int>(1, 8)(random);
+    for (int i = 0; i < mutations && !data->empty(); i++) {
+        std::uniform_int_distribution<size_t> offset(0, data->size() - 1);
+        switch (std::uniform_int_distribution<int>(0, 3)(random)) {
+            case 0:
+                (*data)[offset(random)] = byteValue(random);
+                break;
+            case 1:
+                data->resize(offset(random));
+                break;
+            case 2:
+                // The extension count, and the data block and timing offsets of the extension.
+                if (data->size() > 130) {
+                    (*data)[std::uniform_int_distribution<int>(0, 1)(random) ? 126 : 130] =
+                            byteValue(random);
+                }
+                break;
+            case 3:
+                // Data block headers, which give their own length.
+                if (data->size() > 128 + 4) {
+                    const size_t dataBlock =
+                            std::uniform_int_distribution<size_t>(128 + 4, data->size() - 1)(
+                                    random);
+                    (*data)[dataBlock] = byteValue(random);
+                }
+                break;
+        }
+    }
+}
+
+TEST(DisplayIdentificationTest, parseMutatedCorpus) {
+    const std::string directory = getCorpusDirectory();
+    auto corpus = loadCorpus(directory);
+    ASSERT_FALSE(corpus.empty()) << "No EDIDs in " << directory;
+    for (const auto& data : {getInternalEdid(), getExternalEdid(), getExternalEedid(),
+                             getHdrVrrEedid()}) {
+        corpus.push_back(data);
+    }
+
+    std::mt19937 random(0x45444944);
+    constexpr int kMutationsPerEdid = 2000;
+    for (const auto& seed : corpus) {
+        ASSERT_TRUE(parseEdid(seed));
+
+        for (int i = 0; i < kMutationsPerEdid; i++) {
+            auto data = seed;
+            mutate(random, &data);
+
+            const auto edid = parseEdid(data);
+            if (!edid) {
+                continue;
+            }
+            EXPECT_FALSE(edid->displayName.empty());
+
+            const auto& capabilities = edid->capabilities;
+            if (const auto& timing = capabilities.preferredTiming) {
+                EXPECT_GT(timing->width, 0u);
+                EXPECT_GT(timing->height, 0u);
+                EXPECT_GT(timing->refreshRate, 0.f);
+            }
+            for (const auto& range : {capabilities.refreshRateRange, capabilities.vrrRange}) {
+                if (range) {
+                    EXPECT_GT(range->min, 0u);
+                    EXPECT_LE(range->min, range->max);
+                }
+            }
+            if (const auto& hdr = capabilities.hdrStaticMetadata) {
+                EXPECT_LE(hdr->minLuminance, hdr->maxLuminance);
+            }
+
+            parseDisplayIdentificationData(0, data);
+        }
+    }
+}
+
 } // namespace android
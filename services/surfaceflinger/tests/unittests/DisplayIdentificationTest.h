@@ -23,5 +23,6 @@ namespace android {
 const DisplayIdentificationData& getInternalEdid();
 const DisplayIdentificationData& getExternalEdid();
 const DisplayIdentificationData& getExternalEedid();
+const DisplayIdentificationData& getHdrVrrEedid();
 
 } // namespace android
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "FrameRateEstimatorTest"
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <dirent.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Scheduler/FrameRateEstimator.h"
+
+namespace android {
+namespace scheduler {
+namespace {
+
+constexpr nsecs_t kMillis = 1000000;
+constexpr nsecs_t kMinFramePeriod = 1e9 / 120;
+
+TEST(FrameRateEstimatorTest, noIntervalsEstimatesMaxRate) {
+    FrameRateEstimator estimator(kMinFramePeriod);
+    estimator.addPresentTime(1000 * kMillis);
+
+    const auto estimate = estimator.getEstimate();
+    EXPECT_FLOAT_EQ(120.f, estimate.fps);
+    EXPECT_FLOAT_EQ(1.f, estimate.confidence);
+}
+
+TEST(FrameRateEstimatorTest, steadyRate) {
+    FrameRateEstimator estimator(kMinFramePeriod);
+    for (int i = 1; i <= 10; i++) {
+        estimator.addPresentTime(i * 40 * kMillis);
+    }
+
+    const auto estimate = estimator.getEstimate();
+    EXPECT_FLOAT_EQ(25.f, estimate.fps);
+    EXPECT_FLOAT_EQ(1.f, estimate.confidence);
+}
+
+TEST(FrameRateEstimatorTest, rejectsDroppedFrames) {
+    FrameRateEstimator estimator(kMinFramePeriod);
+    nsecs_t presentTime = 1000 * kMillis;
+    for (size_t i = 0; i < FrameRateEstimator::HISTORY_SIZE + 1; i++) {
+        // Every fifth frame is dropped, so a plain mean would estimate 25 fps.
+        presentTime += (i % 5 == 4) ? 66666666 : 33333333;
+        estimator.addPresentTime(presentTime);
+    }
+
+    const auto estimate = estimator.getEstimate();
+    EXPECT_NEAR(30.f, estimate.fps, 0.01f);
+    EXPECT_NEAR(0.8f, estimate.confidence, 0.05f);
+}
+
+TEST(FrameRateEstimatorTest, variableRateHasLowConfidence) {
+    FrameRateEstimator estimator(kMinFramePeriod);
+    nsecs_t presentTime = 1000 * kMillis;
+    for (size_t i = 0; i < FrameRateEstimator::HISTORY_SIZE + 1; i++) {
+        presentTime += (10 + (i * 7) % 40) * kMillis;
+        estimator.addPresentTime(presentTime);
+    }
+
+    EXPECT_LT(estimator.getEstimate().confidence, 0.5f);
+}
+
+TEST(FrameRateEstimatorTest, ignoresStaleIntervals) {
+    FrameRateEstimator estimator(kMinFramePeriod);
+    estimator.addPresentTime(1000 * kMillis);
+    estimator.addPresentTime(1040 * kMillis);
+    estimator.addPresentTime(5000 * kMillis);
+    estimator.addPresentTime(5040 * kMillis);
+
+    const auto estimate = estimator.getEstimate();
+    EXPECT_FLOAT_EQ(25.f, estimate.fps);
+    EXPECT_FLOAT_EQ(1.f, estimate.confidence);
+}
+
+TEST(FrameRateEstimatorTest, clear) {
+    FrameRateEstimator estimator(kMinFramePeriod);
+    estimator.addPresentTime(1000 * kMillis);
+    estimator.addPresentTime(1040 * kMillis);
+    estimator.clear();
+    estimator.addPresentTime(1050 * kMillis);
+
+    EXPECT_FLOAT_EQ(120.f, estimator.getEstimate().fps);
+}
+
+/*
+ * Offline evaluation of the estimator against present time traces. Each trace in
+ * testdata/synthetic_present_times, or in the directory named by FRAME_RATE_TRACE_DIR, holds one
+ * present time in nanoseconds per line, and an "# expected_fps: <fps>" comment with the content
+ * rate. The estimator is replayed over each trace, and is correct for a frame if its rounded
+ * estimate is within 1 fps of the content rate.
+ *
+ * The checked-in traces are synthetic: they model content rates with jitter and dropped frames,
+ * not captures from a device. Traces recorded on a device can be evaluated by pointing
+ * FRAME_RATE_TRACE_DIR at them.
+ */
+struct PresentTimeTrace {
+    std::string name;
+    float expectedFps = 0.f;
+    std::vector<nsecs_t> presentTimes;
+};
+
+std::string getTraceDirectory() {
+    if (const char* dir = getenv("FRAME_RATE_TRACE_DIR")) {
+        return dir;
+    }
+    return base::GetExecutableDirectory() + "/testdata/synthetic_present_times";
+}
+
+std::vector<PresentTimeTrace> loadTraces(const std::string& directory) {
+    std::vector<PresentTimeTrace> traces;
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(directory.c_str()), closedir);
+    if (!dir) {
+        return traces;
+    }
+
+    while (const dirent* entry = readdir(dir.get())) {
+        PresentTimeTrace trace;
+        trace.name = entry->d_name;
+        if (!base::EndsWith(trace.name, ".txt")) {
+            continue;
+        }
+
+        std::ifstream file(directory + "/" + trace.name);
+        std::string line;
+        while (std::getline(file, line)) {
+            constexpr const char* kExpectedFps = "# expected_fps:";
+            if (base::StartsWith(line, kExpectedFps)) {
+                trace.expectedFps = std::stof(line.substr(strlen(kExpectedFps)));
+            } else if (!line.empty() && line[0] != '#') {
+                trace.presentTimes.push_back(std::stoll(line));
+            }
+        }
+        traces.push_back(std::move(trace));
+    }
+    return traces;
+}
+
+// Returns the fraction of the frames after the first HISTORY_SIZE ones for which
+// estimateFps(presentTime) is within 1 fps of the content rate.
+template <typename EstimateFps>
+float replayTrace(const PresentTimeTrace& trace, EstimateFps&& estimateFps) {
+    size_t frames = 0;
+    size_t correctFrames = 0;
+    for (size_t i = 0; i < trace.presentTimes.size(); i++) {
+        const float fps = estimateFps(trace.presentTimes[i]);
+        if (i <= FrameRateEstimator::HISTORY_SIZE) {
+            continue;
+        }
+        frames++;
+        if (std::abs(std::round(fps) - trace.expectedFps) <= 1.f) {
+            correctFrames++;
+        }
+    }
+    return frames ? float(correctFrames) / frames : 0.f;
+}
+
+TEST(FrameRateEstimatorTest, syntheticTraces) {
+    const std::string directory = getTraceDirectory();
+    const auto traces = loadTraces(directory);
+    ASSERT_FALSE(traces.empty()) << "No traces in " << directory;
+
+    for (const auto& trace : traces) {
+        SCOPED_TRACE(trace.name);
+        ASSERT_GT(trace.expectedFps, 0.f) << "Missing expected_fps";
+
+        FrameRateEstimator estimator(kMinFramePeriod);
+        const float accuracy = replayTrace(trace, [&](nsecs_t presentTime) {
+            estimator.addPresentTime(presentTime);
+            return estimator.getEstimate().fps;
+        });
+        EXPECT_GE(accuracy, 0.9f);
+    }
+}
+
+} // namespace
+} // namespace scheduler
+} // namespace android
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "FrameTrackerTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <ui/FenceTime.h>
+
+#include "FrameTracker.h"
+#include "LatencyHistogram.h"
+
+namespace android {
+namespace {
+
+using testing::HasSubstr;
+
+constexpr nsecs_t kMillis = 1000000;
+
+TEST(LatencyHistogramTest, emptyHistogramHasNoPercentiles) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(0u, histogram.getCount());
+    EXPECT_EQ(0, histogram.getPercentile(50));
+    EXPECT_EQ(0, histogram.getMax());
+}
+
+TEST(LatencyHistogramTest, percentilesAreWithinBucketPrecision) {
+    LatencyHistogram histogram;
+    // 1ms, 2ms, ..., 100ms.
+    for (nsecs_t i = 1; i <= 100; i++) {
+        histogram.record(i * kMillis);
+    }
+
+    EXPECT_EQ(100u, histogram.getCount());
+    EXPECT_EQ(100 * kMillis, histogram.getMax());
+    for (float percentile : {1.0f, 10.0f, 50.0f, 90.0f, 99.0f}) {
+        const nsecs_t expected = nsecs_t(percentile) * kMillis;
+        EXPECT_NEAR(expected, histogram.getPercentile(percentile), expected * 0.07)
+                << "p" << percentile;
+    }
+    EXPECT_EQ(100 * kMillis, histogram.getPercentile(100));
+}
+
+TEST(LatencyHistogramTest, countsShortLatenciesWithMicrosecondPrecision) {
+    LatencyHistogram histogram;
+    histogram.record(-5 * kMillis);
+    histogram.record(3000);
+    histogram.record(20000);
+
+    EXPECT_EQ(3u, histogram.getCount());
+    EXPECT_EQ(500, histogram.getPercentile(10));
+    EXPECT_EQ(3500, histogram.getPercentile(50));
+    EXPECT_EQ(20000, histogram.getPercentile(100));
+}
+
+TEST(LatencyHistogramTest, clampsVeryLongLatencies) {
+    LatencyHistogram histogram;
+    histogram.record(1000 * 1000 * kMillis);
+    EXPECT_EQ(1u, histogram.getCount());
+    EXPECT_EQ(1000 * 1000 * kMillis, histogram.getMax());
+    EXPECT_LE(histogram.getPercentile(50), histogram.getMax());
+}
+
+TEST(LatencyHistogramTest, clear) {
+    LatencyHistogram histogram;
+    histogram.record(kMillis);
+    histogram.clear();
+    EXPECT_EQ(0u, histogram.getCount());
+    EXPECT_EQ(0, histogram.getMax());
+}
+
+class FrameTrackerTest : public testing::Test {
+protected:
+    void addFrame(nsecs_t desiredPresentTime, nsecs_t readyTime, nsecs_t presentTime) {
+        mFrameTracker.setDesiredPresentTime(desiredPresentTime);
+        mFrameTracker.setFrameReadyTime(readyTime);
+        mFrameTracker.setActualPresentTime(presentTime);
+        mFrameTracker.advanceFrame();
+    }
+
+    FrameTracker mFrameTracker;
+};
+
+TEST_F(FrameTrackerTest, countsLatenciesOfAllFrames) {
+    // More frames than there are frame records.
+    const size_t frameCount = FrameTracker::NUM_FRAME_RECORDS * 4;
+    for (size_t i = 0; i < frameCount; i++) {
+        const nsecs_t desired = (i + 1) * 16 * kMillis;
+        addFrame(desired, desired - 2 * kMillis, desired + 8 * kMillis);
+    }
+
+    const LatencyHistogram& present = mFrameTracker.getPresentLatencies();
+    EXPECT_EQ(frameCount, present.getCount());
+    EXPECT_NEAR(8 * kMillis, present.getPercentile(50), kMillis / 2);
+
+    // Frames that were ready early have no ready latency.
+    const LatencyHistogram& ready = mFrameTracker.getReadyLatencies();
+    EXPECT_EQ(frameCount, ready.getCount());
+    EXPECT_EQ(0, ready.getMax());
+}
+
+TEST_F(FrameTrackerTest, countsLatenciesOnceFencesSignal) {
+    FenceToFenceTimeMap fenceMap;
+    const sp<Fence> presentFence = new Fence();
+
+    mFrameTracker.setDesiredPresentTime(16 * kMillis);
+    mFrameTracker.setFrameReadyTime(16 * kMillis);
+    mFrameTracker.setActualPresentFence(fenceMap.createFenceTimeForTest(presentFence));
+    mFrameTracker.advanceFrame();
+    EXPECT_EQ(0u, mFrameTracker.getPresentLatencies().getCount());
+
+    fenceMap.signalAllForTest(presentFence, 36 * kMillis);
+    addFrame(32 * kMillis, 32 * kMillis, 48 * kMillis);
+
+    const LatencyHistogram& present = mFrameTracker.getPresentLatencies();
+    EXPECT_EQ(2u, present.getCount());
+    EXPECT_EQ(20 * kMillis, present.getMax());
+}
+
+TEST_F(FrameTrackerTest, clearStatsClearsLatencies) {
+    addFrame(16 * kMillis, 16 * kMillis, 32 * kMillis);
+    mFrameTracker.clearStats();
+    EXPECT_EQ(0u, mFrameTracker.getPresentLatencies().getCount());
+    EXPECT_EQ(0u, mFrameTracker.getReadyLatencies().getCount());
+}
+
+TEST_F(FrameTrackerTest, dumpLatencyPercentiles) {
+    addFrame(16 * kMillis, 17 * kMillis, 32 * kMillis);
+
+    std::string result;
+    mFrameTracker.dumpLatencyPercentiles(result);
+    EXPECT_THAT(result, HasSubstr("present frames=1 "));
+    EXPECT_THAT(result, HasSubstr("max=16.00ms"));
+    EXPECT_THAT(result, HasSubstr("ready   frames=1 "));
+    EXPECT_THAT(result, HasSubstr("max=1.00ms"));
+}
+
+} // namespace
+} // namespace android
@@ -22,6 +22,7 @@
 
 #include "AsyncCallRecorder.h"
 #include "Scheduler/IdleTimer.h"
+#include "Scheduler/TimerDispatcher.h"
 
 using namespace std::chrono_literals;
 
@@ -205,6 +206,46 @@ TEST_F(IdleTimerTest, noCallbacksAfterStopTest) {
     EXPECT_FALSE(mResetTimerCallback.waitForCall().has_value());
 }
 
+TEST_F(IdleTimerTest, resetWhileWaitingDoesNotWakeDispatcherTest) {
+    mIdleTimer = std::make_unique<scheduler::IdleTimer>(100ms, mResetTimerCallback.getInvocable(),
+                                                        mExpiredTimerCallback.getInvocable());
+    mIdleTimer->start();
+    EXPECT_TRUE(mResetTimerCallback.waitForCall().has_value());
+
+    const auto dispatcher = TimerDispatcher::getInstance();
+    const uint64_t wakeups = dispatcher->getWakeupCount();
+    for (int i = 0; i < 1000; i++) {
+        mIdleTimer->reset();
+    }
+    EXPECT_FALSE(mResetTimerCallback.waitForCall(1ms).has_value());
+    // The dispatcher only wakes up once the first deadline expires, if the test ran that long.
+    EXPECT_LE(dispatcher->getWakeupCount(), wakeups + 1);
+    mIdleTimer->stop();
+}
+
+TEST_F(IdleTimerTest, timersShareDispatcherTest) {
+    AsyncCallRecorder<void (*)()> otherExpiredTimerCallback;
+    mIdleTimer = std::make_unique<scheduler::IdleTimer>(3ms, [] {},
+                                                        mExpiredTimerCallback.getInvocable());
+    auto otherIdleTimer =
+            std::make_unique<scheduler::IdleTimer>(6ms, [] {},
+                                                   otherExpiredTimerCallback.getInvocable());
+    mIdleTimer->start();
+    otherIdleTimer->start();
+
+    EXPECT_TRUE(mExpiredTimerCallback.waitForCall(waitTimeForExpected3msCallback).has_value());
+    EXPECT_TRUE(otherExpiredTimerCallback.waitForCall(waitTimeForExpected3msCallback).has_value());
+
+    // Stopping one timer does not affect the other.
+    otherIdleTimer->stop();
+    mIdleTimer->reset();
+    EXPECT_TRUE(mExpiredTimerCallback.waitForCall(waitTimeForExpected3msCallback).has_value());
+    otherIdleTimer->reset();
+    EXPECT_FALSE(
+            otherExpiredTimerCallback.waitForCall(waitTimeForUnexpected3msCallback).has_value());
+    mIdleTimer->stop();
+}
+
 } // namespace
 } // namespace scheduler
 } // namespace android
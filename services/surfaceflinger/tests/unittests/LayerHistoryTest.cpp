@@ -135,6 +135,58 @@ TEST_F(LayerHistoryTest, multipleLayers) {
     EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
 }
 
+TEST_F(LayerHistoryTest, smallLayersDoNotVote) {
+    std::unique_ptr<LayerHistory::LayerHandle> test30FpsLayer =
+            mLayerHistory->createLayer("30FpsLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setArea(test30FpsLayer, 1920 * 1080);
+    std::unique_ptr<LayerHistory::LayerHandle> spinnerLayer =
+            mLayerHistory->createLayer("SpinnerLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setArea(spinnerLayer, 100 * 100);
+
+    forceRelevancy(spinnerLayer);
+    mLayerHistory->setVisibility(test30FpsLayer, true);
+    nsecs_t startTime = systemTime();
+    for (int i = 0; i < RELEVANT_FRAME_THRESHOLD; i++) {
+        mLayerHistory->insert(test30FpsLayer, startTime + (i * THIRTY_FPS_INTERVAL),
+                              false /*isHDR*/);
+    }
+    EXPECT_FLOAT_EQ(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+
+    mLayerHistory->setArea(spinnerLayer, 1920 * 1080 / 2);
+    EXPECT_FLOAT_EQ(MAX_REFRESH_RATE, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+}
+
+TEST_F(LayerHistoryTest, jitteryLayer) {
+    std::unique_ptr<LayerHistory::LayerHandle> test30FpsLayer =
+            mLayerHistory->createLayer("30FpsLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setVisibility(test30FpsLayer, true);
+
+    // Frames are up to 3ms early or late, and every eighth frame is dropped.
+    nsecs_t startTime = systemTime();
+    for (int i = 0; i < RELEVANT_FRAME_THRESHOLD; i++) {
+        if (i % 8 == 7) {
+            continue;
+        }
+        const nsecs_t jitter = ((i * 5) % 7 - 3) * 1000000;
+        mLayerHistory->insert(test30FpsLayer, startTime + (i * THIRTY_FPS_INTERVAL) + jitter,
+                              false /*isHDR*/);
+    }
+    EXPECT_NEAR(30.f, mLayerHistory->getDesiredRefreshRateAndHDR().first, 0.5f);
+}
+
+TEST_F(LayerHistoryTest, variableRateLayerVotesMax) {
+    std::unique_ptr<LayerHistory::LayerHandle> testLayer =
+            mLayerHistory->createLayer("VariableRateLayer", MIN_REFRESH_RATE, MAX_REFRESH_RATE);
+    mLayerHistory->setVisibility(testLayer, true);
+
+    nsecs_t presentTime = systemTime();
+    for (int i = 0; i < RELEVANT_FRAME_THRESHOLD; i++) {
+        presentTime += (12 + (i * 11) % 30) * 1000000;
+        mLayerHistory->insert(testLayer, presentTime, false /*isHDR*/);
+    }
+    EXPECT_FLOAT_EQ(MAX_REFRESH_RATE, mLayerHistory->getDesiredRefreshRateAndHDR().first);
+}
+
 } // namespace
 } // namespace scheduler
 } // namespace android
\ No newline at end of file
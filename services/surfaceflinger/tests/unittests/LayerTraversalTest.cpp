@@ -0,0 +1,208 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LayerTraversalTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <gui/LayerMetadata.h>
+#include <log/log.h>
+#include <utils/String8.h>
+
+#include "ColorLayer.h"
+#include "Layer.h"
+
+#include "TestableScheduler.h"
+#include "TestableSurfaceFlinger.h"
+#include "mock/MockDispSync.h"
+#include "mock/MockEventControlThread.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockMessageQueue.h"
+
+namespace android {
+namespace {
+
+using testing::_;
+
+constexpr uint32_t LAYER_STACK = 0;
+constexpr size_t NUM_ROOTS = 50;
+constexpr size_t NUM_CHILDREN_PER_ROOT = 9;
+// One in this many children is placed relative to a layer in the next tree.
+constexpr size_t RELATIVE_Z_INTERVAL = 4;
+
+class LayerTraversalTest : public testing::Test {
+public:
+    LayerTraversalTest() {
+        mFlinger.mutableEventQueue().reset(mMessageQueue);
+
+        mScheduler = new TestableScheduler(mFlinger.mutableRefreshRateConfigs());
+        mScheduler->mutableEventControlThread().reset(mEventControlThread);
+        mScheduler->mutablePrimaryDispSync().reset(mPrimaryDispSync);
+        EXPECT_CALL(*mEventThread.get(), registerDisplayEventConnection(_));
+        mFlinger.mutableSfConnectionHandle() =
+                mScheduler->addConnection(std::move(mEventThread));
+        mFlinger.mutableScheduler().reset(mScheduler);
+    }
+
+    ~LayerTraversalTest() override {
+        mFlinger.mutableDrawingState().layersSortedByZ.clear();
+        mLayers.clear();
+    }
+
+    sp<Layer> createLayer(int32_t z) {
+        sp<Layer> layer =
+                new ColorLayer(LayerCreationArgs(mFlinger.mFlinger.get(), sp<Client>(),
+                                                 String8("test-layer"), 100, 100, 0,
+                                                 LayerMetadata()));
+        auto& layerDrawingState = mFlinger.mutableLayerDrawingState(layer);
+        layerDrawingState.layerStack = LAYER_STACK;
+        layerDrawingState.z = z;
+        mLayers.push_back(layer);
+        return layer;
+    }
+
+    // Builds NUM_ROOTS trees of one root with NUM_CHILDREN_PER_ROOT children each, for a total
+    // of 500 layers, with some children using relative-z to a layer of another tree.
+    void createLayerTree() {
+        std::vector<sp<Layer>> roots;
+        for (size_t i = 0; i < NUM_ROOTS; i++) {
+            sp<Layer> root = createLayer(static_cast<int32_t>(i));
+            mFlinger.mutableDrawingState().layersSortedByZ.add(root);
+            roots.push_back(root);
+        }
+
+        for (size_t i = 0; i < NUM_ROOTS; i++) {
+            for (size_t j = 0; j < NUM_CHILDREN_PER_ROOT; j++) {
+                const int32_t z = static_cast<int32_t>(j) - 3;
+                sp<Layer> child = createLayer(z);
+                mFlinger.mutableLayerDrawingChildren(roots[i]).add(child);
+
+                if (j % RELATIVE_Z_INTERVAL == 0 && i + 1 < NUM_ROOTS) {
+                    const sp<Layer>& relativeTo = roots[i + 1];
+                    mFlinger.mutableLayerDrawingState(child).zOrderRelativeOf = relativeTo;
+                    mFlinger.mutableLayerDrawingState(relativeTo).zOrderRelatives.add(child);
+                }
+            }
+        }
+    }
+
+    std::vector<Layer*> traverseUncached(LayerVector::StateSet stateSet, bool reverse) {
+        std::vector<Layer*> layers;
+        const LayerVector& layersSortedByZ = mFlinger.mutableDrawingState().layersSortedByZ;
+        if (reverse) {
+            layersSortedByZ.traverseInReverseZOrder(stateSet,
+                                                    [&](Layer* layer) { layers.push_back(layer); });
+        } else {
+            layersSortedByZ.traverseInZOrder(stateSet,
+                                             [&](Layer* layer) { layers.push_back(layer); });
+        }
+        return layers;
+    }
+
+    std::vector<Layer*> traverseCached(bool reverse) {
+        std::vector<Layer*> layers;
+        if (reverse) {
+            mFlinger.traverseDrawingStateInReverseZOrder(
+                    [&](Layer* layer) { layers.push_back(layer); });
+        } else {
+            mFlinger.traverseDrawingStateInZOrder([&](Layer* layer) { layers.push_back(layer); });
+        }
+        return layers;
+    }
+
+    TestableScheduler* mScheduler;
+    TestableSurfaceFlinger mFlinger;
+    std::vector<sp<Layer>> mLayers;
+
+    std::unique_ptr<mock::EventThread> mEventThread = std::make_unique<mock::EventThread>();
+    mock::EventControlThread* mEventControlThread = new mock::EventControlThread();
+    mock::MessageQueue* mMessageQueue = new mock::MessageQueue();
+    mock::DispSync* mPrimaryDispSync = new mock::DispSync();
+};
+
+TEST_F(LayerTraversalTest, cachedTraversalMatchesTreeWalk) {
+    createLayerTree();
+
+    const auto expected = traverseUncached(LayerVector::StateSet::Drawing, false);
+    ASSERT_EQ(NUM_ROOTS * (NUM_CHILDREN_PER_ROOT + 1), expected.size());
+    EXPECT_EQ(expected, traverseCached(false));
+    // Traversing again is served from the cache.
+    EXPECT_EQ(expected, traverseCached(false));
+
+    const auto expectedReverse = traverseUncached(LayerVector::StateSet::Drawing, true);
+    EXPECT_EQ(expectedReverse, traverseCached(true));
+}
+
+TEST_F(LayerTraversalTest, cacheIsInvalidatedByZOrderChange) {
+    createLayerTree();
+    traverseCached(false);
+
+    // Move the bottom-most root to the top.
+    sp<Layer> root = mFlinger.mutableDrawingState().layersSortedByZ[0];
+    mFlinger.mutableDrawingState().layersSortedByZ.remove(root);
+    mFlinger.mutableLayerDrawingState(root).z = static_cast<int32_t>(NUM_ROOTS);
+    mFlinger.mutableDrawingState().layersSortedByZ.add(root);
+
+    const auto layers = traverseCached(false);
+    EXPECT_EQ(traverseUncached(LayerVector::StateSet::Drawing, false), layers);
+    EXPECT_EQ(root.get(), layers[layers.size() - NUM_CHILDREN_PER_ROOT - 1]);
+}
+
+TEST_F(LayerTraversalTest, nestedTraversalMatchesTreeWalk) {
+    createLayerTree();
+
+    size_t numVisited = 0;
+    mFlinger.traverseDrawingStateInZOrder([&](Layer*) {
+        if (numVisited++ == 0) {
+            EXPECT_EQ(traverseUncached(LayerVector::StateSet::Drawing, false),
+                      traverseCached(false));
+        }
+    });
+    EXPECT_EQ(NUM_ROOTS * (NUM_CHILDREN_PER_ROOT + 1), numVisited);
+}
+
+TEST_F(LayerTraversalTest, invalidationDuringTraversalKeepsCacheUntilDone) {
+    createLayerTree();
+    const auto expected = traverseCached(false);
+
+    sp<Layer> root = mFlinger.mutableDrawingState().layersSortedByZ[0];
+    std::vector<Layer*> visited;
+    std::vector<Layer*> nested;
+    mFlinger.traverseDrawingStateInZOrder([&](Layer* layer) {
+        if (visited.empty()) {
+            // Move the bottom-most root to the top while the cache is iterated.
+            mFlinger.mutableDrawingState().layersSortedByZ.remove(root);
+            mFlinger.mutableLayerDrawingState(root).z = static_cast<int32_t>(NUM_ROOTS);
+            mFlinger.mutableDrawingState().layersSortedByZ.add(root);
+            mFlinger.mutableDrawingState().invalidateTraversalCache();
+
+            // The cache cannot be rebuilt under the outer traversal, so this walks the tree.
+            nested = traverseCached(false);
+        }
+        visited.push_back(layer);
+    });
+
+    // The outer traversal finishes over the list it started with.
+    EXPECT_EQ(expected, visited);
+    EXPECT_EQ(traverseUncached(LayerVector::StateSet::Drawing, false), nested);
+    EXPECT_NE(expected, nested);
+    // The next traversal rebuilds the cache.
+    EXPECT_EQ(nested, traverseCached(false));
+}
+
+} // namespace
+} // namespace android
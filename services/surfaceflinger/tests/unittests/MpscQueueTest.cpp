@@ -0,0 +1,108 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "MpscQueueTest"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "MpscQueue.h"
+
+namespace android {
+namespace {
+
+TEST(MpscQueueTest, popsInPushOrder) {
+    MpscQueue<int> queue;
+    EXPECT_TRUE(queue.empty());
+
+    queue.push(1);
+    queue.push(2);
+    EXPECT_FALSE(queue.empty());
+
+    int item = 0;
+    ASSERT_TRUE(queue.pop(&item));
+    EXPECT_EQ(1, item);
+    queue.push(3);
+    ASSERT_TRUE(queue.pop(&item));
+    EXPECT_EQ(2, item);
+    ASSERT_TRUE(queue.pop(&item));
+    EXPECT_EQ(3, item);
+
+    EXPECT_FALSE(queue.pop(&item));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(MpscQueueTest, movesItems) {
+    MpscQueue<std::unique_ptr<int>> queue;
+    queue.push(std::make_unique<int>(42));
+
+    std::unique_ptr<int> item;
+    ASSERT_TRUE(queue.pop(&item));
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(42, *item);
+}
+
+TEST(MpscQueueTest, destroysItemsLeftInQueue) {
+    auto item = std::make_shared<int>(0);
+    {
+        MpscQueue<std::shared_ptr<int>> queue;
+        queue.push(item);
+        queue.push(item);
+        EXPECT_EQ(3, item.use_count());
+    }
+    EXPECT_EQ(1, item.use_count());
+}
+
+TEST(MpscQueueTest, keepsOrderOfEachProducer) {
+    constexpr int kProducers = 4;
+    constexpr int kItemsPerProducer = 10000;
+    MpscQueue<std::pair<int, int>> queue;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < kProducers; producer++) {
+        producers.emplace_back([&queue, producer] {
+            for (int i = 0; i < kItemsPerProducer; i++) {
+                queue.push({producer, i});
+            }
+        });
+    }
+
+    std::vector<int> nextItem(kProducers, 0);
+    int popped = 0;
+    while (popped < kProducers * kItemsPerProducer) {
+        std::pair<int, int> item;
+        if (!queue.pop(&item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(nextItem[item.first], item.second) << "producer " << item.first;
+        nextItem[item.first]++;
+        popped++;
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+} // namespace
+} // namespace android
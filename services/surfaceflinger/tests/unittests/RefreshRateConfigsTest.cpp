@@ -167,6 +167,60 @@ TEST_F(RefreshRateConfigsTest, twoDeviceConfigs_storesPerformanceConfig) {
     assertRatesEqual(expectedPerformanceConfig,
                      *mConfigs.getRefreshRate(RefreshRateType::PERFORMANCE));
 }
+
+TEST_F(RefreshRateConfigsTest, supportedRange_leavesOutUnsupportedConfigs) {
+    auto display = new Hwc2::mock::Display();
+    std::vector<std::shared_ptr<const HWC2::Display::Config>> displayConfigs;
+    auto config60 = HWC2::Display::Config::Builder(*display, CONFIG_ID_60);
+    config60.setVsyncPeriod(VSYNC_60);
+    displayConfigs.push_back(config60.build());
+    auto config90 = HWC2::Display::Config::Builder(*display, CONFIG_ID_90);
+    config90.setVsyncPeriod(VSYNC_90);
+    displayConfigs.push_back(config90.build());
+
+    // The display range limits of a monitor that only accepts up to 75Hz.
+    mConfigs.setSupportedRange(RefreshRateRange{24, 75});
+    mConfigs.populate(displayConfigs);
+
+    const auto& rates = mConfigs.getRefreshRates();
+    ASSERT_EQ(2, rates.size());
+    ASSERT_TRUE(mConfigs.getRefreshRate(RefreshRateType::DEFAULT));
+    RefreshRate expectedDefaultConfig = RefreshRate{CONFIG_ID_60, "60fps", 60, HWC2_CONFIG_ID_60};
+    assertRatesEqual(expectedDefaultConfig, *mConfigs.getRefreshRate(RefreshRateType::DEFAULT));
+    ASSERT_FALSE(mConfigs.getRefreshRate(RefreshRateType::PERFORMANCE));
+
+    // A range that leaves out every config is ignored.
+    mConfigs.setSupportedRange(RefreshRateRange{100, 144});
+    mConfigs.populate(displayConfigs);
+    ASSERT_EQ(3, mConfigs.getRefreshRates().size());
+    ASSERT_TRUE(mConfigs.getRefreshRate(RefreshRateType::PERFORMANCE));
+
+    mConfigs.setSupportedRange(std::nullopt);
+    mConfigs.populate(displayConfigs);
+    ASSERT_EQ(3, mConfigs.getRefreshRates().size());
+}
+
+TEST_F(RefreshRateConfigsTest, vrrRange_doesNotLeaveOutConfigs) {
+    auto display = new Hwc2::mock::Display();
+    std::vector<std::shared_ptr<const HWC2::Display::Config>> displayConfigs;
+    auto config60 = HWC2::Display::Config::Builder(*display, CONFIG_ID_60);
+    config60.setVsyncPeriod(VSYNC_60);
+    displayConfigs.push_back(config60.build());
+    auto config90 = HWC2::Display::Config::Builder(*display, CONFIG_ID_90);
+    config90.setVsyncPeriod(VSYNC_90);
+    displayConfigs.push_back(config90.build());
+
+    // A TV that varies its refresh rate between 70 and 120Hz still accepts a fixed 60Hz.
+    mConfigs.setVrrRange(RefreshRateRange{70, 120});
+    mConfigs.populate(displayConfigs);
+
+    ASSERT_EQ(3, mConfigs.getRefreshRates().size());
+    ASSERT_TRUE(mConfigs.getRefreshRate(RefreshRateType::DEFAULT));
+    ASSERT_TRUE(mConfigs.getRefreshRate(RefreshRateType::PERFORMANCE));
+    ASSERT_TRUE(mConfigs.getVrrRange());
+    EXPECT_EQ(70u, mConfigs.getVrrRange()->min);
+    EXPECT_EQ(120u, mConfigs.getVrrRange()->max);
+}
 } // namespace
 } // namespace scheduler
 } // namespace android
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "ScreenCaptureCacheTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ScreenCaptureCache.h"
+
+namespace android {
+namespace {
+
+using testing::HasSubstr;
+
+class ScreenCaptureCacheTest : public testing::Test {
+protected:
+    static ScreenCaptureCache::Key makeKey(pid_t pid, uint32_t width, uid_t uid = 10000) {
+        ScreenCaptureCache::Key key;
+        key.uid = uid;
+        key.pid = pid;
+        key.source = &kDisplay;
+        key.reqWidth = width;
+        key.reqHeight = 100;
+        return key;
+    }
+
+    static const int kDisplay;
+
+    ScreenCaptureCache mCache{2};
+    sp<GraphicBuffer> mBuffer1{new GraphicBuffer()};
+    sp<GraphicBuffer> mBuffer2{new GraphicBuffer()};
+    sp<GraphicBuffer> mBuffer3{new GraphicBuffer()};
+};
+
+const int ScreenCaptureCacheTest::kDisplay = 0;
+
+TEST_F(ScreenCaptureCacheTest, returnsBufferOfSameCapture) {
+    const auto key = makeKey(1, 100);
+    mCache.put(key, mCache.getGeneration(), mBuffer1, true);
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    ASSERT_TRUE(mCache.get(key, &buffer, &capturedSecureLayers));
+    EXPECT_EQ(mBuffer1, buffer);
+    EXPECT_TRUE(capturedSecureLayers);
+}
+
+TEST_F(ScreenCaptureCacheTest, doesNotShareBuffersBetweenClients) {
+    mCache.put(makeKey(1, 100), mCache.getGeneration(), mBuffer1, false);
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    EXPECT_FALSE(mCache.get(makeKey(2, 100), &buffer, &capturedSecureLayers));
+    EXPECT_FALSE(mCache.get(makeKey(1, 200), &buffer, &capturedSecureLayers));
+    EXPECT_EQ(nullptr, buffer);
+}
+
+TEST_F(ScreenCaptureCacheTest, doesNotShareBuffersWithProcessReusingPid) {
+    mCache.put(makeKey(1, 100, 10000), mCache.getGeneration(), mBuffer1, false);
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    EXPECT_FALSE(mCache.get(makeKey(1, 100, 10001), &buffer, &capturedSecureLayers));
+    EXPECT_EQ(nullptr, buffer);
+}
+
+TEST_F(ScreenCaptureCacheTest, invalidateDropsCaptures) {
+    const auto key = makeKey(1, 100);
+    mCache.put(key, mCache.getGeneration(), mBuffer1, false);
+    mCache.invalidate();
+    // The buffer of the out of date capture is released right away.
+    EXPECT_EQ(0u, mCache.size());
+    EXPECT_EQ(1, mBuffer1->getStrongCount());
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    EXPECT_FALSE(mCache.get(key, &buffer, &capturedSecureLayers));
+    EXPECT_EQ(0u, mCache.size());
+}
+
+TEST_F(ScreenCaptureCacheTest, ignoresCapturesRenderedBeforeAChange) {
+    const auto key = makeKey(1, 100);
+    const uint64_t generation = mCache.getGeneration();
+    mCache.invalidate();
+    mCache.put(key, generation, mBuffer1, false);
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    EXPECT_FALSE(mCache.get(key, &buffer, &capturedSecureLayers));
+}
+
+TEST_F(ScreenCaptureCacheTest, evictsLeastRecentlyUsedCapture) {
+    const auto key1 = makeKey(1, 100);
+    const auto key2 = makeKey(2, 100);
+    const auto key3 = makeKey(3, 100);
+    mCache.put(key1, mCache.getGeneration(), mBuffer1, false);
+    mCache.put(key2, mCache.getGeneration(), mBuffer2, false);
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    ASSERT_TRUE(mCache.get(key1, &buffer, &capturedSecureLayers));
+
+    mCache.put(key3, mCache.getGeneration(), mBuffer3, false);
+    EXPECT_EQ(2u, mCache.size());
+    EXPECT_TRUE(mCache.get(key1, &buffer, &capturedSecureLayers));
+    EXPECT_FALSE(mCache.get(key2, &buffer, &capturedSecureLayers));
+    EXPECT_TRUE(mCache.get(key3, &buffer, &capturedSecureLayers));
+    EXPECT_EQ(mBuffer3, buffer);
+}
+
+TEST_F(ScreenCaptureCacheTest, replacesCaptureWithSameKey) {
+    const auto key = makeKey(1, 100);
+    mCache.put(key, mCache.getGeneration(), mBuffer1, false);
+    mCache.put(key, mCache.getGeneration(), mBuffer2, false);
+    EXPECT_EQ(1u, mCache.size());
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    ASSERT_TRUE(mCache.get(key, &buffer, &capturedSecureLayers));
+    EXPECT_EQ(mBuffer2, buffer);
+}
+
+TEST_F(ScreenCaptureCacheTest, zeroCapacityDisablesCache) {
+    EXPECT_TRUE(mCache.isEnabled());
+    mCache.setCapacity(0);
+    const auto key = makeKey(1, 100);
+    mCache.put(key, mCache.getGeneration(), mBuffer1, false);
+
+    sp<GraphicBuffer> buffer;
+    bool capturedSecureLayers = false;
+    EXPECT_FALSE(mCache.get(key, &buffer, &capturedSecureLayers));
+    EXPECT_FALSE(mCache.isEnabled());
+}
+
+TEST(ScreenCaptureStatsTest, dumpsCaptures) {
+    ScreenCaptureStats stats;
+    ScreenCaptureStats::Capture capture;
+    capture.pid = 1234;
+    capture.width = 1080;
+    capture.height = 1920;
+    capture.total = 2000000;
+    stats.record(capture);
+    capture.cacheHit = true;
+    capture.total = 50000;
+    stats.record(capture);
+    capture.cacheHit = false;
+    capture.result = PERMISSION_DENIED;
+    stats.record(capture);
+
+    std::string result;
+    stats.dump(result);
+    EXPECT_THAT(result, HasSubstr("Screen captures: 3 (cache hits: 1, failed: 1)"));
+    EXPECT_THAT(result, HasSubstr("hit        p50=0.050ms"));
+    EXPECT_THAT(result, HasSubstr("miss       p50=2.000ms"));
+    EXPECT_THAT(result, HasSubstr("pid=1234 1080x1920"));
+
+    stats.clear();
+    result.clear();
+    stats.dump(result);
+    EXPECT_EQ("Screen captures: 0 (cache hits: 0, failed: 0)\n", result);
+}
+
+} // namespace
+} // namespace android
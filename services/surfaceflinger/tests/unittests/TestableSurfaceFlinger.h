@@ -206,7 +206,14 @@ public:
     using HotplugEvent = SurfaceFlinger::HotplugEvent;
 
     auto& mutableLayerCurrentState(sp<Layer> layer) { return layer->mCurrentState; }
-    auto& mutableLayerDrawingState(sp<Layer> layer) { return layer->mDrawingState; }
+    auto& mutableLayerDrawingState(sp<Layer> layer) {
+        mFlinger->mDrawingState.invalidateTraversalCache();
+        return layer->mDrawingState;
+    }
+    auto& mutableLayerDrawingChildren(sp<Layer> layer) {
+        mFlinger->mDrawingState.invalidateTraversalCache();
+        return layer->mDrawingChildren;
+    }
 
     void setLayerSidebandStream(sp<Layer> layer, sp<NativeHandle> sidebandStream) {
         layer->mDrawingState.sidebandStream = sidebandStream;
@@ -249,6 +256,14 @@ public:
                                                        producer);
     }
 
+    void traverseDrawingStateInZOrder(const LayerVector::Visitor& visitor) {
+        mFlinger->mDrawingState.traverseInZOrder(visitor);
+    }
+
+    void traverseDrawingStateInReverseZOrder(const LayerVector::Visitor& visitor) {
+        mFlinger->mDrawingState.traverseInReverseZOrder(visitor);
+    }
+
     auto handleTransactionLocked(uint32_t transactionFlags) {
         Mutex::Autolock _l(mFlinger->mStateLock);
         return mFlinger->handleTransactionLocked(transactionFlags);
@@ -321,7 +336,11 @@ public:
     auto& mutableCurrentState() { return mFlinger->mCurrentState; }
     auto& mutableDisplayColorSetting() { return mFlinger->mDisplayColorSetting; }
     auto& mutableDisplays() { return mFlinger->mDisplays; }
-    auto& mutableDrawingState() { return mFlinger->mDrawingState; }
+    auto& mutableDrawingState() {
+        // Callers may change the layer hierarchy directly.
+        mFlinger->mDrawingState.invalidateTraversalCache();
+        return mFlinger->mDrawingState;
+    }
     auto& mutableEventQueue() { return mFlinger->mEventQueue; }
     auto& mutableGeometryInvalid() { return mFlinger->mGeometryInvalid; }
     auto& mutableInterceptor() { return mFlinger->mInterceptor; }
@@ -0,0 +1,403 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "VirtualDisplaySinkFeederTest"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "DisplayHardware/VirtualDisplaySinkFeeder.h"
+#include "mock/gui/MockGraphicBufferProducer.h"
+
+namespace android {
+namespace {
+
+using namespace std::chrono_literals;
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+
+using Policy = VirtualDisplaySinkFeeder::Policy;
+using QueueBufferInput = IGraphicBufferProducer::QueueBufferInput;
+using QueueBufferOutput = IGraphicBufferProducer::QueueBufferOutput;
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 32;
+constexpr PixelFormat kFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+constexpr uint64_t kUsage = GRALLOC_USAGE_HW_COMPOSER;
+
+QueueBufferInput makeQueueBufferInput() {
+    return QueueBufferInput(0, false, HAL_DATASPACE_UNKNOWN, Rect(kWidth, kHeight),
+                            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+}
+
+/*
+ * An async mode BufferQueue in miniature: dequeues fail with WOULD_BLOCK once the maximum number of
+ * buffers are dequeued, and queueBuffer can be held until released by the test.
+ */
+class FakeSink {
+public:
+    explicit FakeSink(mock::GraphicBufferProducer& producer) {
+        ON_CALL(producer, setMaxDequeuedBufferCount(_))
+                .WillByDefault(Invoke([this](int count) {
+                    std::lock_guard lock(mMutex);
+                    if (mFixedMaxDequeued) {
+                        return BAD_VALUE;
+                    }
+                    mMaxDequeued = count;
+                    return NO_ERROR;
+                }));
+        ON_CALL(producer, dequeueBuffer(_, _, _, _, _, _, _, _))
+                .WillByDefault(Invoke([this](int* slot, sp<Fence>* fence, uint32_t, uint32_t,
+                                             PixelFormat, uint64_t, uint64_t*,
+                                             FrameEventHistoryDelta*) {
+                    std::lock_guard lock(mMutex);
+                    if (mDequeueError != NO_ERROR) {
+                        return mDequeueError;
+                    }
+                    if (mDequeued.size() >= static_cast<size_t>(mMaxDequeued)) {
+                        return status_t(WOULD_BLOCK);
+                    }
+                    while (std::find(mDequeued.begin(), mDequeued.end(), mNextSlot) !=
+                           mDequeued.end()) {
+                        mNextSlot = (mNextSlot + 1) % kSlots;
+                    }
+                    *slot = mNextSlot;
+                    mNextSlot = (mNextSlot + 1) % kSlots;
+                    *fence = Fence::NO_FENCE;
+                    mDequeued.push_back(*slot);
+                    mCondition.notify_all();
+                    if (mBuffers[*slot] == nullptr) {
+                        mBuffers[*slot] = new GraphicBuffer();
+                        return status_t(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION);
+                    }
+                    return status_t(NO_ERROR);
+                }));
+        ON_CALL(producer, requestBuffer(_, _))
+                .WillByDefault(Invoke([this](int slot, sp<GraphicBuffer>* buffer) {
+                    std::lock_guard lock(mMutex);
+                    *buffer = mBuffers[slot];
+                    return NO_ERROR;
+                }));
+        ON_CALL(producer, queueBuffer(_, _, _))
+                .WillByDefault(Invoke([this](int slot, const QueueBufferInput&,
+                                             QueueBufferOutput* output) {
+                    std::unique_lock lock(mMutex);
+                    mQueueing++;
+                    mCondition.notify_all();
+                    mCondition.wait(lock, [this] { return !mHoldQueue; });
+                    mQueueing--;
+                    if (mQueueDelay > 0ms) {
+                        lock.unlock();
+                        std::this_thread::sleep_for(mQueueDelay);
+                        lock.lock();
+                    }
+                    release(slot);
+                    mQueued.push_back(slot);
+                    output->width = kWidth;
+                    output->height = kHeight;
+                    mCondition.notify_all();
+                    return NO_ERROR;
+                }));
+        ON_CALL(producer, cancelBuffer(_, _))
+                .WillByDefault(Invoke([this](int slot, const sp<Fence>&) {
+                    std::lock_guard lock(mMutex);
+                    release(slot);
+                    mCancelled.push_back(slot);
+                    mCondition.notify_all();
+                    return NO_ERROR;
+                }));
+    }
+
+    void setDequeueError(status_t error) {
+        std::lock_guard lock(mMutex);
+        mDequeueError = error;
+    }
+
+    // Lets the feeder hold a single buffer at a time.
+    void fixMaxDequeued() {
+        std::lock_guard lock(mMutex);
+        mFixedMaxDequeued = true;
+    }
+
+    void setQueueDelay(std::chrono::milliseconds delay) {
+        std::lock_guard lock(mMutex);
+        mQueueDelay = delay;
+    }
+
+    void holdQueue(bool hold) {
+        std::lock_guard lock(mMutex);
+        mHoldQueue = hold;
+        mCondition.notify_all();
+    }
+
+    // Waits until queueBuffer is blocked by holdQueue.
+    bool waitForHeldQueue() {
+        std::unique_lock lock(mMutex);
+        return mCondition.wait_for(lock, 1s, [this] { return mQueueing > 0; });
+    }
+
+    // Waits until the sink has no buffers dequeued but the ones expected.
+    bool waitForDequeued(size_t count) {
+        std::unique_lock lock(mMutex);
+        return mCondition.wait_for(lock, 1s, [&] { return mDequeued.size() == count; });
+    }
+
+    bool waitForQueued(size_t count) {
+        std::unique_lock lock(mMutex);
+        return mCondition.wait_for(lock, 1s, [&] { return mQueued.size() == count; });
+    }
+
+    bool waitForCancelled(size_t count) {
+        std::unique_lock lock(mMutex);
+        return mCondition.wait_for(lock, 1s, [&] { return mCancelled.size() == count; });
+    }
+
+    std::vector<int> queued() {
+        std::lock_guard lock(mMutex);
+        return mQueued;
+    }
+
+    std::vector<int> cancelled() {
+        std::lock_guard lock(mMutex);
+        return mCancelled;
+    }
+
+    sp<GraphicBuffer> buffer(int slot) {
+        std::lock_guard lock(mMutex);
+        return mBuffers[slot];
+    }
+
+private:
+    static constexpr int kSlots = 4;
+
+    void release(int slot) { mDequeued.erase(std::find(mDequeued.begin(), mDequeued.end(), slot)); }
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    int mMaxDequeued = 1;
+    bool mFixedMaxDequeued = false;
+    int mNextSlot = 0;
+    int mQueueing = 0;
+    bool mHoldQueue = false;
+    std::chrono::milliseconds mQueueDelay = 0ms;
+    status_t mDequeueError = NO_ERROR;
+    std::vector<int> mDequeued;
+    std::vector<int> mQueued;
+    std::vector<int> mCancelled;
+    sp<GraphicBuffer> mBuffers[kSlots];
+};
+
+class VirtualDisplaySinkFeederTest : public testing::Test {
+protected:
+    std::unique_ptr<VirtualDisplaySinkFeeder> createFeeder(Policy policy) {
+        return std::make_unique<VirtualDisplaySinkFeeder>(mProducer, policy, "test");
+    }
+
+    status_t dequeue(VirtualDisplaySinkFeeder& feeder, int* slot, sp<GraphicBuffer>* buffer,
+                     uint32_t width = kWidth) {
+        sp<Fence> fence;
+        return feeder.dequeueBuffer(slot, &fence, buffer, width, kHeight, kFormat, kUsage);
+    }
+
+    // Retries dequeues dropped while the feeder has yet to fetch a buffer from the sink.
+    status_t dequeueWhenReady(VirtualDisplaySinkFeeder& feeder, int* slot,
+                              sp<GraphicBuffer>* buffer) {
+        const auto deadline = std::chrono::steady_clock::now() + 1s;
+        status_t result;
+        while ((result = dequeue(feeder, slot, buffer)) == WOULD_BLOCK &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        return result;
+    }
+
+    sp<NiceMock<mock::GraphicBufferProducer>> mProducer = new NiceMock<mock::GraphicBufferProducer>;
+    FakeSink mSink{*mProducer};
+};
+
+TEST_F(VirtualDisplaySinkFeederTest, raisesMaxDequeuedBufferCountOfSink) {
+    EXPECT_CALL(*mProducer, setMaxDequeuedBufferCount(1 + VirtualDisplaySinkFeeder::kExtraBuffers))
+            .WillOnce(Return(NO_ERROR));
+    auto feeder = createFeeder(Policy::BACK_PRESSURE);
+
+    EXPECT_CALL(*mProducer, setMaxDequeuedBufferCount(2 + VirtualDisplaySinkFeeder::kExtraBuffers))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_EQ(NO_ERROR, feeder->setMaxDequeuedBufferCount(2));
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, handsOutRequestedSinkBuffers) {
+    auto feeder = createFeeder(Policy::BACK_PRESSURE);
+
+    int slot;
+    sp<GraphicBuffer> buffer;
+    status_t result = dequeue(*feeder, &slot, &buffer);
+    ASSERT_GE(result, 0);
+    EXPECT_TRUE(result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION);
+    EXPECT_EQ(mSink.buffer(slot), buffer);
+
+    feeder->queueBuffer(slot, makeQueueBufferInput());
+    ASSERT_TRUE(mSink.waitForQueued(1));
+    EXPECT_EQ(std::vector<int>{slot}, mSink.queued());
+
+    // The output is stored once queueBuffer returns to the queue thread.
+    QueueBufferOutput output;
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (!feeder->takeQueueBufferOutput(&output) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(kWidth, output.width);
+    EXPECT_FALSE(feeder->takeQueueBufferOutput(&output));
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, onlyFlagsReallocationOfNewBuffers) {
+    auto feeder = createFeeder(Policy::BACK_PRESSURE);
+
+    // The fake sink cycles through its four slots, so the fifth buffer is not a new one.
+    for (int i = 0; i < 5; i++) {
+        int slot;
+        sp<GraphicBuffer> buffer;
+        status_t result = dequeue(*feeder, &slot, &buffer);
+        ASSERT_GE(result, 0);
+        EXPECT_EQ(i < 4, (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) != 0) << i;
+        feeder->queueBuffer(slot, makeQueueBufferInput());
+    }
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, replacesReadyBufferOnParameterChange) {
+    auto feeder = createFeeder(Policy::DROP_FRAMES);
+
+    int slot;
+    sp<GraphicBuffer> buffer;
+    ASSERT_GE(dequeue(*feeder, &slot, &buffer), 0);
+    feeder->queueBuffer(slot, makeQueueBufferInput());
+    // Once the first buffer is queued, the sink only has the prefetched one dequeued.
+    ASSERT_TRUE(mSink.waitForQueued(1));
+    ASSERT_TRUE(mSink.waitForDequeued(1));
+
+    // The prefetched buffer does not have the new width, so it is cancelled.
+    ASSERT_GE(dequeue(*feeder, &slot, &buffer, kWidth * 2), 0);
+    EXPECT_TRUE(mSink.waitForCancelled(1));
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, dropsFrameWhenSinkHasNoBuffer) {
+    mSink.fixMaxDequeued();
+    auto feeder = createFeeder(Policy::DROP_FRAMES);
+
+    int slot;
+    sp<GraphicBuffer> buffer;
+    ASSERT_GE(dequeue(*feeder, &slot, &buffer), 0);
+
+    EXPECT_EQ(WOULD_BLOCK, dequeue(*feeder, &slot, &buffer));
+    EXPECT_EQ(1u, feeder->getStats().framesDropped);
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, backPressureWaitsForSinkBuffer) {
+    mSink.fixMaxDequeued();
+    auto feeder = createFeeder(Policy::BACK_PRESSURE);
+
+    int firstSlot;
+    sp<GraphicBuffer> buffer;
+    ASSERT_GE(dequeue(*feeder, &firstSlot, &buffer), 0);
+
+    std::thread release([&] {
+        std::this_thread::sleep_for(2ms);
+        feeder->queueBuffer(firstSlot, makeQueueBufferInput());
+    });
+    int slot;
+    EXPECT_GE(dequeue(*feeder, &slot, &buffer), 0);
+    release.join();
+    EXPECT_EQ(0u, feeder->getStats().framesDropped);
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, dropFramesReplacesFramesWaitingToBeQueued) {
+    auto feeder = createFeeder(Policy::DROP_FRAMES);
+    mSink.holdQueue(true);
+
+    int slots[3];
+    sp<GraphicBuffer> buffer;
+    ASSERT_GE(dequeue(*feeder, &slots[0], &buffer), 0);
+    feeder->queueBuffer(slots[0], makeQueueBufferInput());
+    ASSERT_TRUE(mSink.waitForHeldQueue());
+
+    ASSERT_GE(dequeueWhenReady(*feeder, &slots[1], &buffer), 0);
+    feeder->queueBuffer(slots[1], makeQueueBufferInput());
+    ASSERT_GE(dequeueWhenReady(*feeder, &slots[2], &buffer), 0);
+    const size_t droppedBefore = feeder->getStats().framesDropped;
+    feeder->queueBuffer(slots[2], makeQueueBufferInput());
+
+    mSink.holdQueue(false);
+    ASSERT_TRUE(mSink.waitForQueued(2));
+    EXPECT_EQ((std::vector<int>{slots[0], slots[2]}), mSink.queued());
+    EXPECT_EQ(std::vector<int>{slots[1]}, mSink.cancelled());
+    EXPECT_EQ(droppedBefore + 1, feeder->getStats().framesDropped);
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, reportsDequeueErrors) {
+    mSink.setDequeueError(NO_INIT);
+    auto feeder = createFeeder(Policy::BACK_PRESSURE);
+
+    int slot;
+    sp<GraphicBuffer> buffer;
+    EXPECT_EQ(NO_INIT, dequeue(*feeder, &slot, &buffer));
+
+    // The dequeue thread may have failed again before the sink recovered, which is reported once.
+    mSink.setDequeueError(NO_ERROR);
+    status_t result = dequeue(*feeder, &slot, &buffer);
+    if (result == NO_INIT) {
+        result = dequeue(*feeder, &slot, &buffer);
+    }
+    EXPECT_GE(result, 0);
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, returnsBuffersOnDestruction) {
+    auto feeder = createFeeder(Policy::BACK_PRESSURE);
+
+    int slot;
+    sp<GraphicBuffer> buffer;
+    ASSERT_GE(dequeue(*feeder, &slot, &buffer), 0);
+    feeder->queueBuffer(slot, makeQueueBufferInput());
+    ASSERT_TRUE(mSink.waitForQueued(1));
+
+    feeder.reset();
+    EXPECT_TRUE(mSink.waitForDequeued(0));
+}
+
+TEST_F(VirtualDisplaySinkFeederTest, queueBufferDoesNotWaitForSink) {
+    auto feeder = createFeeder(Policy::BACK_PRESSURE);
+    mSink.setQueueDelay(50ms);
+
+    int slot;
+    sp<GraphicBuffer> buffer;
+    ASSERT_GE(dequeue(*feeder, &slot, &buffer), 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    feeder->queueBuffer(slot, makeQueueBufferInput());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 50ms);
+    EXPECT_TRUE(mSink.waitForQueued(1));
+}
+
+} // namespace
+} // namespace android